@@ -0,0 +1,126 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include "api_pgsql.h"
+#include "ClanLib/Database/db_reader.h"
+
+namespace clan
+{
+
+class PgsqlConnection;
+class PgsqlBatchLoader_Impl;
+
+/// \brief Merge the lookups of concurrent callers into one query per batch.
+///
+/// The statement takes an array of keys as its only parameter, and returns
+/// the key of each row in key_column:
+/// \code
+/// PgsqlBatchLoader loader(connection, "SELECT * FROM players WHERE id = ANY(?1)", "id");
+/// DBReader reader = loader.load(player_id); // From any thread
+/// \endcode
+///
+/// The first caller of a batch waits for the connection to be free (and at
+/// least window_ms), while the keys requested by other threads in the
+/// meantime join the batch, up to max_batch_size keys. One query then
+/// returns the rows of every key, and each caller receives a reader over
+/// its own rows. Without concurrent callers, a lookup costs one query as
+/// usual, plus the window.
+///
+/// Rows go to the callers whose key equals the text of key_column, as the
+/// server prints it. String keys must be given in that form, or a caller
+/// gets no row: lowercase for a uuid, padded with spaces for a char(n), in
+/// the stored case for a citext. When the keys of the callers may differ,
+/// return a normalized key column instead, for instance
+/// SELECT *, lower(code) AS lookup_code FROM items WHERE lower(code) = ANY(?1),
+/// and pass the keys in lowercase.
+///
+/// The connection must be dedicated to the loader, which runs one query at
+/// a time on it.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlBatchLoader
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a PgsqlBatchLoader
+	///
+	/// \param connection = PgsqlConnection using the libpq engine
+	/// \param sql = Statement with an array parameter, usually ... WHERE key = ANY(?1)
+	/// \param key_column = Result column holding the key of each row
+	/// \param max_batch_size = Maximum number of distinct keys per query
+	/// \param window_ms = Minimum time a batch stays open for other keys
+	PgsqlBatchLoader(PgsqlConnection &connection, const std::string &sql, const std::string &key_column,
+		int max_batch_size = 500, int window_ms = 0);
+
+	~PgsqlBatchLoader();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Number of load calls.
+	unsigned int get_load_count() const;
+
+	/// \brief Number of queries run.
+	unsigned int get_query_count() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Return the rows of key, once the query of its batch completed.
+	///
+	/// The keys of one loader are either all integers or all strings. String
+	/// keys are compared with the server's text of key_column (see above).
+	DBReader load(long long key);
+	DBReader load(const std::string &key);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<PgsqlBatchLoader_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,170 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "api_pgsql.h"
+
+namespace clan
+{
+
+class PgsqlConnection;
+class DataBuffer;
+class DateTime;
+
+/// \brief Number of rows changed by PgsqlConnection::bulk_sync.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlBulkSyncResult
+{
+public:
+	PgsqlBulkSyncResult() : inserted(0), updated(0), deleted(0) { }
+
+	/// \brief Rows whose key was not in the table.
+	unsigned long long inserted;
+
+	/// \brief Existing rows with at least one different value.
+	unsigned long long updated;
+
+	/// \brief Rows missing from the input, when set_delete_missing is enabled.
+	unsigned long long deleted;
+};
+
+/// \brief Rows to write into a table with PgsqlConnection::bulk_sync.
+///
+/// Values are added column by column, row after row. They are kept in the
+/// binary COPY format, ready to be sent:
+/// \code
+/// PgsqlBulkSync sync("players", {"id", "name", "score"}, {"id"});
+/// for (auto &player : players)
+/// 	sync.add(player.id).add(player.name).add(player.score);
+/// PgsqlBulkSyncResult result = connection.bulk_sync(sync);
+/// \endcode
+///
+/// The values of a column must all be of one kind (integers, floating point
+/// numbers, booleans, strings and dates, or binary data) or null. They are
+/// converted to the type of the table column by the server. The key columns
+/// need a unique index, and each key may only appear once in the input.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlBulkSync
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a PgsqlBulkSync
+	///
+	/// \param table = Table to write into
+	/// \param columns = Columns receiving the values of each row
+	/// \param key_columns = Columns among columns identifying a row
+	PgsqlBulkSync(const std::string &table, const std::vector<std::string> &columns, const std::vector<std::string> &key_columns);
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Number of complete rows added.
+	int get_row_count() const;
+
+	/// \brief The rows as a whole binary COPY stream, with its header and trailer.
+	///
+	/// It can be given to PgsqlConnection::copy_from, with a COPY ... FROM
+	/// STDIN (FORMAT binary) statement naming the columns in the same order.
+	std::string get_copy_data() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Also delete the rows of the table whose key is not in the input.
+	///
+	/// \param enable = Enable or disable the deletion
+	/// \param condition = SQL condition on the columns of the table limiting
+	///        the deletion to the rows it is true for, as in WHERE (empty for all rows)
+	void set_delete_missing(bool enable, const std::string &condition = std::string());
+
+	PgsqlBulkSync &add_null();
+	PgsqlBulkSync &add(bool value);
+	PgsqlBulkSync &add(int value);
+	PgsqlBulkSync &add(long long value);
+	PgsqlBulkSync &add(double value);
+	PgsqlBulkSync &add(const char *value);
+	PgsqlBulkSync &add(const std::string &value);
+	PgsqlBulkSync &add(const DateTime &value);
+	PgsqlBulkSync &add(const DataBuffer &value);
+
+	/// \brief Remove the rows, keeping the settings.
+	void clear();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	enum ValueKind
+	{
+		no_value,
+		bool_value,
+		int_value,
+		double_value,
+		text_value,
+		binary_value
+	};
+
+	void begin_value(ValueKind kind);
+	void add_bytes(ValueKind kind, const char *data, size_t size);
+	PgsqlBulkSyncResult apply(PgsqlConnection &connection) const;
+
+	std::string table;
+	std::vector<std::string> columns;
+	std::vector<std::string> key_columns;
+	std::vector<ValueKind> column_kinds;
+	bool delete_missing;
+	std::string delete_condition;
+
+	/// \brief Body of the binary COPY data.
+	std::string data;
+	size_t value_count;
+
+	friend class PgsqlConnection;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,216 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include "api_pgsql.h"
+#include "ClanLib/Database/db_command.h"
+#include "ClanLib/Core/Math/vec2.h"
+#include "ClanLib/Core/Math/rect.h"
+#include "ClanLib/Core/Math/line_segment.h"
+#include "ClanLib/Core/Math/circle.h"
+#include <vector>
+
+namespace clan
+{
+
+class DataBuffer;
+class PgsqlCommandProvider;
+
+/// \brief PostgreSQL specific operations on a DBCommand.
+///
+/// \code
+/// DBCommand command = connection.create_command("SELECT * FROM big_table");
+/// PgsqlCommand(command).set_timeout(500);
+/// DBReader reader = connection.execute_reader(command);
+/// \endcode
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlCommand
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a PgsqlCommand
+	///
+	/// \param command = Command created by a PgsqlConnection
+	PgsqlCommand(DBCommand &command);
+
+	~PgsqlCommand();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Returns the deadline of the command (-1 = connection default, 0 = none).
+	int get_timeout() const;
+
+	/// \brief Number of rows inserted, updated, deleted... by the last execution.
+	int get_affected_rows() const;
+
+	/// \brief Id of the row inserted by the last execution, or -1.
+	///
+	/// It is the first column of the last row returned by INSERT ... RETURNING,
+	/// which is the reliable way to get it. For an INSERT without RETURNING,
+	/// it is the value of lastval(), fetched on the first call. That costs one
+	/// round trip, or four inside a transaction, where the query runs in a
+	/// savepoint so that its failure does not abort the transaction. lastval()
+	/// is the last value taken from any sequence by the session, which may be
+	/// the sequence of a trigger rather than the one of the table, and -1 if
+	/// none was used. Call it before the connection runs another command.
+	long long get_last_insert_id() const;
+
+	/// \brief Tells if results are requested in the binary format.
+	bool get_binary_results() const;
+
+	/// \brief Tells if the command may hold several statements.
+	bool get_multiple_statements() const;
+
+	/// \brief Tells if refcursors returned by the command are fetched.
+	bool get_fetch_cursors() const;
+
+	/// \brief Tells if the rows are received one at a time when a result memory budget is in force.
+	bool get_stream_results() const;
+
+	/// \brief Tells if concurrent executions of this statement share one result.
+	bool get_single_flight() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Cancel the command if it runs longer than timeout_ms.
+	///
+	/// \param timeout_ms = Deadline in milliseconds, -1 to use the connection default, 0 for none
+	void set_timeout(int timeout_ms);
+
+	/// \brief Request results in the binary format.
+	///
+	/// The server then sends numbers, dates and arrays without formatting them.
+	/// DBReader converts booleans, integers, floats, numeric, date, timestamp,
+	/// timestamptz, text, json, jsonb, xml, bytea and geometric columns; other
+	/// types throw an Exception, so read them with the text format. timestamptz
+	/// values are given in UTC, not in the TimeZone of the session. Such a
+	/// command holds a single statement.
+	void set_binary_results(bool enable);
+
+	/// \brief Allow several statements separated by semicolons, each giving a result.
+	///
+	/// The command is then sent with the simple query protocol when it has no
+	/// parameters nor binary results. Otherwise it must hold a single statement.
+	void set_multiple_statements(bool enable);
+
+	/// \brief Fetch the refcursors returned by the command.
+	///
+	/// Inside a transaction, results made only of refcursor values are replaced
+	/// by the rows of these cursors, one result per cursor.
+	void set_fetch_cursors(bool enable);
+
+	/// \brief Receive the rows of this SQL statement one at a time, charged to the result memory budgets.
+	///
+	/// Only used when a budget is set with PgsqlConnection::set_result_memory_budget
+	/// or PgsqlConnection::set_global_result_memory_budget. Read only statements
+	/// are always received this way then; enable it for the other statements
+	/// whose results may be large, like several statements or writes with RETURNING.
+	void set_stream_results(bool enable);
+
+	/// \brief Share the result of identical executions of this read only statement running at the same time.
+	///
+	/// When the statement is executed outside a transaction while the same SQL
+	/// text with the same parameters, also sharing its result, is already
+	/// running on a connection to the same server, database and user, with
+	/// the same role, search_path, TimeZone and other formatting settings, it
+	/// is not sent again: the call waits for the running one and reads a copy
+	/// of its result, or throws its exception. A caller waiting longer than
+	/// its own timeout gets a PgsqlTimeoutException.
+	///
+	/// Only enable it for statements giving the same rows to every caller:
+	/// calling nextval(), now(), random() or other volatile functions, the
+	/// callers would all get the same values. Useful when many threads miss a
+	/// cache at once for the same hot key.
+	void set_single_flight(bool enable);
+
+	/// \brief Bind a one dimensional array, sent in the binary format.
+	///
+	/// One prepared statement then serves lists of any size:
+	/// \code
+	/// DBCommand command = connection.create_command("SELECT * FROM players WHERE id = ANY(?1)");
+	/// PgsqlCommand(command).set_input_parameter_int_array(1, ids);
+	/// \endcode
+	void set_input_parameter_int16_array(int index, const std::vector<short> &values);
+	void set_input_parameter_int_array(int index, const std::vector<int> &values);
+	void set_input_parameter_int64_array(int index, const std::vector<long long> &values);
+	void set_input_parameter_float_array(int index, const std::vector<float> &values);
+	void set_input_parameter_double_array(int index, const std::vector<double> &values);
+	void set_input_parameter_string_array(int index, const std::vector<std::string> &values);
+	void set_input_parameter_binary_array(int index, const std::vector<DataBuffer> &values);
+
+	/// \brief Bind the NUMERIC value / 10^scale, sent in the binary format.
+	///
+	/// \code
+	/// PgsqlCommand(command).set_input_parameter_fixed(1, 1999, 2); // 19.99
+	/// \endcode
+	void set_input_parameter_fixed(int index, long long value, int scale);
+#ifdef __SIZEOF_INT128__
+	void set_input_parameter_fixed128(int index, __int128 value, int scale);
+#endif
+
+	/// \brief Bind a point, lseg, box, circle or polygon, sent in the binary format.
+	///
+	/// A box is built from left/top as its lower corner and right/bottom as its
+	/// upper corner.
+	void set_input_parameter_point(int index, const Vec2d &value);
+	void set_input_parameter_line_segment(int index, const LineSegment2d &value);
+	void set_input_parameter_box(int index, const Rectd &value);
+	void set_input_parameter_circle(int index, const Circled &value);
+	void set_input_parameter_polygon(int index, const std::vector<Vec2d> &points);
+	void set_input_parameter_point_array(int index, const std::vector<Vec2d> &values);
+	void set_input_parameter_line_segment_array(int index, const std::vector<LineSegment2d> &values);
+	void set_input_parameter_box_array(int index, const std::vector<Rectd> &values);
+	void set_input_parameter_circle_array(int index, const std::vector<Circled> &values);
+	void set_input_parameter_polygon_array(int index, const std::vector<std::vector<Vec2d> > &polygons);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	DBCommand command;
+	PgsqlCommandProvider *provider;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
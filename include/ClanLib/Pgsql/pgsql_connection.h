@@ -33,8 +33,12 @@
 
 #include <memory>
 #include <map>
+#include <functional>
 
 #include "api_pgsql.h"
+#include "pgsql_exception.h"
+#include "pgsql_retry_policy.h"
+#include "pgsql_bulk_sync.h"
 #include "ClanLib/Database/db_connection.h"
 
 namespace clan
@@ -52,8 +56,42 @@ public:
 
 	typedef std::map<std::string, std::string> Parameters;
 
+	/// \brief Transaction isolation levels.
+	///
+	/// default_isolation keeps the level configured on the server.
+	enum IsolationLevel
+	{
+		default_isolation,
+		read_committed,
+		repeatable_read,
+		serializable
+	};
+
+	/// \brief What happens to a result exceeding a memory budget.
+	enum ResultOverflow
+	{
+		spill_to_disk,
+		throw_on_overflow
+	};
+
+	/// \brief Receives the rows of copy_to, one at a time.
+	///
+	/// data points to length bytes, reused once the function returns.
+	typedef std::function<void(const char *data, int length)> CopyHandler;
+
 	/// \brief Constructs a PgsqlConnection
 	///
+	/// The extra parameter clanpgsql_engine=native selects the experimental
+	/// native engine, which reads rows straight from the network buffers
+	/// instead of going through libpq. It is incomplete: it only supports
+	/// plain TCP or Unix socket connections to a single host, trust, password,
+	/// md5 and SCRAM-SHA-256 authentication, the DBConnection interface plus
+	/// begin_transaction, copy_from, copy_to and PgsqlNotificationDispatcher.
+	/// The rows of COPY TO STDOUT can also be read with a DBReader. The
+	/// features of PgsqlCommand, PgsqlReader and the other Pgsql classes taking
+	/// a connection (timeouts, memory budgets, single flight...) throw an
+	/// Exception: they need the default libpq engine.
+	///
 	/// \param parameters = List of std::paire<Key, Value>
 	PgsqlConnection(const Parameters &parameters);
 
@@ -62,6 +100,7 @@ public:
 	/// \param connection_string = Parameters as a string.
 	///        If empty, default parameters are used.
 	///        It could be a connection uri. (see libpq-connect documentation)
+	///        clanpgsql_engine may be given as a key=value pair or URI query parameter.
 	PgsqlConnection(const std::string &connecton_tring);
 
 	~PgsqlConnection();
@@ -77,6 +116,88 @@ public:
 /// \{
 
 public:
+	using DBConnection::begin_transaction;
+
+	/// \brief Cancel commands still running after timeout_ms (0 = no deadline).
+	///
+	/// Expired commands are cancelled on the server and throw a
+	/// PgsqlTimeoutException. PgsqlCommand::set_timeout overrides this value.
+	void set_default_timeout(int timeout_ms);
+
+	/// \brief Also send deadlines to the server as SET LOCAL statement_timeout.
+	///
+	/// Only applies inside transactions, and costs one more round trip per
+	/// command. The server then aborts the statement even if the client dies.
+	void set_statement_timeout_propagation(bool enable);
+
+	/// \brief Limit the memory held by the results of this connection (0 = no limit).
+	///
+	/// Once a budget is set, here or with set_global_result_memory_budget,
+	/// read only statements (a single SELECT, WITH, SHOW, VALUES or TABLE not
+	/// writing nor locking rows) and statements enabling
+	/// PgsqlCommand::set_stream_results are received one row at a time, and
+	/// every row is charged to the budgets as it arrives. A result going over
+	/// one of them is either moved to a temporary file that the reader maps in
+	/// memory, or cancelled with a PgsqlResultTooLargeException.
+	///
+	/// The results of the other commands (several statements, writes with
+	/// RETURNING, stored procedures...) can only be measured once received
+	/// whole: each one is then charged with its PQresultMemorySize, and one
+	/// over a budget is moved to a temporary file or throws the same way.
+	/// Their peak memory use is not bounded.
+	///
+	/// Results moved to disk can only be read through DBReader and PgsqlReader.
+	///
+	/// \param max_bytes = Budget of this connection, counted with PQresultMemorySize.
+	/// \param overflow = What to do with a result over budget, also used for the global budget.
+	/// \param spill_directory = Where to create the temporary files; empty for TMPDIR or /tmp.
+	void set_result_memory_budget(size_t max_bytes, ResultOverflow overflow = spill_to_disk, const std::string &spill_directory = std::string());
+
+	/// \brief Limit the memory held by the results of all connections together (0 = no limit).
+	static void set_global_result_memory_budget(size_t max_bytes);
+
+	/// \brief Start a transaction with the given isolation level.
+	DBTransaction begin_transaction(IsolationLevel isolation, DBTransaction::Type type = DBTransaction::default_transaction);
+
+	/// \brief Run fn inside a transaction, running it again on serialization failure or deadlock.
+	///
+	/// The transaction is committed when fn returns. If fn or the commit
+	/// throws a PgsqlException allowed by the policy, the transaction is
+	/// rolled back and fn is called again after a jittered backoff.
+	/// Any other exception, or the last retryable one, is rethrown.
+	///
+	/// \param fn = Unit of work. It must only touch this connection and
+	///        must not keep side effects from an aborted attempt.
+	/// \param policy = Limits on the number of attempts and delays.
+	/// \param isolation = Isolation level of each attempt.
+	void run_transaction(const std::function<void()> &fn,
+		const PgsqlRetryPolicy &policy = PgsqlRetryPolicy(),
+		IsolationLevel isolation = serializable);
+
+	/// \brief Write the rows of sync into its table, inserting new keys and updating the others.
+	///
+	/// The rows are sent with one binary COPY into a temporary table, then
+	/// applied with one INSERT ... ON CONFLICT DO UPDATE, which leaves rows
+	/// without changes untouched, and one DELETE if set_delete_missing is
+	/// enabled. Everything runs in the active transaction, or in a
+	/// transaction of its own.
+	PgsqlBulkSyncResult bulk_sync(const PgsqlBulkSync &sync);
+
+	/// \brief Run a COPY ... FROM STDIN statement with data as its input.
+	///
+	/// data holds the rows in the format given to COPY: lines of text or csv,
+	/// or the whole binary stream with its header and trailer.
+	///
+	/// \return Number of rows copied.
+	long long copy_from(const std::string &sql, const std::string &data);
+
+	/// \brief Run a COPY ... TO STDOUT statement, passing each row to handler.
+	///
+	/// If handler throws, the statement is cancelled and the exception is
+	/// rethrown once the connection is ready for the next command.
+	///
+	/// \return Number of rows copied.
+	long long copy_to(const std::string &sql, const CopyHandler &handler);
 
 /// \}
 /// \name Implementation
@@ -0,0 +1,153 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include "api_pgsql.h"
+#include "ClanLib/Core/System/exception.h"
+
+namespace clan
+{
+
+/// \brief Exception thrown when the PostgreSQL server reports an error.
+///
+/// Carries the fields of the server error report, so that callers can
+/// test the SQLSTATE instead of matching the message text.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlException : public Exception
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a PgsqlException
+	///
+	/// \param message = Full error message, as given by libpq
+	/// \param sqlstate = Five characters SQLSTATE code (may be empty)
+	/// \param severity = Severity (ERROR, FATAL, PANIC...)
+	/// \param detail = Optional secondary message
+	/// \param hint = Optional suggestion
+	PgsqlException(const std::string &message,
+		const std::string &sqlstate = std::string(),
+		const std::string &severity = std::string(),
+		const std::string &detail = std::string(),
+		const std::string &hint = std::string());
+
+	~PgsqlException() throw();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Returns the SQLSTATE code of the error, or an empty string if unknown.
+	const std::string &get_sqlstate() const { return sqlstate; }
+
+	/// \brief Returns the severity of the error (ERROR, FATAL, PANIC...).
+	const std::string &get_severity() const { return severity; }
+
+	/// \brief Returns the secondary message of the error, if any.
+	const std::string &get_detail() const { return detail; }
+
+	/// \brief Returns the suggestion given by the server, if any.
+	const std::string &get_hint() const { return hint; }
+
+	/// \brief Returns the SQLSTATE class (the two first characters).
+	std::string get_sqlstate_class() const;
+
+	/// \brief True if the error is a serialization failure (40001).
+	bool is_serialization_failure() const;
+
+	/// \brief True if the error is a detected deadlock (40P01).
+	bool is_deadlock() const;
+
+	/// \brief True if re-running the whole transaction may succeed.
+	bool is_transaction_retryable() const;
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::string sqlstate;
+	std::string severity;
+	std::string detail;
+	std::string hint;
+/// \}
+};
+
+/// \brief Exception thrown when a command was cancelled because its deadline expired.
+///
+/// The connection stays usable. If the command ran inside a transaction,
+/// that transaction is aborted and must be rolled back.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlTimeoutException : public PgsqlException
+{
+public:
+	/// \brief Constructs a PgsqlTimeoutException
+	///
+	/// \param timeout_ms = The deadline which expired
+	PgsqlTimeoutException(int timeout_ms);
+	~PgsqlTimeoutException() throw();
+
+	/// \brief The deadline which expired, in milliseconds.
+	int get_timeout() const { return timeout_ms; }
+
+private:
+	int timeout_ms;
+};
+
+/// \brief Exception thrown when a result exceeds its memory budget and the connection does not spill to disk.
+///
+/// The command was cancelled and the rows received so far were dropped.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlResultTooLargeException : public PgsqlException
+{
+public:
+	/// \brief Constructs a PgsqlResultTooLargeException
+	///
+	/// \param budget = The budget which was exceeded, in bytes
+	PgsqlResultTooLargeException(size_t budget);
+	~PgsqlResultTooLargeException() throw();
+
+	/// \brief The budget which was exceeded, in bytes.
+	size_t get_budget() const { return budget; }
+
+private:
+	size_t budget;
+};
+
+}; // namespace clan
+
+/// \}
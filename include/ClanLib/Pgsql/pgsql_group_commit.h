@@ -0,0 +1,121 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "api_pgsql.h"
+
+namespace clan
+{
+
+class PgsqlConnection;
+class PgsqlGroupCommit_Impl;
+
+/// \brief Commit the small transactions of concurrent callers together.
+///
+/// Each call to execute() is a unit of work that would otherwise run in a
+/// transaction of its own. Units requested by other threads while the
+/// connection is busy, or within window_ms of the first one, form a group
+/// which runs in a single transaction:
+/// \code
+/// PgsqlGroupCommit group(connection);
+/// group.execute([&](PgsqlConnection &connection) // From any thread
+/// {
+/// 	DBCommand command = connection.create_command("INSERT INTO unlocks (player, achievement) VALUES (?1, ?2)");
+/// 	command.set_input_parameter_int(1, player_id);
+/// 	command.set_input_parameter_int(2, achievement_id);
+/// 	connection.execute_non_query(command);
+/// });
+/// \endcode
+///
+/// The units of a group run one after another on the thread of its first
+/// caller, each behind a savepoint: a unit that throws only rolls back its
+/// own changes, and its caller receives the exception. Every other caller
+/// returns once the group committed, or receives the error which prevented
+/// the commit, in which case none of the units were committed.
+///
+/// Units must only use the connection they are given, must not begin or end
+/// transactions, and must not call execute() themselves. The connection
+/// must be dedicated to the group commit.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlGroupCommit
+{
+/// \name Construction
+/// \{
+
+public:
+	typedef std::function<void(PgsqlConnection &connection)> Unit;
+
+	/// \brief Constructs a PgsqlGroupCommit
+	///
+	/// \param connection = PgsqlConnection using the libpq engine
+	/// \param max_units = Maximum number of units per transaction
+	/// \param window_ms = Minimum time a group stays open for other units
+	PgsqlGroupCommit(PgsqlConnection &connection, int max_units = 64, int window_ms = 0);
+
+	~PgsqlGroupCommit();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Number of units executed.
+	unsigned int get_unit_count() const;
+
+	/// \brief Number of transactions run.
+	unsigned int get_commit_count() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Run unit in the next group, and return once the group committed.
+	void execute(const Unit &unit);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<PgsqlGroupCommit_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
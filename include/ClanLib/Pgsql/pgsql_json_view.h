@@ -0,0 +1,147 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api_pgsql.h"
+
+namespace clan
+{
+
+class JsonValue;
+class PgsqlJsonView_Impl;
+
+/// \brief Read only view of a JSON document, parsed on demand.
+///
+/// Building a view only locates the structural characters of the document
+/// (braces, brackets, colons, commas and the start of every value), 16 bytes
+/// at a time with SSE2 when the compiler targets it, and pairs the braces
+/// and brackets. Values are decoded when they are read, so fetching one
+/// field of a large payload skips the rest of it:
+/// \code
+/// PgsqlJsonView settings = PgsqlReader(reader).get_column_json(2);
+/// double volume = settings["audio"]["volume"].to_number();
+/// std::string theme = settings.get_path("ui.theme").to_string();
+/// \endcode
+///
+/// Views of the values of a document share it; they are cheap to copy and
+/// may be read from several threads. Looking up a missing member or item
+/// gives an undefined view rather than throwing, and malformed values
+/// throw an Exception when they are read.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlJsonView
+{
+/// \name Construction
+/// \{
+
+public:
+	enum Type
+	{
+		type_undefined,
+		type_null,
+		type_object,
+		type_array,
+		type_string,
+		type_number,
+		type_boolean
+	};
+
+	/// \brief Constructs an undefined view.
+	PgsqlJsonView();
+
+	/// \brief Index a JSON document.
+	///
+	/// Throws an Exception if its braces, brackets or quotes do not match.
+	PgsqlJsonView(const std::string &json);
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	Type get_type() const;
+
+	bool is_undefined() const { return get_type() == type_undefined; }
+	bool is_null() const { return get_type() == type_null; }
+
+	/// \brief Number of members of an object or items of an array, 0 for other values.
+	int get_size() const;
+
+	/// \brief Names of the members of an object, in document order.
+	std::vector<std::string> get_member_names() const;
+
+	/// \brief Member of an object, or an undefined view.
+	PgsqlJsonView operator[](const std::string &name) const;
+	PgsqlJsonView operator[](const char *name) const { return (*this)[std::string(name)]; }
+
+	/// \brief Item of an array, or an undefined view.
+	PgsqlJsonView operator[](int index) const;
+
+	/// \brief Value at a path of member names and array indexes separated by dots ("items.3.id").
+	PgsqlJsonView get_path(const std::string &path) const;
+
+	/// \brief Text of a string, with its escape sequences decoded.
+	std::string to_string() const;
+
+	double to_number() const;
+
+	/// \brief Value of a number without fraction nor exponent.
+	long long to_int64() const;
+
+	bool to_boolean() const;
+
+	/// \brief JSON text of the value, as it appears in the document.
+	std::string to_json() const;
+
+	/// \brief Parse the value into a JsonValue tree.
+	JsonValue to_json_value() const;
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	PgsqlJsonView(const std::shared_ptr<const PgsqlJsonView_Impl> &impl, int token);
+
+	std::shared_ptr<const PgsqlJsonView_Impl> impl;
+	int token;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,160 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+
+#include "api_pgsql.h"
+
+namespace clan
+{
+
+class IODevice;
+class PgsqlConnection;
+class PgsqlLargeObject_Impl;
+
+/// \brief Stream over a PostgreSQL large object (lo_* functions).
+///
+/// Large objects are read and written by chunks, so huge blobs never have to
+/// be held in memory at once, unlike bytea columns. Their identifier (an oid)
+/// is stored in the rows referencing them.
+///
+/// Large object descriptors only live until the end of the transaction, so a
+/// large object must be opened and used inside a transaction.
+/// Destroying the object after its transaction ended does not close the
+/// descriptor again, even if the connection runs another transaction by then.
+///
+/// \code
+/// DBTransaction transaction = connection.begin_transaction();
+/// PgsqlLargeObject replay = PgsqlLargeObject::create(connection);
+/// replay.copy_from(file);
+/// DBCommand command = connection.create_command("INSERT INTO replays (data) VALUES (?1)");
+/// command.set_input_parameter_int(1, replay.get_oid());
+/// connection.execute_non_query(command);
+/// transaction.commit();
+/// \endcode
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlLargeObject
+{
+/// \name Construction
+/// \{
+
+public:
+	enum OpenMode
+	{
+		open_read = 1,
+		open_write = 2,
+		open_read_write = 3
+	};
+
+	enum SeekMode
+	{
+		seek_set,
+		seek_cur,
+		seek_end
+	};
+
+	/// \brief Constructs a null instance.
+	PgsqlLargeObject();
+
+	/// \brief Open the large object oid.
+	PgsqlLargeObject(PgsqlConnection &connection, unsigned int oid, OpenMode mode = open_read);
+
+	~PgsqlLargeObject();
+
+	/// \brief Create an empty large object and open it for reading and writing.
+	static PgsqlLargeObject create(PgsqlConnection &connection);
+
+	/// \brief Delete the large object oid.
+	static void unlink(PgsqlConnection &connection, unsigned int oid);
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	bool is_null() const { return !impl; }
+
+	/// \brief Identifier of the large object.
+	unsigned int get_oid() const;
+
+	/// \brief Current read/write position.
+	long long get_position() const;
+
+	/// \brief Size of the large object in bytes.
+	long long get_size() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Read up to size bytes at the current position; returns the number read (0 at the end).
+	int read(void *data, int size);
+
+	/// \brief Write size bytes at the current position.
+	void write(const void *data, int size);
+
+	/// \brief Move the current position; returns the new position.
+	long long seek(long long offset, SeekMode mode = seek_set);
+
+	/// \brief Truncate (or extend with zeros) the large object to size bytes.
+	void truncate(long long size);
+
+	/// \brief Write the large object, from the current position to its end, to device.
+	///
+	/// \param chunk_size = Bytes read at once; this bounds the memory used.
+	/// \return Number of bytes copied.
+	long long copy_to(IODevice &device, int chunk_size = 256 * 1024);
+
+	/// \brief Write everything device returns at the current position.
+	///
+	/// \param chunk_size = Bytes read at once; this bounds the memory used.
+	/// \return Number of bytes copied.
+	long long copy_from(IODevice &device, int chunk_size = 256 * 1024);
+
+	/// \brief Close the descriptor. Also done when the last copy of the object is destroyed.
+	void close();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<PgsqlLargeObject_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,149 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "api_pgsql.h"
+
+namespace clan
+{
+
+class Exception;
+class PgsqlConnection;
+class PgsqlNotificationDispatcher_Impl;
+
+/// \brief Asynchronous notification received from the server (NOTIFY).
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlNotification
+{
+public:
+	PgsqlNotification() : backend_pid(0) { }
+	PgsqlNotification(const std::string &channel, const std::string &payload, int backend_pid)
+	: channel(channel), payload(payload), backend_pid(backend_pid) { }
+
+	/// \brief Channel name given to NOTIFY.
+	std::string channel;
+
+	/// \brief Payload string (empty if none was given).
+	std::string payload;
+
+	/// \brief Process ID of the notifying server process.
+	int backend_pid;
+};
+
+/// \brief Dispatch LISTEN/NOTIFY notifications to registered handlers.
+///
+/// The dispatcher watches the socket of a connection and calls the handlers
+/// subscribed to a channel with each notification received on it.
+/// Notifications can be pumped from a user loop with process(), or by a
+/// background thread with start(). In the latter case, the connection should
+/// be dedicated to the dispatcher, since connections must not be used
+/// from several threads at once.
+///
+/// If the connection is lost, it is reset and every subscribed channel is
+/// listened to again. When the reset fails, process() throws an Exception;
+/// the background thread reports it to the error handler and retries with
+/// a growing delay.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlNotificationDispatcher
+{
+/// \name Construction
+/// \{
+
+public:
+	typedef std::function<void(const PgsqlNotification &)> Handler;
+	typedef std::function<void(const Exception &error)> ErrorHandler;
+
+	/// \brief Constructs a PgsqlNotificationDispatcher
+	///
+	/// \param connection = Connection to receive notifications on
+	PgsqlNotificationDispatcher(PgsqlConnection &connection);
+
+	~PgsqlNotificationDispatcher();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief True while the background thread runs.
+	bool is_running() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Call handler for each notification on channel (issues LISTEN the first time).
+	void subscribe(const std::string &channel, const Handler &handler);
+
+	/// \brief Remove all handlers of channel and issue UNLISTEN.
+	void unsubscribe(const std::string &channel);
+
+	/// \brief Wait up to timeout_ms for notifications and dispatch them.
+	///
+	/// \param timeout_ms = Maximum wait, 0 to only dispatch what already arrived, -1 to wait forever.
+	/// \return Number of notifications dispatched.
+	int process(int timeout_ms = 0);
+
+	/// \brief Start a background thread which dispatches notifications as they arrive.
+	void start();
+
+	/// \brief Call handler with each error met by the background thread.
+	///
+	/// Errors include lost connections and exceptions thrown by notification
+	/// handlers. Set it before start().
+	void set_error_handler(const ErrorHandler &handler);
+
+	/// \brief Stop the background thread, if any.
+	void stop();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	PgsqlNotificationDispatcher(const PgsqlNotificationDispatcher &);
+	PgsqlNotificationDispatcher &operator=(const PgsqlNotificationDispatcher &);
+
+	std::shared_ptr<PgsqlNotificationDispatcher_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,213 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+#include <utility>
+
+#include "api_pgsql.h"
+
+namespace clan
+{
+
+class DBReader;
+class DataBuffer;
+class DateTime;
+class PgsqlRowSource;
+class PgsqlParallelDecoder_Impl;
+
+/// \brief One row of a result, read without moving any reader.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlRowView
+{
+/// \name Construction
+/// \{
+
+public:
+	PgsqlRowView(const PgsqlRowSource *source, int row) : source(source), row(row) { }
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Index of the row in the result.
+	int get_row() const { return row; }
+
+	/// \brief Another row of the same result.
+	PgsqlRowView at(int other_row) const { return PgsqlRowView(source, other_row); }
+
+	int get_column_count() const;
+	int get_name_index(const std::string &name) const;
+	bool is_null(int index) const;
+	std::string get_column_string(int index) const;
+	bool get_column_bool(int index) const;
+	int get_column_int(int index) const;
+	unsigned int get_column_uint(int index) const;
+	long long get_column_int64(int index) const;
+	double get_column_double(int index) const;
+	DateTime get_column_datetime(int index) const;
+	DataBuffer get_column_binary(int index) const;
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	const PgsqlRowSource *source;
+	int row;
+/// \}
+};
+
+/// \brief Decode the rows of a result on a pool of threads.
+///
+/// The rows of the current result of a reader are split into chunks of
+/// consecutive rows. Each thread of the pool starts with its own share of
+/// the chunks and steals chunks from the other threads once it is done, so
+/// uneven rows don't leave threads idle. The calling thread works too.
+///
+/// Each chunk writes to its own output, so threads never share writes.
+/// Functions given to the decoder are called from several threads at once.
+///
+/// \code
+/// PgsqlParallelDecoder decoder;
+/// std::vector<Item> items = decoder.transform<Item>(reader, [](const PgsqlRowView &row, std::vector<Item> &out)
+/// {
+///     out.push_back(Item(row.get_column_int(0), row.get_column_string(1)));
+/// });
+/// \endcode
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlParallelDecoder
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Called for rows [first.get_row(), first.get_row() + count) of chunk.
+	typedef std::function<void(int chunk, const PgsqlRowView &first, int count)> ChunkFunction;
+
+	/// \brief Constructs a PgsqlParallelDecoder
+	///
+	/// \param thread_count = Threads working on a result, including the caller (0 = one per core)
+	/// \param chunk_rows = Rows per chunk
+	PgsqlParallelDecoder(int thread_count = 0, int chunk_rows = 1024);
+
+	~PgsqlParallelDecoder();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	int get_thread_count() const;
+	int get_chunk_rows() const;
+
+	/// \brief Number of rows in the current result of reader.
+	static int get_row_count(DBReader &reader);
+
+	/// \brief Number of chunks a result of row_count rows is split into.
+	int get_chunk_count(int row_count) const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Call fn for every chunk of the current result of reader, and wait for all.
+	///
+	/// \param completion_order = If not null, receives the chunk indices in the order they completed.
+	void for_each_chunk(DBReader &reader, const ChunkFunction &fn, std::vector<int> *completion_order = nullptr);
+
+	/// \brief Returns fn(row) for every row, in row order.
+	template<typename T>
+	std::vector<T> map(DBReader &reader, const std::function<T(const PgsqlRowView &row)> &fn)
+	{
+		std::vector<T> values(get_row_count(reader));
+		for_each_chunk(reader, [&](int, const PgsqlRowView &first, int count)
+		{
+			for (int row = first.get_row(), end = row + count; row < end; row++)
+				values[row] = fn(first.at(row));
+		});
+		return values;
+	}
+
+	/// \brief Returns everything fn(row, out) appends to out for every row.
+	///
+	/// \param keep_order = If false, the output of the chunks is joined in the order they completed.
+	template<typename T>
+	std::vector<T> transform(DBReader &reader, const std::function<void(const PgsqlRowView &row, std::vector<T> &out)> &fn, bool keep_order = true)
+	{
+		std::vector<std::vector<T> > chunks(get_chunk_count(get_row_count(reader)));
+		std::vector<int> order;
+		for_each_chunk(reader, [&](int chunk, const PgsqlRowView &first, int count)
+		{
+			std::vector<T> &out = chunks[chunk];
+			out.reserve(count);
+			for (int row = first.get_row(), end = row + count; row < end; row++)
+				fn(first.at(row), out);
+		}, keep_order ? nullptr : &order);
+
+		size_t total = 0;
+		for (size_t i = 0; i < chunks.size(); i++)
+			total += chunks[i].size();
+
+		std::vector<T> values;
+		values.reserve(total);
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			std::vector<T> &chunk = chunks[keep_order ? i : order[i]];
+			for (size_t j = 0; j < chunk.size(); j++)
+				values.push_back(std::move(chunk[j]));
+		}
+		return values;
+	}
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	PgsqlParallelDecoder(const PgsqlParallelDecoder &);
+	PgsqlParallelDecoder &operator=(const PgsqlParallelDecoder &);
+
+	std::shared_ptr<PgsqlParallelDecoder_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,140 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "api_pgsql.h"
+#include "ClanLib/Database/db_reader.h"
+
+namespace clan
+{
+
+class PgsqlParallelScan_Impl;
+
+/// \brief Scan a query by partitions, on several connections at once.
+///
+/// The query is split into partitions by a key expression, either by hash or
+/// by ranges of values, and the partitions are run concurrently, each
+/// connection taking the next partition left. All connections read the same
+/// snapshot of the database: the first one exports it (pg_export_snapshot)
+/// and the others import it (SET TRANSACTION SNAPSHOT), so the partitions
+/// are consistent with each other.
+///
+/// A partition is "SELECT * FROM (query) WHERE <predicate on key>", so the
+/// key expression can only use the columns returned by the query.
+///
+/// \code
+/// PgsqlParallelScan scan(connection_string, 8);
+/// scan.set_hash_partitions("player_id", 32);
+/// scan.run("SELECT * FROM inventory", [&](int partition, DBReader &reader)
+/// {
+///     while (reader.retrieve_row())
+///         ...  // Called from 8 threads at once
+/// });
+/// \endcode
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlParallelScan
+{
+/// \name Construction
+/// \{
+
+public:
+	typedef std::function<void(int partition, DBReader &reader)> PartitionHandler;
+
+	/// \brief Constructs a PgsqlParallelScan
+	///
+	/// \param connection_string = Parameters of the connections (see PgsqlConnection)
+	/// \param connection_count = Number of connections opened, and partitions run at once
+	PgsqlParallelScan(const std::string &connection_string, int connection_count);
+
+	~PgsqlParallelScan();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	int get_connection_count() const;
+
+	/// \brief Number of partitions a query is split into.
+	int get_partition_count() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Split queries into count partitions by hash of key (hashtext(key::text) modulo count).
+	///
+	/// Rows where key is NULL go to the first partition.
+	void set_hash_partitions(const std::string &key, int count);
+
+	/// \brief Split queries by ranges of key: key < bounds[0], bounds[0] <= key < bounds[1], ..., key >= bounds.back().
+	///
+	/// Rows where key is NULL go to the first partition.
+	///
+	/// \param bounds = Increasing values; there are bounds.size() + 1 partitions.
+	void set_range_partitions(const std::string &key, const std::vector<long long> &bounds);
+
+	/// \brief Run the partitions of query and call handler with the rows of each.
+	///
+	/// handler is called from one thread per connection, so the rows of the
+	/// partitions are read concurrently. If a partition fails, the remaining
+	/// ones are skipped and the first exception is thrown once all threads ended.
+	void run(const std::string &query, const PartitionHandler &handler);
+
+	/// \brief Run the partitions of query and return the reader of each, in partition order.
+	std::vector<DBReader> execute_readers(const std::string &query);
+
+	/// \brief Run the partitions of query and return their rows as one stream, in partition order.
+	DBReader execute_reader(const std::string &query);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	PgsqlParallelScan(const PgsqlParallelScan &);
+	PgsqlParallelScan &operator=(const PgsqlParallelScan &);
+
+	std::shared_ptr<PgsqlParallelScan_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,163 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include "api_pgsql.h"
+#include "ClanLib/Database/db_reader.h"
+#include "ClanLib/Core/Math/vec2.h"
+#include "ClanLib/Core/Math/rect.h"
+#include "ClanLib/Core/Math/line_segment.h"
+#include "ClanLib/Core/Math/circle.h"
+#include <vector>
+
+namespace clan
+{
+
+class DataBuffer;
+class PgsqlReaderProvider;
+class PgsqlSnapshotReaderProvider;
+class PgsqlValue;
+class PgsqlJsonView;
+
+/// \brief PostgreSQL specific operations on a DBReader.
+///
+/// A command without parameters may hold several queries when
+/// PgsqlCommand::set_multiple_statements is enabled; each one gives a result.
+/// With PgsqlCommand::set_fetch_cursors, functions and procedures returning
+/// refcursors have them fetched when called inside a transaction, each cursor
+/// giving one result.
+///
+/// \code
+/// DBCommand command = connection.create_command(
+///     "SELECT * FROM profile WHERE id = 42; SELECT * FROM inventory WHERE owner = 42");
+/// PgsqlCommand(command).set_multiple_statements(true);
+/// DBReader reader = connection.execute_reader(command);
+/// PgsqlReader results(reader);
+/// do
+/// {
+///     while (reader.retrieve_row())
+///         ...
+/// } while (results.next_result());
+/// \endcode
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlReader
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a PgsqlReader
+	///
+	/// \param reader = Reader returned by a PgsqlConnection or a PgsqlResultCache
+	PgsqlReader(DBReader &reader);
+
+	~PgsqlReader();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Number of results returned by the command.
+	int get_result_count() const;
+
+	/// \brief Returns the one dimensional array in a column of the current row.
+	///
+	/// Arrays are decoded from the binary or the text format. Integer arrays may be
+	/// read into wider integers, and float4 arrays as doubles. NULL elements give
+	/// empty strings and buffers; in numeric arrays they throw an Exception.
+	std::vector<short> get_column_int16_array(int index) const;
+	std::vector<int> get_column_int_array(int index) const;
+	std::vector<long long> get_column_int64_array(int index) const;
+	std::vector<float> get_column_float_array(int index) const;
+	std::vector<double> get_column_double_array(int index) const;
+	std::vector<std::string> get_column_string_array(int index) const;
+	std::vector<DataBuffer> get_column_binary_array(int index) const;
+
+	/// \brief Returns a NUMERIC or integer column as a fixed point integer: its value times 10^scale.
+	///
+	/// Binary results are converted straight from the base 10000 digits of
+	/// the server, without going through text or floating point. Digits
+	/// beyond scale are rounded half away from zero. Values which do not fit,
+	/// NaN and infinities throw an Exception.
+	long long get_column_fixed(int index, int scale) const;
+#ifdef __SIZEOF_INT128__
+	__int128 get_column_fixed128(int index, int scale) const;
+#endif
+
+	/// \brief Returns a json or jsonb column as a lazily parsed view.
+	///
+	/// Only the structure of the document is indexed; members are decoded
+	/// when they are read.
+	PgsqlJsonView get_column_json(int index) const;
+
+	/// \brief Returns a point, lseg, box, circle or polygon column as a ClanLib math type.
+	///
+	/// Binary results are read straight from their float8 coordinates. A box
+	/// maps its lower corner to left/top and its upper corner to right/bottom.
+	/// Paths are read as polygons. Arrays of these types are read the same way.
+	Vec2d get_column_point(int index) const;
+	LineSegment2d get_column_line_segment(int index) const;
+	Rectd get_column_box(int index) const;
+	Circled get_column_circle(int index) const;
+	std::vector<Vec2d> get_column_polygon(int index) const;
+	std::vector<Vec2d> get_column_point_array(int index) const;
+	std::vector<LineSegment2d> get_column_line_segment_array(int index) const;
+	std::vector<Rectd> get_column_box_array(int index) const;
+	std::vector<Circled> get_column_circle_array(int index) const;
+	std::vector<std::vector<Vec2d> > get_column_polygon_array(int index) const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Move the reader to the next result; returns false after the last one.
+	bool next_result();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	PgsqlValue get_column_value(int index) const;
+
+	DBReader reader;
+	PgsqlReaderProvider *provider;
+	PgsqlSnapshotReaderProvider *snapshot_provider;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,296 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "api_pgsql.h"
+#include "pgsql_connection.h"
+
+namespace clan
+{
+
+class Exception;
+class PgsqlReplicationStream_Impl;
+
+/// \brief Table described by the server before the first change made to it.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlReplicationRelation
+{
+public:
+	PgsqlReplicationRelation() : relation_id(0), replica_identity('d') { }
+
+	struct Column
+	{
+		Column() : type(0), type_modifier(-1), is_key(false) { }
+		std::string name;
+		unsigned int type;
+		int type_modifier;
+
+		/// \brief True if the column is part of the replica identity (usually the primary key).
+		bool is_key;
+	};
+
+	/// \brief Returns the index of the column called name, or -1.
+	int get_column_index(const std::string &name) const;
+
+	/// \brief Oid of the table on the server.
+	unsigned int relation_id;
+
+	/// \brief Schema name (empty for pg_catalog).
+	std::string schema;
+
+	std::string table;
+
+	/// \brief REPLICA IDENTITY of the table: 'd'efault, 'n'othing, 'f'ull or 'i'ndex.
+	char replica_identity;
+
+	std::vector<Column> columns;
+};
+
+/// \brief One row inserted, updated or deleted, or one table truncated.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlReplicationChange
+{
+public:
+	enum Type
+	{
+		row_inserted,
+		row_updated,
+		row_deleted,
+		table_truncated
+	};
+
+	enum ValueState
+	{
+		value_null,
+
+		/// \brief Large (TOASTed) value left untouched by an update; it is not sent again.
+		value_unchanged,
+
+		value_text
+	};
+
+	struct Value
+	{
+		Value() : state(value_null) { }
+		ValueState state;
+
+		/// \brief Value in text format, as returned by a query.
+		std::string text;
+	};
+
+	PgsqlReplicationChange() : type(row_inserted), old_values_are_key(false) { }
+
+	Type type;
+
+	std::shared_ptr<const PgsqlReplicationRelation> relation;
+
+	/// \brief Row before an update or a delete, one value per column of the relation.
+	///
+	/// Empty for an update unless the key changed or the table has REPLICA IDENTITY FULL.
+	std::vector<Value> old_values;
+
+	/// \brief True if old_values only holds the key columns (the other ones are null).
+	bool old_values_are_key;
+
+	/// \brief Row after an insert or an update.
+	std::vector<Value> new_values;
+};
+
+/// \brief Changes committed by one transaction, in the order they were made.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlReplicationTransaction
+{
+public:
+	PgsqlReplicationTransaction() : xid(0), commit_lsn(0), end_lsn(0), commit_time(0) { }
+
+	unsigned int xid;
+
+	/// \brief Position of the commit record in the write-ahead log.
+	unsigned long long commit_lsn;
+
+	/// \brief Position just after the transaction; confirming it acknowledges the transaction.
+	unsigned long long end_lsn;
+
+	/// \brief Commit time, in microseconds since 2000-01-01 00:00 UTC.
+	long long commit_time;
+
+	std::vector<PgsqlReplicationChange> changes;
+};
+
+/// \brief Consume the changes of a logical replication slot (pgoutput plugin).
+///
+/// The stream opens a replication connection to the database, creates or
+/// reuses a slot, and decodes the changes made to the tables of the given
+/// publications (CREATE PUBLICATION ... FOR TABLE ...). Each committed
+/// transaction is passed whole to the handler, so that in-memory copies of
+/// tables can be updated incrementally instead of being reloaded.
+///
+/// The server keeps the write-ahead log from the confirmed position of the
+/// slot, and sends the transactions after it again on the next start. By
+/// default a transaction is confirmed as soon as the handler returns.
+///
+/// Changes are pumped by process() or by a background thread with start().
+/// Either way process() must run regularly (less than wal_sender_timeout
+/// apart, 60 seconds by default), since the server drops silent clients.
+/// The server needs wal_level=logical.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlReplicationStream
+{
+/// \name Construction
+/// \{
+
+public:
+	typedef std::function<void(const PgsqlReplicationTransaction &)> Handler;
+	typedef std::function<void(const Exception &error)> ErrorHandler;
+
+	/// \brief Constructs a PgsqlReplicationStream
+	///
+	/// \param parameters = Connection parameters, as given to PgsqlConnection
+	/// \param slot_name = Replication slot (lower case letters, digits and underscores)
+	/// \param publications = Publications to receive the changes of
+	PgsqlReplicationStream(const PgsqlConnection::Parameters &parameters, const std::string &slot_name, const std::vector<std::string> &publications);
+
+	/// \brief Constructs a PgsqlReplicationStream
+	///
+	/// \param connection_string = Connection string, as given to PgsqlConnection
+	/// \param slot_name = Replication slot (lower case letters, digits and underscores)
+	/// \param publications = Publications to receive the changes of
+	PgsqlReplicationStream(const std::string &connection_string, const std::string &slot_name, const std::vector<std::string> &publications);
+
+	~PgsqlReplicationStream();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief True once start_replication() succeeded.
+	bool is_streaming() const;
+
+	/// \brief True while the background thread runs.
+	bool is_running() const;
+
+	/// \brief End position of the last transaction passed to the handler.
+	unsigned long long get_received_lsn() const;
+
+	/// \brief Position reported to the server as processed.
+	unsigned long long get_confirmed_lsn() const;
+
+	/// \brief Formats a log position like the server does (for instance 16/B374D848).
+	static std::string lsn_to_text(unsigned long long lsn);
+
+	/// \brief Parses a log position formatted like 16/B374D848.
+	static unsigned long long text_to_lsn(const std::string &text);
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Set the function called with each committed transaction.
+	void set_handler(const Handler &handler);
+
+	/// \brief Set the function called by the background thread when receiving or handling changes fails.
+	///
+	/// Errors include lost connections and exceptions thrown by the handler;
+	/// the thread then waits before trying again, longer while errors go on.
+	/// Set it before start().
+	void set_error_handler(const ErrorHandler &handler);
+
+	/// \brief Confirm each transaction once the handler returned (the default), or only through confirm().
+	void set_auto_confirm(bool enable);
+
+	/// \brief Interval between two status reports to the server (10 seconds by default).
+	void set_status_interval(int interval_ms);
+
+	/// \brief Create the slot, which starts recording changes from now on.
+	///
+	/// The returned snapshot name shows the database exactly as it was when the
+	/// slot was created. Load the initial table contents through another
+	/// connection, in a REPEATABLE READ transaction starting with
+	/// SET TRANSACTION SNAPSHOT 'name', then call start_replication().
+	/// The snapshot can't be imported any more after start_replication().
+	///
+	/// \param temporary = Drop the slot when the connection closes.
+	/// \return Name of the exported snapshot.
+	std::string create_slot(bool temporary = false);
+
+	/// \brief Drop the slot, letting the server free the log kept for it.
+	void drop_slot();
+
+	/// \brief Start receiving the changes committed after start_lsn.
+	///
+	/// \param start_lsn = Position to resume from, 0 for the confirmed position of the slot.
+	void start_replication(unsigned long long start_lsn = 0);
+
+	/// \brief Report every transaction ending at or before lsn as processed.
+	void confirm(unsigned long long lsn);
+
+	/// \brief Wait up to timeout_ms for changes and pass the received transactions to the handler.
+	///
+	/// If the connection is lost, it is reopened and streaming resumes after
+	/// the last transaction received.
+	///
+	/// \param timeout_ms = Maximum wait, 0 to only handle what already arrived, -1 to wait forever.
+	/// \return Number of transactions handled.
+	int process(int timeout_ms = 0);
+
+	/// \brief Start a background thread which handles transactions as they arrive.
+	void start();
+
+	/// \brief Stop the background thread, if any.
+	void stop();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	PgsqlReplicationStream(const PgsqlReplicationStream &);
+	PgsqlReplicationStream &operator=(const PgsqlReplicationStream &);
+
+	std::shared_ptr<PgsqlReplicationStream_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
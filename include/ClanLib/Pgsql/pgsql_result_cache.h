@@ -0,0 +1,128 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api_pgsql.h"
+#include "ClanLib/Database/db_connection.h"
+#include "ClanLib/Database/db_command.h"
+#include "ClanLib/Database/db_reader.h"
+
+namespace clan
+{
+
+class PgsqlResultCache_Impl;
+
+/// \brief Opt-in client side cache of query results.
+///
+/// Results are keyed by server, session settings (role, search_path, TimeZone...),
+/// SQL text and bound parameter bytes, and kept
+/// as immutable snapshots shared by every reader returned for the same key.
+/// Entries expire after their time to live, are evicted in least recently
+/// used order once the memory budget is exceeded, and can be dropped by tag.
+///
+/// A cache may be shared by several connections and threads.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlResultCache
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief Constructs a PgsqlResultCache
+	///
+	/// \param memory_budget = Maximum size in bytes of all cached results
+	PgsqlResultCache(size_t memory_budget = 64 * 1024 * 1024);
+
+	~PgsqlResultCache();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Size in bytes of all cached results.
+	size_t get_memory_usage() const;
+
+	/// \brief Number of cached results.
+	int get_entry_count() const;
+
+	/// \brief Number of execute_reader calls served from the cache.
+	unsigned int get_hit_count() const;
+
+	/// \brief Number of execute_reader calls which ran the query.
+	unsigned int get_miss_count() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Return the cached result of command, running it on connection if needed.
+	///
+	/// The returned reader has the usual get_column_* interface. On a cache
+	/// hit, it is served without any network I/O. Inside a transaction the
+	/// cache is bypassed, as the rows may not be committed yet. A result read
+	/// while one of its tags is invalidated is not stored.
+	///
+	/// \param connection = PgsqlConnection to run the command on in case of miss
+	/// \param command = Command created by connection
+	/// \param ttl_ms = Time to live of the entry in milliseconds
+	/// \param tags = Tags of the entry, usually the tables read by the query
+	DBReader execute_reader(DBConnection &connection, DBCommand &command, int ttl_ms,
+		const std::vector<std::string> &tags = std::vector<std::string>());
+
+	/// \brief Drop every entry tagged with tag.
+	void invalidate_tag(const std::string &tag);
+
+	/// \brief Drop every entry.
+	void invalidate_all();
+
+	/// \brief Change the memory budget, evicting entries if needed.
+	void set_memory_budget(size_t memory_budget);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<PgsqlResultCache_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
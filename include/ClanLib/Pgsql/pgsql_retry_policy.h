@@ -0,0 +1,91 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include "api_pgsql.h"
+
+namespace clan
+{
+
+class PgsqlException;
+
+/// \brief Tells PgsqlConnection::run_transaction when and how to retry.
+///
+/// The delay before the n-th retry is drawn uniformly between zero and
+/// min(max_delay_ms, initial_delay_ms * 2^(n-1)), so that concurrent
+/// clients which failed together do not retry in lockstep.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlRetryPolicy
+{
+/// \name Construction
+/// \{
+
+public:
+	PgsqlRetryPolicy()
+	: max_attempts(5), initial_delay_ms(10), max_delay_ms(1000), max_total_time_ms(0),
+	  retry_serialization_failures(true), retry_deadlocks(true)
+	{
+	}
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Maximum number of times the transaction is run (1 disables retries).
+	int max_attempts;
+
+	/// \brief Upper bound of the delay before the first retry.
+	int initial_delay_ms;
+
+	/// \brief Upper bound of any single delay.
+	int max_delay_ms;
+
+	/// \brief Give up once this much time elapsed since the first attempt (0 = no limit).
+	int max_total_time_ms;
+
+	/// \brief Retry on SQLSTATE 40001.
+	bool retry_serialization_failures;
+
+	/// \brief Retry on SQLSTATE 40P01.
+	bool retry_deadlocks;
+
+	/// \brief Tells if this policy allows retrying after the given error.
+	bool is_retryable(const PgsqlException &error) const;
+
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
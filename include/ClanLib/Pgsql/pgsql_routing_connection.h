@@ -0,0 +1,150 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api_pgsql.h"
+#include "pgsql_connection.h"
+
+namespace clan
+{
+
+class PgsqlRoutingConnection_Impl;
+
+/// \brief Connection to a primary server and its read replicas.
+///
+/// Commands are routed when they are created: read only statements
+/// (see create_command) go to a healthy replica, everything else goes to
+/// the primary. A transaction stays on the server it was started on until
+/// it ends.
+///
+/// Routing state is kept per thread. After a thread wrote to the primary,
+/// its reads also go to the primary for the read your writes window, so it
+/// does not miss its own changes on a lagging replica.
+///
+/// The object may be used from several threads: every server connection is
+/// used by one thread at a time, and a transaction owns its connection
+/// until it is committed or rolled back.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlRoutingConnection
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief How reads are spread over the replicas.
+	enum BalancePolicy
+	{
+		round_robin,
+		least_outstanding
+	};
+
+	/// \brief Constructs a PgsqlRoutingConnection
+	///
+	/// target_session_attrs is added to the connection strings when they do not
+	/// give it: read-write for the primary, prefer-standby for the replicas.
+	///
+	/// \param primary = Connection string of the primary
+	/// \param replicas = Connection strings of the replicas
+	/// \param policy = How reads are spread over the replicas
+	PgsqlRoutingConnection(const std::string &primary, const std::vector<std::string> &replicas, BalancePolicy policy = round_robin);
+
+	~PgsqlRoutingConnection();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief Connection to the primary.
+	PgsqlConnection &get_primary();
+
+	int get_replica_count() const;
+
+	/// \brief False if the last health check failed or found the replica too far behind.
+	bool is_replica_healthy(int index) const;
+
+	/// \brief Replay lag of the replica in bytes of WAL, as of the last health check.
+	long long get_replica_lag(int index) const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Reads issued by a thread less than window_ms after its last write go to the primary.
+	void set_read_your_writes_window(int window_ms);
+
+	/// \brief Replicas more than max_lag_bytes behind the primary receive no reads (0 = no limit).
+	void set_max_replica_lag(long long max_lag_bytes);
+
+	/// \brief Health checks run at most this often, from the thread picking a replica (0 = only check_health).
+	void set_health_check_interval(int interval_ms);
+
+	/// \brief Reconnect broken connections and refresh the lag of every replica.
+	void check_health();
+
+	/// \brief Create a command on the server chosen from its text.
+	///
+	/// Statements starting with SELECT, WITH, SHOW, VALUES or TABLE are read
+	/// only, unless they lock rows, use SELECT INTO, contain data modifying
+	/// statements or several statements. Use the other overload for
+	/// functions with side effects.
+	DBCommand create_command(const std::string &text, DBCommand::Type type = DBCommand::sql_statement);
+
+	/// \brief Create a command on a replica if read_only is true, on the primary otherwise.
+	DBCommand create_command(const std::string &text, bool read_only, DBCommand::Type type = DBCommand::sql_statement);
+
+	/// \brief Start a transaction; the commands created by this thread go to its server until it ends.
+	DBTransaction begin_transaction(bool read_only = false, DBTransaction::Type type = DBTransaction::default_transaction);
+
+	DBReader execute_reader(DBCommand &command);
+	std::string execute_scalar_string(DBCommand &command);
+	int execute_scalar_int(DBCommand &command);
+	void execute_non_query(DBCommand &command);
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<PgsqlRoutingConnection_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,184 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "api_pgsql.h"
+#include "pgsql_connection.h"
+
+namespace clan
+{
+
+class PgsqlShardedConnection_Impl;
+
+/// \brief Connections to several servers each holding a part of the data.
+///
+/// Every row belongs to the shard chosen by its shard key, either by
+/// consistent hashing or by a map of key ranges:
+/// \code
+/// PgsqlShardedConnection shards;
+/// shards.add_shard("eu1", "host=db-eu1 dbname=game", 4);
+/// shards.add_shard("eu2", "host=db-eu2 dbname=game", 4);
+///
+/// DBCommand command = shards.create_command(player_id, "SELECT * FROM players WHERE id = ?1");
+/// command.set_input_parameter_int(1, player_id);
+/// DBReader reader = shards.execute_reader(command);
+///
+/// // Each shard gives its best 10 players: the first 10 rows of the merge are the best overall
+/// DBReader top = shards.execute_reader_all_shards("SELECT id, score FROM players ORDER BY score DESC LIMIT 10", {"score DESC"});
+/// \endcode
+///
+/// With consistent hashing, each shard owns the keys closest to the points
+/// given by its name on a hash ring, in proportion to its weight. Adding a
+/// shard only moves keys to the new shard: about 1/n of them with n shards
+/// of equal weight. Integer and string keys with the same text land on the
+/// same shard.
+///
+/// Each shard holds a set of connections. A command runs on the connection
+/// it was created on, which is used by one thread at a time; commands are
+/// created on the least busy connection of the shard.
+///
+/// Shards and key ranges must be configured before the object is used
+/// from several threads.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlShardedConnection
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief How shard keys are mapped to shards.
+	enum ShardMap
+	{
+		consistent_hash,
+		key_ranges
+	};
+
+	/// \brief Constructs a PgsqlShardedConnection
+	PgsqlShardedConnection(ShardMap map = consistent_hash);
+
+	~PgsqlShardedConnection();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	int get_shard_count() const;
+
+	std::string get_shard_name(int shard) const;
+
+	/// \brief Number of connections of a shard.
+	int get_connection_count(int shard) const;
+
+	/// \brief Connection of a shard, for work which does not go through this object.
+	PgsqlConnection &get_connection(int shard, int index);
+
+	/// \brief Shard owning key.
+	///
+	/// Range maps only take integer keys.
+	int get_shard_of(long long key) const;
+	int get_shard_of(const std::string &key) const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Connect to a new shard; returns its index.
+	///
+	/// \param name = Name placing the shard on the hash ring. Keep it when the server moves.
+	/// \param connection_string = Parameters of the connections
+	/// \param connection_count = Number of connections to the shard
+	/// \param weight = Share of the keys, relative to the other shards (points on the hash ring)
+	int add_shard(const std::string &name, const std::string &connection_string, int connection_count = 1, int weight = 100);
+
+	/// \brief Send the keys from first_key up to the next range to shard (key_ranges map).
+	///
+	/// Keys below the first range throw an Exception.
+	void set_key_range(long long first_key, int shard);
+
+	/// \brief Create a command on the shard owning shard_key.
+	DBCommand create_command(long long shard_key, const std::string &text, DBCommand::Type type = DBCommand::sql_statement);
+	DBCommand create_command(const std::string &shard_key, const std::string &text, DBCommand::Type type = DBCommand::sql_statement);
+
+	DBReader execute_reader(DBCommand &command);
+	std::string execute_scalar_string(DBCommand &command);
+	int execute_scalar_int(DBCommand &command);
+	void execute_non_query(DBCommand &command);
+
+	/// \brief Call fn with a connection of shard, reserved to the calling thread until fn returns.
+	///
+	/// Use it for transactions: fn may begin, commit and roll back
+	/// transactions on the connection it receives, and must only use that
+	/// connection.
+	void run_on_shard(int shard, const std::function<void(PgsqlConnection &connection)> &fn);
+
+	/// \brief Run a query on every shard at the same time, and return all their rows.
+	///
+	/// Rows are returned shard after shard, or merged in the order given by
+	/// order_by, a list of column names each optionally followed by DESC.
+	/// The query must sort its rows by the same columns. Integer, floating
+	/// point, numeric, date and timestamp columns compare as values, in the
+	/// text or binary format. Other columns compare byte by byte, which is
+	/// the order of the C collation: sort text with COLLATE "C" in the query.
+	/// Dates and timestamps in text must use the ISO DateStyle, the default;
+	/// timestamptz values compare in UTC whatever their offsets. Nulls come
+	/// last in ascending order as on the server.
+	///
+	/// A LIMIT in the query applies to each shard, so the merge may give up to
+	/// that many rows per shard.
+	///
+	/// \param sql = Query, the same for every shard
+	/// \param order_by = Columns to merge the rows of the shards on
+	/// \param bind = Called on the command of every shard to set its parameters
+	DBReader execute_reader_all_shards(const std::string &sql, const std::vector<std::string> &order_by = std::vector<std::string>(),
+		const std::function<void(DBCommand &command)> &bind = std::function<void(DBCommand &command)>());
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	std::shared_ptr<PgsqlShardedConnection_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
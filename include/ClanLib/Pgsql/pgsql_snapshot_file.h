@@ -0,0 +1,94 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <string>
+
+#include "api_pgsql.h"
+#include "ClanLib/Database/db_connection.h"
+#include "ClanLib/Database/db_command.h"
+#include "ClanLib/Database/db_reader.h"
+
+namespace clan
+{
+
+/// \brief Query results saved in files and mapped back in memory, for tables that rarely change.
+///
+/// A snapshot file holds the rows of one command in the column layout of
+/// the result cache, along with the SQL text, the parameters and the value
+/// of a version query (for instance SELECT max(updated_at) FROM items).
+/// While the version query returns the same value, the rows are read from
+/// the mapped file without running the command nor decoding anything.
+///
+/// The version is read before the rows, so a change racing with the save
+/// is caught at the next start rather than missed.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlSnapshotFile
+{
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Return the rows of command, from the file at path if it is up to date.
+	///
+	/// Otherwise the command is run and its result replaces the file (see
+	/// save for the limits on Windows).
+	///
+	/// \param connection = PgsqlConnection to run the queries on
+	/// \param command = Command created by connection
+	/// \param path = Snapshot file
+	/// \param version_query = Query returning one value which changes with the data.
+	///        If empty, any file saved for the same command is used.
+	static DBReader execute_reader(DBConnection &connection, DBCommand &command,
+		const std::string &path, const std::string &version_query = std::string());
+
+	/// \brief Return the rows saved in the file at path, without any database access.
+	///
+	/// Throws if the file is missing or invalid.
+	static DBReader open(const std::string &path);
+
+	/// \brief Run command and save its rows to the file at path.
+	///
+	/// The file is written next to path then renamed, so readers of the old
+	/// file are not disturbed. On Windows, a file can't be replaced while a
+	/// reader still maps it: the rename is retried for half a second, then an
+	/// Exception is thrown. Close the readers of a file before saving it again.
+	static void save(DBConnection &connection, DBCommand &command,
+		const std::string &path, const std::string &version_query = std::string());
+
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,221 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "api_pgsql.h"
+
+namespace clan
+{
+
+class DataBuffer;
+class DateTime;
+class Exception;
+class PgsqlConnection;
+class PgsqlWriteBehind_Impl;
+
+/// \brief Row queued by a PgsqlWriteBehind, with one value per column of its table.
+///
+/// Values are converted to text when added, and to the column types by the server.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlWriteBehindRow
+{
+/// \name Construction
+/// \{
+
+public:
+	PgsqlWriteBehindRow() : field_count(0) { }
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	int get_field_count() const { return field_count; }
+
+	/// \brief The row in the text format of COPY.
+	const std::string &get_data() const { return data; }
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	PgsqlWriteBehindRow &add_null();
+	PgsqlWriteBehindRow &add(bool value);
+	PgsqlWriteBehindRow &add(int value);
+	PgsqlWriteBehindRow &add(long long value);
+	PgsqlWriteBehindRow &add(double value);
+	PgsqlWriteBehindRow &add(const char *value);
+	PgsqlWriteBehindRow &add(const std::string &value);
+	PgsqlWriteBehindRow &add(const DateTime &value);
+	PgsqlWriteBehindRow &add(const DataBuffer &value);
+
+	void clear();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	void begin_field();
+
+	std::string data;
+	int field_count;
+/// \}
+};
+
+/// \brief Write rows in the background, in batches, without making the writing threads wait for the database.
+///
+/// Rows are queued in a fixed size lock free queue that any thread may fill.
+/// A dedicated thread takes them out, groups them by table, and writes them
+/// with COPY, all tables in one transaction, once a row count or a delay is
+/// reached. If that transaction fails, each table is written again in its own
+/// transaction, so that a rejected row only loses the batch of its table. This
+/// suits non critical data such as telemetry: rows are lost if the process
+/// dies, or if the server rejects them.
+///
+/// \code
+/// PgsqlWriteBehind writer(connection);
+/// int kills = writer.add_table("kills", { "killer", "victim", "weapon" });
+/// writer.set_synchronous_commit(false);
+/// writer.start();
+/// writer.write(kills, PgsqlWriteBehindRow().add(killer_id).add(victim_id).add(weapon));
+/// \endcode
+///
+/// The connection must be dedicated to the writer.
+///
+/// \xmlonly !group=Pgsql/System! !header=pgsql.h! \endxmlonly
+class CL_API_PGSQL PgsqlWriteBehind
+{
+/// \name Construction
+/// \{
+
+public:
+	/// \brief What write() does when the queue is full.
+	enum OverflowPolicy
+	{
+		/// \brief Wait for room in the queue.
+		block_when_full,
+
+		/// \brief Return false at once, losing the row.
+		drop_when_full
+	};
+
+	typedef std::function<void(const Exception &error, int lost_rows)> ErrorHandler;
+
+	/// \brief Constructs a PgsqlWriteBehind
+	///
+	/// \param connection = PgsqlConnection using the libpq engine
+	/// \param capacity = Maximum number of queued rows, rounded up to a power of two
+	/// \param overflow = What write() does when the queue is full
+	PgsqlWriteBehind(PgsqlConnection &connection, int capacity = 65536, OverflowPolicy overflow = drop_when_full);
+
+	/// \brief Writes the queued rows, then stops the thread.
+	~PgsqlWriteBehind();
+
+/// \}
+/// \name Attributes
+/// \{
+
+public:
+	/// \brief True while the background thread runs.
+	bool is_running() const;
+
+	/// \brief Number of rows written to the database.
+	unsigned long long get_written_count() const;
+
+	/// \brief Number of rows refused by write() because the queue was full.
+	unsigned long long get_dropped_count() const;
+
+	/// \brief Number of rows lost because their batch failed.
+	unsigned long long get_failed_count() const;
+
+/// \}
+/// \name Operations
+/// \{
+
+public:
+	/// \brief Declare a table and the columns given by each row, in order; returns the index to pass to write().
+	///
+	/// Names are used as written in SQL. Tables can only be added before start().
+	int add_table(const std::string &table, const std::vector<std::string> &columns);
+
+	/// \brief Write a batch once max_rows are queued, or max_delay_ms after the oldest row (defaults: 5000 rows, 200 ms).
+	void set_flush_threshold(int max_rows, int max_delay_ms);
+
+	/// \brief With false, batches are committed with SET LOCAL synchronous_commit = off (the default is true).
+	///
+	/// The commit then returns before the server flushed its log to disk, and a
+	/// server crash may lose the last batches, but never corrupts the database.
+	void set_synchronous_commit(bool enable);
+
+	/// \brief Function called on the writer thread when the batch of a table fails.
+	void set_error_handler(const ErrorHandler &handler);
+
+	/// \brief Start the background thread.
+	void start();
+
+	/// \brief Queue a row for the given table.
+	///
+	/// Never waits for the database. With block_when_full, it waits while the queue
+	/// is full, and throws an Exception if the writer thread is not running.
+	///
+	/// \return false if the row was dropped.
+	bool write(int table, const PgsqlWriteBehindRow &row);
+
+	/// \brief Wait until every row queued before the call is written or lost.
+	void flush();
+
+	/// \brief Write the queued rows, then stop the background thread.
+	void stop();
+
+/// \}
+/// \name Implementation
+/// \{
+
+private:
+	PgsqlWriteBehind(const PgsqlWriteBehind &);
+	PgsqlWriteBehind &operator=(const PgsqlWriteBehind &);
+
+	std::shared_ptr<PgsqlWriteBehind_Impl> impl;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
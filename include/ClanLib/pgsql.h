@@ -36,6 +36,24 @@
 #endif
 
 #include "Pgsql/pgsql_connection.h"
+#include "Pgsql/pgsql_command.h"
+#include "Pgsql/pgsql_reader.h"
+#include "Pgsql/pgsql_large_object.h"
+#include "Pgsql/pgsql_parallel_scan.h"
+#include "Pgsql/pgsql_parallel_decoder.h"
+#include "Pgsql/pgsql_exception.h"
+#include "Pgsql/pgsql_retry_policy.h"
+#include "Pgsql/pgsql_notification_dispatcher.h"
+#include "Pgsql/pgsql_replication_stream.h"
+#include "Pgsql/pgsql_result_cache.h"
+#include "Pgsql/pgsql_batch_loader.h"
+#include "Pgsql/pgsql_write_behind.h"
+#include "Pgsql/pgsql_group_commit.h"
+#include "Pgsql/pgsql_bulk_sync.h"
+#include "Pgsql/pgsql_sharded_connection.h"
+#include "Pgsql/pgsql_json_view.h"
+#include "Pgsql/pgsql_snapshot_file.h"
+#include "Pgsql/pgsql_routing_connection.h"
 
 #ifdef __cplusplus_cli
 #pragma managed(pop)
@@ -58,5 +58,24 @@
 #define ZPBITOID       1560
 #define VARBITOID      1562
 #define NUMERICOID     1700
+#define REFCURSOROID   1790
+#define JSONOID        114
+#define XMLOID         142
+#define JSONBOID       3802
+#define BYTEAARRAYOID  1001
+#define INT2ARRAYOID   1005
+#define INT4ARRAYOID   1007
+#define TEXTARRAYOID   1009
+#define BPCHARARRAYOID 1014
+#define VARCHARARRAYOID 1015
+#define INT8ARRAYOID   1016
+#define FLOAT4ARRAYOID 1021
+#define FLOAT8ARRAYOID 1022
+#define POINTARRAYOID  1017
+#define LSEGARRAYOID   1018
+#define PATHARRAYOID   1019
+#define BOXARRAYOID    1020
+#define POLYGONARRAYOID 1027
+#define CIRCLEARRAYOID 719
 
 #endif   /* PG_TYPE_H */
@@ -0,0 +1,645 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "pgsql_array.h"
+#include "pgsql_binary.h"
+#include "pg_type.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/Text/string_format.h"
+#include <memory>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
+
+namespace clan
+{
+
+namespace
+{
+	/// \brief Binary array: dimension count, has-null flag, element type, then size and lower bound of each dimension.
+	struct BinaryArray
+	{
+		Oid element_type;
+		int count;
+		const char *elements;
+		const char *end;
+	};
+
+	BinaryArray read_binary_array(const char *data, int length)
+	{
+		if (length < 12)
+			throw Exception("Invalid binary array");
+
+		BinaryArray array;
+		const int dimensions = PgsqlBinary::read_int32(data);
+		array.element_type = PgsqlBinary::read_uint32(data + 8);
+		array.end = data + length;
+		array.count = 0;
+		array.elements = data + 12;
+		if (dimensions == 0)
+			return array;
+		if (dimensions != 1)
+			throw Exception("Only one dimensional arrays are supported");
+		if (length < 20)
+			throw Exception("Invalid binary array");
+
+		array.count = PgsqlBinary::read_int32(data + 12);
+		array.elements = data + 20;
+		if (array.count < 0)
+			throw Exception("Invalid binary array");
+		return array;
+	}
+
+	void throw_invalid_elements(const BinaryArray &array, int width)
+	{
+		const char *p = array.elements;
+		for (int i = 0; i < array.count && array.end - p >= 4; i++)
+		{
+			const int element_length = PgsqlBinary::read_int32(p);
+			if (element_length == -1)
+				throw Exception("Array holds NULL values");
+			if (element_length != width)
+				break;
+			p += 4 + width;
+		}
+		throw Exception("Invalid binary array");
+	}
+
+	/// \brief Decode elements of a fixed size, converted by read.
+	template<typename T, typename Read>
+	void decode_fixed(const BinaryArray &array, int width, Read read, std::vector<T> &out)
+	{
+		// Every element is prefixed by its length. Check them all at once after the
+		// loop, so it has no branch and is only made of loads, byte swaps and stores.
+		const size_t stride = 4 + width;
+		if (size_t(array.end - array.elements) < array.count * stride)
+			throw_invalid_elements(array, width);
+
+		out.resize(array.count);
+		T *values = out.data();
+		const char *p = array.elements;
+		uint32_t mismatch = 0;
+		for (int i = 0; i < array.count; i++, p += stride)
+		{
+			mismatch |= PgsqlBinary::read_uint32(p) ^ uint32_t(width);
+			values[i] = static_cast<T>(read(p + 4));
+		}
+		if (mismatch)
+			throw_invalid_elements(array, width);
+	}
+
+	/// \brief Decode elements of variable size, built by make (receiving nullptr for NULL).
+	template<typename T, typename Make>
+	void decode_variable(const BinaryArray &array, Make make, std::vector<T> &out)
+	{
+		out.clear();
+		out.reserve(array.count);
+		const char *p = array.elements;
+		for (int i = 0; i < array.count; i++)
+		{
+			if (array.end - p < 4)
+				throw Exception("Invalid binary array");
+			const int element_length = PgsqlBinary::read_int32(p);
+			p += 4;
+			if (element_length == -1)
+			{
+				out.push_back(make(nullptr, 0));
+				continue;
+			}
+			if (element_length < 0 || array.end - p < element_length)
+				throw Exception("Invalid binary array");
+			out.push_back(make(p, element_length));
+			p += element_length;
+		}
+	}
+
+	/// \brief Split the text form of an array: {1,2,NULL} or {"a b","c\"d"}.
+	///
+	/// Elements are separated by commas, except for boxes which use semicolons.
+	void parse_text(const char *data, int length, std::vector<std::string> &elements, std::vector<bool> &nulls, char delimiter = ',')
+	{
+		const char *p = data;
+		const char *end = data + length;
+
+		// Arrays not starting at index 1 are prefixed by their bounds: [0:2]={1,2,3}
+		if (p < end && *p == '[')
+		{
+			while (p < end && *p != '=')
+				++p;
+			if (p < end)
+				++p;
+		}
+		if (p == end || *p != '{')
+			throw Exception("Invalid array");
+		++p;
+
+		while (p < end && isspace(static_cast<unsigned char>(*p)))
+			++p;
+		if (p < end && *p == '}')
+			return;
+
+		while (true)
+		{
+			while (p < end && isspace(static_cast<unsigned char>(*p)))
+				++p;
+			if (p == end)
+				throw Exception("Invalid array");
+			if (*p == '{')
+				throw Exception("Only one dimensional arrays are supported");
+
+			std::string element;
+			bool quoted = false;
+			if (*p == '"')
+			{
+				quoted = true;
+				for (++p; p < end && *p != '"'; ++p)
+				{
+					if (*p == '\\' && p + 1 < end)
+						++p;
+					element.push_back(*p);
+				}
+				if (p == end)
+					throw Exception("Invalid array");
+				++p;
+			}
+			else
+			{
+				for (; p < end && *p != delimiter && *p != '}'; ++p)
+				{
+					if (*p == '\\' && p + 1 < end)
+						++p;
+					element.push_back(*p);
+				}
+				while (!element.empty() && isspace(static_cast<unsigned char>(element.back())))
+					element.pop_back();
+			}
+
+			while (p < end && isspace(static_cast<unsigned char>(*p)))
+				++p;
+			nulls.push_back(!quoted && element.size() == 4 && toupper(element[0]) == 'N' && toupper(element[1]) == 'U'
+				&& toupper(element[2]) == 'L' && toupper(element[3]) == 'L');
+			elements.push_back(element);
+
+			if (p == end)
+				throw Exception("Invalid array");
+			if (*p == '}')
+				break;
+			if (*p != delimiter)
+				throw Exception("Invalid array");
+			++p;
+		}
+	}
+
+	void check_element_type(Oid element_type, Oid accepted1, Oid accepted2, Oid accepted3, const char *name)
+	{
+		if (element_type != accepted1 && element_type != accepted2 && element_type != accepted3)
+			throw Exception(string_format("Array of type %1 can't be read as %2", (int)element_type, name));
+	}
+
+	/// \brief Decode an array of integers or floats; text elements are converted by parse.
+	template<typename T, typename Parse>
+	void decode_text_numbers(const char *data, int length, Parse parse, std::vector<T> &out)
+	{
+		std::vector<std::string> elements;
+		std::vector<bool> nulls;
+		parse_text(data, length, elements, nulls);
+
+		out.resize(elements.size());
+		for (size_t i = 0; i < elements.size(); i++)
+		{
+			if (nulls[i])
+				throw Exception("Array holds NULL values");
+			char *element_end = nullptr;
+			out[i] = static_cast<T>(parse(elements[i].c_str(), &element_end));
+			if (element_end == elements[i].c_str() || *element_end != '\0')
+				throw Exception(string_format("Invalid array element %1", elements[i]));
+		}
+	}
+
+	/// \brief Decode an array of geometric values; text elements are converted by decode.
+	template<typename T, typename Decode>
+	void decode_text_geometry(const char *data, int length, Oid element_type, char delimiter, Decode decode, std::vector<T> &out)
+	{
+		std::vector<std::string> elements;
+		std::vector<bool> nulls;
+		parse_text(data, length, elements, nulls, delimiter);
+
+		out.resize(elements.size());
+		for (size_t i = 0; i < elements.size(); i++)
+		{
+			if (nulls[i])
+				throw Exception("Array holds NULL values");
+			out[i] = decode(elements[i].data(), elements[i].size(), element_type, 0);
+		}
+	}
+
+	long long parse_integer(const char *text, char **end) { return std::strtoll(text, end, 10); }
+	double parse_float(const char *text, char **end) { return std::strtod(text, end); }
+
+	/// \brief Decode an array of integers of any width up to sizeof(T).
+	template<typename T>
+	void decode_integers(const char *data, int length, Oid array_type, int format, std::vector<T> &out, const char *name)
+	{
+		const Oid wide = sizeof(T) >= 8 ? INT8OID : INT2OID;
+		const Oid medium = sizeof(T) >= 4 ? INT4OID : INT2OID;
+		if (format == 0)
+		{
+			check_element_type(PgsqlArray::get_element_type(array_type), INT2OID, medium, wide, name);
+			decode_text_numbers(data, length, parse_integer, out);
+			return;
+		}
+
+		const BinaryArray array = read_binary_array(data, length);
+		check_element_type(array.element_type, INT2OID, medium, wide, name);
+		if (array.element_type == INT2OID)
+			decode_fixed(array, 2, [](const char *p) { return PgsqlBinary::read_int16(p); }, out);
+		else if (array.element_type == INT4OID)
+			decode_fixed(array, 4, [](const char *p) { return PgsqlBinary::read_int32(p); }, out);
+		else
+			decode_fixed(array, 8, [](const char *p) { return PgsqlBinary::read_int64(p); }, out);
+	}
+
+	/// \brief Write the array header; an empty array has no dimension.
+	char *write_header(std::string &out, Oid element_type, size_t count, size_t elements_size)
+	{
+		out.resize((count ? 20 : 12) + elements_size);
+		char *p = &out[0];
+		PgsqlBinary::store_uint32(p, count ? 1 : 0);
+		PgsqlBinary::store_uint32(p + 4, 0);
+		PgsqlBinary::store_uint32(p + 8, element_type);
+		if (count == 0)
+			return p + 12;
+		PgsqlBinary::store_uint32(p + 12, count);
+		PgsqlBinary::store_uint32(p + 16, 1);
+		return p + 20;
+	}
+
+	template<typename T, typename Store>
+	std::string encode_fixed(Oid element_type, const std::vector<T> &values, int width, Store store)
+	{
+		std::string out;
+		char *p = write_header(out, element_type, values.size(), values.size() * (4 + width));
+		for (size_t i = 0; i < values.size(); i++, p += 4 + width)
+		{
+			PgsqlBinary::store_uint32(p, width);
+			store(p + 4, values[i]);
+		}
+		return out;
+	}
+
+	std::string encode_variable(Oid element_type, size_t count, const char *const *data, const size_t *sizes)
+	{
+		size_t elements_size = 0;
+		for (size_t i = 0; i < count; i++)
+			elements_size += 4 + sizes[i];
+
+		std::string out;
+		char *p = write_header(out, element_type, count, elements_size);
+		for (size_t i = 0; i < count; i++)
+		{
+			PgsqlBinary::store_uint32(p, sizes[i]);
+			if (sizes[i])
+				std::memcpy(p + 4, data[i], sizes[i]);
+			p += 4 + sizes[i];
+		}
+		return out;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlArray:
+
+Oid PgsqlArray::get_element_type(Oid array_type)
+{
+	switch (array_type)
+	{
+	case BYTEAARRAYOID: return BYTEAOID;
+	case INT2ARRAYOID: return INT2OID;
+	case INT4ARRAYOID: return INT4OID;
+	case INT8ARRAYOID: return INT8OID;
+	case FLOAT4ARRAYOID: return FLOAT4OID;
+	case FLOAT8ARRAYOID: return FLOAT8OID;
+	case TEXTARRAYOID: return TEXTOID;
+	case VARCHARARRAYOID: return VARCHAROID;
+	case BPCHARARRAYOID: return BPCHAROID;
+	case POINTARRAYOID: return POINTOID;
+	case LSEGARRAYOID: return LSEGOID;
+	case PATHARRAYOID: return PATHOID;
+	case BOXARRAYOID: return BOXOID;
+	case POLYGONARRAYOID: return POLYGONOID;
+	case CIRCLEARRAYOID: return CIRCLEOID;
+	default: return 0;
+	}
+}
+
+std::string PgsqlArray::encode(const std::vector<short> &values)
+{
+	return encode_fixed(INT2OID, values, 2, [](char *p, short value) { PgsqlBinary::store_uint16(p, static_cast<uint16_t>(value)); });
+}
+
+std::string PgsqlArray::encode(const std::vector<int> &values)
+{
+	return encode_fixed(INT4OID, values, 4, [](char *p, int value) { PgsqlBinary::store_uint32(p, static_cast<uint32_t>(value)); });
+}
+
+std::string PgsqlArray::encode(const std::vector<long long> &values)
+{
+	return encode_fixed(INT8OID, values, 8, [](char *p, long long value) { PgsqlBinary::store_uint64(p, static_cast<uint64_t>(value)); });
+}
+
+std::string PgsqlArray::encode(const std::vector<float> &values)
+{
+	return encode_fixed(FLOAT4OID, values, 4, [](char *p, float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		PgsqlBinary::store_uint32(p, bits);
+	});
+}
+
+std::string PgsqlArray::encode(const std::vector<double> &values)
+{
+	return encode_fixed(FLOAT8OID, values, 8, [](char *p, double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		PgsqlBinary::store_uint64(p, bits);
+	});
+}
+
+std::string PgsqlArray::encode(const std::vector<std::string> &values)
+{
+	std::vector<const char*> data(values.size());
+	std::vector<size_t> sizes(values.size());
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		data[i] = values[i].data();
+		sizes[i] = values[i].size();
+	}
+	return encode_variable(TEXTOID, values.size(), data.data(), sizes.data());
+}
+
+std::string PgsqlArray::encode(const std::vector<DataBuffer> &values)
+{
+	std::vector<const char*> data(values.size());
+	std::vector<size_t> sizes(values.size());
+	for (size_t i = 0; i < values.size(); i++)
+	{
+		data[i] = values[i].get_data();
+		sizes[i] = values[i].get_size();
+	}
+	return encode_variable(BYTEAOID, values.size(), data.data(), sizes.data());
+}
+
+std::string PgsqlArray::encode(const std::vector<Vec2d> &values)
+{
+	return encode_fixed(POINTOID, values, PgsqlGeometry::point_size, PgsqlGeometry::store_point);
+}
+
+std::string PgsqlArray::encode(const std::vector<LineSegment2d> &values)
+{
+	return encode_fixed(LSEGOID, values, PgsqlGeometry::line_segment_size, PgsqlGeometry::store_line_segment);
+}
+
+std::string PgsqlArray::encode(const std::vector<Rectd> &values)
+{
+	return encode_fixed(BOXOID, values, PgsqlGeometry::box_size, PgsqlGeometry::store_box);
+}
+
+std::string PgsqlArray::encode(const std::vector<Circled> &values)
+{
+	return encode_fixed(CIRCLEOID, values, PgsqlGeometry::circle_size, PgsqlGeometry::store_circle);
+}
+
+std::string PgsqlArray::encode(const std::vector<std::vector<Vec2d> > &polygons)
+{
+	std::vector<std::string> encoded(polygons.size());
+	std::vector<const char*> data(polygons.size());
+	std::vector<size_t> sizes(polygons.size());
+	for (size_t i = 0; i < polygons.size(); i++)
+	{
+		encoded[i] = PgsqlGeometry::encode(polygons[i]);
+		data[i] = encoded[i].data();
+		sizes[i] = encoded[i].size();
+	}
+	return encode_variable(POLYGONOID, polygons.size(), data.data(), sizes.data());
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<short> &out)
+{
+	decode_integers(data, length, array_type, format, out, "int16");
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<int> &out)
+{
+	decode_integers(data, length, array_type, format, out, "int");
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<long long> &out)
+{
+	decode_integers(data, length, array_type, format, out, "int64");
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<float> &out)
+{
+	if (format == 0)
+	{
+		check_element_type(get_element_type(array_type), FLOAT4OID, FLOAT4OID, FLOAT4OID, "float");
+		decode_text_numbers(data, length, parse_float, out);
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	check_element_type(array.element_type, FLOAT4OID, FLOAT4OID, FLOAT4OID, "float");
+	decode_fixed(array, 4, [](const char *p) { return PgsqlBinary::read_float4(p); }, out);
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<double> &out)
+{
+	if (format == 0)
+	{
+		check_element_type(get_element_type(array_type), FLOAT4OID, FLOAT8OID, FLOAT8OID, "double");
+		decode_text_numbers(data, length, parse_float, out);
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	check_element_type(array.element_type, FLOAT4OID, FLOAT8OID, FLOAT8OID, "double");
+	if (array.element_type == FLOAT4OID)
+		decode_fixed(array, 4, [](const char *p) { return PgsqlBinary::read_float4(p); }, out);
+	else
+		decode_fixed(array, 8, [](const char *p) { return PgsqlBinary::read_float8(p); }, out);
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<std::string> &out)
+{
+	if (format == 0)
+	{
+		// Elements of any type have a text form; only boxes are separated by semicolons
+		std::vector<bool> nulls;
+		out.clear();
+		parse_text(data, length, out, nulls, array_type == BOXARRAYOID ? ';' : ',');
+		for (size_t i = 0; i < out.size(); i++)
+		{
+			if (nulls[i])
+				out[i].clear();
+		}
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	if (array.element_type != NAMEOID)
+		check_element_type(array.element_type, TEXTOID, VARCHAROID, BPCHAROID, "string");
+	decode_variable(array, [](const char *p, int size) { return p ? std::string(p, size) : std::string(); }, out);
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<DataBuffer> &out)
+{
+	if (format == 0)
+	{
+		check_element_type(get_element_type(array_type), BYTEAOID, BYTEAOID, BYTEAOID, "binary");
+		std::vector<std::string> elements;
+		std::vector<bool> nulls;
+		parse_text(data, length, elements, nulls);
+
+		out.clear();
+		out.reserve(elements.size());
+		for (size_t i = 0; i < elements.size(); i++)
+		{
+			if (nulls[i])
+			{
+				out.push_back(DataBuffer());
+				continue;
+			}
+			size_t size;
+			auto deleter = [](void *ptr) {if (ptr) {free(ptr);} };
+			std::unique_ptr<unsigned char, decltype(deleter)> value(PQunescapeBytea(
+						reinterpret_cast<const unsigned char*>(elements[i].c_str()),
+						&size),
+						deleter);
+			if (!value)
+				throw Exception("Invalid bytea array element");
+			out.push_back(DataBuffer(value.get(), size));
+		}
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	check_element_type(array.element_type, BYTEAOID, BYTEAOID, BYTEAOID, "binary");
+	decode_variable(array, [](const char *p, int size) { return p ? DataBuffer(p, size) : DataBuffer(); }, out);
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<Vec2d> &out)
+{
+	if (format == 0)
+	{
+		check_element_type(get_element_type(array_type), POINTOID, POINTOID, POINTOID, "point");
+		decode_text_geometry(data, length, POINTOID, ',', PgsqlGeometry::decode_point, out);
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	check_element_type(array.element_type, POINTOID, POINTOID, POINTOID, "point");
+	decode_fixed(array, PgsqlGeometry::point_size, PgsqlGeometry::read_point, out);
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<LineSegment2d> &out)
+{
+	if (format == 0)
+	{
+		check_element_type(get_element_type(array_type), LSEGOID, LSEGOID, LSEGOID, "line segment");
+		decode_text_geometry(data, length, LSEGOID, ',', PgsqlGeometry::decode_line_segment, out);
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	check_element_type(array.element_type, LSEGOID, LSEGOID, LSEGOID, "line segment");
+	decode_fixed(array, PgsqlGeometry::line_segment_size, PgsqlGeometry::read_line_segment, out);
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<Rectd> &out)
+{
+	if (format == 0)
+	{
+		check_element_type(get_element_type(array_type), BOXOID, BOXOID, BOXOID, "box");
+		decode_text_geometry(data, length, BOXOID, ';', PgsqlGeometry::decode_box, out);
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	check_element_type(array.element_type, BOXOID, BOXOID, BOXOID, "box");
+	decode_fixed(array, PgsqlGeometry::box_size, PgsqlGeometry::read_box, out);
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<Circled> &out)
+{
+	if (format == 0)
+	{
+		check_element_type(get_element_type(array_type), CIRCLEOID, CIRCLEOID, CIRCLEOID, "circle");
+		decode_text_geometry(data, length, CIRCLEOID, ',', PgsqlGeometry::decode_circle, out);
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	check_element_type(array.element_type, CIRCLEOID, CIRCLEOID, CIRCLEOID, "circle");
+	decode_fixed(array, PgsqlGeometry::circle_size, PgsqlGeometry::read_circle, out);
+}
+
+void PgsqlArray::decode(const char *data, int length, Oid array_type, int format, std::vector<std::vector<Vec2d> > &out)
+{
+	if (format == 0)
+	{
+		const Oid element_type = get_element_type(array_type);
+		check_element_type(element_type, POLYGONOID, PATHOID, PATHOID, "polygon");
+		std::vector<std::string> elements;
+		std::vector<bool> nulls;
+		parse_text(data, length, elements, nulls);
+
+		out.assign(elements.size(), std::vector<Vec2d>());
+		for (size_t i = 0; i < elements.size(); i++)
+		{
+			if (!nulls[i])
+				PgsqlGeometry::decode_polygon(elements[i].data(), elements[i].size(), element_type, 0, out[i]);
+		}
+		return;
+	}
+
+	const BinaryArray array = read_binary_array(data, length);
+	check_element_type(array.element_type, POLYGONOID, PATHOID, PATHOID, "polygon");
+	const Oid element_type = array.element_type;
+	decode_variable(array, [element_type](const char *p, int size)
+	{
+		std::vector<Vec2d> points;
+		if (p)
+			PgsqlGeometry::decode_polygon(p, size, element_type, 1, points);
+		return points;
+	}, out);
+}
+
+}; // namespace clan
@@ -0,0 +1,90 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+#include "pgsql_geometry.h"
+
+namespace clan
+{
+
+class DataBuffer;
+
+/// \brief One dimensional arrays of the binary wire format.
+///
+/// Values of the text format ("{1,2,3}") are decoded too, so arrays can be read
+/// whatever the result format of the command.
+namespace PgsqlArray
+{
+	/// \brief Type of the elements of the supported array types, or 0.
+	Oid get_element_type(Oid array_type);
+
+	std::string encode(const std::vector<short> &values);
+	std::string encode(const std::vector<int> &values);
+	std::string encode(const std::vector<long long> &values);
+	std::string encode(const std::vector<float> &values);
+	std::string encode(const std::vector<double> &values);
+	std::string encode(const std::vector<std::string> &values);
+	std::string encode(const std::vector<DataBuffer> &values);
+	std::string encode(const std::vector<Vec2d> &values);
+	std::string encode(const std::vector<LineSegment2d> &values);
+	std::string encode(const std::vector<Rectd> &values);
+	std::string encode(const std::vector<Circled> &values);
+	std::string encode(const std::vector<std::vector<Vec2d> > &polygons);
+
+	/// \brief Decode the value of a column of type array_type, in the given format (0 = text, 1 = binary).
+	///
+	/// Integer elements may be read into wider integers, and float4 into double.
+	/// NULL elements can't be read as numbers; they give empty strings and buffers.
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<short> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<int> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<long long> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<float> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<double> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<std::string> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<DataBuffer> &out);
+
+	/// \brief Decode an array of geometric values (see PgsqlGeometry). NULL polygons give empty lists.
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<Vec2d> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<LineSegment2d> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<Rectd> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<Circled> &out);
+	void decode(const char *data, int length, Oid array_type, int format, std::vector<std::vector<Vec2d> > &out);
+}
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,202 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_batch_loader.h"
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "ClanLib/Pgsql/pgsql_command.h"
+#include "ClanLib/Pgsql/pgsql_exception.h"
+#include "ClanLib/Core/Text/string_help.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_command_provider.h"
+#include "pgsql_reader_provider.h"
+#include "pgsql_result_snapshot.h"
+#include "pgsql_snapshot_reader_provider.h"
+#include "pgsql_request_window.h"
+
+#include <map>
+#include <vector>
+
+namespace clan
+{
+
+class PgsqlBatchLoader_Impl
+{
+public:
+	struct Batch
+	{
+		std::vector<std::string> keys;
+		std::map<std::string, std::shared_ptr<const PgsqlResultSnapshot> > rows;
+	};
+
+	PgsqlBatchLoader_Impl(PgsqlConnection &connection, const std::string &sql, const std::string &key_column, int max_batch_size, int window_ms)
+	: connection(connection), provider(PgsqlConnectionProvider::from_connection(connection)), sql(sql), key_column(key_column),
+	  window(max_batch_size, window_ms), integer_keys(false), key_type_known(false), load_count(0)
+	{
+	}
+
+	DBReader load(const std::string &key, bool integer_key);
+
+	PgsqlConnection connection;
+	PgsqlConnectionProvider *provider;
+	std::string sql;
+	std::string key_column;
+
+	/// \brief Its mutex also guards the key type and load_count.
+	PgsqlRequestWindow<Batch> window;
+	bool integer_keys;
+	bool key_type_known;
+	unsigned int load_count;
+
+private:
+	void run(Batch &batch);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBatchLoader Construction:
+
+PgsqlBatchLoader::PgsqlBatchLoader(PgsqlConnection &connection, const std::string &sql, const std::string &key_column, int max_batch_size, int window_ms)
+: impl(std::make_shared<PgsqlBatchLoader_Impl>(connection, sql, key_column, max_batch_size, window_ms))
+{
+}
+
+PgsqlBatchLoader::~PgsqlBatchLoader()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBatchLoader Attributes:
+
+unsigned int PgsqlBatchLoader::get_load_count() const
+{
+	std::lock_guard<std::mutex> lock(impl->window.mutex);
+	return impl->load_count;
+}
+
+unsigned int PgsqlBatchLoader::get_query_count() const
+{
+	std::lock_guard<std::mutex> lock(impl->window.mutex);
+	return impl->window.batch_count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBatchLoader Operations:
+
+DBReader PgsqlBatchLoader::load(long long key)
+{
+	return impl->load(StringHelp::ll_to_text(key), true);
+}
+
+DBReader PgsqlBatchLoader::load(const std::string &key)
+{
+	return impl->load(key, false);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBatchLoader_Impl Operations:
+
+DBReader PgsqlBatchLoader_Impl::load(const std::string &key, bool integer_key)
+{
+	std::unique_lock<std::mutex> lock(window.mutex);
+	if (!key_type_known)
+	{
+		integer_keys = integer_key;
+		key_type_known = true;
+	}
+	else if (integer_keys != integer_key)
+	{
+		throw Exception("The keys of a PgsqlBatchLoader must all be integers or all be strings");
+	}
+	load_count++;
+
+	auto join = [&](Batch &batch) -> size_t
+	{
+		if (!batch.rows.count(key))
+		{
+			batch.rows[key];
+			batch.keys.push_back(key);
+		}
+		return batch.keys.size();
+	};
+	std::shared_ptr<PgsqlRequestWindow<Batch>::Batch> batch = window.submit(lock, join, [&](Batch &content) { run(content); });
+
+	if (batch->error)
+		std::rethrow_exception(batch->error);
+
+	// The batch is complete, so it is only read from now on
+	auto it = batch->content.rows.find(key);
+	if (it == batch->content.rows.end() || !it->second)
+		throw Exception("PgsqlBatchLoader: no result for key " + key);
+	return DBReader(new PgsqlSnapshotReaderProvider(it->second));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBatchLoader_Impl Implementation:
+
+void PgsqlBatchLoader_Impl::run(Batch &batch)
+{
+	const std::vector<std::string> &keys = batch.keys;
+	DBCommand command = connection.create_command(sql);
+	if (integer_keys)
+	{
+		std::vector<long long> values;
+		values.reserve(keys.size());
+		for (auto &key : keys)
+			values.push_back(StringHelp::text_to_ll(key));
+		PgsqlCommand(command).set_input_parameter_int64_array(1, values);
+	}
+	else
+	{
+		PgsqlCommand(command).set_input_parameter_string_array(1, keys);
+	}
+
+	PgsqlCommandProvider *command_provider = dynamic_cast<PgsqlCommandProvider*>(command.get_provider());
+	std::unique_ptr<PgsqlReaderProvider> reader(new PgsqlReaderProvider(provider, command_provider));
+	if (reader->is_spilled())
+		throw PgsqlResultTooLargeException(provider->get_result_budget());
+
+	const PGresult *result = reader->get_result();
+	const int key_index = PQfnumber(result, key_column.c_str());
+	if (key_index < 0)
+		throw Exception("PgsqlBatchLoader: column " + key_column + " missing from the result");
+
+	// Matched on the text the server prints; rows of keys nobody asked for, if any, are dropped
+	std::map<std::string, std::vector<PgsqlResultSnapshot::RowRef> > rows;
+	const int row_count = PQntuples(result);
+	for (int row = 0; row < row_count; row++)
+	{
+		if (!PQgetisnull(result, row, key_index))
+			rows[PQgetvalue(result, row, key_index)].push_back(PgsqlResultSnapshot::RowRef(result, row));
+	}
+
+	for (auto &key : keys)
+		batch.rows[key] = PgsqlResultSnapshot::create(result, rows[key]);
+}
+
+}; // namespace clan
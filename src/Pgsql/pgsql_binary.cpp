@@ -0,0 +1,73 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "pgsql_binary.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+namespace clan
+{
+
+namespace
+{
+	/// \brief Shortest text of at least precision digits reading back as the same value.
+	std::string float_to_text(double value, int precision, bool single)
+	{
+		if (std::isnan(value))
+			return "NaN";
+		if (std::isinf(value))
+			return value < 0 ? "-Infinity" : "Infinity";
+
+		char buffer[32];
+		for (; precision <= 17; precision++)
+		{
+			snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+			if (single ? std::strtof(buffer, nullptr) == static_cast<float>(value) : std::strtod(buffer, nullptr) == value)
+				break;
+		}
+		return buffer;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBinary Operations:
+
+std::string PgsqlBinary::float4_to_text(float value)
+{
+	return float_to_text(value, 6, true);
+}
+
+std::string PgsqlBinary::float8_to_text(double value)
+{
+	return float_to_text(value, 15, false);
+}
+
+}; // namespace clan
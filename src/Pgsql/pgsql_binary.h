@@ -0,0 +1,147 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <string>
+#include <cstring>
+#include <stdint.h>
+
+namespace clan
+{
+
+/// \brief Encoding and decoding of the values of the binary wire format (network byte order).
+namespace PgsqlBinary
+{
+	inline uint16_t read_uint16(const char *data)
+	{
+		const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+		return (uint16_t(p[0]) << 8) | uint16_t(p[1]);
+	}
+
+	inline uint32_t read_uint32(const char *data)
+	{
+		const unsigned char *p = reinterpret_cast<const unsigned char*>(data);
+		return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+	}
+
+	inline uint64_t read_uint64(const char *data)
+	{
+		return (uint64_t(read_uint32(data)) << 32) | read_uint32(data + 4);
+	}
+
+	inline int16_t read_int16(const char *data) { return static_cast<int16_t>(read_uint16(data)); }
+	inline int32_t read_int32(const char *data) { return static_cast<int32_t>(read_uint32(data)); }
+	inline int64_t read_int64(const char *data) { return static_cast<int64_t>(read_uint64(data)); }
+
+	inline float read_float4(const char *data)
+	{
+		const uint32_t bits = read_uint32(data);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	inline double read_float8(const char *data)
+	{
+		const uint64_t bits = read_uint64(data);
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	inline void store_uint16(char *out, uint16_t value)
+	{
+		out[0] = char(value >> 8);
+		out[1] = char(value);
+	}
+
+	inline void store_uint32(char *out, uint32_t value)
+	{
+		out[0] = char(value >> 24);
+		out[1] = char(value >> 16);
+		out[2] = char(value >> 8);
+		out[3] = char(value);
+	}
+
+	inline void store_uint64(char *out, uint64_t value)
+	{
+		store_uint32(out, uint32_t(value >> 32));
+		store_uint32(out + 4, uint32_t(value));
+	}
+
+	inline void write_uint16(std::string &out, uint16_t value)
+	{
+		out.push_back(char(value >> 8));
+		out.push_back(char(value));
+	}
+
+	inline void write_uint32(std::string &out, uint32_t value)
+	{
+		out.push_back(char(value >> 24));
+		out.push_back(char(value >> 16));
+		out.push_back(char(value >> 8));
+		out.push_back(char(value));
+	}
+
+	inline void write_uint64(std::string &out, uint64_t value)
+	{
+		write_uint32(out, uint32_t(value >> 32));
+		write_uint32(out, uint32_t(value));
+	}
+
+	inline void write_int16(std::string &out, int16_t value) { write_uint16(out, static_cast<uint16_t>(value)); }
+	inline void write_int32(std::string &out, int32_t value) { write_uint32(out, static_cast<uint32_t>(value)); }
+	inline void write_int64(std::string &out, int64_t value) { write_uint64(out, static_cast<uint64_t>(value)); }
+
+	inline void write_float4(std::string &out, float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		write_uint32(out, bits);
+	}
+
+	inline void write_float8(std::string &out, double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		write_uint64(out, bits);
+	}
+
+	/// \brief Shortest text reading back as the same value, as the server prints float4 and float8.
+	std::string float4_to_text(float value);
+	std::string float8_to_text(double value);
+}
+
+}; // namespace clan
+
+/// \}
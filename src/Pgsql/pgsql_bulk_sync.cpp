@@ -0,0 +1,347 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_bulk_sync.h"
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "ClanLib/Database/db_transaction.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/System/datetime.h"
+#include "ClanLib/Core/Text/string_help.h"
+#include "ClanLib/Core/Text/string_format.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_binary.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace clan
+{
+
+namespace
+{
+	const char *stage_table = "clan_bulk_sync";
+
+	// Signature, flags and header extension length of the binary COPY format
+	const char copy_header[19] = { 'P', 'G', 'C', 'O', 'P', 'Y', '\n', '\377', '\r', '\n', '\0', 0, 0, 0, 0, 0, 0, 0, 0 };
+	const char copy_trailer[2] = { '\377', '\377' };
+
+	/// \brief Runs one statement; returns its result, which must be cleared.
+	PGresult *execute(PgsqlConnectionProvider *provider, const std::string &sql, ExecStatusType expected)
+	{
+		PGresult *result = PQexec(provider->get_handle(), sql.c_str());
+		if (PQresultStatus(result) != expected)
+		{
+			auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+			std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(result, deleter);
+			provider->throw_result_error(result);
+		}
+		return result;
+	}
+
+	void execute(PgsqlConnectionProvider *provider, const std::string &sql)
+	{
+		PQclear(execute(provider, sql, PGRES_COMMAND_OK));
+	}
+
+	std::string join(const std::vector<std::string> &items, const std::string &prefix, const std::string &suffix)
+	{
+		std::string text;
+		for (size_t i = 0; i < items.size(); i++)
+			text += (i ? ", " : "") + prefix + items[i] + suffix;
+		return text;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBulkSync Construction:
+
+PgsqlBulkSync::PgsqlBulkSync(const std::string &table, const std::vector<std::string> &columns, const std::vector<std::string> &key_columns)
+: table(table), columns(columns), key_columns(key_columns), column_kinds(columns.size(), no_value), delete_missing(false), value_count(0)
+{
+	if (columns.empty() || columns.size() > 1600)
+		throw Exception("PgsqlBulkSync needs between 1 and 1600 columns");
+	if (key_columns.empty())
+		throw Exception("PgsqlBulkSync needs at least one key column");
+	for (auto &key : key_columns)
+	{
+		if (std::find(columns.begin(), columns.end(), key) == columns.end())
+			throw Exception("PgsqlBulkSync key column " + key + " is not one of the columns");
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBulkSync Attributes:
+
+int PgsqlBulkSync::get_row_count() const
+{
+	return value_count / columns.size();
+}
+
+std::string PgsqlBulkSync::get_copy_data() const
+{
+	if (value_count % columns.size())
+		throw Exception("PgsqlBulkSync: the last row is incomplete");
+
+	std::string copy_data;
+	copy_data.reserve(sizeof(copy_header) + data.size() + sizeof(copy_trailer));
+	copy_data.append(copy_header, sizeof(copy_header));
+	copy_data.append(data);
+	copy_data.append(copy_trailer, sizeof(copy_trailer));
+	return copy_data;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBulkSync Operations:
+
+void PgsqlBulkSync::set_delete_missing(bool enable, const std::string &condition)
+{
+	delete_missing = enable;
+	delete_condition = condition;
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add_null()
+{
+	begin_value(no_value);
+	PgsqlBinary::write_int32(data, -1);
+	return *this;
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add(bool value)
+{
+	const char byte = value ? 1 : 0;
+	add_bytes(bool_value, &byte, 1);
+	return *this;
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add(int value)
+{
+	return add(static_cast<long long>(value));
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add(long long value)
+{
+	begin_value(int_value);
+	PgsqlBinary::write_int32(data, 8);
+	PgsqlBinary::write_int64(data, value);
+	return *this;
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add(double value)
+{
+	begin_value(double_value);
+	PgsqlBinary::write_int32(data, 8);
+	PgsqlBinary::write_float8(data, value);
+	return *this;
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add(const char *value)
+{
+	add_bytes(text_value, value, std::strlen(value));
+	return *this;
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add(const std::string &value)
+{
+	add_bytes(text_value, value.data(), value.size());
+	return *this;
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add(const DateTime &value)
+{
+	return add(value.to_short_datetime_string());
+}
+
+PgsqlBulkSync &PgsqlBulkSync::add(const DataBuffer &value)
+{
+	add_bytes(binary_value, value.get_data(), value.get_size());
+	return *this;
+}
+
+void PgsqlBulkSync::clear()
+{
+	data.clear();
+	value_count = 0;
+	std::fill(column_kinds.begin(), column_kinds.end(), no_value);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlBulkSync Implementation:
+
+void PgsqlBulkSync::begin_value(ValueKind kind)
+{
+	const size_t column = value_count % columns.size();
+	if (kind != no_value)
+	{
+		if (column_kinds[column] == no_value)
+			column_kinds[column] = kind;
+		else if (column_kinds[column] != kind)
+			throw Exception("PgsqlBulkSync: the values of column " + columns[column] + " are not all of the same kind");
+	}
+
+	if (column == 0)
+		PgsqlBinary::write_int16(data, columns.size());
+	value_count++;
+}
+
+void PgsqlBulkSync::add_bytes(ValueKind kind, const char *bytes, size_t size)
+{
+	if (size > 0x7fffffff)
+		throw Exception("PgsqlBulkSync value too large");
+	begin_value(kind);
+	PgsqlBinary::write_int32(data, size);
+	data.append(bytes, size);
+}
+
+PgsqlBulkSyncResult PgsqlBulkSync::apply(PgsqlConnection &connection) const
+{
+	if (value_count % columns.size())
+		throw Exception("PgsqlBulkSync: the last row is incomplete");
+
+	PgsqlConnectionProvider *provider = PgsqlConnectionProvider::from_connection(connection);
+	PGconn *db = provider->get_handle();
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+
+	// Names of the column types, to convert the staged values
+	std::vector<std::string> casts;
+	{
+		std::unique_ptr<PGresult, decltype(deleter)> result(execute(provider, "SELECT " + join(columns, "", "") + " FROM " + table + " LIMIT 0", PGRES_TUPLES_OK), deleter);
+		std::string sql = "SELECT ";
+		for (size_t i = 0; i < columns.size(); i++)
+			sql += (i ? ", " : "") + string_format("format_type(%1, %2)", StringHelp::ll_to_text(PQftype(result.get(), i)), StringHelp::int_to_text(PQfmod(result.get(), i)));
+		std::unique_ptr<PGresult, decltype(deleter)> types(execute(provider, sql, PGRES_TUPLES_OK), deleter);
+		for (size_t i = 0; i < columns.size(); i++)
+			casts.push_back(std::string("::") + PQgetvalue(types.get(), 0, i));
+	}
+
+	DBTransaction transaction;
+	const bool own_transaction = !provider->in_transaction();
+	if (own_transaction)
+		transaction = connection.begin_transaction();
+
+	PgsqlBulkSyncResult counts;
+	try
+	{
+		// Temporary tables are never written to the WAL
+		std::string create = string_format("CREATE TEMPORARY TABLE %1 (", stage_table);
+		for (size_t i = 0; i < columns.size(); i++)
+		{
+			static const char *stage_types[] = { "text", "boolean", "bigint", "double precision", "text", "bytea" };
+			create += (i ? ", " : "") + columns[i] + " " + stage_types[column_kinds[i]];
+		}
+		create += ") ON COMMIT DROP";
+		execute(provider, create);
+
+		{
+			std::unique_ptr<PGresult, decltype(deleter)> copy_result(execute(provider, string_format("COPY %1 FROM STDIN (FORMAT binary)", stage_table), PGRES_COPY_IN), deleter);
+
+			const size_t chunk_size = 1024 * 1024;
+			bool sent = PQputCopyData(db, copy_header, sizeof(copy_header)) == 1;
+			for (size_t pos = 0; sent && pos < data.size(); pos += chunk_size)
+				sent = PQputCopyData(db, data.data() + pos, std::min(chunk_size, data.size() - pos)) == 1;
+			if (!sent || PQputCopyData(db, copy_trailer, sizeof(copy_trailer)) != 1 || PQputCopyEnd(db, nullptr) != 1)
+				throw Exception(PQerrorMessage(db));
+
+			std::unique_ptr<PGresult, decltype(deleter)> result(PQgetResult(db), deleter);
+			for (PGresult *next = PQgetResult(db); next; next = PQgetResult(db))
+				PQclear(next);
+			if (PQresultStatus(result.get()) != PGRES_COMMAND_OK)
+				provider->throw_result_error(result.get());
+		}
+		execute(provider, string_format("ANALYZE %1", stage_table));
+
+		std::vector<std::string> values;
+		std::vector<std::string> updated_columns;
+		for (size_t i = 0; i < columns.size(); i++)
+		{
+			values.push_back("s." + columns[i] + casts[i]);
+			if (std::find(key_columns.begin(), key_columns.end(), columns[i]) == key_columns.end())
+				updated_columns.push_back(columns[i]);
+		}
+
+		// xmax is zero for the rows inserted by the statement, and set for the updated ones
+		std::string upsert = "WITH applied AS (INSERT INTO " + table + " AS t (" + join(columns, "", "") + ") SELECT " + join(values, "", "") +
+			" FROM " + stage_table + " s ON CONFLICT (" + join(key_columns, "", "") + ") DO ";
+		if (updated_columns.empty())
+		{
+			upsert += "NOTHING";
+		}
+		else
+		{
+			upsert += "UPDATE SET ";
+			for (size_t i = 0; i < updated_columns.size(); i++)
+				upsert += (i ? ", " : "") + updated_columns[i] + " = EXCLUDED." + updated_columns[i];
+			upsert += " WHERE (" + join(updated_columns, "t.", "") + ") IS DISTINCT FROM (" + join(updated_columns, "EXCLUDED.", "") + ")";
+		}
+		upsert += " RETURNING (t.xmax = 0) AS inserted) SELECT count(*) FILTER (WHERE inserted), count(*) FILTER (WHERE NOT inserted) FROM applied";
+
+		{
+			std::unique_ptr<PGresult, decltype(deleter)> result(execute(provider, upsert, PGRES_TUPLES_OK), deleter);
+			counts.inserted = StringHelp::text_to_ll(PQgetvalue(result.get(), 0, 0));
+			counts.updated = StringHelp::text_to_ll(PQgetvalue(result.get(), 0, 1));
+		}
+
+		if (delete_missing)
+		{
+			std::string sql = "DELETE FROM " + table + " AS t WHERE NOT EXISTS (SELECT 1 FROM " + stage_table + " s WHERE ";
+			for (size_t i = 0; i < key_columns.size(); i++)
+			{
+				const size_t column = std::find(columns.begin(), columns.end(), key_columns[i]) - columns.begin();
+				sql += (i ? " AND " : "") + std::string("t.") + key_columns[i] + " = " + values[column];
+			}
+			sql += ")";
+			if (!delete_condition.empty())
+				sql += " AND (" + delete_condition + ")";
+
+			std::unique_ptr<PGresult, decltype(deleter)> result(execute(provider, sql, PGRES_COMMAND_OK), deleter);
+			counts.deleted = StringHelp::text_to_ll(PQcmdTuples(result.get()));
+		}
+
+		execute(provider, string_format("DROP TABLE %1", stage_table));
+		if (own_transaction)
+			transaction.commit();
+	}
+	catch (...)
+	{
+		if (own_transaction)
+		{
+			try
+			{
+				transaction.rollback();
+			}
+			catch (...)
+			{
+			}
+		}
+		throw;
+	}
+	return counts;
+}
+
+}; // namespace clan
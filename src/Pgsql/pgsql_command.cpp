@@ -0,0 +1,235 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_command.h"
+#include "pgsql_command_provider.h"
+#include "pgsql_array.h"
+#include "pgsql_numeric.h"
+#include "pgsql_geometry.h"
+#include "pg_type.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlCommand Construction:
+
+PgsqlCommand::PgsqlCommand(DBCommand &command)
+: command(command), provider(dynamic_cast<PgsqlCommandProvider*>(command.get_provider()))
+{
+	if (!provider)
+		throw Exception("PgsqlCommand only accepts commands created by a PgsqlConnection using the libpq engine");
+}
+
+PgsqlCommand::~PgsqlCommand()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlCommand Attributes:
+
+int PgsqlCommand::get_timeout() const
+{
+	return provider->get_timeout();
+}
+
+int PgsqlCommand::get_affected_rows() const
+{
+	return provider->get_affected_rows();
+}
+
+long long PgsqlCommand::get_last_insert_id() const
+{
+	return provider->get_last_insert_id();
+}
+
+bool PgsqlCommand::get_binary_results() const
+{
+	return provider->get_binary_results();
+}
+
+bool PgsqlCommand::get_multiple_statements() const
+{
+	return provider->get_multiple_statements();
+}
+
+bool PgsqlCommand::get_fetch_cursors() const
+{
+	return provider->get_fetch_cursors();
+}
+
+bool PgsqlCommand::get_stream_results() const
+{
+	return provider->get_stream_results();
+}
+
+bool PgsqlCommand::get_single_flight() const
+{
+	return provider->get_single_flight();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlCommand Operations:
+
+void PgsqlCommand::set_timeout(int timeout_ms)
+{
+	provider->set_timeout(timeout_ms);
+}
+
+void PgsqlCommand::set_binary_results(bool enable)
+{
+	provider->set_binary_results(enable);
+}
+
+void PgsqlCommand::set_multiple_statements(bool enable)
+{
+	provider->set_multiple_statements(enable);
+}
+
+void PgsqlCommand::set_fetch_cursors(bool enable)
+{
+	provider->set_fetch_cursors(enable);
+}
+
+void PgsqlCommand::set_stream_results(bool enable)
+{
+	provider->set_stream_results(enable);
+}
+
+void PgsqlCommand::set_single_flight(bool enable)
+{
+	provider->set_single_flight(enable);
+}
+
+void PgsqlCommand::set_input_parameter_int16_array(int index, const std::vector<short> &values)
+{
+	provider->set_input_parameter_array(index, INT2ARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_int_array(int index, const std::vector<int> &values)
+{
+	provider->set_input_parameter_array(index, INT4ARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_int64_array(int index, const std::vector<long long> &values)
+{
+	provider->set_input_parameter_array(index, INT8ARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_float_array(int index, const std::vector<float> &values)
+{
+	provider->set_input_parameter_array(index, FLOAT4ARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_double_array(int index, const std::vector<double> &values)
+{
+	provider->set_input_parameter_array(index, FLOAT8ARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_string_array(int index, const std::vector<std::string> &values)
+{
+	provider->set_input_parameter_array(index, TEXTARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_binary_array(int index, const std::vector<DataBuffer> &values)
+{
+	provider->set_input_parameter_array(index, BYTEAARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_fixed(int index, long long value, int scale)
+{
+	provider->set_input_parameter_numeric(index, PgsqlNumeric::encode(value, scale));
+}
+
+#ifdef __SIZEOF_INT128__
+void PgsqlCommand::set_input_parameter_fixed128(int index, __int128 value, int scale)
+{
+	provider->set_input_parameter_numeric(index, PgsqlNumeric::encode(value, scale));
+}
+#endif
+
+void PgsqlCommand::set_input_parameter_point(int index, const Vec2d &value)
+{
+	std::string encoded(PgsqlGeometry::point_size, '\0');
+	PgsqlGeometry::store_point(&encoded[0], value);
+	provider->set_input_parameter_geometry(index, POINTOID, encoded);
+}
+
+void PgsqlCommand::set_input_parameter_line_segment(int index, const LineSegment2d &value)
+{
+	std::string encoded(PgsqlGeometry::line_segment_size, '\0');
+	PgsqlGeometry::store_line_segment(&encoded[0], value);
+	provider->set_input_parameter_geometry(index, LSEGOID, encoded);
+}
+
+void PgsqlCommand::set_input_parameter_box(int index, const Rectd &value)
+{
+	std::string encoded(PgsqlGeometry::box_size, '\0');
+	PgsqlGeometry::store_box(&encoded[0], value);
+	provider->set_input_parameter_geometry(index, BOXOID, encoded);
+}
+
+void PgsqlCommand::set_input_parameter_circle(int index, const Circled &value)
+{
+	std::string encoded(PgsqlGeometry::circle_size, '\0');
+	PgsqlGeometry::store_circle(&encoded[0], value);
+	provider->set_input_parameter_geometry(index, CIRCLEOID, encoded);
+}
+
+void PgsqlCommand::set_input_parameter_polygon(int index, const std::vector<Vec2d> &points)
+{
+	provider->set_input_parameter_geometry(index, POLYGONOID, PgsqlGeometry::encode(points));
+}
+
+void PgsqlCommand::set_input_parameter_point_array(int index, const std::vector<Vec2d> &values)
+{
+	provider->set_input_parameter_array(index, POINTARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_line_segment_array(int index, const std::vector<LineSegment2d> &values)
+{
+	provider->set_input_parameter_array(index, LSEGARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_box_array(int index, const std::vector<Rectd> &values)
+{
+	provider->set_input_parameter_array(index, BOXARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_circle_array(int index, const std::vector<Circled> &values)
+{
+	provider->set_input_parameter_array(index, CIRCLEARRAYOID, PgsqlArray::encode(values));
+}
+
+void PgsqlCommand::set_input_parameter_polygon_array(int index, const std::vector<std::vector<Vec2d> > &polygons)
+{
+	provider->set_input_parameter_array(index, POLYGONARRAYOID, PgsqlArray::encode(polygons));
+}
+
+}; // namespace clan
@@ -30,15 +30,22 @@
 
 #include "Pgsql/precomp.h"
 #include "pg_type.h"
+#include "pgsql_binary.h"
+#include "pgsql_value.h"
 #include "pgsql_command_provider.h"
 #include "pgsql_connection_provider.h"
 #include "pgsql_reader_provider.h"
 #include "ClanLib/Core/System/databuffer.h"
 #include "ClanLib/Core/Text/string_help.h"
+#include "ClanLib/Core/Text/string_format.h"
 #include "ClanLib/Database/db_command_provider.h"
 
 #include <libpq-fe.h>
 #include <sstream>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 
 namespace clan
 {
@@ -46,11 +53,23 @@ namespace clan
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlCommandProvider Construction:
 
-PgsqlCommandProvider::PgsqlCommandProvider(PgsqlConnectionProvider *connection, const std::string &user_text)
-: connection(connection), last_insert_rowid(-1)
+PgsqlCommandProvider::PgsqlCommandProvider(PgsqlConnectionProvider *connection, const std::string &user_text, DBCommand::Type type)
+: connection(connection), type(type), last_insert_id(-1), lastval_pending(false), affected_rows(0), is_insert_without_returning(false), timeout(-1), binary_results(false), multiple_statements(false), fetch_cursors(false), stream_results(false), single_flight(false)
 {
+	if (type == DBCommand::stored_procedure)
+	{
+		// The text is the routine name; parameters are added as they are set
+		text = user_text;
+		arguments_count = 0;
+		return;
+	}
+
 	text = compute_command(user_text, arguments_count);
-	arguments.resize(arguments_count);
+	parameters.resize(arguments_count);
+
+	const std::vector<std::string> keywords = get_keywords(text);
+	if (!keywords.empty() && keywords.front() == "INSERT")
+		is_insert_without_returning = std::find(keywords.begin(), keywords.end(), "RETURNING") == keywords.end();
 }
 
 PgsqlCommandProvider::~PgsqlCommandProvider()
@@ -67,7 +86,72 @@ int PgsqlCommandProvider::get_input_parameter_column(const std::string &name) co
 
 int PgsqlCommandProvider::get_output_last_insert_rowid() const
 {
-	return last_insert_rowid;
+	return static_cast<int>(get_last_insert_id());
+}
+
+long long PgsqlCommandProvider::get_last_insert_id() const
+{
+	if (!lastval_pending)
+		return last_insert_id;
+	lastval_pending = false;
+
+	PGconn *db = connection->db;
+	switch (PQtransactionStatus(db))
+	{
+	case PQTRANS_IDLE:
+		last_insert_id = read_lastval(PQexec(db, "SELECT lastval()"));
+		break;
+	case PQTRANS_INTRANS:
+		// lastval() fails if no sequence was used yet; do not let that abort the transaction
+		PQclear(PQexec(db, "SAVEPOINT clanpgsql_lastval"));
+		last_insert_id = read_lastval(PQexec(db, "SELECT lastval()"));
+		if (last_insert_id < 0)
+			PQclear(PQexec(db, "ROLLBACK TO SAVEPOINT clanpgsql_lastval"));
+		PQclear(PQexec(db, "RELEASE SAVEPOINT clanpgsql_lastval"));
+		break;
+	default:
+		break;
+	}
+	return last_insert_id;
+}
+
+std::string PgsqlCommandProvider::get_cache_key() const
+{
+	std::string key = type == DBCommand::stored_procedure ? "CALL " + text : text;
+	for (auto &parameter : parameters)
+	{
+		// Length prefixed, so that no two parameter lists give the same key
+		if (parameter.kind == Parameter::null_value)
+			key += "\nn";
+		else
+			key += string_format("\n%1.%2.%3:", (int)parameter.kind, (int)parameter.type, (int)parameter.data.size());
+		key += parameter.data;
+	}
+	return key;
+}
+
+bool PgsqlCommandProvider::is_read_only_statement(const std::string &text)
+{
+	std::vector<std::string> words = get_keywords(text);
+	while (!words.empty() && words.back() == ";")
+		words.pop_back();
+
+	if (words.empty())
+		return false;
+
+	const std::string &first = words.front();
+	if (first != "SELECT" && first != "WITH" && first != "SHOW" && first != "VALUES" && first != "TABLE")
+		return false;
+
+	for (size_t i = 1; i < words.size(); i++)
+	{
+		const std::string &w = words[i];
+		if (w == "INSERT" || w == "UPDATE" || w == "DELETE" || w == "MERGE" || w == "INTO" || w == ";")
+			return false;
+		if (w == "FOR" && i + 1 < words.size() && (words[i + 1] == "UPDATE" || words[i + 1] == "SHARE" || words[i + 1] == "NO" || words[i + 1] == "KEY"))
+			return false;
+	}
+	return true;
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -75,56 +159,165 @@ int PgsqlCommandProvider::get_output_last_insert_rowid() const
 
 void PgsqlCommandProvider::set_input_parameter_string(int index, const std::string &value)
 {
-	put(index, std::string(value));
+	Parameter &parameter = put(index);
+	parameter.kind = Parameter::text_value;
+	parameter.data = value;
 }
 
 void PgsqlCommandProvider::set_input_parameter_bool(int index, bool value)
 {
-	put(index, StringHelp::bool_to_text(value));
+	Parameter &parameter = put(index);
+	parameter.kind = Parameter::bool_value;
+	parameter.data = StringHelp::bool_to_text(value);
+	parameter.int_data = value ? 1 : 0;
 }
 
 void PgsqlCommandProvider::set_input_parameter_int(int index, int value)
 {
-	put(index, StringHelp::int_to_text(value));
+	Parameter &parameter = put(index);
+	parameter.kind = Parameter::int_value;
+	parameter.data = StringHelp::int_to_text(value);
+	parameter.int_data = value;
 }
 
 void PgsqlCommandProvider::set_input_parameter_double(int index, double value)
 {
-	put(index, StringHelp::double_to_text(value));
+	Parameter &parameter = put(index);
+	parameter.kind = Parameter::double_value;
+	parameter.data = StringHelp::double_to_text(value);
+	parameter.double_data = value;
 }
 
 void PgsqlCommandProvider::set_input_parameter_datetime(int index, const DateTime &value)
 {
-	put(index, PgsqlConnectionProvider::to_sql_datetime(value));
+	set_input_parameter_string(index, PgsqlConnectionProvider::to_sql_datetime(value));
+}
+
+void PgsqlCommandProvider::set_input_parameter_array(int index, Oid array_type, const std::string &encoded)
+{
+	Parameter &parameter = put(index);
+	parameter.kind = Parameter::binary_value;
+	parameter.data = encoded;
+	parameter.type = array_type;
+}
+
+void PgsqlCommandProvider::set_input_parameter_numeric(int index, const std::string &encoded)
+{
+	Parameter &parameter = put(index);
+	parameter.kind = Parameter::binary_value;
+	parameter.data = encoded;
+	parameter.type = NUMERICOID;
+}
+
+void PgsqlCommandProvider::set_input_parameter_geometry(int index, Oid type, const std::string &encoded)
+{
+	Parameter &parameter = put(index);
+	parameter.kind = Parameter::binary_value;
+	parameter.data = encoded;
+	parameter.type = type;
 }
 
 void PgsqlCommandProvider::set_input_parameter_binary(int index, const DataBuffer &value)
 {
-	put(index, value);
+	Parameter &parameter = put(index);
+	parameter.kind = Parameter::binary_value;
+	parameter.data.assign(value.get_data(), value.get_size());
+	parameter.type = BYTEAOID;
 }
 
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlCommandProvider Implementation:
-inline
-void PgsqlCommandProvider::put(int index, const std::string &value)
+PgsqlCommandProvider::Parameter &PgsqlCommandProvider::put(int index)
 {
-	if (index > arguments_count)
+	if (type == DBCommand::stored_procedure && index > arguments_count)
+	{
+		arguments_count = index;
+		parameters.resize(arguments_count);
+	}
+	if (index < 1 || index > arguments_count)
 		throw Exception("Index out of range");
-	arguments[index - 1] = value;
-	bin_arguments.erase(index);
+
+	Parameter &parameter = parameters[index - 1];
+	parameter = Parameter();
+	return parameter;
 }
 
-inline
-void PgsqlCommandProvider::put(int index, const DataBuffer &value)
+void PgsqlCommandProvider::fill_parameters(const char **values, Oid *types, int *lengths, int *formats,
+	std::vector<std::string> &encoded, const std::vector<Oid> *routine_types) const
 {
-	if (index < 1 || index > arguments_count)
-		throw Exception("Index out of range");
-	last_insert_rowid = index;
-	arguments[index - 1] = "";
-	bin_arguments[index - 1] = value;
+	encoded.assign(arguments_count, std::string());
+	for (int i = 0; i < arguments_count; i++)
+	{
+		const Parameter &parameter = parameters[i];
+		const Oid target = routine_types ? (*routine_types)[i] : NULLOID;
+
+		values[i] = parameter.data.data();
+		types[i] = NULLOID; //Let the server infer the type
+		formats[i] = 0; //It's a text string
+		lengths[i] = parameter.data.size();
+
+		switch (parameter.kind)
+		{
+		case Parameter::null_value:
+			values[i] = 0;
+			break;
+		case Parameter::text_value:
+			if (parameter.data.empty())
+				values[i] = 0; //An empty string is sent as NULL
+			break;
+		case Parameter::binary_value:
+			types[i] = parameter.type;
+			formats[i] = 1;
+			break;
+		case Parameter::bool_value:
+			if (target == BOOLOID)
+			{
+				encoded[i].assign(1, parameter.int_data ? 1 : 0);
+				formats[i] = 1;
+			}
+			break;
+		case Parameter::int_value:
+			if (target == INT8OID)
+			{
+				PgsqlBinary::write_int64(encoded[i], parameter.int_data);
+				formats[i] = 1;
+			}
+			else if (target == INT4OID && parameter.int_data >= -2147483647LL - 1 && parameter.int_data <= 2147483647LL)
+			{
+				PgsqlBinary::write_int32(encoded[i], parameter.int_data);
+				formats[i] = 1;
+			}
+			else if (target == INT2OID && parameter.int_data >= -32768 && parameter.int_data <= 32767)
+			{
+				PgsqlBinary::write_int16(encoded[i], parameter.int_data);
+				formats[i] = 1;
+			}
+			break;
+		case Parameter::double_value:
+			if (target == FLOAT8OID)
+			{
+				PgsqlBinary::write_float8(encoded[i], parameter.double_data);
+				formats[i] = 1;
+			}
+			else if (target == FLOAT4OID)
+			{
+				PgsqlBinary::write_float4(encoded[i], parameter.double_data);
+				formats[i] = 1;
+			}
+			break;
+		}
+
+		if (!encoded[i].empty())
+		{
+			values[i] = encoded[i].data();
+			lengths[i] = encoded[i].size();
+		}
+		if (routine_types)
+			types[i] = target;
+	}
 }
 
-std::string PgsqlCommandProvider::compute_command(const std::string &text, int &arguments_count) const
+std::string PgsqlCommandProvider::compute_command(const std::string &text, int &arguments_count)
 {
 	std::string out;
 	int arguments = 0;
@@ -142,49 +335,309 @@ std::string PgsqlCommandProvider::compute_command(const std::string &text, int &
 	return out;
 }
 
-PGresult *PgsqlCommandProvider::exec_command()
+std::vector<std::string> PgsqlCommandProvider::get_keywords(const std::string &text)
 {
-	std::unique_ptr<const char*[]> values(new const char*[arguments_count + 1]);
-	std::unique_ptr<Oid[]>  types(new Oid[arguments_count + 1]);
-	std::unique_ptr<int[]>  formats(new int[arguments_count + 1]);
-	std::unique_ptr<int[]>  lengths(new int[arguments_count + 1]);
-
-	for (int i = 0; i < arguments_count; i++)
+	std::vector<std::string> words;
+	std::string word;
+	for (size_t i = 0; i < text.size(); i++)
 	{
-		if (!arguments[i].empty())
+		const char c = text[i];
+		if (isalnum(static_cast<unsigned char>(c)) || c == '_' || (c == '$' && !word.empty()))
 		{
-			values[i] = arguments[i].c_str(); //The value as string
-			types[i] = NULLOID; //Default type
-			formats[i] = 0; //It's a text string
-			lengths[i] = 0; //Let libpq calculate the string length
+			word.push_back(toupper(static_cast<unsigned char>(c)));
+			continue;
 		}
-		else
+		if (!word.empty())
+		{
+			words.push_back(word);
+			word.clear();
+		}
+
+		size_t end;
+		if (c == '-' && i + 1 < text.size() && text[i + 1] == '-')
+			end = text.find('\n', i);
+		else if (c == '/' && i + 1 < text.size() && text[i + 1] == '*')
+			end = text.find("*/", i + 2) + 1;
+		else if (c == '\'' || c == '"')
+			end = text.find(c, i + 1);
+		else if (c != '$' || !is_dollar_quote(text, i, end))
+		{
+			if (c == ';')
+				words.push_back(";");
+			continue;
+		}
+		if (end == std::string::npos || end == 0)
+			break;
+		i = end;
+	}
+	if (!word.empty())
+		words.push_back(word);
+	return words;
+}
+
+bool PgsqlCommandProvider::is_dollar_quote(const std::string &text, size_t start, size_t &end)
+{
+	// $$ or $tag$, where tag does not start with a digit ($1 is a placeholder)
+	size_t tag_end = start + 1;
+	if (tag_end < text.size() && (isalpha(static_cast<unsigned char>(text[tag_end])) || text[tag_end] == '_'))
+	{
+		while (tag_end < text.size() && (isalnum(static_cast<unsigned char>(text[tag_end])) || text[tag_end] == '_'))
+			tag_end++;
+	}
+	if (tag_end >= text.size() || text[tag_end] != '$')
+		return false;
+
+	const std::string tag = text.substr(start, tag_end - start + 1);
+	end = text.find(tag, tag_end + 1);
+	if (end != std::string::npos)
+		end += tag.size() - 1;
+	return true;
+}
+
+void PgsqlCommandProvider::capture_result(const PGresult *result)
+{
+	const ExecStatusType status = PQresultStatus(result);
+	if (status != PGRES_COMMAND_OK && status != PGRES_TUPLES_OK)
+	{
+		lastval_pending = false;
+		return;
+	}
+
+	affected_rows = std::atoi(PQcmdTuples(const_cast<PGresult*>(result)));
+
+	// "INSERT oid rows": the first RETURNING column holds the new id
+	if (std::strncmp(PQcmdStatus(const_cast<PGresult*>(result)), "INSERT", 6) == 0)
+	{
+		const int rows = PQntuples(result);
+		if (PQnfields(result) > 0 && rows > 0 && !PQgetisnull(result, rows - 1, 0))
 		{
-			if (bin_arguments.find(i) != bin_arguments.end())
+			const char *value = PQgetvalue(result, rows - 1, 0);
+			const Oid id_type = PQftype(result, 0);
+			if (PQfformat(result, 0) == 1)
 			{
-				values[i] = bin_arguments[i].get_data();
-				types[i] = BYTEAOID; //Default type
-				formats[i] = 1; //It's a binary string
-				lengths[i] = bin_arguments[i].get_size();
+				const bool integer = id_type == INT2OID || id_type == INT4OID || id_type == INT8OID;
+				last_insert_id = integer ? PgsqlValue(value, PQgetlength(result, rows - 1, 0), id_type, 1).to_int64() : -1;
 			}
 			else
 			{
-				values[i] = 0;
-				types[i] = NULLOID;
-				formats[i] = 0;
-				lengths[i] = 0; //Let libpq calculate the string length
+				char *end = nullptr;
+				const long long id = std::strtoll(value, &end, 10);
+				last_insert_id = (end != value && *end == '\0') ? id : -1;
 			}
 		}
 	}
+}
+
+long long PgsqlCommandProvider::read_lastval(PGresult *result)
+{
+	long long value = -1;
+	if (PQresultStatus(result) == PGRES_TUPLES_OK && PQntuples(result) == 1 && !PQgetisnull(result, 0, 0))
+		value = std::strtoll(PQgetvalue(result, 0, 0), nullptr, 10);
+	PQclear(result);
+	return value;
+}
+
+PGresult *PgsqlCommandProvider::exec_command()
+{
+	std::unique_ptr<const char*[]> values(new const char*[arguments_count + 1]);
+	std::unique_ptr<Oid[]>  types(new Oid[arguments_count + 1]);
+	std::unique_ptr<int[]>  formats(new int[arguments_count + 1]);
+	std::unique_ptr<int[]>  lengths(new int[arguments_count + 1]);
+
+	std::vector<std::string> encoded;
+	fill_parameters(values.get(), types.get(), lengths.get(), formats.get(), encoded, nullptr);
+
+	last_insert_id = -1;
+	lastval_pending = is_insert_without_returning;
+	affected_rows = 0;
 
-	return PQexecParams(connection->db,
+	PGresult *result;
+	if (type == DBCommand::stored_procedure)
+		result = exec_routine();
+	else
+		result = send_command(values.get(), types.get(), lengths.get(), formats.get());
+	capture_result(result);
+	return result;
+}
+
+void PgsqlCommandProvider::exec_command(std::vector<PGresult*> &results)
+{
+	// Only the simple query protocol accepts several statements, and it takes no parameters nor gives binary results
+	if (!multiple_statements || type != DBCommand::sql_statement || arguments_count > 0 || binary_results)
+	{
+		results.push_back(exec_command());
+		return;
+	}
+
+	last_insert_id = -1;
+	lastval_pending = is_insert_without_returning;
+	affected_rows = 0;
+
+	const int deadline = timeout >= 0 ? timeout : connection->default_timeout;
+	std::string previous_timeout;
+	PGresult *error = propagate_timeout(deadline, previous_timeout);
+	if (error)
+	{
+		results.push_back(error);
+		return;
+	}
+
+	if (!PQsendQuery(connection->db, text.c_str()))
+	{
+		results.push_back(nullptr);
+		return;
+	}
+	connection->get_results(deadline, results);
+	restore_timeout(previous_timeout);
+	for (PGresult *result : results)
+		capture_result(result);
+}
+
+void PgsqlCommandProvider::exec_streaming(const std::function<void(PGresult*)> &consume)
+{
+	last_insert_id = -1;
+	lastval_pending = false;
+	affected_rows = 0;
+
+	const int deadline = timeout >= 0 ? timeout : connection->default_timeout;
+	std::string previous_timeout;
+	PGresult *error = propagate_timeout(deadline, previous_timeout);
+	if (error)
+	{
+		consume(error);
+		return;
+	}
+
+	int sent;
+	if (multiple_statements && arguments_count == 0 && !binary_results)
+	{
+		sent = PQsendQuery(connection->db, text.c_str());
+	}
+	else
+	{
+		std::unique_ptr<const char*[]> values(new const char*[arguments_count + 1]);
+		std::unique_ptr<Oid[]>  types(new Oid[arguments_count + 1]);
+		std::unique_ptr<int[]>  formats(new int[arguments_count + 1]);
+		std::unique_ptr<int[]>  lengths(new int[arguments_count + 1]);
+		std::vector<std::string> encoded;
+		fill_parameters(values.get(), types.get(), lengths.get(), formats.get(), encoded, nullptr);
+		sent = PQsendQueryParams(connection->db, text.c_str(), arguments_count, types.get(), values.get(),
+			lengths.get(), formats.get(), binary_results ? 1 : 0);
+	}
+	if (!sent)
+	{
+		consume(nullptr);
+		return;
+	}
+
+	connection->receive_results(deadline, true, [&](PGresult *result)
+	{
+		// The last result of each statement has no rows but gives the command status
+		if (PQresultStatus(result) != PGRES_SINGLE_TUPLE)
+			capture_result(result);
+		consume(result);
+	});
+	restore_timeout(previous_timeout);
+}
+
+PGresult *PgsqlCommandProvider::propagate_timeout(int deadline, std::string &previous_timeout)
+{
+	previous_timeout.clear();
+	if (deadline > 0 && connection->propagate_statement_timeout && connection->in_transaction())
+	{
+		// Same as SET LOCAL, returning the value it replaces
+		const std::string set_timeout = string_format(
+			"SELECT current_setting('statement_timeout'), set_config('statement_timeout', '%1', true)", deadline);
+		PGresult *result = PQexec(connection->db, set_timeout.c_str());
+		if (PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) != 1)
+			return result;
+		previous_timeout = PQgetvalue(result, 0, 0);
+		PQclear(result);
+	}
+	return nullptr;
+}
+
+void PgsqlCommandProvider::restore_timeout(const std::string &previous_timeout)
+{
+	// After a failure, the transaction accepts no command until it is rolled back, which drops the setting
+	if (previous_timeout.empty() || PQtransactionStatus(connection->db) != PQTRANS_INTRANS)
+		return;
+
+	const char *values[1] = { previous_timeout.c_str() };
+	PQclear(PQexecParams(connection->db, "SELECT set_config('statement_timeout', $1, true)", 1, nullptr, values, nullptr, nullptr, 0));
+}
+
+PGresult *PgsqlCommandProvider::send_command(const char *const *values, const Oid *types, const int *lengths, const int *formats)
+{
+	const int deadline = timeout >= 0 ? timeout : connection->default_timeout;
+	if (deadline <= 0)
+	{
+		return PQexecParams(connection->db,
+				text.c_str(),
+				arguments_count,
+				types,
+				values,
+				lengths,
+				formats,
+				binary_results ? 1 : 0);
+	}
+
+	std::string previous_timeout;
+	PGresult *error = propagate_timeout(deadline, previous_timeout);
+	if (error)
+		return error;
+
+	if (!PQsendQueryParams(connection->db,
 			text.c_str(),
 			arguments_count,
-			types.get(),
-			values.get(),
-			lengths.get(),
-			formats.get(),
-			0); //Text output format
+			types,
+			values,
+			lengths,
+			formats,
+			binary_results ? 1 : 0))
+		return nullptr;
+	PGresult *result = connection->get_last_result(deadline);
+	restore_timeout(previous_timeout);
+	return result;
+}
+
+PGresult *PgsqlCommandProvider::exec_routine()
+{
+	std::unique_ptr<const char*[]> values(new const char*[arguments_count + 1]);
+	std::unique_ptr<Oid[]>  types(new Oid[arguments_count + 1]);
+	std::unique_ptr<int[]>  formats(new int[arguments_count + 1]);
+	std::unique_ptr<int[]>  lengths(new int[arguments_count + 1]);
+	std::vector<std::string> encoded;
+
+	const int deadline = timeout >= 0 ? timeout : connection->default_timeout;
+	for (int attempt = 0; ; attempt++)
+	{
+		const PgsqlConnectionProvider::Routine &routine = connection->prepare_routine(text, arguments_count);
+		fill_parameters(values.get(), types.get(), lengths.get(), formats.get(), encoded, &routine.input_types);
+
+		PGresult *result;
+		if (deadline <= 0)
+		{
+			result = PQexecPrepared(connection->db, routine.statement_name.c_str(), arguments_count,
+				values.get(), lengths.get(), formats.get(), binary_results ? 1 : 0);
+		}
+		else if (PQsendQueryPrepared(connection->db, routine.statement_name.c_str(), arguments_count,
+				values.get(), lengths.get(), formats.get(), binary_results ? 1 : 0))
+			result = connection->get_last_result(deadline);
+		else
+			result = nullptr;
+
+		// The prepared statement is gone after a reconnection, and stale if the routine was replaced
+		const char *sqlstate = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+		if (attempt == 0 && sqlstate && (std::string(sqlstate) == "26000" || std::string(sqlstate) == "0A000")
+			&& PQtransactionStatus(connection->db) == PQTRANS_IDLE)
+		{
+			PQclear(result);
+			connection->forget_routines();
+			continue;
+		}
+		return result;
+	}
 }
 
 };
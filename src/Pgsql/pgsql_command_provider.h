@@ -32,6 +32,7 @@
 
 #pragma once
 
+#include <functional>
 #include <vector>
 #include <map>
 
@@ -50,7 +51,7 @@ class PgsqlCommandProvider : public DBCommandProvider
 /// \name Construction
 /// \{
 public:
-	PgsqlCommandProvider(PgsqlConnectionProvider *connection, const std::string &text);
+	PgsqlCommandProvider(PgsqlConnectionProvider *connection, const std::string &text, DBCommand::Type type = DBCommand::sql_statement);
 	~PgsqlCommandProvider();
 /// \}
 
@@ -59,6 +60,47 @@ public:
 public:
 	int get_input_parameter_column(const std::string &name) const;
 	int get_output_last_insert_rowid() const;
+
+	/// \brief Returns the SQL text followed by the bytes of every bound parameter.
+	///
+	/// Two commands with the same key return the same rows when run on the same database snapshot.
+	std::string get_cache_key() const;
+
+	PgsqlConnectionProvider *get_connection() const { return connection; }
+
+	/// \brief Tells if the SQL text only reads data, judging from its leading keyword.
+	///
+	/// SELECT ... FOR UPDATE/SHARE, SELECT ... INTO and WITH queries containing
+	/// data modifying statements are not considered read only.
+	static bool is_read_only_statement(const std::string &text);
+
+	/// \brief Deadline of the command; -1 uses the connection default, 0 disables it.
+	int get_timeout() const { return timeout; }
+
+	/// \brief Tells if results are requested in the binary format.
+	bool get_binary_results() const { return binary_results; }
+
+	/// \brief Tells if the text may hold several statements.
+	bool get_multiple_statements() const { return multiple_statements; }
+
+	/// \brief Tells if refcursors returned by the command are fetched.
+	bool get_fetch_cursors() const { return fetch_cursors; }
+
+	/// \brief Tells if the rows are received one at a time, charged to the result memory budgets.
+	bool get_stream_results() const { return stream_results; }
+
+	/// \brief Tells if concurrent executions of the same read only statement share one result.
+	bool get_single_flight() const { return single_flight; }
+
+	/// \brief Number of rows affected by the last execution (PQcmdTuples).
+	int get_affected_rows() const { return affected_rows; }
+
+	/// \brief Id of the row inserted by the last execution, or -1.
+	///
+	/// Taken from the first column of the RETURNING clause. Without one,
+	/// lastval() is fetched on the first call: one query when idle, four
+	/// inside a transaction (the query runs in a savepoint).
+	long long get_last_insert_id() const;
 /// \}
 
 /// \name Operations
@@ -70,27 +112,133 @@ public:
 	void set_input_parameter_double(int index, double value);
 	void set_input_parameter_datetime(int index, const DateTime &value);
 	void set_input_parameter_binary(int index, const DataBuffer &value);
+
+	/// \brief Bind an array encoded by PgsqlArray::encode.
+	void set_input_parameter_array(int index, Oid array_type, const std::string &encoded);
+
+	/// \brief Bind a NUMERIC encoded by PgsqlNumeric::encode.
+	void set_input_parameter_numeric(int index, const std::string &encoded);
+
+	/// \brief Bind a geometric value of the given type, encoded by PgsqlGeometry.
+	void set_input_parameter_geometry(int index, Oid type, const std::string &encoded);
+
+	void set_timeout(int timeout_ms) { timeout = timeout_ms; }
+
+	/// \brief Request results in the binary format (extended query protocol only).
+	void set_binary_results(bool enable) { binary_results = enable; }
+
+	/// \brief Send the text with the simple query protocol, so it may hold several statements.
+	void set_multiple_statements(bool enable) { multiple_statements = enable; }
+
+	/// \brief Replace results made only of refcursors by the rows of these cursors.
+	void set_fetch_cursors(bool enable) { fetch_cursors = enable; }
+
+	/// \brief Receive the rows one at a time when a result memory budget is in force.
+	void set_stream_results(bool enable) { stream_results = enable; }
+
+	/// \brief Share the result of concurrent executions of the same read only statement.
+	void set_single_flight(bool enable) { single_flight = enable; }
 /// \}
 
 /// \name Implementation
 /// \{
 private:
 	/// \brief Replace each '?' by a '$i' where i is the occurence of '?'.
-	std::string compute_command(const std::string &text, int &arguments_count) const;
+	static std::string compute_command(const std::string &text, int &arguments_count);
+
+	/// \brief Split the SQL text into upper case words, skipping comments and literals (dollar quoted too).
+	///
+	/// Statement separators are returned as ";" words.
+	static std::vector<std::string> get_keywords(const std::string &text);
+
+	/// \brief Tells if a dollar quoted string starts at start, and finds its last character.
+	static bool is_dollar_quote(const std::string &text, size_t start, size_t &end);
+
+	/// \brief Record affected rows and RETURNING id of a result.
+	void capture_result(const PGresult *result);
+
+	/// \brief Read the value of SELECT lastval(); returns -1 if the query failed.
+	static long long read_lastval(PGresult *result);
+
+	/// \brief A bound parameter.
+	struct Parameter
+	{
+		enum Kind
+		{
+			null_value,
+			text_value,
+			int_value,
+			double_value,
+			bool_value,
+			binary_value
+		};
+
+		Parameter() : kind(null_value), type(0), int_data(0), double_data(0) { }
+
+		Kind kind;
+		std::string data;  // Text form, or bytes of binary values
+		Oid type;          // Type of binary values
+		long long int_data;
+		double double_data;
+	};
 
-	inline void put(int index, const DataBuffer &value);
-	inline void put(int index, const std::string &value);
+	/// \brief Returns the parameter at index (1 based), creating it for stored procedures.
+	Parameter &put(int index);
+
+	/// \brief Fill the arrays given to libpq. Values are sent in binary when routine_types gives a matching type.
+	void fill_parameters(const char **values, Oid *types, int *lengths, int *formats,
+		std::vector<std::string> &encoded, const std::vector<Oid> *routine_types) const;
+
+	PGresult *exec_routine();
 
 	PgsqlConnectionProvider *connection;
+	DBCommand::Type type;
 	std::string text;
-	int last_insert_rowid;
+	mutable long long last_insert_id;
+	mutable bool lastval_pending;
+	int affected_rows;
+	bool is_insert_without_returning;
 	int arguments_count;
-	std::vector<std::string> arguments;
-	std::map<int, DataBuffer> bin_arguments;
+	std::vector<Parameter> parameters;
+	int timeout;
+	bool binary_results;
+	bool multiple_statements;
+	bool fetch_cursors;
+	bool stream_results;
+	bool single_flight;
 
 	PGresult *exec_command();
 
+	/// \brief Execute the command and append all its results, in order.
+	///
+	/// With multiple statements enabled, commands without parameters are sent with
+	/// the simple query protocol, so the text may hold several queries separated by
+	/// semicolons.
+	void exec_command(std::vector<PGresult*> &results);
+
+	/// \brief Tells if the command is a read only SQL statement.
+	bool is_read_only() const { return type == DBCommand::sql_statement && is_read_only_statement(text); }
+
+	/// \brief Tells if the results may be received row by row: read only statements, and SQL statements asking for it.
+	bool can_stream() const { return type == DBCommand::sql_statement && (stream_results || is_read_only()); }
+
+	/// \brief Execute the command in single row mode, handing every result to consume as it arrives.
+	///
+	/// consume takes ownership of the results, and receives null if the command could not be sent.
+	void exec_streaming(const std::function<void(PGresult*)> &consume);
+
+	/// \brief Apply the deadline to the server side statement_timeout if enabled; returns the error result if it failed.
+	///
+	/// previous_timeout receives the setting to give back to restore_timeout, or is empty when nothing was changed.
+	PGresult *propagate_timeout(int deadline, std::string &previous_timeout);
+
+	/// \brief Put back the statement_timeout replaced by propagate_timeout, for the next commands of the transaction.
+	void restore_timeout(const std::string &previous_timeout);
+	PGresult *send_command(const char *const *values, const Oid *types, const int *lengths, const int *formats);
+
+	friend class PgsqlConnectionProvider;
 	friend class PgsqlReaderProvider;
+	friend class PgsqlWireCommandProvider;
 /// \}
 };
 
@@ -29,20 +29,99 @@
 #include "Pgsql/precomp.h"
 #include "ClanLib/Pgsql/pgsql_connection.h"
 #include "pgsql_connection_provider.h"
+#include "pgsql_transaction_provider.h"
+#include "pgsql_wire_connection_provider.h"
+
+#include <chrono>
+#include <cstring>
+#include <random>
+#include <thread>
 
 namespace clan
 {
 
+namespace
+{
+	const char *engine_keyword = "clanpgsql_engine";
+
+	DBConnectionProvider *create_provider(const std::string &engine, const PgsqlConnection::Parameters &parameters)
+	{
+		if (engine == "native")
+			return new PgsqlWireConnectionProvider(parameters);
+		if (engine == "libpq")
+			return new PgsqlConnectionProvider(parameters);
+		throw Exception("Unknown " + std::string(engine_keyword) + " " + engine + " (libpq or native expected)");
+	}
+
+	DBConnectionProvider *create_provider(PgsqlConnection::Parameters parameters)
+	{
+		auto it = parameters.find(engine_keyword);
+		if (it == parameters.end())
+			return new PgsqlConnectionProvider(parameters);
+
+		const std::string engine = it->second;
+		parameters.erase(it);
+		return create_provider(engine, parameters);
+	}
+
+	/// \brief Remove the engine keyword from a key=value string or from the query of a URI; returns its value.
+	std::string take_engine(std::string &connection_string)
+	{
+		const size_t keyword = connection_string.find(engine_keyword);
+		if (keyword == std::string::npos)
+			return std::string();
+
+		const bool is_uri = connection_string.compare(0, 13, "postgresql://") == 0 || connection_string.compare(0, 11, "postgres://") == 0;
+		size_t start = keyword;
+		size_t pos = keyword + std::strlen(engine_keyword);
+		while (pos < connection_string.size() && connection_string[pos] == ' ')
+			pos++;
+		if (pos >= connection_string.size() || connection_string[pos] != '=')
+			return std::string();
+		pos++;
+		while (pos < connection_string.size() && connection_string[pos] == ' ')
+			pos++;
+
+		std::string engine;
+		const char *separators = is_uri ? "&" : " ";
+		const bool quoted = !is_uri && pos < connection_string.size() && connection_string[pos] == '\'';
+		if (quoted)
+			pos++;
+		while (pos < connection_string.size() && (quoted ? connection_string[pos] != '\'' : !std::strchr(separators, connection_string[pos])))
+			engine.push_back(connection_string[pos++]);
+		if (quoted && pos < connection_string.size())
+			pos++;
+
+		// Drop a separator too, so that the rest stays well formed
+		if (pos < connection_string.size() && std::strchr(separators, connection_string[pos]))
+			pos++;
+		else if (is_uri && start > 0 && connection_string[start - 1] == '&')
+			start--;
+		connection_string.erase(start, pos - start);
+		if (is_uri && !connection_string.empty() && connection_string[connection_string.size() - 1] == '?')
+			connection_string.erase(connection_string.size() - 1);
+		return engine;
+	}
+
+	DBConnectionProvider *create_provider(std::string connection_string)
+	{
+		const std::string engine = take_engine(connection_string);
+		if (engine.empty() || engine == "libpq")
+			return new PgsqlConnectionProvider(connection_string);
+		return create_provider(engine, PgsqlWireConnection::parse_connection_string(connection_string));
+	}
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlConnection Construction:
 
 PgsqlConnection::PgsqlConnection(const PgsqlConnection::Parameters &parameters)
-: DBConnection(new PgsqlConnectionProvider(parameters))
+: DBConnection(create_provider(parameters))
 {
 }
 
 PgsqlConnection::PgsqlConnection(const std::string &connection_string)
-: DBConnection(new PgsqlConnectionProvider(connection_string))
+: DBConnection(create_provider(connection_string))
 {
 }
 
@@ -56,6 +135,98 @@ PgsqlConnection::~PgsqlConnection()
 /////////////////////////////////////////////////////////////////////////////
 // DBConnection Operations:
 
+void PgsqlConnection::set_default_timeout(int timeout_ms)
+{
+	PgsqlConnectionProvider::from_connection(*this)->default_timeout = timeout_ms;
+}
+
+void PgsqlConnection::set_statement_timeout_propagation(bool enable)
+{
+	PgsqlConnectionProvider::from_connection(*this)->propagate_statement_timeout = enable;
+}
+
+void PgsqlConnection::set_result_memory_budget(size_t max_bytes, ResultOverflow overflow, const std::string &spill_directory)
+{
+	PgsqlConnectionProvider *provider = PgsqlConnectionProvider::from_connection(*this);
+	provider->result_budget = max_bytes;
+	provider->result_overflow = overflow;
+	provider->spill_directory = spill_directory;
+}
+
+void PgsqlConnection::set_global_result_memory_budget(size_t max_bytes)
+{
+	PgsqlConnectionProvider::global_result_budget = max_bytes;
+}
+
+DBTransaction PgsqlConnection::begin_transaction(IsolationLevel isolation, DBTransaction::Type type)
+{
+	PgsqlWireConnectionProvider *wire_provider = dynamic_cast<PgsqlWireConnectionProvider*>(get_provider());
+	if (wire_provider)
+		return DBTransaction(wire_provider->begin_transaction(type, isolation));
+	PgsqlConnectionProvider *provider = PgsqlConnectionProvider::from_connection(*this);
+	return DBTransaction(provider->begin_transaction(type, isolation));
+}
+
+void PgsqlConnection::run_transaction(const std::function<void()> &fn, const PgsqlRetryPolicy &policy, IsolationLevel isolation)
+{
+	std::random_device seed;
+	std::mt19937 generator(seed());
+	const auto start = std::chrono::steady_clock::now();
+
+	for (int attempt = 1; ; ++attempt)
+	{
+		try
+		{
+			DBTransaction transaction = begin_transaction(isolation);
+			fn();
+			transaction.commit();
+			return;
+		}
+		catch (const PgsqlException &e)
+		{
+			if (!policy.is_retryable(e) || attempt >= policy.max_attempts)
+				throw;
+
+			int ceiling = policy.initial_delay_ms;
+			for (int i = 1; i < attempt && ceiling < policy.max_delay_ms; ++i)
+				ceiling *= 2;
+			if (ceiling > policy.max_delay_ms)
+				ceiling = policy.max_delay_ms;
+			std::uniform_int_distribution<int> jitter(0, ceiling > 0 ? ceiling : 0);
+			const std::chrono::milliseconds delay(jitter(generator));
+
+			if (policy.max_total_time_ms > 0)
+			{
+				const auto elapsed = std::chrono::steady_clock::now() - start + delay;
+				if (elapsed >= std::chrono::milliseconds(policy.max_total_time_ms))
+					throw;
+			}
+			std::this_thread::sleep_for(delay);
+		}
+	}
+}
+
+PgsqlBulkSyncResult PgsqlConnection::bulk_sync(const PgsqlBulkSync &sync)
+{
+	return sync.apply(*this);
+}
+
+long long PgsqlConnection::copy_from(const std::string &sql, const std::string &data)
+{
+	PgsqlWireConnectionProvider *wire_provider = dynamic_cast<PgsqlWireConnectionProvider*>(get_provider());
+	if (wire_provider)
+		return wire_provider->copy_from(sql, data);
+	return PgsqlConnectionProvider::from_connection(*this)->copy_from(sql, data);
+}
+
+long long PgsqlConnection::copy_to(const std::string &sql, const CopyHandler &handler)
+{
+	PgsqlWireConnectionProvider *wire_provider = dynamic_cast<PgsqlWireConnectionProvider*>(get_provider());
+	if (wire_provider)
+		return wire_provider->copy_to(sql, handler);
+	return PgsqlConnectionProvider::from_connection(*this)->copy_to(sql, handler);
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // DBConnection Implementation:
 
@@ -27,32 +27,48 @@
 */
 
 #include <memory>
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstdlib>
+#include <exception>
 
 #include "Pgsql/precomp.h"
 #include "pgsql_connection_provider.h"
 #include "pgsql_command_provider.h"
 #include "pgsql_reader_provider.h"
+#include "pgsql_single_flight.h"
 #include "pgsql_transaction_provider.h"
 #include "ClanLib/Core/System/databuffer.h"
 #include "ClanLib/Core/System/datetime.h"
 #include "ClanLib/Core/Text/string_help.h"
 #include "ClanLib/Core/Text/string_format.h"
 
+#ifdef WIN32
+#include <winsock2.h>
+#else
+#include <poll.h>
+#endif
+
 namespace clan
 {
 
+std::atomic<size_t> PgsqlConnectionProvider::global_result_budget(0);
+std::atomic<size_t> PgsqlConnectionProvider::global_result_memory(0);
+
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlConnectionProvider Construction:
 
 PgsqlConnectionProvider::PgsqlConnectionProvider(const Parameters &parameters)
-: db(nullptr), active_transaction(nullptr)
+: db(nullptr), active_transaction(nullptr), default_timeout(0), propagate_statement_timeout(false), routine_statements(0),
+  result_budget(0), result_overflow(PgsqlConnection::spill_to_disk), result_memory(0), session_state_pid(0)
 {
 	const int length = parameters.size() + 1;
 	std::unique_ptr<const char*[]> keywords(new const char*[length]);
 	std::unique_ptr<const char*[]> values(new const char*[length]);
 
   int i = 0;
-  for (auto pair : parameters)
+  for (const auto &pair : parameters)
 	{
 		keywords[i] = pair.first.c_str();
 		values[i] = pair.second.c_str();
@@ -70,7 +86,8 @@ PgsqlConnectionProvider::PgsqlConnectionProvider(const Parameters &parameters)
 }
 
 PgsqlConnectionProvider::PgsqlConnectionProvider(const std::string &connection_string)
-: db(nullptr), active_transaction(nullptr)
+: db(nullptr), active_transaction(nullptr), default_timeout(0), propagate_statement_timeout(false), routine_statements(0),
+  result_budget(0), result_overflow(PgsqlConnection::spill_to_disk), result_memory(0), session_state_pid(0)
 {
 	db = PQconnectdb(connection_string.c_str());
 	if (PQstatus(db) == CONNECTION_BAD)
@@ -90,16 +107,75 @@ PgsqlConnectionProvider::~PgsqlConnectionProvider()
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlConnectionProvider Attributes:
 
+bool PgsqlConnectionProvider::wait_for_input(int timeout_ms) const
+{
+	const int socket = PQsocket(db);
+	if (socket < 0)
+		throw Exception("Database connection has no socket");
+
+	// poll rather than select, which can't watch descriptors above FD_SETSIZE
+#ifdef WIN32
+	WSAPOLLFD descriptor;
+	descriptor.fd = socket;
+	descriptor.events = POLLRDNORM;
+	descriptor.revents = 0;
+	const int result = WSAPoll(&descriptor, 1, timeout_ms < 0 ? -1 : timeout_ms);
+#else
+	pollfd descriptor;
+	descriptor.fd = socket;
+	descriptor.events = POLLIN;
+	descriptor.revents = 0;
+	const int result = poll(&descriptor, 1, timeout_ms < 0 ? -1 : timeout_ms);
+#endif
+	if (result < 0)
+		return true; // Interrupted; let the caller poll libpq again
+	return result > 0;
+}
+
+std::string PgsqlConnectionProvider::get_server_key() const
+{
+	return string_format("%1:%2/%3@%4\n", PQhost(db) ? PQhost(db) : "", PQport(db), PQdb(db), PQuser(db));
+}
+
+std::string PgsqlConnectionProvider::get_session_key()
+{
+	// The server does not report the role and search_path; ask again after statements which may change them
+	const int pid = PQbackendPID(db);
+	if (session_state.empty() || session_state_pid != pid)
+	{
+		auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+		std::unique_ptr<PGresult, decltype(deleter)> result(PQexec(db, "SELECT current_user, current_setting('search_path')"), deleter);
+		if (PQresultStatus(result.get()) != PGRES_TUPLES_OK || PQntuples(result.get()) != 1)
+			throw_result_error(result.get());
+		session_state = string_format("%1\n%2\n", PQgetvalue(result.get(), 0, 0), PQgetvalue(result.get(), 0, 1));
+		session_state_pid = pid;
+	}
+
+	std::string key = session_state;
+	const char *reported[] = { "TimeZone", "DateStyle", "IntervalStyle", "client_encoding", "standard_conforming_strings", "session_authorization" };
+	for (const char *name : reported)
+	{
+		const char *value = PQparameterStatus(db, name);
+		key += value ? value : "";
+		key += '\n';
+	}
+	return key;
+}
+
+PgsqlConnectionProvider *PgsqlConnectionProvider::from_connection(DBConnection &connection)
+{
+	PgsqlConnectionProvider *provider = dynamic_cast<PgsqlConnectionProvider*>(connection.get_provider());
+	if (!provider)
+		throw Exception("This feature requires a PgsqlConnection using the libpq engine");
+	return provider;
+}
 
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlConnectionProvider Operations:
 
 DBCommandProvider *PgsqlConnectionProvider::create_command(const std::string &text, DBCommand::Type type)
 {
-	if (type != DBCommand::sql_statement)
-		throw Exception("DBCommand::sql_statement not yet implemented");
-	else
-		return new PgsqlCommandProvider(this, text);
+	return new PgsqlCommandProvider(this, text, type);
 }
 
 DBTransactionProvider *PgsqlConnectionProvider::begin_transaction(DBTransaction::Type type)
@@ -107,9 +183,31 @@ DBTransactionProvider *PgsqlConnectionProvider::begin_transaction(DBTransaction:
 	return new PgsqlTransactionProvider(this, type);
 }
 
+DBTransactionProvider *PgsqlConnectionProvider::begin_transaction(DBTransaction::Type type, PgsqlConnection::IsolationLevel isolation)
+{
+	return new PgsqlTransactionProvider(this, type, isolation);
+}
+
 DBReaderProvider *PgsqlConnectionProvider::execute_reader(DBCommandProvider *command)
 {
-	return new PgsqlReaderProvider(this, dynamic_cast<PgsqlCommandProvider*>(command));
+	PgsqlCommandProvider *pgsql_command = dynamic_cast<PgsqlCommandProvider*>(command);
+
+	if (!pgsql_command->is_read_only())
+	{
+		// It may change the role or the search_path
+		session_state.clear();
+	}
+	else if (pgsql_command->get_single_flight() && !active_transaction && PQtransactionStatus(db) == PQTRANS_IDLE)
+	{
+		// Inside a transaction, another connection may not see the same data
+		std::string key = get_server_key();
+		key += get_session_key();
+		key += pgsql_command->get_binary_results() ? "binary\n" : "text\n";
+		key += pgsql_command->get_cache_key();
+		const int timeout_ms = pgsql_command->get_timeout() >= 0 ? pgsql_command->get_timeout() : default_timeout;
+		return PgsqlSingleFlight::execute(key, timeout_ms, [&] { return new PgsqlReaderProvider(this, pgsql_command); });
+	}
+	return new PgsqlReaderProvider(this, pgsql_command);
 }
 
 std::string PgsqlConnectionProvider::execute_scalar_string(DBCommandProvider *command)
@@ -135,6 +233,68 @@ void PgsqlConnectionProvider::execute_non_query(DBCommandProvider *command)
 	std::unique_ptr<DBReaderProvider> reader(execute_reader(command));
 }
 
+long long PgsqlConnectionProvider::copy_from(const std::string &sql, const std::string &data)
+{
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> copy_result(PQexec(db, sql.c_str()), deleter);
+	if (PQresultStatus(copy_result.get()) != PGRES_COPY_IN)
+		throw_result_error(copy_result.get());
+
+	const size_t chunk_size = 1024 * 1024;
+	bool sent = true;
+	for (size_t pos = 0; sent && pos < data.size(); pos += chunk_size)
+		sent = PQputCopyData(db, data.data() + pos, std::min(chunk_size, data.size() - pos)) == 1;
+	if (!sent || PQputCopyEnd(db, nullptr) != 1)
+		throw Exception(PQerrorMessage(db));
+
+	std::unique_ptr<PGresult, decltype(deleter)> result(PQgetResult(db), deleter);
+	for (PGresult *next = PQgetResult(db); next; next = PQgetResult(db))
+		PQclear(next);
+	if (PQresultStatus(result.get()) != PGRES_COMMAND_OK)
+		throw_result_error(result.get());
+	return StringHelp::text_to_ll(PQcmdTuples(result.get()));
+}
+
+long long PgsqlConnectionProvider::copy_to(const std::string &sql, const PgsqlConnection::CopyHandler &handler)
+{
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> copy_result(PQexec(db, sql.c_str()), deleter);
+	if (PQresultStatus(copy_result.get()) != PGRES_COPY_OUT)
+		throw_result_error(copy_result.get());
+
+	// After a failure of handler, the rows still coming are dropped
+	std::exception_ptr error;
+	while (true)
+	{
+		char *buffer = nullptr;
+		const int size = PQgetCopyData(db, &buffer, 0);
+		if (size < 0)
+			break;
+		if (!error)
+		{
+			try
+			{
+				handler(buffer, size);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+				cancel();
+			}
+		}
+		PQfreemem(buffer);
+	}
+
+	std::unique_ptr<PGresult, decltype(deleter)> result(PQgetResult(db), deleter);
+	for (PGresult *next = PQgetResult(db); next; next = PQgetResult(db))
+		PQclear(next);
+	if (error)
+		std::rethrow_exception(error);
+	if (PQresultStatus(result.get()) != PGRES_COMMAND_OK)
+		throw_result_error(result.get());
+	return StringHelp::text_to_ll(PQcmdTuples(result.get()));
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlConnectionProvider Implementation:
 
@@ -148,4 +308,302 @@ DateTime PgsqlConnectionProvider::from_sql_datetime(const std::string &value)
 	return DateTime::from_short_date_string(value);
 }
 
+PGresult *PgsqlConnectionProvider::get_last_result(int timeout_ms)
+{
+	std::vector<PGresult*> results;
+	get_results(timeout_ms, results);
+
+	// Like PQexec, keep the last result, or the first error
+	PGresult *last = nullptr;
+	for (PGresult *result : results)
+	{
+		const ExecStatusType status = PQresultStatus(last);
+		if (last && (status == PGRES_FATAL_ERROR || status == PGRES_NONFATAL_ERROR))
+			PQclear(result);
+		else
+		{
+			PQclear(last);
+			last = result;
+		}
+	}
+	return last;
+}
+
+void PgsqlConnectionProvider::get_results(int timeout_ms, std::vector<PGresult*> &results)
+{
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::vector<std::unique_ptr<PGresult, decltype(deleter)>> received;
+	receive_results(timeout_ms, false, [&](PGresult *result)
+	{
+		received.push_back(std::unique_ptr<PGresult, decltype(deleter)>(result, deleter));
+	});
+
+	for (auto &result : received)
+		results.push_back(result.release());
+}
+
+void PgsqlConnectionProvider::receive_results(int timeout_ms, bool single_row, const std::function<void(PGresult*)> &consume)
+{
+	typedef std::chrono::steady_clock Clock;
+
+	if (single_row)
+		PQsetSingleRowMode(db);
+
+	// Once cancelled, the server is given a grace period to answer before the connection is reset
+	const int grace_ms = 5000;
+	bool cancelled = false;
+	bool timed_out = false;
+	std::exception_ptr consume_error;
+	Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+
+	while (true)
+	{
+		while (PQisBusy(db))
+		{
+			long long remaining = -1;
+			if (timeout_ms > 0 || cancelled)
+			{
+				remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+				if (remaining <= 0)
+				{
+					if (cancelled)
+					{
+						reset_after_cancel();
+						if (consume_error)
+							std::rethrow_exception(consume_error);
+						throw PgsqlTimeoutException(timeout_ms);
+					}
+					cancel();
+					cancelled = true;
+					deadline = Clock::now() + std::chrono::milliseconds(grace_ms);
+					continue;
+				}
+			}
+			if (wait_for_input(static_cast<int>(remaining)) && !PQconsumeInput(db))
+				break; // Connection error, reported by PQgetResult
+		}
+
+		PGresult *result = PQgetResult(db);
+		if (!result)
+			break;
+
+		if (cancelled)
+		{
+			const char *sqlstate = PQresultErrorField(result, PG_DIAG_SQLSTATE);
+			if (sqlstate && std::string(sqlstate) == "57014")
+				timed_out = true;
+		}
+
+		if (consume_error)
+		{
+			PQclear(result);
+			continue;
+		}
+
+		try
+		{
+			consume(result);
+		}
+		catch (...)
+		{
+			// Drop the rest of the command
+			consume_error = std::current_exception();
+			if (!cancelled)
+			{
+				cancel();
+				cancelled = true;
+				deadline = Clock::now() + std::chrono::milliseconds(grace_ms);
+			}
+		}
+	}
+
+	if (consume_error)
+		std::rethrow_exception(consume_error);
+	if (timed_out)
+		throw PgsqlTimeoutException(timeout_ms);
+}
+
+bool PgsqlConnectionProvider::charge_result_memory(size_t bytes)
+{
+	if (result_budget > 0 && result_memory + bytes > result_budget)
+		return false;
+
+	size_t used = global_result_memory.load();
+	do
+	{
+		const size_t budget = global_result_budget.load();
+		if (budget > 0 && used + bytes > budget)
+			return false;
+	} while (!global_result_memory.compare_exchange_weak(used, used + bytes));
+
+	result_memory += bytes;
+	return true;
+}
+
+void PgsqlConnectionProvider::release_result_memory(size_t bytes)
+{
+	result_memory -= bytes;
+	global_result_memory -= bytes;
+}
+
+size_t PgsqlConnectionProvider::get_result_budget() const
+{
+	const size_t global_budget = global_result_budget.load();
+	if (result_budget == 0 || (global_budget > 0 && global_budget < result_budget))
+		return global_budget;
+	return result_budget;
+}
+
+void PgsqlConnectionProvider::cancel()
+{
+#ifdef LIBPQ_HAS_ASYNC_CANCEL
+	PGcancelConn *cancel_connection = PQcancelCreate(db);
+	if (cancel_connection)
+	{
+		PQcancelBlocking(cancel_connection);
+		PQcancelFinish(cancel_connection);
+	}
+#else
+	PGcancel *cancel_handle = PQgetCancel(db);
+	if (cancel_handle)
+	{
+		char error[256];
+		PQcancel(cancel_handle, error, sizeof(error));
+		PQfreeCancel(cancel_handle);
+	}
+#endif
+}
+
+void PgsqlConnectionProvider::reset_after_cancel()
+{
+	PQreset(db);
+	if (active_transaction)
+	{
+		active_transaction->lost = true;
+		active_transaction = nullptr;
+	}
+}
+
+const PgsqlConnectionProvider::Routine &PgsqlConnectionProvider::prepare_routine(const std::string &name, int input_count)
+{
+	const std::string key = string_format("%1/%2", name, input_count);
+	auto it = routines.find(key);
+	if (it != routines.end())
+		return it->second;
+
+	// Split "schema.routine", folding unquoted identifiers to lower case like the server does
+	std::vector<std::string> parts(1);
+	bool quoted = false;
+	for (size_t i = 0; i < name.size(); i++)
+	{
+		const char c = name[i];
+		if (c == '"')
+		{
+			if (quoted && i + 1 < name.size() && name[i + 1] == '"')
+				parts.back().push_back(name[++i]);
+			else
+				quoted = !quoted;
+		}
+		else if (c == '.' && !quoted)
+			parts.push_back(std::string());
+		else
+			parts.back().push_back(quoted ? c : tolower(static_cast<unsigned char>(c)));
+	}
+	if (parts.size() > 2)
+		throw Exception(string_format("Invalid routine name %1", name));
+	const std::string routine_name = parts.back();
+	const std::string schema_name = parts.size() == 2 ? parts.front() : std::string();
+
+	const char *lookup =
+		"SELECT p.prokind = 'p', coalesce(array_to_string(p.proargmodes, ','), ''),"
+		" array_to_string(coalesce(p.proallargtypes, p.proargtypes::oid[]), ',')"
+		" FROM pg_catalog.pg_proc p JOIN pg_catalog.pg_namespace n ON n.oid = p.pronamespace"
+		" WHERE p.proname = $1"
+		" AND CASE WHEN $2 = '' THEN pg_catalog.pg_function_is_visible(p.oid) ELSE n.nspname = $2 END";
+	const char *lookup_values[2] = { routine_name.c_str(), schema_name.c_str() };
+
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> result(PQexecParams(db, lookup, 2, nullptr, lookup_values, nullptr, nullptr, 0), deleter);
+	if (PQresultStatus(result.get()) != PGRES_TUPLES_OK)
+		throw_result_error(result.get());
+
+	// Keep the overload whose IN, INOUT and VARIADIC arguments match the parameter count
+	int matches = 0;
+	std::string call;
+	Routine routine;
+	for (int row = 0; row < PQntuples(result.get()); row++)
+	{
+		const bool is_procedure = PQgetvalue(result.get(), row, 0)[0] == 't';
+		const std::vector<std::string> modes = StringHelp::split_text(PQgetvalue(result.get(), row, 1), ",");
+		const std::vector<std::string> arg_types = StringHelp::split_text(PQgetvalue(result.get(), row, 2), ",");
+
+		std::vector<Oid> input_types;
+		std::string arguments;
+		for (size_t arg = 0; arg < arg_types.size(); arg++)
+		{
+			const char mode = arg < modes.size() ? modes[arg][0] : 'i';
+			if (mode == 't' || (mode == 'o' && !is_procedure))
+				continue;
+			if (!arguments.empty())
+				arguments += ", ";
+			if (mode == 'o')
+			{
+				arguments += "NULL";
+				continue;
+			}
+			input_types.push_back(std::strtoul(arg_types[arg].c_str(), nullptr, 10));
+			arguments += string_format("%1$%2", mode == 'v' ? "VARIADIC " : "", (int)input_types.size());
+		}
+		if ((int)input_types.size() != input_count)
+			continue;
+
+		matches++;
+		routine.input_types = input_types;
+		if (is_procedure)
+			call = "CALL " + name + "(" + arguments + ")";
+		else
+			call = "SELECT * FROM " + name + "(" + arguments + ")";
+	}
+	if (matches == 0)
+		throw Exception(string_format("No function or procedure %1 taking %2 arguments", name, input_count));
+	if (matches > 1)
+		throw Exception(string_format("Function or procedure %1 taking %2 arguments is ambiguous", name, input_count));
+
+	routine.statement_name = string_format("clanpgsql_routine_%1", ++routine_statements);
+	result.reset(PQprepare(db, routine.statement_name.c_str(), call.c_str(), input_count, routine.input_types.data()));
+	if (PQresultStatus(result.get()) != PGRES_COMMAND_OK)
+		throw_result_error(result.get());
+
+	return routines[key] = routine;
+}
+
+void PgsqlConnectionProvider::forget_routines()
+{
+	for (auto &routine : routines)
+	{
+		const std::string deallocate = "DEALLOCATE " + routine.second.statement_name;
+		PQclear(PQexec(db, deallocate.c_str()));
+	}
+	routines.clear();
+}
+
+void PgsqlConnectionProvider::throw_result_error(const PGresult *result) const
+{
+	auto field = [result](int code) -> std::string
+	{
+		const char *value = result ? PQresultErrorField(result, code) : nullptr;
+		return value ? value : "";
+	};
+
+	std::string message = result ? PQresultErrorMessage(result) : "";
+	if (message.empty())
+		message = PQerrorMessage(db);
+
+	throw PgsqlException(StringHelp::text_to_local8(message),
+		field(PG_DIAG_SQLSTATE),
+		field(PG_DIAG_SEVERITY),
+		field(PG_DIAG_MESSAGE_DETAIL),
+		field(PG_DIAG_MESSAGE_HINT));
+}
+
 }; // namespace clan
@@ -33,6 +33,11 @@
 #pragma once
 
 
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
+
 #include <libpq-fe.h>
 #include "ClanLib/Pgsql/pgsql_connection.h"
 #include "ClanLib/Database/db_connection_provider.h"
@@ -59,6 +64,34 @@ public:
 /// \name Attributes
 /// \{
 public:
+	/// \brief Returns the libpq connection handle.
+	PGconn *get_handle() const { return db; }
+
+	/// \brief Wait until the server socket is readable.
+	///
+	/// \param timeout_ms = Maximum wait in milliseconds, -1 to wait forever.
+	/// \return false if the timeout expired.
+	bool wait_for_input(int timeout_ms) const;
+
+	/// \brief True while a transaction started by begin_transaction is active.
+	bool in_transaction() const { return active_transaction != nullptr; }
+
+	/// \brief True if a budget is in force, so that results are charged to it (see PgsqlConnection::set_result_memory_budget).
+	bool has_result_budget() const { return result_budget > 0 || global_result_budget > 0; }
+
+	PgsqlConnection::ResultOverflow get_result_overflow() const { return result_overflow; }
+	const std::string &get_spill_directory() const { return spill_directory; }
+
+	/// \brief Identifies the server, database and user, to prefix the keys of shared results.
+	std::string get_server_key() const;
+
+	/// \brief Identifies the session settings changing what a query returns: role, search_path, TimeZone...
+	///
+	/// Costs a round trip the first time, and after statements which are not read only.
+	std::string get_session_key();
+
+	/// \brief Returns the provider of a connection using the libpq engine; throws for the native engine.
+	static PgsqlConnectionProvider *from_connection(DBConnection &connection);
 /// \}
 
 /// \name Operations
@@ -66,24 +99,105 @@ public:
 public:
 	DBCommandProvider *create_command(const std::string &text, DBCommand::Type type);
 	DBTransactionProvider *begin_transaction(DBTransaction::Type type);
+	DBTransactionProvider *begin_transaction(DBTransaction::Type type, PgsqlConnection::IsolationLevel isolation);
 	DBReaderProvider *execute_reader(DBCommandProvider *command);
 	std::string execute_scalar_string(DBCommandProvider *command);
 	int execute_scalar_int(DBCommandProvider *command);
 	void execute_non_query(DBCommandProvider *command);
+
+	/// \brief See PgsqlConnection::copy_from.
+	long long copy_from(const std::string &sql, const std::string &data);
+
+	/// \brief See PgsqlConnection::copy_to.
+	long long copy_to(const std::string &sql, const PgsqlConnection::CopyHandler &handler);
+
+	/// \brief Wait for the results of the command sent last, cancelling it after timeout_ms.
+	///
+	/// Returns the last result, like PQexec. Throws PgsqlTimeoutException if
+	/// the command was cancelled.
+	PGresult *get_last_result(int timeout_ms);
+
+	/// \brief Wait for all the results of the command sent last, in order.
+	///
+	/// timeout_ms <= 0 waits without deadline.
+	void get_results(int timeout_ms, std::vector<PGresult*> &results);
+
+	/// \brief Wait for the results of the command sent last and hand each one to consume, which takes ownership.
+	///
+	/// With single_row, the rows are received one by one (PQsetSingleRowMode).
+	/// If consume throws, the command is cancelled and its remaining results
+	/// are dropped before the exception is rethrown. timeout_ms <= 0 waits
+	/// without deadline.
+	void receive_results(int timeout_ms, bool single_row, const std::function<void(PGresult*)> &consume);
+
+	/// \brief Add bytes to the memory held by results, unless that goes over the budget of the connection or the global one.
+	///
+	/// \return false, charging nothing, if a budget would be exceeded.
+	bool charge_result_memory(size_t bytes);
+
+	void release_result_memory(size_t bytes);
+
+	/// \brief The smallest budget in force, for error messages.
+	size_t get_result_budget() const;
+
+	/// \brief Ask the server to cancel the command in progress.
+	void cancel();
+
+	/// \brief Reconnect after a cancellation the server did not answer.
+	///
+	/// The server rolled back the active transaction, if any; it is marked
+	/// lost so that its commit throws.
+	void reset_after_cancel();
+
+	/// \brief Throw a PgsqlException describing the error held by result (or by db if result is null).
+	void throw_result_error(const PGresult *result) const;
 /// \}
 
 /// \name Implementation
 /// \{
 private:
+	/// \brief A function or procedure prepared for direct calls.
+	struct Routine
+	{
+		std::string statement_name;
+		std::vector<Oid> input_types;
+	};
+
+	/// \brief Returns the prepared call of the routine name taking input_count IN/INOUT arguments.
+	///
+	/// Procedures are called with CALL, passing NULL for their OUT arguments.
+	/// Functions are called with SELECT * FROM name(...).
+	const Routine &prepare_routine(const std::string &name, int input_count);
+
+	/// \brief Drop the prepared routine calls (they do not survive a reconnection).
+	void forget_routines();
+
 	static std::string to_sql_datetime(const DateTime &value);
 	static DateTime from_sql_datetime(const std::string &value);
 
 	PGconn *db;
 	PgsqlTransactionProvider *active_transaction;
-
+	int default_timeout;
+	bool propagate_statement_timeout;
+	std::map<std::string, Routine> routines;
+	int routine_statements;
+	size_t result_budget;
+	PgsqlConnection::ResultOverflow result_overflow;
+	std::string spill_directory;
+	size_t result_memory;
+	std::string session_state;
+	int session_state_pid;
+
+	static std::atomic<size_t> global_result_budget;
+	static std::atomic<size_t> global_result_memory;
+
+	friend class PgsqlConnection;
 	friend class PgsqlReaderProvider;
 	friend class PgsqlTransactionProvider;
 	friend class PgsqlCommandProvider;
+	friend class PgsqlSnapshotReaderProvider;
+	friend class PgsqlValue;
+	friend class PgsqlWireCommandProvider;
 /// \}
 };
 
@@ -0,0 +1,109 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_exception.h"
+#include "ClanLib/Pgsql/pgsql_retry_policy.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlException Construction:
+
+PgsqlException::PgsqlException(const std::string &message,
+	const std::string &sqlstate,
+	const std::string &severity,
+	const std::string &detail,
+	const std::string &hint)
+: Exception(message), sqlstate(sqlstate), severity(severity), detail(detail), hint(hint)
+{
+}
+
+PgsqlException::~PgsqlException() throw()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlException Attributes:
+
+std::string PgsqlException::get_sqlstate_class() const
+{
+	return sqlstate.substr(0, 2);
+}
+
+bool PgsqlException::is_serialization_failure() const
+{
+	return sqlstate == "40001";
+}
+
+bool PgsqlException::is_deadlock() const
+{
+	return sqlstate == "40P01";
+}
+
+bool PgsqlException::is_transaction_retryable() const
+{
+	return is_serialization_failure() || is_deadlock();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlTimeoutException Construction:
+
+PgsqlTimeoutException::PgsqlTimeoutException(int timeout_ms)
+: PgsqlException(string_format("Database command cancelled after %1 ms", timeout_ms), "57014", "ERROR"), timeout_ms(timeout_ms)
+{
+}
+
+PgsqlTimeoutException::~PgsqlTimeoutException() throw()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultTooLargeException Construction:
+
+PgsqlResultTooLargeException::PgsqlResultTooLargeException(size_t budget)
+: PgsqlException("Database result exceeds its memory budget of " + std::to_string(static_cast<unsigned long long>(budget)) + " bytes", "54000", "ERROR"), budget(budget)
+{
+}
+
+PgsqlResultTooLargeException::~PgsqlResultTooLargeException() throw()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlRetryPolicy Attributes:
+
+bool PgsqlRetryPolicy::is_retryable(const PgsqlException &error) const
+{
+	return (retry_serialization_failures && error.is_serialization_failure())
+		|| (retry_deadlocks && error.is_deadlock());
+}
+
+}; // namespace clan
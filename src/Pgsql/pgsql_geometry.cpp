@@ -0,0 +1,306 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "pgsql_geometry.h"
+#include "pgsql_binary.h"
+#include "pg_type.h"
+#include "ClanLib/Core/Text/string_format.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace clan
+{
+
+namespace
+{
+	void check_type(Oid type, Oid expected, const char *name)
+	{
+		if (type != expected)
+			throw Exception(string_format("Value of type %1 can't be read as %2", (int)type, name));
+	}
+
+	void check_length(int length, int expected)
+	{
+		if (length != expected)
+			throw Exception("Invalid binary geometric value");
+	}
+
+	/// \brief Numbers of the text form, whatever its punctuation: (1,2), [(1,2),(3,4)], <(1,2),3>...
+	void parse_numbers(const char *data, int length, std::vector<double> &out)
+	{
+		const std::string text(data, length);
+		const char *p = text.c_str();
+		while (*p)
+		{
+			if (std::strchr(" \t\n\r()[]<>,", *p))
+			{
+				++p;
+				continue;
+			}
+			char *end = nullptr;
+			out.push_back(std::strtod(p, &end));
+			if (end == p)
+				throw Exception(string_format("Invalid geometric value %1", text));
+			p = end;
+		}
+	}
+
+	void parse_numbers(const char *data, int length, double *out, size_t count)
+	{
+		std::vector<double> numbers;
+		numbers.reserve(count);
+		parse_numbers(data, length, numbers);
+		if (numbers.size() != count)
+			throw Exception(string_format("Invalid geometric value %1", std::string(data, length)));
+		std::copy(numbers.begin(), numbers.end(), out);
+	}
+
+	void store_float8(char *out, double value)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+		PgsqlBinary::store_uint64(out, bits);
+	}
+
+	void write_point(std::string &out, const char *data)
+	{
+		out += '(';
+		out += PgsqlBinary::float8_to_text(PgsqlBinary::read_float8(data));
+		out += ',';
+		out += PgsqlBinary::float8_to_text(PgsqlBinary::read_float8(data + 8));
+		out += ')';
+	}
+
+	void write_points(std::string &out, const char *data, int count)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			if (i > 0)
+				out += ',';
+			write_point(out, data + i * PgsqlGeometry::point_size);
+		}
+	}
+
+	/// \brief Points of a binary polygon (count, points) or path (closed flag, count, points).
+	const char *read_point_list(const char *data, int length, Oid type, int &count)
+	{
+		const int header = type == PATHOID ? 5 : 4;
+		if (length < header)
+			throw Exception("Invalid binary geometric value");
+		count = PgsqlBinary::read_int32(data + header - 4);
+		if (count < 0 || (length - header) / PgsqlGeometry::point_size != count || (length - header) % PgsqlGeometry::point_size != 0)
+			throw Exception("Invalid binary geometric value");
+		return data + header;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlGeometry:
+
+Vec2d PgsqlGeometry::read_point(const char *data)
+{
+	return Vec2d(PgsqlBinary::read_float8(data), PgsqlBinary::read_float8(data + 8));
+}
+
+LineSegment2d PgsqlGeometry::read_line_segment(const char *data)
+{
+	return LineSegment2d(read_point(data), read_point(data + point_size));
+}
+
+Rectd PgsqlGeometry::read_box(const char *data)
+{
+	// The upper corner comes first
+	const Vec2d high = read_point(data);
+	const Vec2d low = read_point(data + point_size);
+	return Rectd(low.x, low.y, high.x, high.y);
+}
+
+Circled PgsqlGeometry::read_circle(const char *data)
+{
+	return Circled(read_point(data), PgsqlBinary::read_float8(data + point_size));
+}
+
+void PgsqlGeometry::store_point(char *out, const Vec2d &value)
+{
+	store_float8(out, value.x);
+	store_float8(out + 8, value.y);
+}
+
+void PgsqlGeometry::store_line_segment(char *out, const LineSegment2d &value)
+{
+	store_point(out, value.p);
+	store_point(out + point_size, value.q);
+}
+
+void PgsqlGeometry::store_box(char *out, const Rectd &value)
+{
+	// The server swaps the corners if needed
+	store_point(out, Vec2d(value.right, value.bottom));
+	store_point(out + point_size, Vec2d(value.left, value.top));
+}
+
+void PgsqlGeometry::store_circle(char *out, const Circled &value)
+{
+	store_point(out, value.position);
+	store_float8(out + point_size, value.radius);
+}
+
+std::string PgsqlGeometry::encode(const std::vector<Vec2d> &polygon)
+{
+	std::string out(4 + polygon.size() * point_size, '\0');
+	PgsqlBinary::store_uint32(&out[0], polygon.size());
+	for (size_t i = 0; i < polygon.size(); i++)
+		store_point(&out[4 + i * point_size], polygon[i]);
+	return out;
+}
+
+Vec2d PgsqlGeometry::decode_point(const char *data, int length, Oid type, int format)
+{
+	check_type(type, POINTOID, "point");
+	if (format == 0)
+	{
+		double values[2];
+		parse_numbers(data, length, values, 2);
+		return Vec2d(values[0], values[1]);
+	}
+	check_length(length, point_size);
+	return read_point(data);
+}
+
+LineSegment2d PgsqlGeometry::decode_line_segment(const char *data, int length, Oid type, int format)
+{
+	check_type(type, LSEGOID, "line segment");
+	if (format == 0)
+	{
+		double values[4];
+		parse_numbers(data, length, values, 4);
+		return LineSegment2d(Vec2d(values[0], values[1]), Vec2d(values[2], values[3]));
+	}
+	check_length(length, line_segment_size);
+	return read_line_segment(data);
+}
+
+Rectd PgsqlGeometry::decode_box(const char *data, int length, Oid type, int format)
+{
+	check_type(type, BOXOID, "box");
+	if (format == 0)
+	{
+		// (x2,y2),(x1,y1) with the upper corner first
+		double values[4];
+		parse_numbers(data, length, values, 4);
+		return Rectd(values[2], values[3], values[0], values[1]);
+	}
+	check_length(length, box_size);
+	return read_box(data);
+}
+
+Circled PgsqlGeometry::decode_circle(const char *data, int length, Oid type, int format)
+{
+	check_type(type, CIRCLEOID, "circle");
+	if (format == 0)
+	{
+		double values[3];
+		parse_numbers(data, length, values, 3);
+		return Circled(Vec2d(values[0], values[1]), values[2]);
+	}
+	check_length(length, circle_size);
+	return read_circle(data);
+}
+
+void PgsqlGeometry::decode_polygon(const char *data, int length, Oid type, int format, std::vector<Vec2d> &out)
+{
+	if (type != PATHOID)
+		check_type(type, POLYGONOID, "polygon");
+
+	if (format == 0)
+	{
+		std::vector<double> values;
+		parse_numbers(data, length, values);
+		if (values.size() % 2 != 0)
+			throw Exception(string_format("Invalid geometric value %1", std::string(data, length)));
+		out.resize(values.size() / 2);
+		for (size_t i = 0; i < out.size(); i++)
+			out[i] = Vec2d(values[i * 2], values[i * 2 + 1]);
+		return;
+	}
+
+	int count = 0;
+	const char *points = read_point_list(data, length, type, count);
+	out.resize(count);
+	for (int i = 0; i < count; i++)
+		out[i] = read_point(points + i * point_size);
+}
+
+std::string PgsqlGeometry::to_text(const char *data, int length, Oid type)
+{
+	std::string text;
+	switch (type)
+	{
+	case POINTOID:
+		check_length(length, point_size);
+		write_point(text, data);
+		break;
+	case LSEGOID:
+		check_length(length, line_segment_size);
+		text += '[';
+		write_points(text, data, 2);
+		text += ']';
+		break;
+	case BOXOID:
+		check_length(length, box_size);
+		write_points(text, data, 2);
+		break;
+	case CIRCLEOID:
+		check_length(length, circle_size);
+		text += '<';
+		write_point(text, data);
+		text += ',';
+		text += PgsqlBinary::float8_to_text(PgsqlBinary::read_float8(data + point_size));
+		text += '>';
+		break;
+	case POLYGONOID:
+	case PATHOID:
+		{
+			int count = 0;
+			const char *points = read_point_list(data, length, type, count);
+			const bool open = type == PATHOID && data[0] == 0;
+			text += open ? '[' : '(';
+			write_points(text, points, count);
+			text += open ? ']' : ')';
+		}
+		break;
+	default:
+		throw Exception(string_format("Value of type %1 is not geometric", (int)type));
+	}
+	return text;
+}
+
+}; // namespace clan
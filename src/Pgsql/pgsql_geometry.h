@@ -0,0 +1,90 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+#include "ClanLib/Core/Math/vec2.h"
+#include "ClanLib/Core/Math/rect.h"
+#include "ClanLib/Core/Math/line_segment.h"
+#include "ClanLib/Core/Math/circle.h"
+
+namespace clan
+{
+
+/// \brief Geometric types as ClanLib math types.
+///
+/// The binary format is made of float8 coordinates and is converted without
+/// going through text. Values of the text format are read too. A box maps its
+/// lower corner to left/top and its upper corner to right/bottom; polygons
+/// and paths are lists of points.
+namespace PgsqlGeometry
+{
+	/// \brief Size of the binary values of fixed size.
+	const int point_size = 16;
+	const int line_segment_size = 32;
+	const int box_size = 32;
+	const int circle_size = 24;
+
+	Vec2d read_point(const char *data);
+	LineSegment2d read_line_segment(const char *data);
+	Rectd read_box(const char *data);
+	Circled read_circle(const char *data);
+
+	void store_point(char *out, const Vec2d &value);
+	void store_line_segment(char *out, const LineSegment2d &value);
+	void store_box(char *out, const Rectd &value);
+	void store_circle(char *out, const Circled &value);
+
+	/// \brief Binary value of a polygon.
+	std::string encode(const std::vector<Vec2d> &polygon);
+
+	/// \brief Decode the value of a column of the given type and format (0 = text, 1 = binary).
+	Vec2d decode_point(const char *data, int length, Oid type, int format);
+	LineSegment2d decode_line_segment(const char *data, int length, Oid type, int format);
+	Rectd decode_box(const char *data, int length, Oid type, int format);
+	Circled decode_circle(const char *data, int length, Oid type, int format);
+
+	/// \brief Decode a polygon or a path.
+	void decode_polygon(const char *data, int length, Oid type, int format, std::vector<Vec2d> &out);
+
+	/// \brief Text form of a binary geometric value, as the server prints it.
+	std::string to_text(const char *data, int length, Oid type);
+}
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,187 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_group_commit.h"
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "ClanLib/Database/db_transaction.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_request_window.h"
+
+#include <vector>
+
+namespace clan
+{
+
+class PgsqlGroupCommit_Impl
+{
+public:
+	struct Group
+	{
+		std::vector<const PgsqlGroupCommit::Unit *> units;
+		std::vector<std::exception_ptr> unit_errors;
+	};
+
+	PgsqlGroupCommit_Impl(PgsqlConnection &connection, int max_units, int window_ms)
+	: connection(connection), provider(PgsqlConnectionProvider::from_connection(connection)),
+	  window(max_units, window_ms), unit_count(0)
+	{
+	}
+
+	void execute(const PgsqlGroupCommit::Unit &unit);
+
+	PgsqlConnection connection;
+	PgsqlConnectionProvider *provider;
+
+	/// \brief Its mutex also guards unit_count.
+	PgsqlRequestWindow<Group> window;
+	unsigned int unit_count;
+
+private:
+	void run(Group &group);
+	void execute(const char *sql);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlGroupCommit Construction:
+
+PgsqlGroupCommit::PgsqlGroupCommit(PgsqlConnection &connection, int max_units, int window_ms)
+: impl(std::make_shared<PgsqlGroupCommit_Impl>(connection, max_units, window_ms))
+{
+}
+
+PgsqlGroupCommit::~PgsqlGroupCommit()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlGroupCommit Attributes:
+
+unsigned int PgsqlGroupCommit::get_unit_count() const
+{
+	std::lock_guard<std::mutex> lock(impl->window.mutex);
+	return impl->unit_count;
+}
+
+unsigned int PgsqlGroupCommit::get_commit_count() const
+{
+	std::lock_guard<std::mutex> lock(impl->window.mutex);
+	return impl->window.batch_count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlGroupCommit Operations:
+
+void PgsqlGroupCommit::execute(const Unit &unit)
+{
+	impl->execute(unit);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlGroupCommit_Impl Operations:
+
+void PgsqlGroupCommit_Impl::execute(const PgsqlGroupCommit::Unit &unit)
+{
+	std::unique_lock<std::mutex> lock(window.mutex);
+	unit_count++;
+
+	size_t index = 0;
+	auto join = [&](Group &group) -> size_t
+	{
+		index = group.units.size();
+		group.units.push_back(&unit);
+		return group.units.size();
+	};
+	std::shared_ptr<PgsqlRequestWindow<Group>::Batch> group = window.submit(lock, join, [&](Group &content) { run(content); });
+
+	if (group->error)
+		std::rethrow_exception(group->error);
+	if (group->content.unit_errors[index])
+		std::rethrow_exception(group->content.unit_errors[index]);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlGroupCommit_Impl Implementation:
+
+void PgsqlGroupCommit_Impl::run(Group &group)
+{
+	const std::vector<const PgsqlGroupCommit::Unit *> &units = group.units;
+	group.unit_errors.resize(units.size());
+	DBTransaction transaction = connection.begin_transaction();
+	try
+	{
+		execute("SAVEPOINT clan_group_unit");
+		for (size_t i = 0; i < units.size(); i++)
+		{
+			bool succeeded = false;
+			try
+			{
+				(*units[i])(connection);
+				if (PQtransactionStatus(provider->get_handle()) == PQTRANS_INERROR)
+					throw Exception("PgsqlGroupCommit unit returned with its transaction aborted");
+				succeeded = true;
+			}
+			catch (...)
+			{
+				group.unit_errors[i] = std::current_exception();
+			}
+
+			// One round trip per unit: the savepoint of the next unit is
+			// set along with the release of this one. The last unit needs
+			// neither, the commit ends its savepoint.
+			if (!succeeded)
+				execute("ROLLBACK TO SAVEPOINT clan_group_unit");
+			else if (i + 1 < units.size())
+				execute("RELEASE SAVEPOINT clan_group_unit; SAVEPOINT clan_group_unit");
+		}
+		transaction.commit();
+	}
+	catch (...)
+	{
+		try
+		{
+			transaction.rollback();
+		}
+		catch (...)
+		{
+		}
+		throw;
+	}
+}
+
+void PgsqlGroupCommit_Impl::execute(const char *sql)
+{
+	PGresult *result = PQexec(provider->get_handle(), sql);
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(result, deleter);
+	if (PQresultStatus(result) != PGRES_COMMAND_OK)
+		provider->throw_result_error(result);
+}
+
+}; // namespace clan
@@ -0,0 +1,599 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_json_view.h"
+#include "ClanLib/Core/Text/json_value.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+// CLANPGSQL_JSON_SCALAR keeps the portable scan only; the tests compare both
+#if !defined(CLANPGSQL_JSON_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define CLANPGSQL_JSON_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace clan
+{
+
+class PgsqlJsonView_Impl
+{
+public:
+	PgsqlJsonView_Impl(const std::string &json);
+
+	char at(int token) const { return json[positions[token]]; }
+	int get_count() const { return positions.size(); }
+
+	PgsqlJsonView::Type get_type(int token) const;
+
+	/// \brief Byte after the end of the value starting at token.
+	size_t get_value_end(int token) const;
+
+	std::string decode_string(int token) const;
+	bool key_equals(int token, const std::string &name) const;
+
+	/// \brief Call fn(key token, value token) for each member, until it returns false.
+	template<typename Fn>
+	void for_each_member(int object, Fn fn) const;
+
+	/// \brief Call fn(value token) for each item, until it returns false.
+	template<typename Fn>
+	void for_each_item(int array, Fn fn) const;
+
+	static void throw_invalid();
+
+	std::string json;
+
+	/// \brief Position of every structural character and value start, in document order.
+	std::vector<uint32_t> positions;
+
+	/// \brief For each token starting a value, the token following that value.
+	std::vector<uint32_t> ends;
+
+private:
+	void scan();
+	void pair_brackets();
+	void add_tokens(size_t offset, unsigned int mask);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlJsonView Construction:
+
+PgsqlJsonView::PgsqlJsonView()
+: token(-1)
+{
+}
+
+PgsqlJsonView::PgsqlJsonView(const std::string &json)
+: impl(std::make_shared<PgsqlJsonView_Impl>(json)), token(0)
+{
+}
+
+PgsqlJsonView::PgsqlJsonView(const std::shared_ptr<const PgsqlJsonView_Impl> &impl, int token)
+: impl(impl), token(token)
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlJsonView Attributes:
+
+PgsqlJsonView::Type PgsqlJsonView::get_type() const
+{
+	if (!impl || token < 0)
+		return type_undefined;
+	return impl->get_type(token);
+}
+
+int PgsqlJsonView::get_size() const
+{
+	int size = 0;
+	switch (get_type())
+	{
+	case type_object:
+		impl->for_each_member(token, [&](int, int) { size++; return true; });
+		break;
+	case type_array:
+		impl->for_each_item(token, [&](int) { size++; return true; });
+		break;
+	default:
+		break;
+	}
+	return size;
+}
+
+std::vector<std::string> PgsqlJsonView::get_member_names() const
+{
+	std::vector<std::string> names;
+	if (get_type() == type_object)
+		impl->for_each_member(token, [&](int key, int) { names.push_back(impl->decode_string(key)); return true; });
+	return names;
+}
+
+PgsqlJsonView PgsqlJsonView::operator[](const std::string &name) const
+{
+	int found = -1;
+	if (get_type() == type_object)
+	{
+		impl->for_each_member(token, [&](int key, int value)
+		{
+			if (!impl->key_equals(key, name))
+				return true;
+			found = value;
+			return false;
+		});
+	}
+	return found < 0 ? PgsqlJsonView() : PgsqlJsonView(impl, found);
+}
+
+PgsqlJsonView PgsqlJsonView::operator[](int index) const
+{
+	int found = -1;
+	if (index >= 0 && get_type() == type_array)
+	{
+		int position = 0;
+		impl->for_each_item(token, [&](int value)
+		{
+			if (position++ < index)
+				return true;
+			found = value;
+			return false;
+		});
+	}
+	return found < 0 ? PgsqlJsonView() : PgsqlJsonView(impl, found);
+}
+
+PgsqlJsonView PgsqlJsonView::get_path(const std::string &path) const
+{
+	PgsqlJsonView view = *this;
+	size_t start = 0;
+	while (!view.is_undefined() && start <= path.size())
+	{
+		size_t end = path.find('.', start);
+		if (end == std::string::npos)
+			end = path.size();
+		const std::string segment = path.substr(start, end - start);
+
+		if (view.get_type() == type_array && !segment.empty() && segment.size() < 10 && segment.find_first_not_of("0123456789") == std::string::npos)
+			view = view[std::atoi(segment.c_str())];
+		else
+			view = view[segment];
+		start = end + 1;
+	}
+	return view;
+}
+
+std::string PgsqlJsonView::to_string() const
+{
+	if (get_type() != type_string)
+		throw Exception("JSON value is not a string");
+	return impl->decode_string(token);
+}
+
+double PgsqlJsonView::to_number() const
+{
+	if (get_type() != type_number)
+		throw Exception("JSON value is not a number");
+	return std::strtod(impl->json.c_str() + impl->positions[token], nullptr);
+}
+
+long long PgsqlJsonView::to_int64() const
+{
+	if (get_type() != type_number)
+		throw Exception("JSON value is not a number");
+
+	const char *text = impl->json.c_str() + impl->positions[token];
+	char *end = nullptr;
+	errno = 0;
+	const long long value = std::strtoll(text, &end, 10);
+	if (end == text || *end == '.' || *end == 'e' || *end == 'E' || errno == ERANGE)
+		throw Exception(string_format("JSON number %1 is not a 64 bit integer", to_json()));
+	return value;
+}
+
+bool PgsqlJsonView::to_boolean() const
+{
+	if (get_type() != type_boolean)
+		throw Exception("JSON value is not a boolean");
+	return impl->at(token) == 't';
+}
+
+std::string PgsqlJsonView::to_json() const
+{
+	if (get_type() == type_undefined)
+		throw Exception("Undefined JSON value");
+	const size_t start = impl->positions[token];
+	return impl->json.substr(start, impl->get_value_end(token) - start);
+}
+
+JsonValue PgsqlJsonView::to_json_value() const
+{
+	return JsonValue::from_json(to_json());
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlJsonView_Impl Construction:
+
+PgsqlJsonView_Impl::PgsqlJsonView_Impl(const std::string &json)
+: json(json)
+{
+	if (json.size() >= 0xffffffffu)
+		throw Exception("JSON document too large");
+	positions.reserve(json.size() / 8);
+	scan();
+	pair_brackets();
+	if (positions.empty())
+		throw Exception("Empty JSON document");
+	get_type(0);
+	if (ends[0] != positions.size())
+		throw Exception("Unexpected data after the JSON value");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlJsonView_Impl Attributes:
+
+PgsqlJsonView::Type PgsqlJsonView_Impl::get_type(int token) const
+{
+	switch (at(token))
+	{
+	case '{': return PgsqlJsonView::type_object;
+	case '[': return PgsqlJsonView::type_array;
+	case '"': return PgsqlJsonView::type_string;
+	case 't': case 'f': return PgsqlJsonView::type_boolean;
+	case 'n': return PgsqlJsonView::type_null;
+	case '-': case '0': case '1': case '2': case '3': case '4': case '5': case '6': case '7': case '8': case '9':
+		return PgsqlJsonView::type_number;
+	default:
+		throw_invalid();
+		return PgsqlJsonView::type_undefined;
+	}
+}
+
+size_t PgsqlJsonView_Impl::get_value_end(int token) const
+{
+	const char c = at(token);
+	if (c == '{' || c == '[')
+		return positions[ends[token] - 1] + 1;
+
+	size_t pos = positions[token] + 1;
+	if (c == '"')
+	{
+		for (; pos < json.size() && json[pos] != '"'; pos++)
+		{
+			if (json[pos] == '\\')
+				pos++;
+		}
+		return pos + 1;
+	}
+
+	while (pos < json.size() && !std::strchr(" \t\n\r{}[]:,\"", json[pos]))
+		pos++;
+	return pos;
+}
+
+std::string PgsqlJsonView_Impl::decode_string(int token) const
+{
+	std::string text;
+	const char *pos = json.c_str() + positions[token] + 1;
+	while (true)
+	{
+		const char *run = pos;
+		while (*pos != '"' && *pos != '\\' && *pos != '\0')
+			pos++;
+		text.append(run, pos);
+		if (*pos == '"')
+			return text;
+		if (*pos == '\0')
+			throw_invalid();
+
+		pos++;
+		switch (*pos++)
+		{
+		case '"': text += '"'; break;
+		case '\\': text += '\\'; break;
+		case '/': text += '/'; break;
+		case 'b': text += '\b'; break;
+		case 'f': text += '\f'; break;
+		case 'n': text += '\n'; break;
+		case 'r': text += '\r'; break;
+		case 't': text += '\t'; break;
+		case 'u':
+			{
+				auto read_hex = [&]() -> unsigned int
+				{
+					unsigned int value = 0;
+					for (int i = 0; i < 4; i++)
+					{
+						const char c = *pos++;
+						value <<= 4;
+						if (c >= '0' && c <= '9') value |= c - '0';
+						else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+						else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+						else throw_invalid();
+					}
+					return value;
+				};
+				unsigned int code = read_hex();
+				if (code >= 0xd800 && code < 0xdc00 && pos[0] == '\\' && pos[1] == 'u')
+				{
+					pos += 2;
+					const unsigned int low = read_hex();
+					if (low < 0xdc00 || low >= 0xe000)
+						throw_invalid();
+					code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+				}
+
+				if (code < 0x80)
+				{
+					text += static_cast<char>(code);
+				}
+				else if (code < 0x800)
+				{
+					text += static_cast<char>(0xc0 | (code >> 6));
+					text += static_cast<char>(0x80 | (code & 0x3f));
+				}
+				else if (code < 0x10000)
+				{
+					text += static_cast<char>(0xe0 | (code >> 12));
+					text += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+					text += static_cast<char>(0x80 | (code & 0x3f));
+				}
+				else
+				{
+					text += static_cast<char>(0xf0 | (code >> 18));
+					text += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+					text += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+					text += static_cast<char>(0x80 | (code & 0x3f));
+				}
+			}
+			break;
+		default:
+			throw_invalid();
+		}
+	}
+}
+
+bool PgsqlJsonView_Impl::key_equals(int token, const std::string &name) const
+{
+	// Compare the raw text first; keys with escape sequences are decoded
+	const size_t start = positions[token] + 1;
+	const size_t raw_end = positions[token + 1];
+	if (name.size() < raw_end - start && json.compare(start, name.size(), name) == 0 && json[start + name.size()] == '"' &&
+		name.find_first_of("\\\"") == std::string::npos)
+	{
+		return true;
+	}
+	if (std::memchr(json.data() + start, '\\', raw_end - start) == nullptr)
+		return false;
+	return decode_string(token) == name;
+}
+
+template<typename Fn>
+void PgsqlJsonView_Impl::for_each_member(int object, Fn fn) const
+{
+	int token = object + 1;
+	if (at(token) == '}')
+		return;
+	while (true)
+	{
+		const int key = token;
+		if (at(key) != '"' || key + 2 >= get_count() || at(key + 1) != ':')
+			throw_invalid();
+		const int value = key + 2;
+		get_type(value);
+		if (!fn(key, value))
+			return;
+
+		token = ends[value];
+		if (at(token) == '}')
+			return;
+		if (at(token) != ',')
+			throw_invalid();
+		token++;
+	}
+}
+
+template<typename Fn>
+void PgsqlJsonView_Impl::for_each_item(int array, Fn fn) const
+{
+	int token = array + 1;
+	if (at(token) == ']')
+		return;
+	while (true)
+	{
+		get_type(token);
+		if (!fn(token))
+			return;
+
+		token = ends[token];
+		if (at(token) == ']')
+			return;
+		if (at(token) != ',')
+			throw_invalid();
+		token++;
+	}
+}
+
+void PgsqlJsonView_Impl::throw_invalid()
+{
+	throw Exception("Invalid JSON document");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlJsonView_Impl Implementation:
+
+void PgsqlJsonView_Impl::scan()
+{
+	const char *data = json.data();
+	const size_t size = json.size();
+	bool in_string = false;
+	bool escape_next = false;
+	bool in_scalar = false;
+	size_t i = 0;
+
+#ifdef CLANPGSQL_JSON_SSE2
+	// Same rules as the loop below, on masks of 16 characters
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i backslash = _mm_set1_epi8('\\');
+	for (; i + 16 <= size; i += 16)
+	{
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+		unsigned int quotes = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, quote));
+		const unsigned int backslashes = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, backslash));
+		const unsigned int structurals = _mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('{')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('}'))),
+				_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('[')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(']')))),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(':')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8(',')))));
+		const unsigned int spaces = _mm_movemask_epi8(_mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\t'))),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')), _mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')))));
+
+		// Characters following an odd run of backslashes are escaped
+		unsigned int escaped = 0;
+		if (backslashes || escape_next)
+		{
+			for (int bit = 0; bit < 16; bit++)
+			{
+				if (escape_next)
+				{
+					escaped |= 1u << bit;
+					escape_next = false;
+				}
+				else if (backslashes & (1u << bit))
+				{
+					escape_next = true;
+				}
+			}
+		}
+		quotes &= ~escaped;
+
+		// Prefix xor of the quotes: set from an opening quote up to the character before its closing quote
+		unsigned int strings = quotes;
+		strings ^= strings << 1;
+		strings ^= strings << 2;
+		strings ^= strings << 4;
+		strings ^= strings << 8;
+		strings = (strings ^ (in_string ? 0xffffu : 0u)) & 0xffffu;
+		in_string = (strings >> 15) != 0;
+
+		const unsigned int scalars = ~(structurals | spaces | quotes | strings) & 0xffffu;
+		const unsigned int scalar_starts = scalars & ~((scalars << 1) | (in_scalar ? 1u : 0u));
+		in_scalar = (scalars >> 15) != 0;
+
+		add_tokens(i, (structurals & ~strings) | (quotes & strings) | scalar_starts);
+	}
+	if (in_string)
+		in_scalar = false;
+#endif
+
+	for (; i < size; i++)
+	{
+		const char c = data[i];
+		if (in_string)
+		{
+			if (escape_next)
+				escape_next = false;
+			else if (c == '\\')
+				escape_next = true;
+			else if (c == '"')
+				in_string = false;
+			continue;
+		}
+
+		switch (c)
+		{
+		case '"':
+			in_string = true;
+			positions.push_back(i);
+			in_scalar = false;
+			break;
+		case '{': case '}': case '[': case ']': case ':': case ',':
+			positions.push_back(i);
+			in_scalar = false;
+			break;
+		case ' ': case '\t': case '\n': case '\r':
+			in_scalar = false;
+			break;
+		default:
+			if (!in_scalar)
+				positions.push_back(i);
+			in_scalar = true;
+			break;
+		}
+	}
+
+	if (in_string)
+		throw Exception("Unterminated string in JSON document");
+}
+
+void PgsqlJsonView_Impl::add_tokens(size_t offset, unsigned int mask)
+{
+	while (mask)
+	{
+#if defined(__GNUC__)
+		const int bit = __builtin_ctz(mask);
+#else
+		int bit = 0;
+		while (!(mask & (1u << bit)))
+			bit++;
+#endif
+		positions.push_back(static_cast<uint32_t>(offset + bit));
+		mask &= mask - 1;
+	}
+}
+
+void PgsqlJsonView_Impl::pair_brackets()
+{
+	const int count = positions.size();
+	ends.resize(count);
+	std::vector<int> open;
+	for (int token = 0; token < count; token++)
+	{
+		const char c = at(token);
+		ends[token] = token + 1;
+		if (c == '{' || c == '[')
+		{
+			open.push_back(token);
+		}
+		else if (c == '}' || c == ']')
+		{
+			if (open.empty() || at(open.back()) != (c == '}' ? '{' : '['))
+				throw Exception("Unbalanced brackets in JSON document");
+			ends[open.back()] = token + 1;
+			open.pop_back();
+		}
+	}
+	if (!open.empty())
+		throw Exception("Unbalanced brackets in JSON document");
+}
+
+}; // namespace clan
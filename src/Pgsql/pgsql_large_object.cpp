@@ -0,0 +1,262 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_large_object.h"
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "ClanLib/Core/IOData/iodevice.h"
+#include "pgsql_connection_provider.h"
+
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <libpq/libpq-fs.h>
+
+namespace clan
+{
+
+class PgsqlLargeObject_Impl
+{
+public:
+	PgsqlLargeObject_Impl(PgsqlConnection &connection, Oid oid, PgsqlLargeObject::OpenMode mode)
+	: connection(connection), provider(PgsqlConnectionProvider::from_connection(connection)), oid(oid), fd(-1)
+	{
+		check_transaction(provider);
+		transaction = get_transaction_key();
+		if (transaction.empty())
+			provider->throw_result_error(nullptr);
+
+		int flags = 0;
+		if (mode & PgsqlLargeObject::open_read)
+			flags |= INV_READ;
+		if (mode & PgsqlLargeObject::open_write)
+			flags |= INV_WRITE;
+		fd = lo_open(provider->get_handle(), oid, flags);
+		if (fd < 0)
+			provider->throw_result_error(nullptr);
+	}
+
+	~PgsqlLargeObject_Impl()
+	{
+		// A descriptor is already gone if its transaction ended; closing it in
+		// a later transaction would fail and abort that one
+		if (fd >= 0 && PQtransactionStatus(provider->get_handle()) == PQTRANS_INTRANS && get_transaction_key() == transaction)
+			lo_close(provider->get_handle(), fd);
+	}
+
+	/// \brief Backend and start time of the current transaction, or an empty string.
+	std::string get_transaction_key() const
+	{
+		PGresult *result = PQexec(provider->get_handle(), "SELECT pg_backend_pid() || ' ' || transaction_timestamp()");
+		std::string key;
+		if (PQresultStatus(result) == PGRES_TUPLES_OK && PQntuples(result) == 1)
+			key = PQgetvalue(result, 0, 0);
+		PQclear(result);
+		return key;
+	}
+
+	static void check_transaction(PgsqlConnectionProvider *provider)
+	{
+		if (PQtransactionStatus(provider->get_handle()) != PQTRANS_INTRANS)
+			throw Exception("Large objects can only be used inside a transaction");
+	}
+
+	void check_open() const
+	{
+		if (fd < 0)
+			throw Exception("Large object is closed");
+	}
+
+	long long seek(long long offset, int whence)
+	{
+		check_open();
+		const pg_int64 position = lo_lseek64(provider->get_handle(), fd, offset, whence);
+		if (position < 0)
+			provider->throw_result_error(nullptr);
+		return position;
+	}
+
+	PgsqlConnection connection;
+	PgsqlConnectionProvider *provider;
+	Oid oid;
+	int fd;
+
+	/// \brief Transaction the descriptor was opened in.
+	std::string transaction;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlLargeObject Construction:
+
+PgsqlLargeObject::PgsqlLargeObject()
+{
+}
+
+PgsqlLargeObject::PgsqlLargeObject(PgsqlConnection &connection, unsigned int oid, OpenMode mode)
+: impl(std::make_shared<PgsqlLargeObject_Impl>(connection, oid, mode))
+{
+}
+
+PgsqlLargeObject::~PgsqlLargeObject()
+{
+}
+
+PgsqlLargeObject PgsqlLargeObject::create(PgsqlConnection &connection)
+{
+	PgsqlConnectionProvider *provider = PgsqlConnectionProvider::from_connection(connection);
+	PgsqlLargeObject_Impl::check_transaction(provider);
+
+	const Oid oid = lo_create(provider->get_handle(), InvalidOid);
+	if (oid == InvalidOid)
+		provider->throw_result_error(nullptr);
+	return PgsqlLargeObject(connection, oid, open_read_write);
+}
+
+void PgsqlLargeObject::unlink(PgsqlConnection &connection, unsigned int oid)
+{
+	PgsqlConnectionProvider *provider = PgsqlConnectionProvider::from_connection(connection);
+	if (lo_unlink(provider->get_handle(), oid) < 0)
+		provider->throw_result_error(nullptr);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlLargeObject Attributes:
+
+unsigned int PgsqlLargeObject::get_oid() const
+{
+	return impl->oid;
+}
+
+long long PgsqlLargeObject::get_position() const
+{
+	impl->check_open();
+	const pg_int64 position = lo_tell64(impl->provider->get_handle(), impl->fd);
+	if (position < 0)
+		impl->provider->throw_result_error(nullptr);
+	return position;
+}
+
+long long PgsqlLargeObject::get_size() const
+{
+	const long long position = get_position();
+	const long long size = impl->seek(0, SEEK_END);
+	impl->seek(position, SEEK_SET);
+	return size;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlLargeObject Operations:
+
+int PgsqlLargeObject::read(void *data, int size)
+{
+	impl->check_open();
+	const int received = lo_read(impl->provider->get_handle(), impl->fd, static_cast<char*>(data), size);
+	if (received < 0)
+		impl->provider->throw_result_error(nullptr);
+	return received;
+}
+
+void PgsqlLargeObject::write(const void *data, int size)
+{
+	impl->check_open();
+	const char *pos = static_cast<const char*>(data);
+	while (size > 0)
+	{
+		const int written = lo_write(impl->provider->get_handle(), impl->fd, pos, size);
+		if (written <= 0)
+			impl->provider->throw_result_error(nullptr);
+		pos += written;
+		size -= written;
+	}
+}
+
+long long PgsqlLargeObject::seek(long long offset, SeekMode mode)
+{
+	switch (mode)
+	{
+	case seek_cur:
+		return impl->seek(offset, SEEK_CUR);
+	case seek_end:
+		return impl->seek(offset, SEEK_END);
+	case seek_set:
+	default:
+		return impl->seek(offset, SEEK_SET);
+	}
+}
+
+void PgsqlLargeObject::truncate(long long size)
+{
+	impl->check_open();
+	if (lo_truncate64(impl->provider->get_handle(), impl->fd, size) < 0)
+		impl->provider->throw_result_error(nullptr);
+}
+
+long long PgsqlLargeObject::copy_to(IODevice &device, int chunk_size)
+{
+	std::vector<char> buffer(chunk_size);
+	long long total = 0;
+	while (true)
+	{
+		const int received = read(buffer.data(), chunk_size);
+		if (received == 0)
+			break;
+		if (device.send(buffer.data(), received, true) != received)
+			throw Exception("Unable to write the large object to the device");
+		total += received;
+	}
+	return total;
+}
+
+long long PgsqlLargeObject::copy_from(IODevice &device, int chunk_size)
+{
+	std::vector<char> buffer(chunk_size);
+	long long total = 0;
+	while (true)
+	{
+		const int received = device.receive(buffer.data(), chunk_size, true);
+		if (received > 0)
+		{
+			write(buffer.data(), received);
+			total += received;
+		}
+		if (received < chunk_size)
+			break;
+	}
+	return total;
+}
+
+void PgsqlLargeObject::close()
+{
+	impl->check_open();
+	const int result = lo_close(impl->provider->get_handle(), impl->fd);
+	impl->fd = -1;
+	if (result < 0)
+		impl->provider->throw_result_error(nullptr);
+}
+
+}; // namespace clan
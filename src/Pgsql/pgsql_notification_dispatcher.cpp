@@ -0,0 +1,380 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_notification_dispatcher.h"
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_wire_connection_provider.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+#include <algorithm>
+#include <map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+
+namespace clan
+{
+
+class PgsqlNotificationDispatcher_Impl
+{
+public:
+	PgsqlNotificationDispatcher_Impl(PgsqlConnection &connection)
+	: connection(connection), wire_provider(dynamic_cast<PgsqlWireConnectionProvider*>(connection.get_provider())),
+	  provider(wire_provider ? nullptr : PgsqlConnectionProvider::from_connection(connection)), running(false)
+	{
+	}
+
+	~PgsqlNotificationDispatcher_Impl()
+	{
+		stop();
+	}
+
+	void subscribe(const std::string &channel, const PgsqlNotificationDispatcher::Handler &handler);
+	void unsubscribe(const std::string &channel);
+	int process(int timeout_ms);
+	void start();
+	void stop();
+	bool is_running() const { return running; }
+
+	PgsqlNotificationDispatcher::ErrorHandler error_handler;
+
+private:
+	void execute(const std::string &command, const std::string &channel);
+	void ensure_connected();
+	void consume_input(PGconn *db);
+	void receive(std::unique_lock<std::mutex> &lock, int timeout_ms, std::vector<PgsqlNotification> &notifications);
+	void receive_native(std::unique_lock<std::mutex> &lock, int timeout_ms, std::vector<PgsqlNotification> &notifications);
+	void run();
+
+	PgsqlConnection connection;
+
+	/// \brief Provider of the native engine, or null when using libpq.
+	PgsqlWireConnectionProvider *wire_provider;
+	PgsqlConnectionProvider *provider;
+	std::atomic<bool> running;
+
+	/// \brief Guards the connection handle and the handlers.
+	std::mutex mutex;
+	std::map<std::string, std::vector<PgsqlNotificationDispatcher::Handler> > handlers;
+	std::thread thread;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlNotificationDispatcher Construction:
+
+PgsqlNotificationDispatcher::PgsqlNotificationDispatcher(PgsqlConnection &connection)
+: impl(std::make_shared<PgsqlNotificationDispatcher_Impl>(connection))
+{
+}
+
+PgsqlNotificationDispatcher::~PgsqlNotificationDispatcher()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlNotificationDispatcher Attributes:
+
+bool PgsqlNotificationDispatcher::is_running() const
+{
+	return impl->is_running();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlNotificationDispatcher Operations:
+
+void PgsqlNotificationDispatcher::subscribe(const std::string &channel, const Handler &handler)
+{
+	impl->subscribe(channel, handler);
+}
+
+void PgsqlNotificationDispatcher::unsubscribe(const std::string &channel)
+{
+	impl->unsubscribe(channel);
+}
+
+int PgsqlNotificationDispatcher::process(int timeout_ms)
+{
+	return impl->process(timeout_ms);
+}
+
+void PgsqlNotificationDispatcher::start()
+{
+	impl->start();
+}
+
+void PgsqlNotificationDispatcher::stop()
+{
+	impl->stop();
+}
+
+void PgsqlNotificationDispatcher::set_error_handler(const ErrorHandler &handler)
+{
+	impl->error_handler = handler;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlNotificationDispatcher_Impl Implementation:
+
+void PgsqlNotificationDispatcher_Impl::subscribe(const std::string &channel, const PgsqlNotificationDispatcher::Handler &handler)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	std::vector<PgsqlNotificationDispatcher::Handler> &channel_handlers = handlers[channel];
+	if (channel_handlers.empty())
+	{
+		try
+		{
+			execute("LISTEN", channel);
+		}
+		catch (...)
+		{
+			handlers.erase(channel);
+			throw;
+		}
+	}
+	channel_handlers.push_back(handler);
+}
+
+void PgsqlNotificationDispatcher_Impl::unsubscribe(const std::string &channel)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (handlers.erase(channel))
+		execute("UNLISTEN", channel);
+}
+
+int PgsqlNotificationDispatcher_Impl::process(int timeout_ms)
+{
+	std::vector<PgsqlNotification> notifications;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		ensure_connected();
+		if (wire_provider)
+			receive_native(lock, timeout_ms, notifications);
+		else
+			receive(lock, timeout_ms, notifications);
+	}
+
+	for (auto &notification : notifications)
+	{
+		std::vector<PgsqlNotificationDispatcher::Handler> channel_handlers;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			auto it = handlers.find(notification.channel);
+			if (it != handlers.end())
+				channel_handlers = it->second;
+		}
+		for (auto &handler : channel_handlers)
+			handler(notification);
+	}
+	return notifications.size();
+}
+
+void PgsqlNotificationDispatcher_Impl::receive(std::unique_lock<std::mutex> &lock, int timeout_ms, std::vector<PgsqlNotification> &notifications)
+{
+	PGconn *db = provider->get_handle();
+	consume_input(db);
+	if (timeout_ms != 0 && !PQisBusy(db))
+	{
+		PGnotify *notify = PQnotifies(db);
+		if (notify)
+		{
+			notifications.push_back(PgsqlNotification(notify->relname, notify->extra, notify->be_pid));
+			PQfreemem(notify);
+		}
+		else
+		{
+			// Do not hold the lock while sleeping on the socket
+			lock.unlock();
+			provider->wait_for_input(timeout_ms);
+			lock.lock();
+			ensure_connected();
+			consume_input(db);
+		}
+	}
+
+	for (PGnotify *notify = PQnotifies(db); notify; notify = PQnotifies(db))
+	{
+		notifications.push_back(PgsqlNotification(notify->relname, notify->extra, notify->be_pid));
+		PQfreemem(notify);
+	}
+}
+
+void PgsqlNotificationDispatcher_Impl::receive_native(std::unique_lock<std::mutex> &lock, int timeout_ms, std::vector<PgsqlNotification> &notifications)
+{
+	// The notifications are read between commands, so no reader may be left receiving rows
+	wire_provider->finish_active_reader();
+	PgsqlWireConnection &wire = wire_provider->get_wire();
+	wire.consume_input();
+	if (timeout_ms != 0 && !wire.has_notification())
+	{
+		// Do not hold the lock while sleeping on the socket
+		lock.unlock();
+		wire.wait_for_input(timeout_ms);
+		lock.lock();
+		ensure_connected();
+		wire.consume_input();
+	}
+
+	PgsqlNotification notification;
+	while (wire.get_notification(notification))
+		notifications.push_back(notification);
+}
+
+void PgsqlNotificationDispatcher_Impl::start()
+{
+	if (running)
+		return;
+	running = true;
+	thread = std::thread(&PgsqlNotificationDispatcher_Impl::run, this);
+}
+
+void PgsqlNotificationDispatcher_Impl::stop()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+void PgsqlNotificationDispatcher_Impl::run()
+{
+	int retry_delay_ms = 250;
+	while (running)
+	{
+		Exception error("");
+		try
+		{
+			// Short slices, so that stop() does not wait for a notification
+			process(250);
+			retry_delay_ms = 250;
+			continue;
+		}
+		catch (const Exception &e)
+		{
+			error = e;
+		}
+		catch (const std::exception &e)
+		{
+			error = Exception(e.what());
+		}
+		catch (...)
+		{
+			error = Exception("Unknown exception in notification dispatcher");
+		}
+
+		if (error_handler)
+		{
+			try
+			{
+				error_handler(error);
+			}
+			catch (...)
+			{
+			}
+		}
+
+		// Wait in short slices too, doubling the delay while errors go on
+		for (int waited = 0; running && waited < retry_delay_ms; waited += 50)
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		retry_delay_ms = std::min(retry_delay_ms * 2, 10000);
+	}
+}
+
+void PgsqlNotificationDispatcher_Impl::execute(const std::string &command, const std::string &channel)
+{
+	if (wire_provider)
+	{
+		// Quoted like PQescapeIdentifier does
+		std::string sql = command + " \"";
+		for (char c : channel)
+			sql += (c == '"') ? std::string("\"\"") : std::string(1, c);
+		sql += "\"";
+		std::unique_ptr<DBCommandProvider> statement(wire_provider->create_command(sql, DBCommand::sql_statement));
+		wire_provider->execute_non_query(statement.get());
+		return;
+	}
+
+	PGconn *db = provider->get_handle();
+	char *identifier = PQescapeIdentifier(db, channel.data(), channel.size());
+	if (!identifier)
+		throw Exception(PQerrorMessage(db));
+	std::string sql = command + " " + identifier;
+	PQfreemem(identifier);
+
+	PGresult *result = PQexec(db, sql.c_str());
+	if (PQresultStatus(result) != PGRES_COMMAND_OK)
+	{
+		auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+		std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(result, deleter);
+		provider->throw_result_error(result);
+	}
+	PQclear(result);
+}
+
+void PgsqlNotificationDispatcher_Impl::ensure_connected()
+{
+	if (wire_provider)
+	{
+		if (!wire_provider->get_wire().is_lost())
+			return;
+		try
+		{
+			wire_provider->reset();
+		}
+		catch (const Exception &e)
+		{
+			throw Exception(string_format("Unable to reconnect the notification connection: %1", e.message));
+		}
+		for (auto &channel : handlers)
+			execute("LISTEN", channel.first);
+		return;
+	}
+
+	PGconn *db = provider->get_handle();
+	if (PQstatus(db) == CONNECTION_OK)
+		return;
+
+	PQreset(db);
+	if (PQstatus(db) != CONNECTION_OK)
+		throw Exception(string_format("Unable to reconnect the notification connection: %1", PQerrorMessage(db)));
+
+	// A new server session does not remember our LISTENs
+	for (auto &channel : handlers)
+		execute("LISTEN", channel.first);
+}
+
+void PgsqlNotificationDispatcher_Impl::consume_input(PGconn *db)
+{
+	// Fails once the connection is dead; the next call resets it
+	if (!PQconsumeInput(db))
+		throw Exception(string_format("Notification connection lost: %1", PQerrorMessage(db)));
+}
+
+}; // namespace clan
@@ -0,0 +1,365 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "pgsql_numeric.h"
+#include "pgsql_binary.h"
+#include "pg_type.h"
+#include "ClanLib/Core/Text/string_format.h"
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace clan
+{
+
+namespace
+{
+	const unsigned short numeric_positive = 0x0000;
+	const unsigned short numeric_negative = 0x4000;
+	const unsigned short numeric_nan = 0xC000;
+	const unsigned short numeric_infinity = 0xD000;
+	const unsigned short numeric_negative_infinity = 0xF000;
+
+	void check_scale(int scale)
+	{
+		if (scale < 0 || scale > PgsqlNumeric::max_scale)
+			throw Exception(string_format("Invalid fixed point scale %1", scale));
+	}
+
+	void throw_overflow()
+	{
+		throw Exception("Numeric value out of range of the fixed point integer");
+	}
+
+	/// \brief value * factor + addend, if it does not go over bound.
+	template<typename U>
+	U multiply_add(U value, unsigned int factor, unsigned int addend, U bound)
+	{
+		if (value > (bound - addend) / factor)
+			throw_overflow();
+		return value * factor + addend;
+	}
+
+	template<typename U>
+	U multiply_pow10(U value, int power, U bound)
+	{
+		for (; power >= 4; power -= 4)
+			value = multiply_add<U>(value, 10000, 0, bound);
+		for (; power > 0; power--)
+			value = multiply_add<U>(value, 10, 0, bound);
+		return value;
+	}
+
+	/// \brief Magnitude of a binary NUMERIC times 10^scale, rounded or truncated.
+	template<typename U>
+	U binary_magnitude(const char *data, int length, int scale, bool round, bool &negative, U positive_bound)
+	{
+		if (length < 8)
+			throw Exception("Invalid binary numeric");
+		const int digit_count = PgsqlBinary::read_int16(data);
+		const int weight = PgsqlBinary::read_int16(data + 2);
+		const unsigned short sign = PgsqlBinary::read_uint16(data + 4);
+		if (sign == numeric_nan)
+			throw Exception("NaN can't be read as a fixed point integer");
+		if (sign == numeric_infinity || sign == numeric_negative_infinity)
+			throw Exception("Infinity can't be read as a fixed point integer");
+		if ((sign != numeric_positive && sign != numeric_negative) || digit_count < 0 || length != 8 + 2 * digit_count)
+			throw Exception("Invalid binary numeric");
+
+		negative = sign == numeric_negative;
+		const U bound = negative ? positive_bound + 1 : positive_bound;
+		const char *digits = data + 8;
+
+		// Digit group i holds the decimal powers 4 * (weight - i) to 4 * (weight - i) + 3 of the
+		// value, that is the powers power to power + 3 of the result, power given below
+		U magnitude = 0;
+		int power = 4 * weight + scale;
+		int i = 0;
+		for (; i < digit_count && power >= 0; i++, power -= 4)
+		{
+			const int digit = PgsqlBinary::read_int16(digits + 2 * i);
+			if (digit < 0 || digit > 9999)
+				throw Exception("Invalid binary numeric");
+			magnitude = multiply_add<U>(magnitude, 10000, digit, bound);
+		}
+
+		if (i < digit_count && power >= -4)
+		{
+			// Group across the unit: keep its digits of power 0 and up, round on the one of power -1
+			const int digit = PgsqlBinary::read_int16(digits + 2 * i);
+			if (digit < 0 || digit > 9999)
+				throw Exception("Invalid binary numeric");
+			static const unsigned int divisors[] = { 10, 100, 1000, 10000 };
+			const unsigned int divisor = divisors[-power - 1];
+			magnitude = multiply_add<U>(magnitude, 10000 / divisor, digit / divisor, bound);
+			if (round && digit % divisor * 2 >= divisor)
+				magnitude = multiply_add<U>(magnitude, 1, 1, bound);
+		}
+		else if (i == digit_count && magnitude != 0)
+		{
+			// The groups after the last one are zeros
+			magnitude = multiply_pow10<U>(magnitude, power + 4, bound);
+		}
+		return magnitude;
+	}
+
+	/// \brief Magnitude of a decimal number in text times 10^scale, rounded or truncated.
+	template<typename U>
+	U text_magnitude(const char *data, int length, int scale, bool round, bool &negative, U positive_bound)
+	{
+		const std::string text(data, length);
+		const char *pos = text.c_str();
+		negative = *pos == '-';
+		if (*pos == '-' || *pos == '+')
+			pos++;
+
+		const char *first_digit = pos;
+		int integer_digits = 0;
+		while (*pos >= '0' && *pos <= '9')
+		{
+			pos++;
+			integer_digits++;
+		}
+		const char *fraction = pos;
+		int fraction_digits = 0;
+		if (*pos == '.')
+		{
+			fraction = ++pos;
+			while (*pos >= '0' && *pos <= '9')
+			{
+				pos++;
+				fraction_digits++;
+			}
+		}
+		int exponent = 0;
+		if ((*pos == 'e' || *pos == 'E') && integer_digits + fraction_digits > 0)
+		{
+			char *end = nullptr;
+			const long value = std::strtol(pos + 1, &end, 10);
+			if (end == pos + 1 || value < -100000 || value > 100000)
+				throw Exception(string_format("Invalid numeric %1", text));
+			exponent = value;
+			pos = end;
+		}
+		if (*pos != '\0' || integer_digits + fraction_digits == 0)
+		{
+			if (text == "NaN" || text == "Infinity" || text == "-Infinity" || text == "inf" || text == "-inf" || text == "nan")
+				throw Exception(text + " can't be read as a fixed point integer");
+			throw Exception(string_format("Invalid numeric %1", text));
+		}
+
+		const U bound = negative ? positive_bound + 1 : positive_bound;
+		const int digit_count = integer_digits + fraction_digits;
+		auto digit_at = [&](int i) { return (i < integer_digits ? first_digit[i] : fraction[i - integer_digits]) - '0'; };
+
+		// Digit i is the power power - i of the result
+		U magnitude = 0;
+		int power = integer_digits - 1 + exponent + scale;
+		int i = 0;
+		for (; i < digit_count && power >= 0; i++, power--)
+			magnitude = multiply_add<U>(magnitude, 10, digit_at(i), bound);
+
+		if (i < digit_count && power == -1)
+		{
+			if (round && digit_at(i) >= 5)
+				magnitude = multiply_add<U>(magnitude, 1, 1, bound);
+		}
+		else if (i == digit_count && magnitude != 0)
+		{
+			magnitude = multiply_pow10<U>(magnitude, power + 1, bound);
+		}
+		return magnitude;
+	}
+
+	template<typename T, typename U>
+	T decode(const char *data, int length, Oid type, int format, int scale, bool round, U positive_bound)
+	{
+		check_scale(scale);
+
+		bool negative = false;
+		U magnitude;
+		if (format == 0)
+		{
+			magnitude = text_magnitude<U>(data, length, scale, round, negative, positive_bound);
+		}
+		else if (type == NUMERICOID)
+		{
+			magnitude = binary_magnitude<U>(data, length, scale, round, negative, positive_bound);
+		}
+		else
+		{
+			long long value;
+			if (type == INT2OID && length == 2)
+				value = PgsqlBinary::read_int16(data);
+			else if (type == INT4OID && length == 4)
+				value = PgsqlBinary::read_int32(data);
+			else if (type == INT8OID && length == 8)
+				value = PgsqlBinary::read_int64(data);
+			else
+				throw Exception(string_format("Binary value of type %1 can't be read as a fixed point integer", (int)type));
+			negative = value < 0;
+			const U bound = negative ? positive_bound + 1 : positive_bound;
+			magnitude = negative ? U(0) - U(static_cast<unsigned long long>(value)) : U(value);
+			magnitude = multiply_pow10<U>(magnitude, scale, bound);
+		}
+
+		// The magnitude of the lowest value is one over the largest
+		if (negative && magnitude != 0)
+			return -static_cast<T>(magnitude - 1) - 1;
+		return static_cast<T>(magnitude);
+	}
+
+	template<typename T, typename U>
+	std::string encode(T value, int scale)
+	{
+		check_scale(scale);
+		const bool negative = value < 0;
+		U magnitude = negative ? U(0) - static_cast<U>(value) : static_cast<U>(value);
+
+		// Decimal digits from the lowest; digit j is the power j - scale of the value
+		unsigned char decimals[48];
+		int decimal_count = 0;
+		while (magnitude != 0)
+		{
+			decimals[decimal_count++] = static_cast<unsigned char>(magnitude % 10);
+			magnitude /= 10;
+		}
+
+		// Base 10000 groups aligned on the decimal point; group g holds the powers 4g to 4g + 3
+		auto group_of = [](int power) { return power >= 0 ? power / 4 : -((-power + 3) / 4); };
+		const int lowest = group_of(-scale);
+		const int highest = decimal_count > 0 ? group_of(decimal_count - 1 - scale) : lowest;
+		std::vector<int> groups(highest - lowest + 1, 0);
+		static const int factors[] = { 1, 10, 100, 1000 };
+		for (int j = 0; j < decimal_count; j++)
+		{
+			const int power = j - scale;
+			groups[group_of(power) - lowest] += decimals[j] * factors[power - 4 * group_of(power)];
+		}
+
+		// Drop the zero groups at both ends
+		int first = groups.size() - 1;
+		while (first >= 0 && groups[first] == 0)
+			first--;
+		int last = 0;
+		while (last <= first && groups[last] == 0)
+			last++;
+
+		std::string out;
+		const int digit_count = first >= last ? first - last + 1 : 0;
+		PgsqlBinary::write_int16(out, digit_count);
+		PgsqlBinary::write_int16(out, digit_count ? first + lowest : 0);
+		PgsqlBinary::write_uint16(out, negative ? numeric_negative : numeric_positive);
+		PgsqlBinary::write_uint16(out, scale);
+		for (int g = first; g >= last; g--)
+			PgsqlBinary::write_int16(out, groups[g]);
+		return out;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlNumeric Operations:
+
+std::string PgsqlNumeric::encode(long long value, int scale)
+{
+	return clan::encode<long long, unsigned long long>(value, scale);
+}
+
+long long PgsqlNumeric::decode_int64(const char *data, int length, Oid type, int format, int scale)
+{
+	return clan::decode<long long, unsigned long long>(data, length, type, format, scale, true, 0x7fffffffffffffffULL);
+}
+
+long long PgsqlNumeric::truncate_int64(const char *data, int length, int format)
+{
+	return clan::decode<long long, unsigned long long>(data, length, NUMERICOID, format, 0, false, 0x7fffffffffffffffULL);
+}
+
+#ifdef __SIZEOF_INT128__
+std::string PgsqlNumeric::encode(__int128 value, int scale)
+{
+	return clan::encode<__int128, unsigned __int128>(value, scale);
+}
+
+__int128 PgsqlNumeric::decode_int128(const char *data, int length, Oid type, int format, int scale)
+{
+	const unsigned __int128 positive_bound = (static_cast<unsigned __int128>(1) << 127) - 1;
+	return clan::decode<__int128, unsigned __int128>(data, length, type, format, scale, true, positive_bound);
+}
+#endif
+
+std::string PgsqlNumeric::to_text(const char *data, int length)
+{
+	if (length < 8)
+		throw Exception("Invalid binary numeric");
+	const int digit_count = PgsqlBinary::read_int16(data);
+	const int weight = PgsqlBinary::read_int16(data + 2);
+	const unsigned short sign = PgsqlBinary::read_uint16(data + 4);
+	const int display_scale = PgsqlBinary::read_uint16(data + 6);
+	if (sign == numeric_nan)
+		return "NaN";
+	if (sign == numeric_infinity)
+		return "Infinity";
+	if (sign == numeric_negative_infinity)
+		return "-Infinity";
+	if (digit_count < 0 || length != 8 + 2 * digit_count)
+		throw Exception("Invalid binary numeric");
+
+	auto group = [&](int i) { return i >= 0 && i < digit_count ? PgsqlBinary::read_int16(data + 8 + 2 * i) : 0; };
+	char buffer[8];
+	std::string text = sign == numeric_negative ? "-" : "";
+	if (weight < 0)
+	{
+		text += '0';
+	}
+	else
+	{
+		for (int i = 0; i <= weight; i++)
+		{
+			snprintf(buffer, sizeof(buffer), i == 0 ? "%d" : "%04d", group(i));
+			text += buffer;
+		}
+	}
+
+	if (display_scale > 0)
+	{
+		text += '.';
+		std::string fraction;
+		for (int i = weight + 1; static_cast<int>(fraction.size()) < display_scale; i++)
+		{
+			snprintf(buffer, sizeof(buffer), "%04d", group(i));
+			fraction += buffer;
+		}
+		text += fraction.substr(0, display_scale);
+	}
+	return text;
+}
+
+}; // namespace clan
@@ -0,0 +1,76 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <string>
+
+#include <libpq-fe.h>
+
+namespace clan
+{
+
+/// \brief NUMERIC values as fixed point integers, holding the value times 10^scale.
+///
+/// The binary format is a sign, a weight and base 10000 digits; it is
+/// converted without going through text or floating point. Values of the
+/// text format, and integers and floats of the binary format, are read too.
+/// Digits beyond scale are rounded half away from zero, like the server
+/// rounds numerics. Values out of range, NaN and infinities throw an
+/// Exception.
+namespace PgsqlNumeric
+{
+	/// \brief Largest scale accepted.
+	const int max_scale = 38;
+
+	/// \brief Binary NUMERIC of value / 10^scale, with scale as display scale.
+	std::string encode(long long value, int scale);
+
+	/// \brief Decode the value of a column of the given type and format (0 = text, 1 = binary).
+	long long decode_int64(const char *data, int length, Oid type, int format, int scale);
+
+	/// \brief Integer part of a NUMERIC (0 = text, 1 = binary), truncated toward zero like text_to_int.
+	long long truncate_int64(const char *data, int length, int format);
+
+#ifdef __SIZEOF_INT128__
+	std::string encode(__int128 value, int scale);
+	__int128 decode_int128(const char *data, int length, Oid type, int format, int scale);
+#endif
+
+	/// \brief Text form of a binary NUMERIC, as the server prints it.
+	std::string to_text(const char *data, int length);
+}
+
+}; // namespace clan
+
+/// \}
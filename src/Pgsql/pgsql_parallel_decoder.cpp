@@ -0,0 +1,346 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_parallel_decoder.h"
+#include "ClanLib/Database/db_reader.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/System/datetime.h"
+#include "pgsql_row_source.h"
+#include "pgsql_value.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <stdint.h>
+
+namespace clan
+{
+
+class PgsqlParallelDecoder_Impl
+{
+public:
+	PgsqlParallelDecoder_Impl(int thread_count, int chunk_rows);
+	~PgsqlParallelDecoder_Impl();
+
+	/// \brief Call fn for chunks 0 to chunk_count - 1 on all threads, and wait for all.
+	void run(int chunk_count, const std::function<void(int)> &fn);
+
+	int thread_count;
+	int chunk_rows;
+
+private:
+	void thread_main(int worker);
+	void work(int worker);
+
+	/// \brief Take a chunk from the front of the range of worker, or else from the back of another range.
+	bool take(int worker, int &chunk);
+
+	static uint64_t pack(uint32_t begin, uint32_t end) { return (uint64_t(end) << 32) | begin; }
+
+	std::vector<std::thread> threads;
+
+	/// \brief Chunks left to each worker, as begin and end packed in one word.
+	std::unique_ptr<std::atomic<uint64_t>[]> ranges;
+
+	/// \brief Serializes calls to run.
+	std::mutex run_mutex;
+
+	std::mutex mutex;
+	std::condition_variable wake_condition;
+	std::condition_variable done_condition;
+	unsigned int generation;
+	int pending_threads;
+	bool stopping;
+	const std::function<void(int)> *job;
+	std::atomic<bool> failed;
+	std::exception_ptr error;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlRowView Attributes:
+
+int PgsqlRowView::get_column_count() const
+{
+	return source->get_column_count();
+}
+
+int PgsqlRowView::get_name_index(const std::string &name) const
+{
+	return source->get_name_index(name);
+}
+
+bool PgsqlRowView::is_null(int index) const
+{
+	return source->is_null(row, index);
+}
+
+std::string PgsqlRowView::get_column_string(int index) const
+{
+	return source->get_value(row, index).to_string();
+}
+
+bool PgsqlRowView::get_column_bool(int index) const
+{
+	return source->get_value(row, index).to_bool();
+}
+
+int PgsqlRowView::get_column_int(int index) const
+{
+	return source->get_value(row, index).to_int();
+}
+
+unsigned int PgsqlRowView::get_column_uint(int index) const
+{
+	return source->get_value(row, index).to_uint();
+}
+
+long long PgsqlRowView::get_column_int64(int index) const
+{
+	return source->get_value(row, index).to_int64();
+}
+
+double PgsqlRowView::get_column_double(int index) const
+{
+	return source->get_value(row, index).to_double();
+}
+
+DateTime PgsqlRowView::get_column_datetime(int index) const
+{
+	return source->get_value(row, index).to_datetime();
+}
+
+DataBuffer PgsqlRowView::get_column_binary(int index) const
+{
+	return source->get_value(row, index).to_binary();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelDecoder Construction:
+
+PgsqlParallelDecoder::PgsqlParallelDecoder(int thread_count, int chunk_rows)
+: impl(std::make_shared<PgsqlParallelDecoder_Impl>(thread_count, chunk_rows))
+{
+}
+
+PgsqlParallelDecoder::~PgsqlParallelDecoder()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelDecoder Attributes:
+
+int PgsqlParallelDecoder::get_thread_count() const
+{
+	return impl->thread_count;
+}
+
+int PgsqlParallelDecoder::get_chunk_rows() const
+{
+	return impl->chunk_rows;
+}
+
+int PgsqlParallelDecoder::get_row_count(DBReader &reader)
+{
+	return PgsqlRowSource(reader).get_row_count();
+}
+
+int PgsqlParallelDecoder::get_chunk_count(int row_count) const
+{
+	return (row_count + impl->chunk_rows - 1) / impl->chunk_rows;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelDecoder Operations:
+
+void PgsqlParallelDecoder::for_each_chunk(DBReader &reader, const ChunkFunction &fn, std::vector<int> *completion_order)
+{
+	const PgsqlRowSource source(reader);
+	const int row_count = source.get_row_count();
+	const int chunk_rows = impl->chunk_rows;
+	const int chunk_count = get_chunk_count(row_count);
+
+	std::unique_ptr<std::atomic<int>[]> order;
+	std::atomic<int> completed(0);
+	if (completion_order)
+		order.reset(new std::atomic<int>[chunk_count]);
+
+	impl->run(chunk_count, [&](int chunk)
+	{
+		const int first = chunk * chunk_rows;
+		fn(chunk, PgsqlRowView(&source, first), std::min(chunk_rows, row_count - first));
+		if (completion_order)
+			order[completed++] = chunk;
+	});
+
+	if (completion_order)
+	{
+		completion_order->resize(chunk_count);
+		for (int i = 0; i < chunk_count; i++)
+			(*completion_order)[i] = order[i];
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelDecoder_Impl Construction:
+
+PgsqlParallelDecoder_Impl::PgsqlParallelDecoder_Impl(int thread_count, int chunk_rows)
+: thread_count(thread_count), chunk_rows(chunk_rows), generation(0), pending_threads(0), stopping(false), job(nullptr), failed(false)
+{
+	if (this->thread_count <= 0)
+		this->thread_count = std::max(1u, std::thread::hardware_concurrency());
+	if (chunk_rows < 1)
+		throw Exception("Chunks must hold at least one row");
+
+	ranges.reset(new std::atomic<uint64_t>[this->thread_count]);
+	for (int i = 0; i < this->thread_count; i++)
+		ranges[i] = 0;
+
+	// Worker 0 is the thread calling run
+	for (int i = 1; i < this->thread_count; i++)
+		threads.push_back(std::thread(&PgsqlParallelDecoder_Impl::thread_main, this, i));
+}
+
+PgsqlParallelDecoder_Impl::~PgsqlParallelDecoder_Impl()
+{
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wake_condition.notify_all();
+	for (auto &thread : threads)
+		thread.join();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelDecoder_Impl Operations:
+
+void PgsqlParallelDecoder_Impl::run(int chunk_count, const std::function<void(int)> &fn)
+{
+	std::unique_lock<std::mutex> run_lock(run_mutex);
+
+	// Deal the chunks out in contiguous blocks, so each thread mostly reads neighbour rows
+	for (int i = 0; i < thread_count; i++)
+		ranges[i] = pack(uint64_t(chunk_count) * i / thread_count, uint64_t(chunk_count) * (i + 1) / thread_count);
+
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		job = &fn;
+		failed = false;
+		error = nullptr;
+		pending_threads = threads.size();
+		generation++;
+	}
+	wake_condition.notify_all();
+
+	work(0);
+
+	std::unique_lock<std::mutex> lock(mutex);
+	done_condition.wait(lock, [&]() { return pending_threads == 0; });
+	job = nullptr;
+	if (error)
+		std::rethrow_exception(error);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelDecoder_Impl Implementation:
+
+void PgsqlParallelDecoder_Impl::thread_main(int worker)
+{
+	unsigned int seen_generation = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wake_condition.wait(lock, [&]() { return stopping || generation != seen_generation; });
+			if (stopping)
+				return;
+			seen_generation = generation;
+		}
+
+		work(worker);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		if (--pending_threads == 0)
+			done_condition.notify_all();
+	}
+}
+
+void PgsqlParallelDecoder_Impl::work(int worker)
+{
+	int chunk;
+	while (!failed && take(worker, chunk))
+	{
+		try
+		{
+			(*job)(chunk);
+		}
+		catch (...)
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			if (!error)
+				error = std::current_exception();
+			failed = true;
+		}
+	}
+}
+
+bool PgsqlParallelDecoder_Impl::take(int worker, int &chunk)
+{
+	uint64_t range = ranges[worker];
+	while (uint32_t(range) < uint32_t(range >> 32))
+	{
+		if (ranges[worker].compare_exchange_weak(range, range + 1))
+		{
+			chunk = uint32_t(range);
+			return true;
+		}
+	}
+
+	// Ranges only shrink, so one pass over the others finds any chunk left
+	for (int i = 1; i < thread_count; i++)
+	{
+		std::atomic<uint64_t> &victim = ranges[(worker + i) % thread_count];
+		range = victim;
+		while (uint32_t(range) < uint32_t(range >> 32))
+		{
+			const uint32_t end = uint32_t(range >> 32) - 1;
+			if (victim.compare_exchange_weak(range, pack(uint32_t(range), end)))
+			{
+				chunk = end;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+}; // namespace clan
@@ -0,0 +1,267 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_parallel_scan.h"
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "ClanLib/Core/Text/string_format.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_reader_provider.h"
+#include "pgsql_result_snapshot.h"
+#include "pgsql_snapshot_reader_provider.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <thread>
+#include <exception>
+
+namespace clan
+{
+
+class PgsqlParallelScan_Impl
+{
+public:
+	PgsqlParallelScan_Impl(const std::string &connection_string, int connection_count);
+
+	int get_partition_count() const { return partitions.size(); }
+	void set_hash_partitions(const std::string &key, int count);
+	void set_range_partitions(const std::string &key, const std::vector<long long> &bounds);
+	void run(const std::string &query, const PgsqlParallelScan::PartitionHandler &handler);
+
+	std::vector<PgsqlConnection> connections;
+
+private:
+	/// \brief Start a repeatable read transaction on every connection used, all on the same snapshot.
+	void begin_transactions(int count, std::vector<DBTransaction> &transactions);
+
+	/// \brief Predicate selecting the rows of each partition.
+	std::vector<std::string> partitions;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelScan Construction:
+
+PgsqlParallelScan::PgsqlParallelScan(const std::string &connection_string, int connection_count)
+: impl(std::make_shared<PgsqlParallelScan_Impl>(connection_string, connection_count))
+{
+}
+
+PgsqlParallelScan::~PgsqlParallelScan()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelScan Attributes:
+
+int PgsqlParallelScan::get_connection_count() const
+{
+	return impl->connections.size();
+}
+
+int PgsqlParallelScan::get_partition_count() const
+{
+	return impl->get_partition_count();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelScan Operations:
+
+void PgsqlParallelScan::set_hash_partitions(const std::string &key, int count)
+{
+	impl->set_hash_partitions(key, count);
+}
+
+void PgsqlParallelScan::set_range_partitions(const std::string &key, const std::vector<long long> &bounds)
+{
+	impl->set_range_partitions(key, bounds);
+}
+
+void PgsqlParallelScan::run(const std::string &query, const PartitionHandler &handler)
+{
+	impl->run(query, handler);
+}
+
+std::vector<DBReader> PgsqlParallelScan::execute_readers(const std::string &query)
+{
+	// Results are received completely by the command, so the readers outlive the transactions
+	std::vector<DBReader> readers(impl->get_partition_count());
+	impl->run(query, [&](int partition, DBReader &reader) { readers[partition] = reader; });
+	return readers;
+}
+
+DBReader PgsqlParallelScan::execute_reader(const std::string &query)
+{
+	std::vector<DBReader> readers = execute_readers(query);
+
+	std::vector<PgsqlResultSnapshot::RowRef> rows;
+	const PGresult *layout = nullptr;
+	for (auto &reader : readers)
+	{
+		PgsqlReaderProvider *provider = static_cast<PgsqlReaderProvider*>(reader.get_provider());
+		if (provider->is_spilled())
+			throw Exception("A partition was spilled to disk; read the readers of execute_readers one by one instead");
+		const PGresult *result = provider->get_result();
+		layout = result;
+		for (int row = 0; row < PQntuples(result); row++)
+			rows.push_back(PgsqlResultSnapshot::RowRef(result, row));
+	}
+	return DBReader(new PgsqlSnapshotReaderProvider(PgsqlResultSnapshot::create(layout, rows)));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelScan_Impl Construction:
+
+PgsqlParallelScan_Impl::PgsqlParallelScan_Impl(const std::string &connection_string, int connection_count)
+{
+	if (connection_count < 1)
+		throw Exception("A parallel scan needs at least one connection");
+	for (int i = 0; i < connection_count; i++)
+	{
+		connections.push_back(PgsqlConnection(connection_string));
+		PgsqlConnectionProvider::from_connection(connections.back()); // Readers must hold complete results
+	}
+	set_hash_partitions("", 1);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelScan_Impl Operations:
+
+void PgsqlParallelScan_Impl::set_hash_partitions(const std::string &key, int count)
+{
+	if (count < 1)
+		throw Exception("A parallel scan needs at least one partition");
+
+	partitions.clear();
+	if (count == 1)
+	{
+		partitions.push_back("TRUE");
+		return;
+	}
+	for (int i = 0; i < count; i++)
+		partitions.push_back(string_format("coalesce(mod(hashtext((%1)::text) & 2147483647, %2), 0) = %3", key, count, i));
+}
+
+void PgsqlParallelScan_Impl::set_range_partitions(const std::string &key, const std::vector<long long> &bounds)
+{
+	for (size_t i = 1; i < bounds.size(); i++)
+	{
+		if (bounds[i] <= bounds[i - 1])
+			throw Exception("Range partition bounds must be increasing");
+	}
+
+	partitions.clear();
+	if (bounds.empty())
+	{
+		partitions.push_back("TRUE");
+		return;
+	}
+	partitions.push_back(string_format("((%1) < %2 OR (%1) IS NULL)", key, bounds.front()));
+	for (size_t i = 1; i < bounds.size(); i++)
+		partitions.push_back(string_format("(%1) >= %2 AND (%1) < %3", key, bounds[i - 1], bounds[i]));
+	partitions.push_back(string_format("(%1) >= %2", key, bounds.back()));
+}
+
+void PgsqlParallelScan_Impl::run(const std::string &query, const PgsqlParallelScan::PartitionHandler &handler)
+{
+	// The query becomes a subquery, so a trailing semicolon must go
+	std::string subquery = query;
+	while (!subquery.empty() && (subquery.back() == ';' || isspace(static_cast<unsigned char>(subquery.back()))))
+		subquery.pop_back();
+
+	const int worker_count = std::min<int>(connections.size(), partitions.size());
+	std::vector<DBTransaction> transactions;
+	begin_transactions(worker_count, transactions);
+
+	std::atomic<int> next_partition(0);
+	std::atomic<bool> failed(false);
+	std::vector<std::exception_ptr> errors(worker_count);
+	auto worker = [&](int index)
+	{
+		try
+		{
+			PgsqlConnection &connection = connections[index];
+			while (!failed)
+			{
+				const int partition = next_partition++;
+				if (partition >= (int)partitions.size())
+					break;
+
+				DBCommand command = connection.create_command(string_format(
+					"SELECT * FROM (%1) AS clanpgsql_partition WHERE %2", subquery, partitions[partition]));
+				DBReader reader = connection.execute_reader(command);
+				handler(partition, reader);
+			}
+		}
+		catch (...)
+		{
+			errors[index] = std::current_exception();
+			failed = true;
+		}
+	};
+
+	// The first connection is served by the calling thread
+	std::vector<std::thread> threads;
+	for (int i = 1; i < worker_count; i++)
+		threads.push_back(std::thread(worker, i));
+	worker(0);
+	for (auto &thread : threads)
+		thread.join();
+
+	for (auto &error : errors)
+	{
+		if (error)
+			std::rethrow_exception(error); // Transactions are rolled back by their destructors
+	}
+	for (auto &transaction : transactions)
+		transaction.commit();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlParallelScan_Impl Implementation:
+
+void PgsqlParallelScan_Impl::begin_transactions(int count, std::vector<DBTransaction> &transactions)
+{
+	transactions.push_back(connections[0].begin_transaction(PgsqlConnection::repeatable_read, DBTransaction::default_transaction));
+	if (count == 1)
+		return;
+
+	DBCommand export_snapshot = connections[0].create_command("SELECT pg_export_snapshot()");
+	const std::string snapshot = connections[0].execute_scalar_string(export_snapshot);
+	if (snapshot.find_first_not_of("0123456789ABCDEFabcdef-") != std::string::npos)
+		throw Exception(string_format("Unexpected snapshot identifier %1", snapshot));
+
+	for (int i = 1; i < count; i++)
+	{
+		transactions.push_back(connections[i].begin_transaction(PgsqlConnection::repeatable_read, DBTransaction::default_transaction));
+		DBCommand import_snapshot = connections[i].create_command(string_format("SET TRANSACTION SNAPSHOT '%1'", snapshot));
+		connections[i].execute_non_query(import_snapshot);
+	}
+}
+
+}; // namespace clan
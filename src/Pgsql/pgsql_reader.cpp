@@ -0,0 +1,182 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_reader.h"
+#include "ClanLib/Pgsql/pgsql_json_view.h"
+#include "pgsql_reader_provider.h"
+#include "pgsql_snapshot_reader_provider.h"
+#include "pgsql_value.h"
+#include "ClanLib/Core/System/databuffer.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReader Construction:
+
+PgsqlReader::PgsqlReader(DBReader &reader)
+: reader(reader), provider(dynamic_cast<PgsqlReaderProvider*>(reader.get_provider())),
+  snapshot_provider(dynamic_cast<PgsqlSnapshotReaderProvider*>(reader.get_provider()))
+{
+	// Cached readers hold a single result
+	if (!provider && !snapshot_provider)
+		throw Exception("PgsqlReader only accepts readers created by a PgsqlConnection using the libpq engine");
+}
+
+PgsqlReader::~PgsqlReader()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReader Attributes:
+
+int PgsqlReader::get_result_count() const
+{
+	return provider ? provider->get_result_count() : 1;
+}
+
+std::vector<short> PgsqlReader::get_column_int16_array(int index) const
+{
+	return get_column_value(index).to_array<short>();
+}
+
+std::vector<int> PgsqlReader::get_column_int_array(int index) const
+{
+	return get_column_value(index).to_array<int>();
+}
+
+std::vector<long long> PgsqlReader::get_column_int64_array(int index) const
+{
+	return get_column_value(index).to_array<long long>();
+}
+
+std::vector<float> PgsqlReader::get_column_float_array(int index) const
+{
+	return get_column_value(index).to_array<float>();
+}
+
+std::vector<double> PgsqlReader::get_column_double_array(int index) const
+{
+	return get_column_value(index).to_array<double>();
+}
+
+std::vector<std::string> PgsqlReader::get_column_string_array(int index) const
+{
+	return get_column_value(index).to_array<std::string>();
+}
+
+std::vector<DataBuffer> PgsqlReader::get_column_binary_array(int index) const
+{
+	return get_column_value(index).to_array<DataBuffer>();
+}
+
+long long PgsqlReader::get_column_fixed(int index, int scale) const
+{
+	return get_column_value(index).to_fixed(scale);
+}
+
+#ifdef __SIZEOF_INT128__
+__int128 PgsqlReader::get_column_fixed128(int index, int scale) const
+{
+	return get_column_value(index).to_fixed128(scale);
+}
+#endif
+
+PgsqlJsonView PgsqlReader::get_column_json(int index) const
+{
+	return PgsqlJsonView(get_column_value(index).to_string());
+}
+
+Vec2d PgsqlReader::get_column_point(int index) const
+{
+	return get_column_value(index).to_point();
+}
+
+LineSegment2d PgsqlReader::get_column_line_segment(int index) const
+{
+	return get_column_value(index).to_line_segment();
+}
+
+Rectd PgsqlReader::get_column_box(int index) const
+{
+	return get_column_value(index).to_box();
+}
+
+Circled PgsqlReader::get_column_circle(int index) const
+{
+	return get_column_value(index).to_circle();
+}
+
+std::vector<Vec2d> PgsqlReader::get_column_polygon(int index) const
+{
+	return get_column_value(index).to_polygon();
+}
+
+std::vector<Vec2d> PgsqlReader::get_column_point_array(int index) const
+{
+	return get_column_value(index).to_array<Vec2d>();
+}
+
+std::vector<LineSegment2d> PgsqlReader::get_column_line_segment_array(int index) const
+{
+	return get_column_value(index).to_array<LineSegment2d>();
+}
+
+std::vector<Rectd> PgsqlReader::get_column_box_array(int index) const
+{
+	return get_column_value(index).to_array<Rectd>();
+}
+
+std::vector<Circled> PgsqlReader::get_column_circle_array(int index) const
+{
+	return get_column_value(index).to_array<Circled>();
+}
+
+std::vector<std::vector<Vec2d> > PgsqlReader::get_column_polygon_array(int index) const
+{
+	return get_column_value(index).to_array<std::vector<Vec2d> >();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReader Operations:
+
+bool PgsqlReader::next_result()
+{
+	return provider ? provider->next_result() : false;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReader Implementation:
+
+PgsqlValue PgsqlReader::get_column_value(int index) const
+{
+	return provider ? provider->get_column_value(index) : snapshot_provider->get_column_value(index);
+}
+
+}; // namespace clan
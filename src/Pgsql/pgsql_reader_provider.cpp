@@ -32,12 +32,17 @@
 #include "pgsql_reader_provider.h"
 #include "pgsql_connection_provider.h"
 #include "pgsql_command_provider.h"
+#include "pgsql_value.h"
+#include "pgsql_result_spill.h"
+#include "pg_type.h"
+#include "ClanLib/Pgsql/pgsql_exception.h"
 #include "ClanLib/Core/System/databuffer.h"
 #include "ClanLib/Core/System/datetime.h"
 #include "ClanLib/Core/Text/string_help.h"
 #include "ClanLib/Core/Text/string_format.h"
 #include <libpq-fe.h>
 #include <cstdlib>
+#include <cstring>
 
 namespace clan
 {
@@ -45,35 +50,32 @@ namespace clan
 // PgsqlReaderProvider Construction:
 
 PgsqlReaderProvider::PgsqlReaderProvider(PgsqlConnectionProvider *connection, PgsqlCommandProvider *command)
-    : connection(connection), command(command), closed(false), current_row(-1)
+    : connection(connection), command(command), result_index(0), result(nullptr), type(ResultType::EMPTY_RESULT), closed(false), current_row(-1), nb_rows(0),
+      spill(nullptr), spill_position(0), receiving_rows(false), last_result_memory(0), charged_memory(0)
 {
-	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
-	std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(command->exec_command(), deleter);
-	result = result_uniqueptr.get();
-
-	switch (PQresultStatus(result))
+	try
 	{
-	case PGRES_EMPTY_QUERY:
-		throw Exception("Empty query");
-
-	case PGRES_COMMAND_OK:
-		type = ResultType::EMPTY_RESULT;
-		break;
-	case PGRES_TUPLES_OK:
-		type = ResultType::TUPLES_RESULT;
-		break;
+		const bool streaming = connection->has_result_budget() && command->can_stream();
+		if (streaming)
+			exec_streaming();
+		else
+			command->exec_command(results);
+		for (PGresult *result : results)
+			check_result(result);
 
-	case PGRES_NONFATAL_ERROR:
-		throw Exception("Server gave an unknow answer");
-
-	case PGRES_FATAL_ERROR:
-		throw Exception(PQerrorMessage(connection->db));
+		// Cursors returned by a function only live until the end of the transaction
+		if (command->get_fetch_cursors() && connection->in_transaction() && spills.empty())
+			fetch_cursors();
 
-	default:
-		throw Exception(StringHelp::text_to_local8(PQresultErrorMessage(result)));
+		if (!streaming && connection->has_result_budget())
+			charge_results();
 	}
-	nb_rows = PQntuples(result);
-	result_uniqueptr.release();
+	catch (...)
+	{
+		close();
+		throw;
+	}
+	select_result(0);
 }
 
 PgsqlReaderProvider::~PgsqlReaderProvider()
@@ -107,67 +109,63 @@ int PgsqlReaderProvider::get_name_index(const std::string &name) const
 
 std::string PgsqlReaderProvider::get_column_string(int index) const
 {
-	const char *const str = PQgetvalue(result, current_row, index);
-	if (str != nullptr)
-		return str;
-	else
-		throw ("Index out of range");
+	return get_column_value(index).to_string();
 }
 
 bool PgsqlReaderProvider::get_column_bool(int index) const
 {
-	const std::string value = get_column_string(index);
-	return StringHelp::text_to_bool(value);
+	return get_column_value(index).to_bool();
 }
 
 char PgsqlReaderProvider::get_column_char(int index) const
 {
-	const std::string value = get_column_string(index);
-	return static_cast<int>(StringHelp::text_to_int(value));
+	return static_cast<int>(get_column_value(index).to_int());
 }
 
 unsigned char PgsqlReaderProvider::get_column_uchar(int index) const
 {
-	const std::string value = get_column_string(index);
-	return static_cast<unsigned char>(StringHelp::text_to_uint(value));
+	return static_cast<unsigned char>(get_column_value(index).to_uint());
 }
 
 int PgsqlReaderProvider::get_column_int(int index) const
 {
-	const std::string value = get_column_string(index);
-	return StringHelp::text_to_int(value);
+	return get_column_value(index).to_int();
 }
 
 unsigned int PgsqlReaderProvider::get_column_uint(int index) const
 {
-	const std::string value = get_column_string(index);
-	return StringHelp::text_to_uint(value);
+	return get_column_value(index).to_uint();
 }
 
 double PgsqlReaderProvider::get_column_double(int index) const
 {
-	const std::string value = get_column_string(index);
-	return StringHelp::text_to_double(value);
+	return get_column_value(index).to_double();
 }
 
 DateTime PgsqlReaderProvider::get_column_datetime(int index) const
 {
-	return PgsqlConnectionProvider::from_sql_datetime(get_column_string(index));
+	return get_column_value(index).to_datetime();
 }
 
 DataBuffer PgsqlReaderProvider::get_column_binary(int index) const
 {
-	const unsigned char *const str = reinterpret_cast<unsigned char*>(PQgetvalue(result, current_row, index));
+	return get_column_value(index).to_binary();
+}
+
+PgsqlValue PgsqlReaderProvider::get_column_value(int index) const
+{
+	if (spill)
+	{
+		if (current_row < 0 || current_row >= nb_rows || index < 0 || index >= (int)spill_values.size())
+			throw Exception("Index out of range");
+		const char *value = spill_values[index];
+		return PgsqlValue(value ? value : "", spill_lengths[index], PQftype(result, index), PQfformat(result, index));
+	}
+
+	const char *const str = PQgetvalue(result, current_row, index);
 	if (str == nullptr)
 		throw ("Index out of range");
-	size_t length;
-	auto deleter = [](void *ptr) {if (ptr) {free(ptr);} };
-	std::unique_ptr<unsigned char, decltype(deleter)> value(PQunescapeBytea(
-				str,
-				&length),
-				deleter);
-	DataBuffer output(value.get(), length);
-	return output;
+	return PgsqlValue(str, PQgetlength(result, current_row, index), PQftype(result, index), PQfformat(result, index));
 }
 
 /////////////////////////////////////////////////////////////////////////////
@@ -178,6 +176,8 @@ bool PgsqlReaderProvider::retrieve_row()
 	if (1 + current_row >= nb_rows)
 		return false;
 	++current_row;
+	if (spill)
+		spill->read_row(spill_position, spill_values, spill_lengths);
 	return true;
 }
 
@@ -185,13 +185,223 @@ void PgsqlReaderProvider::close()
 {
 	if (!closed)
 	{
-		PQclear(result);
+		for (PGresult *result : results)
+			PQclear(result);
+		results.clear();
+		spills.clear();
+		spill = nullptr;
+		connection->release_result_memory(charged_memory);
+		charged_memory = 0;
 		closed = true;
 		result = nullptr;
+		nb_rows = 0;
 	}
 }
 
+bool PgsqlReaderProvider::next_result()
+{
+	if (closed || result_index + 1 >= results.size())
+		return false;
+	select_result(result_index + 1);
+	return true;
+}
+
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlReaderProvider Implementation:
 
+void PgsqlReaderProvider::check_result(const PGresult *result) const
+{
+	switch (PQresultStatus(result))
+	{
+	case PGRES_EMPTY_QUERY:
+		throw Exception("Empty query");
+
+	case PGRES_COMMAND_OK:
+	case PGRES_TUPLES_OK:
+		break;
+
+	case PGRES_NONFATAL_ERROR:
+		throw Exception("Server gave an unknow answer");
+
+	case PGRES_FATAL_ERROR:
+	default:
+		connection->throw_result_error(result);
+	}
+}
+
+void PgsqlReaderProvider::fetch_cursors()
+{
+	std::vector<PGresult*> expanded;
+	try
+	{
+		for (size_t index = 0; index < results.size(); index++)
+		{
+			PGresult *current = results[index];
+			bool cursors = PQresultStatus(current) == PGRES_TUPLES_OK && PQnfields(current) > 0;
+			for (int column = 0; cursors && column < PQnfields(current); column++)
+				cursors = PQftype(current, column) == REFCURSOROID;
+
+			if (!cursors)
+			{
+				expanded.push_back(current);
+				results[index] = nullptr;
+				continue;
+			}
+
+			for (int row = 0; row < PQntuples(current); row++)
+			{
+				for (int column = 0; column < PQnfields(current); column++)
+				{
+					if (PQgetisnull(current, row, column))
+						continue;
+
+					const char *name = PQgetvalue(current, row, column);
+					auto deleter = [](char *ptr) {if (ptr) {PQfreemem(ptr);} };
+					std::unique_ptr<char, decltype(deleter)> identifier(PQescapeIdentifier(connection->db, name, std::strlen(name)), deleter);
+					if (!identifier)
+						connection->throw_result_error(nullptr);
+
+					const std::string fetch = std::string("FETCH ALL FROM ") + identifier.get();
+					expanded.push_back(PQexec(connection->db, fetch.c_str()));
+					check_result(expanded.back());
+				}
+			}
+		}
+	}
+	catch (...)
+	{
+		for (PGresult *result : expanded)
+			PQclear(result);
+		throw;
+	}
+
+	for (PGresult *result : results)
+		PQclear(result);
+	results.swap(expanded);
+}
+
+void PgsqlReaderProvider::select_result(size_t index)
+{
+	result_index = index;
+	result = index < results.size() ? results[index] : nullptr;
+	type = PQresultStatus(result) == PGRES_TUPLES_OK ? ResultType::TUPLES_RESULT : ResultType::EMPTY_RESULT;
+	current_row = -1;
+	nb_rows = PQntuples(result);
+
+	auto it = spills.find(index);
+	spill = it != spills.end() ? it->second.get() : nullptr;
+	if (spill)
+	{
+		nb_rows = spill->get_row_count();
+		spill_position = 0;
+		spill_values.resize(PQnfields(result));
+		spill_lengths.resize(PQnfields(result));
+	}
+}
+
+void PgsqlReaderProvider::exec_streaming()
+{
+	command->exec_streaming([this](PGresult *received) { receive_streamed(received); });
+
+	for (auto &it : spills)
+		it.second->finish();
+}
+
+void PgsqlReaderProvider::receive_streamed(PGresult *received)
+{
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> row(received, deleter);
+
+	const ExecStatusType status = PQresultStatus(received);
+	if (status != PGRES_SINGLE_TUPLE)
+	{
+		// The empty result ending the rows of a statement is dropped; errors and results without rows are kept
+		if (!receiving_rows || status != PGRES_TUPLES_OK)
+			results.push_back(row.release());
+		receiving_rows = false;
+		return;
+	}
+
+	if (!receiving_rows)
+	{
+		// The first row of a statement starts its result
+		results.push_back(PQcopyResult(received, PG_COPYRES_ATTRS));
+		if (!results.back())
+			throw Exception("Out of memory");
+		receiving_rows = true;
+		last_result_memory = 0;
+	}
+
+	PGresult *merged = results.back();
+	auto it = spills.find(results.size() - 1);
+	if (it != spills.end())
+	{
+		it->second->append_row(received, 0);
+		return;
+	}
+
+	const int merged_row = PQntuples(merged);
+	for (int column = 0; column < PQnfields(received); column++)
+	{
+		const bool is_null = PQgetisnull(received, 0, column) != 0;
+		if (!PQsetvalue(merged, merged_row, column, is_null ? nullptr : PQgetvalue(received, 0, column), is_null ? -1 : PQgetlength(received, 0, column)))
+			throw Exception("Out of memory");
+	}
+
+	const size_t memory = PQresultMemorySize(merged);
+	if (memory > last_result_memory)
+	{
+		if (!connection->charge_result_memory(memory - last_result_memory))
+		{
+			if (connection->get_result_overflow() == PgsqlConnection::throw_on_overflow)
+				throw PgsqlResultTooLargeException(connection->get_result_budget());
+			spill_result(results.size() - 1);
+			connection->release_result_memory(last_result_memory);
+			charged_memory -= last_result_memory;
+			last_result_memory = 0;
+			return;
+		}
+		charged_memory += memory - last_result_memory;
+		last_result_memory = memory;
+	}
+}
+
+void PgsqlReaderProvider::charge_results()
+{
+	// The results are already in memory: a result over budget is released right away
+	for (size_t index = 0; index < results.size(); index++)
+	{
+		if (PQresultStatus(results[index]) != PGRES_TUPLES_OK)
+			continue;
+
+		const size_t memory = PQresultMemorySize(results[index]);
+		if (connection->charge_result_memory(memory))
+		{
+			charged_memory += memory;
+			continue;
+		}
+
+		if (connection->get_result_overflow() == PgsqlConnection::throw_on_overflow)
+			throw PgsqlResultTooLargeException(connection->get_result_budget());
+		spill_result(index);
+		spills[index]->finish();
+	}
+}
+
+void PgsqlReaderProvider::spill_result(size_t index)
+{
+	PGresult *whole = results[index];
+	std::shared_ptr<PgsqlResultSpill> spill_file(new PgsqlResultSpill(connection->get_spill_directory()));
+	for (int row = 0; row < PQntuples(whole); row++)
+		spill_file->append_row(whole, row);
+
+	// Keep the column layout only
+	PGresult *layout = PQcopyResult(whole, PG_COPYRES_ATTRS);
+	if (!layout)
+		throw Exception("Out of memory");
+	PQclear(whole);
+	results[index] = layout;
+	spills[index] = spill_file;
+}
+
 }; //namespace clan
@@ -33,6 +33,10 @@
 #pragma once
 
 
+#include <map>
+#include <memory>
+#include <vector>
+
 #include <libpq-fe.h>
 #include "ClanLib/Database/db_reader_provider.h"
 
@@ -41,6 +45,8 @@ namespace clan
 
 class PgsqlCommandProvider;
 class PgsqlConnectionProvider;
+class PgsqlValue;
+class PgsqlResultSpill;
 
 /// \brief Pgsql database reader provider.
 class PgsqlReaderProvider : public DBReaderProvider
@@ -67,6 +73,18 @@ public:
 	double get_column_double(int index) const;
 	DateTime get_column_datetime(int index) const;
 	DataBuffer get_column_binary(int index) const;
+
+	/// \brief Returns the field of the current row, in the format of the result.
+	PgsqlValue get_column_value(int index) const;
+
+	/// \brief Returns the current result; it has no rows if they were spilled to disk.
+	const PGresult *get_result() const { return result; }
+
+	/// \brief True if the rows of the current result were moved to a temporary file (see PgsqlConnection::set_result_memory_budget).
+	bool is_spilled() const { return spill != nullptr; }
+
+	/// \brief Number of results returned by the command.
+	int get_result_count() const { return results.size(); }
 /// \}
 
 /// \name Operations
@@ -74,6 +92,9 @@ public:
 public:
 	bool retrieve_row();
 	void close();
+
+	/// \brief Move to the next result of the command; returns false after the last one.
+	bool next_result();
 /// \}
 
 /// \name Implementation
@@ -85,14 +106,45 @@ private:
 		TUPLES_RESULT
 	};
 
+	/// \brief Throw if result holds an error.
+	void check_result(const PGresult *result) const;
+
+	/// \brief Replace results made only of refcursor values by the rows of these cursors.
+	void fetch_cursors();
+
+	void select_result(size_t index);
+
+	/// \brief Receive the results row by row, within the memory budgets of the connection.
+	void exec_streaming();
+
+	/// \brief Add a result given by exec_streaming, merging single rows into the result of their statement.
+	void receive_streamed(PGresult *received);
+
+	/// \brief Charge the results received whole to the memory budgets, spilling or throwing for those over them.
+	void charge_results();
+
+	/// \brief Move the rows of a result to a temporary file, leaving its column layout in results.
+	void spill_result(size_t index);
+
 	PgsqlConnectionProvider *connection;
 	PgsqlCommandProvider *command;
+	std::vector<PGresult*> results;
+	size_t result_index;
 	PGresult *result;
 	ResultType type;
 	bool closed;
 	int current_row;
 	int nb_rows;
 
+	std::map<size_t, std::shared_ptr<PgsqlResultSpill> > spills;
+	PgsqlResultSpill *spill;
+	size_t spill_position;
+	std::vector<const char*> spill_values;
+	std::vector<int> spill_lengths;
+	bool receiving_rows;
+	size_t last_result_memory; // Charged for the result being received
+	size_t charged_memory;
+
 	friend class PgsqlConnectionProvider;
 	friend class PgsqlCommandProvider;
 /// \}
@@ -0,0 +1,807 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_replication_stream.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_wire_connection.h"
+#include "pgsql_binary.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+#include <map>
+#include <algorithm>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+namespace clan
+{
+
+namespace
+{
+	/// \brief Bounds checked reading of a pgoutput message.
+	class MessageReader
+	{
+	public:
+		MessageReader(const char *data, size_t size) : pos(data), end(data + size) { }
+
+		bool at_end() const { return pos == end; }
+		uint8_t read_uint8() { return static_cast<uint8_t>(*require(1)); }
+		uint16_t read_uint16() { return PgsqlBinary::read_uint16(require(2)); }
+		uint32_t read_uint32() { return PgsqlBinary::read_uint32(require(4)); }
+		uint64_t read_uint64() { return PgsqlBinary::read_uint64(require(8)); }
+
+		std::string read_bytes(size_t length)
+		{
+			const char *data = require(length);
+			return std::string(data, length);
+		}
+
+		std::string read_string()
+		{
+			const char *terminator = static_cast<const char*>(memchr(pos, 0, end - pos));
+			if (!terminator)
+				throw Exception("Invalid logical replication message");
+			std::string text(pos, terminator);
+			pos = terminator + 1;
+			return text;
+		}
+
+	private:
+		const char *require(size_t length)
+		{
+			if (static_cast<size_t>(end - pos) < length)
+				throw Exception("Invalid logical replication message");
+			const char *data = pos;
+			pos += length;
+			return data;
+		}
+
+		const char *pos;
+		const char *end;
+	};
+
+	/// \brief Microseconds since 2000-01-01, the epoch of the server.
+	long long get_server_time()
+	{
+		const long long unix_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		return unix_time - 946684800000000LL;
+	}
+}
+
+class PgsqlReplicationStream_Impl
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	PgsqlReplicationStream_Impl(PgsqlConnection::Parameters parameters, const std::string &slot_name, const std::vector<std::string> &publications);
+
+	~PgsqlReplicationStream_Impl()
+	{
+		stop();
+	}
+
+	std::string create_slot(bool temporary);
+	void drop_slot();
+	void start_replication(unsigned long long start_lsn);
+	void confirm(unsigned long long lsn);
+	int process(int timeout_ms);
+	void start();
+	void stop();
+
+	std::unique_ptr<PgsqlConnectionProvider> provider;
+	std::string slot_name;
+	std::vector<std::string> publications;
+
+	PgsqlReplicationStream::Handler handler;
+	PgsqlReplicationStream::ErrorHandler error_handler;
+	bool auto_confirm;
+	int status_interval;
+
+	std::atomic<bool> running;
+
+	/// \brief Guards the connection and every member below.
+	mutable std::mutex mutex;
+
+	bool streaming;
+	bool copying;
+	bool restart_needed;
+
+	unsigned long long received_lsn;
+	unsigned long long decoded_lsn;
+	unsigned long long confirmed_lsn;
+	unsigned long long server_lsn;
+	Clock::time_point last_status;
+
+	std::map<unsigned int, std::shared_ptr<const PgsqlReplicationRelation> > relations;
+	std::unique_ptr<PgsqlReplicationTransaction> current;
+	std::vector<PgsqlReplicationTransaction> completed;
+
+private:
+	bool ensure_streaming();
+	void send_start(unsigned long long start_lsn);
+	void stop_copy();
+	bool receive();
+	void decode(MessageReader &message);
+	void decode_relation(MessageReader &message);
+	void decode_tuple(MessageReader &message, std::vector<PgsqlReplicationChange::Value> &values);
+	PgsqlReplicationChange &add_change(PgsqlReplicationChange::Type type, unsigned int relation_id);
+	void send_status(bool request_reply);
+	bool is_status_due() const;
+	void run();
+
+	std::thread thread;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReplicationRelation Attributes:
+
+int PgsqlReplicationRelation::get_column_index(const std::string &name) const
+{
+	for (size_t i = 0; i < columns.size(); i++)
+	{
+		if (columns[i].name == name)
+			return i;
+	}
+	return -1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReplicationStream Construction:
+
+PgsqlReplicationStream::PgsqlReplicationStream(const PgsqlConnection::Parameters &parameters, const std::string &slot_name, const std::vector<std::string> &publications)
+: impl(std::make_shared<PgsqlReplicationStream_Impl>(parameters, slot_name, publications))
+{
+}
+
+PgsqlReplicationStream::PgsqlReplicationStream(const std::string &connection_string, const std::string &slot_name, const std::vector<std::string> &publications)
+: impl(std::make_shared<PgsqlReplicationStream_Impl>(PgsqlWireConnection::parse_connection_string(connection_string), slot_name, publications))
+{
+}
+
+PgsqlReplicationStream::~PgsqlReplicationStream()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReplicationStream Attributes:
+
+bool PgsqlReplicationStream::is_streaming() const
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	return impl->streaming;
+}
+
+bool PgsqlReplicationStream::is_running() const
+{
+	return impl->running;
+}
+
+unsigned long long PgsqlReplicationStream::get_received_lsn() const
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	return impl->received_lsn;
+}
+
+unsigned long long PgsqlReplicationStream::get_confirmed_lsn() const
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	return impl->confirmed_lsn;
+}
+
+std::string PgsqlReplicationStream::lsn_to_text(unsigned long long lsn)
+{
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%X/%X", static_cast<unsigned int>(lsn >> 32), static_cast<unsigned int>(lsn));
+	return buffer;
+}
+
+unsigned long long PgsqlReplicationStream::text_to_lsn(const std::string &text)
+{
+	const size_t slash = text.find('/');
+	if (slash == 0 || slash == std::string::npos || slash + 1 == text.size() ||
+		text.find_first_not_of("0123456789abcdefABCDEF/") != std::string::npos || slash != text.rfind('/'))
+		throw Exception("Invalid log position: " + text);
+
+	const unsigned long long high = std::strtoull(text.substr(0, slash).c_str(), nullptr, 16);
+	const unsigned long long low = std::strtoull(text.substr(slash + 1).c_str(), nullptr, 16);
+	if (high > 0xffffffffULL || low > 0xffffffffULL)
+		throw Exception("Invalid log position: " + text);
+	return (high << 32) | low;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReplicationStream Operations:
+
+void PgsqlReplicationStream::set_handler(const Handler &handler)
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	impl->handler = handler;
+}
+
+void PgsqlReplicationStream::set_error_handler(const ErrorHandler &handler)
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	impl->error_handler = handler;
+}
+
+void PgsqlReplicationStream::set_auto_confirm(bool enable)
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	impl->auto_confirm = enable;
+}
+
+void PgsqlReplicationStream::set_status_interval(int interval_ms)
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	impl->status_interval = interval_ms > 0 ? interval_ms : 1;
+}
+
+std::string PgsqlReplicationStream::create_slot(bool temporary)
+{
+	return impl->create_slot(temporary);
+}
+
+void PgsqlReplicationStream::drop_slot()
+{
+	impl->drop_slot();
+}
+
+void PgsqlReplicationStream::start_replication(unsigned long long start_lsn)
+{
+	impl->start_replication(start_lsn);
+}
+
+void PgsqlReplicationStream::confirm(unsigned long long lsn)
+{
+	impl->confirm(lsn);
+}
+
+int PgsqlReplicationStream::process(int timeout_ms)
+{
+	return impl->process(timeout_ms);
+}
+
+void PgsqlReplicationStream::start()
+{
+	impl->start();
+}
+
+void PgsqlReplicationStream::stop()
+{
+	impl->stop();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReplicationStream_Impl Construction:
+
+PgsqlReplicationStream_Impl::PgsqlReplicationStream_Impl(PgsqlConnection::Parameters parameters, const std::string &slot_name, const std::vector<std::string> &publications)
+: slot_name(slot_name), publications(publications), auto_confirm(true), status_interval(10000), running(false),
+  streaming(false), copying(false), restart_needed(false), received_lsn(0), decoded_lsn(0), confirmed_lsn(0), server_lsn(0)
+{
+	if (slot_name.empty() || slot_name.find_first_not_of("abcdefghijklmnopqrstuvwxyz0123456789_") != std::string::npos)
+		throw Exception("Invalid replication slot name: " + slot_name);
+	if (publications.empty())
+		throw Exception("PgsqlReplicationStream needs at least one publication");
+
+	parameters["replication"] = "database";
+	provider.reset(new PgsqlConnectionProvider(parameters));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReplicationStream_Impl Operations:
+
+std::string PgsqlReplicationStream_Impl::create_slot(bool temporary)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (copying)
+		throw Exception("A replication slot can't be created while streaming");
+
+	std::string sql = string_format("CREATE_REPLICATION_SLOT \"%1\" %2LOGICAL pgoutput EXPORT_SNAPSHOT", slot_name, temporary ? "TEMPORARY " : "");
+	PGresult *result = PQexec(provider->get_handle(), sql.c_str());
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(result, deleter);
+	if (PQresultStatus(result) != PGRES_TUPLES_OK || PQntuples(result) != 1 || PQnfields(result) < 3)
+		provider->throw_result_error(result);
+
+	confirmed_lsn = PgsqlReplicationStream::text_to_lsn(PQgetvalue(result, 0, 1));
+	return PQgetvalue(result, 0, 2);
+}
+
+void PgsqlReplicationStream_Impl::drop_slot()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (copying)
+		stop_copy();
+	streaming = false;
+
+	std::string sql = string_format("DROP_REPLICATION_SLOT \"%1\"", slot_name);
+	PGresult *result = PQexec(provider->get_handle(), sql.c_str());
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(result, deleter);
+	if (PQresultStatus(result) != PGRES_COMMAND_OK)
+		provider->throw_result_error(result);
+}
+
+void PgsqlReplicationStream_Impl::start_replication(unsigned long long start_lsn)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (copying)
+		stop_copy();
+	streaming = false;
+
+	if (start_lsn)
+	{
+		received_lsn = start_lsn;
+		confirmed_lsn = std::max(confirmed_lsn, start_lsn);
+	}
+	send_start(start_lsn);
+	streaming = true;
+}
+
+void PgsqlReplicationStream_Impl::confirm(unsigned long long lsn)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (lsn <= confirmed_lsn)
+		return;
+	confirmed_lsn = lsn;
+	if (copying && PQstatus(provider->get_handle()) == CONNECTION_OK)
+		send_status(false);
+}
+
+int PgsqlReplicationStream_Impl::process(int timeout_ms)
+{
+	std::vector<PgsqlReplicationTransaction> transactions;
+	PgsqlReplicationStream::Handler transaction_handler;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		if (!ensure_streaming())
+			return 0;
+
+		const Clock::time_point deadline = Clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+		while (receive() && completed.empty() && timeout_ms != 0)
+		{
+			if (is_status_due())
+				send_status(false);
+
+			const Clock::time_point now = Clock::now();
+			if (timeout_ms > 0 && now >= deadline)
+				break;
+
+			// Wake up in time for the next status report
+			Clock::time_point wake_up = last_status + std::chrono::milliseconds(status_interval);
+			if (timeout_ms > 0)
+				wake_up = std::min(wake_up, deadline);
+			const int wait_ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(wake_up - now).count()) + 1;
+
+			// Do not hold the lock while sleeping on the socket
+			lock.unlock();
+			provider->wait_for_input(wait_ms);
+			lock.lock();
+			if (!copying || !PQconsumeInput(provider->get_handle()))
+				break;
+		}
+
+		if (copying && PQstatus(provider->get_handle()) == CONNECTION_OK && is_status_due())
+			send_status(false);
+
+		transactions.swap(completed);
+		transaction_handler = handler;
+	}
+
+	for (auto &transaction : transactions)
+	{
+		try
+		{
+			if (transaction_handler)
+				transaction_handler(transaction);
+		}
+		catch (...)
+		{
+			// The transactions left were already read; receive them again
+			std::lock_guard<std::mutex> lock(mutex);
+			restart_needed = true;
+			throw;
+		}
+
+		std::lock_guard<std::mutex> lock(mutex);
+		received_lsn = transaction.end_lsn;
+		if (auto_confirm)
+			confirmed_lsn = std::max(confirmed_lsn, transaction.end_lsn);
+	}
+	return transactions.size();
+}
+
+void PgsqlReplicationStream_Impl::start()
+{
+	if (running)
+		return;
+	running = true;
+	thread = std::thread(&PgsqlReplicationStream_Impl::run, this);
+}
+
+void PgsqlReplicationStream_Impl::stop()
+{
+	running = false;
+	if (thread.joinable())
+		thread.join();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlReplicationStream_Impl Implementation:
+
+void PgsqlReplicationStream_Impl::run()
+{
+	int retry_delay_ms = 250;
+	while (running)
+	{
+		Exception error("");
+		try
+		{
+			// Short slices, so that stop() does not wait for a change
+			process(250);
+			retry_delay_ms = 250;
+			continue;
+		}
+		catch (const Exception &e)
+		{
+			error = e;
+		}
+		catch (const std::exception &e)
+		{
+			error = Exception(e.what());
+		}
+		catch (...)
+		{
+			error = Exception("Unknown exception in replication stream");
+		}
+
+		PgsqlReplicationStream::ErrorHandler handle_error;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			handle_error = error_handler;
+		}
+		if (handle_error)
+		{
+			try
+			{
+				handle_error(error);
+			}
+			catch (...)
+			{
+			}
+		}
+
+		// Wait in short slices too, doubling the delay while errors go on
+		for (int waited = 0; running && waited < retry_delay_ms; waited += 50)
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+		retry_delay_ms = std::min(retry_delay_ms * 2, 10000);
+	}
+}
+
+bool PgsqlReplicationStream_Impl::ensure_streaming()
+{
+	if (!streaming)
+		throw Exception("PgsqlReplicationStream::start_replication must be called first");
+
+	PGconn *db = provider->get_handle();
+	if (PQstatus(db) != CONNECTION_OK)
+	{
+		copying = false;
+		PQreset(db);
+		if (PQstatus(db) != CONNECTION_OK)
+			return false;
+		restart_needed = true;
+	}
+
+	if (restart_needed)
+	{
+		if (copying)
+			stop_copy();
+		send_start(std::max(received_lsn, confirmed_lsn));
+		restart_needed = false;
+	}
+	return true;
+}
+
+void PgsqlReplicationStream_Impl::send_start(unsigned long long start_lsn)
+{
+	PGconn *db = provider->get_handle();
+
+	std::string names;
+	for (auto &publication : publications)
+	{
+		char *identifier = PQescapeIdentifier(db, publication.data(), publication.size());
+		if (!identifier)
+			throw Exception(PQerrorMessage(db));
+		if (!names.empty())
+			names += ",";
+		names += identifier;
+		PQfreemem(identifier);
+	}
+	char *literal = PQescapeLiteral(db, names.data(), names.size());
+	if (!literal)
+		throw Exception(PQerrorMessage(db));
+	std::string sql = string_format("START_REPLICATION SLOT \"%1\" LOGICAL %2 (proto_version '1', publication_names %3)",
+		slot_name, PgsqlReplicationStream::lsn_to_text(start_lsn), literal);
+	PQfreemem(literal);
+
+	PGresult *result = PQexec(db, sql.c_str());
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(result, deleter);
+	if (PQresultStatus(result) != PGRES_COPY_BOTH)
+		provider->throw_result_error(result);
+
+	// Relations are described again by the server after each start
+	copying = true;
+	relations.clear();
+	current.reset();
+	completed.clear();
+	decoded_lsn = std::max(received_lsn, start_lsn);
+	last_status = Clock::now();
+}
+
+void PgsqlReplicationStream_Impl::stop_copy()
+{
+	PGconn *db = provider->get_handle();
+	copying = false;
+	if (PQstatus(db) != CONNECTION_OK)
+		return;
+
+	// The server answers with its own CopyDone, then completes the command
+	PQputCopyEnd(db, nullptr);
+	char *buffer = nullptr;
+	while (PQgetCopyData(db, &buffer, 0) > 0)
+		PQfreemem(buffer);
+	for (PGresult *result = PQgetResult(db); result; result = PQgetResult(db))
+		PQclear(result);
+}
+
+bool PgsqlReplicationStream_Impl::receive()
+{
+	PGconn *db = provider->get_handle();
+	while (true)
+	{
+		char *buffer = nullptr;
+		const int size = PQgetCopyData(db, &buffer, 1);
+		if (size == 0)
+			return true;
+
+		if (size < 0)
+		{
+			copying = false;
+			if (PQstatus(db) != CONNECTION_OK)
+				return false; // Reconnected by the next process()
+
+			// The server ended the stream
+			restart_needed = true;
+			PGresult *result = PQgetResult(db);
+			auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+			std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(result, deleter);
+			for (PGresult *next = PQgetResult(db); next; next = PQgetResult(db))
+				PQclear(next);
+			if (result && PQresultStatus(result) == PGRES_FATAL_ERROR)
+				provider->throw_result_error(result);
+			return false;
+		}
+
+		auto deleter = [](char *ptr) {if (ptr) {PQfreemem(ptr);} };
+		std::unique_ptr<char, decltype(deleter)> buffer_uniqueptr(buffer, deleter);
+		MessageReader message(buffer, size);
+		const uint8_t type = message.read_uint8();
+		if (type == 'w')
+		{
+			message.read_uint64(); // Start of the data
+			server_lsn = std::max(server_lsn, static_cast<unsigned long long>(message.read_uint64()));
+			message.read_uint64(); // Send time
+			decode(message);
+		}
+		else if (type == 'k')
+		{
+			server_lsn = std::max(server_lsn, static_cast<unsigned long long>(message.read_uint64()));
+			message.read_uint64(); // Send time
+			const bool reply_requested = message.read_uint8() != 0;
+
+			// Nothing in flight: the log up to here holds no change for us, let the server free it
+			if (!current && completed.empty() && confirmed_lsn >= decoded_lsn)
+				confirmed_lsn = std::max(confirmed_lsn, server_lsn);
+			if (reply_requested)
+				send_status(false);
+		}
+	}
+}
+
+void PgsqlReplicationStream_Impl::decode(MessageReader &message)
+{
+	const uint8_t type = message.read_uint8();
+	switch (type)
+	{
+	case 'B':
+		current.reset(new PgsqlReplicationTransaction());
+		current->commit_lsn = message.read_uint64();
+		current->commit_time = message.read_uint64();
+		current->xid = message.read_uint32();
+		break;
+
+	case 'C':
+		if (!current)
+			throw Exception("Invalid logical replication message");
+		message.read_uint8(); // Flags
+		current->commit_lsn = message.read_uint64();
+		current->end_lsn = message.read_uint64();
+		current->commit_time = message.read_uint64();
+		decoded_lsn = current->end_lsn;
+		completed.push_back(std::move(*current));
+		current.reset();
+		break;
+
+	case 'R':
+		decode_relation(message);
+		break;
+
+	case 'I':
+	{
+		PgsqlReplicationChange &change = add_change(PgsqlReplicationChange::row_inserted, message.read_uint32());
+		if (message.read_uint8() != 'N')
+			throw Exception("Invalid logical replication message");
+		decode_tuple(message, change.new_values);
+		break;
+	}
+
+	case 'U':
+	{
+		PgsqlReplicationChange &change = add_change(PgsqlReplicationChange::row_updated, message.read_uint32());
+		uint8_t tuple_type = message.read_uint8();
+		if (tuple_type == 'K' || tuple_type == 'O')
+		{
+			change.old_values_are_key = tuple_type == 'K';
+			decode_tuple(message, change.old_values);
+			tuple_type = message.read_uint8();
+		}
+		if (tuple_type != 'N')
+			throw Exception("Invalid logical replication message");
+		decode_tuple(message, change.new_values);
+		break;
+	}
+
+	case 'D':
+	{
+		PgsqlReplicationChange &change = add_change(PgsqlReplicationChange::row_deleted, message.read_uint32());
+		const uint8_t tuple_type = message.read_uint8();
+		if (tuple_type != 'K' && tuple_type != 'O')
+			throw Exception("Invalid logical replication message");
+		change.old_values_are_key = tuple_type == 'K';
+		decode_tuple(message, change.old_values);
+		break;
+	}
+
+	case 'T':
+	{
+		const uint32_t count = message.read_uint32();
+		message.read_uint8(); // CASCADE and RESTART IDENTITY flags
+		for (uint32_t i = 0; i < count; i++)
+			add_change(PgsqlReplicationChange::table_truncated, message.read_uint32());
+		break;
+	}
+
+	default:
+		// Origins, types and logical messages are of no use to a replica
+		break;
+	}
+}
+
+void PgsqlReplicationStream_Impl::decode_relation(MessageReader &message)
+{
+	std::shared_ptr<PgsqlReplicationRelation> relation = std::make_shared<PgsqlReplicationRelation>();
+	relation->relation_id = message.read_uint32();
+	relation->schema = message.read_string();
+	relation->table = message.read_string();
+	relation->replica_identity = message.read_uint8();
+
+	relation->columns.resize(message.read_uint16());
+	for (auto &column : relation->columns)
+	{
+		column.is_key = (message.read_uint8() & 1) != 0;
+		column.name = message.read_string();
+		column.type = message.read_uint32();
+		column.type_modifier = static_cast<int32_t>(message.read_uint32());
+	}
+
+	// Changes already decoded keep the previous description
+	relations[relation->relation_id] = relation;
+}
+
+void PgsqlReplicationStream_Impl::decode_tuple(MessageReader &message, std::vector<PgsqlReplicationChange::Value> &values)
+{
+	values.resize(message.read_uint16());
+	for (auto &value : values)
+	{
+		const uint8_t kind = message.read_uint8();
+		if (kind == 'n')
+		{
+			value.state = PgsqlReplicationChange::value_null;
+		}
+		else if (kind == 'u')
+		{
+			value.state = PgsqlReplicationChange::value_unchanged;
+		}
+		else if (kind == 't')
+		{
+			value.state = PgsqlReplicationChange::value_text;
+			value.text = message.read_bytes(message.read_uint32());
+		}
+		else
+		{
+			throw Exception("Invalid logical replication message");
+		}
+	}
+}
+
+PgsqlReplicationChange &PgsqlReplicationStream_Impl::add_change(PgsqlReplicationChange::Type type, unsigned int relation_id)
+{
+	if (!current)
+		throw Exception("Invalid logical replication message");
+
+	auto it = relations.find(relation_id);
+	if (it == relations.end())
+		throw Exception(string_format("Logical replication change for the unknown relation %1", relation_id));
+
+	current->changes.push_back(PgsqlReplicationChange());
+	PgsqlReplicationChange &change = current->changes.back();
+	change.type = type;
+	change.relation = it->second;
+	return change;
+}
+
+void PgsqlReplicationStream_Impl::send_status(bool request_reply)
+{
+	char message[34];
+	message[0] = 'r';
+	PgsqlBinary::store_uint64(message + 1, std::max(server_lsn, decoded_lsn)); // Received
+	PgsqlBinary::store_uint64(message + 9, confirmed_lsn); // Flushed
+	PgsqlBinary::store_uint64(message + 17, confirmed_lsn); // Applied
+	PgsqlBinary::store_uint64(message + 25, static_cast<uint64_t>(get_server_time()));
+	message[33] = request_reply ? 1 : 0;
+
+	PGconn *db = provider->get_handle();
+	if (PQputCopyData(db, message, sizeof(message)) != 1 || PQflush(db) != 0)
+		throw Exception(PQerrorMessage(db));
+	last_status = Clock::now();
+}
+
+bool PgsqlReplicationStream_Impl::is_status_due() const
+{
+	return Clock::now() - last_status >= std::chrono::milliseconds(status_interval);
+}
+
+}; // namespace clan
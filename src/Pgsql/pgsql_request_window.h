@@ -0,0 +1,169 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <exception>
+
+namespace clan
+{
+
+/// \brief Gathers the requests of concurrent callers into batches run one at a time.
+///
+/// The first caller finding no open batch opens one and leads it: it waits
+/// up to window_ms, or until max_size requests joined, then runs the batch.
+/// Requests keep joining the batch while the previous one runs. The other
+/// callers wait for the batch they joined to be done.
+///
+/// Content holds the requests of a batch and what running it gave back.
+template<typename Content>
+class PgsqlRequestWindow
+{
+/// \name Construction
+/// \{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Batch
+	{
+		Batch() : closed(false), done(false) { }
+
+		Content content;
+		std::exception_ptr error;
+		Clock::time_point opened;
+		bool closed;
+		bool done;
+	};
+
+	PgsqlRequestWindow(int max_size, int window_ms)
+	: batch_count(0), max_size(max_size > 0 ? max_size : 1), window_ms(window_ms)
+	{
+	}
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	/// \brief Guards the batches and batch_count; owners may guard their own counters with it too.
+	std::mutex mutex;
+
+	/// \brief Number of batches run.
+	unsigned int batch_count;
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	/// \brief Add a request to the open batch and return that batch once it was run.
+	///
+	/// \param lock = Lock on mutex, released on return
+	/// \param join = Called with mutex locked to add the request; returns the number of requests of the batch
+	/// \param run = Called by the leader without mutex locked; an exception it throws is kept in the batch error
+	std::shared_ptr<Batch> submit(std::unique_lock<std::mutex> &lock, const std::function<size_t(Content &)> &join, const std::function<void(Content &)> &run)
+	{
+		std::shared_ptr<Batch> batch = open_batch;
+		const bool leader = !batch;
+		if (leader)
+		{
+			batch = std::make_shared<Batch>();
+			batch->opened = Clock::now();
+			open_batch = batch;
+		}
+		if (join(batch->content) >= static_cast<size_t>(max_size))
+		{
+			// Full: later requests go to a new batch
+			batch->closed = true;
+			open_batch.reset();
+			batch_event.notify_all();
+		}
+
+		if (leader)
+		{
+			if (window_ms > 0)
+				batch_event.wait_until(lock, batch->opened + std::chrono::milliseconds(window_ms), [&] { return batch->closed; });
+
+			// Requests keep joining the batch while the previous one runs
+			lock.unlock();
+			std::unique_lock<std::mutex> run_lock(run_mutex);
+			lock.lock();
+			if (open_batch == batch)
+				open_batch.reset();
+			batch->closed = true;
+			batch_count++;
+			lock.unlock();
+
+			// Nobody else touches a closed batch until it is done
+			try
+			{
+				run(batch->content);
+			}
+			catch (...)
+			{
+				batch->error = std::current_exception();
+			}
+			run_lock.unlock();
+
+			lock.lock();
+			batch->done = true;
+			batch_event.notify_all();
+		}
+		else
+		{
+			batch_event.wait(lock, [&] { return batch->done; });
+		}
+		lock.unlock();
+		return batch;
+	}
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	int max_size;
+	int window_ms;
+	std::condition_variable batch_event;
+	std::shared_ptr<Batch> open_batch;
+
+	/// \brief Held while a batch runs.
+	std::mutex run_mutex;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
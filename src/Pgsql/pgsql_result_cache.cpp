@@ -0,0 +1,287 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_result_cache.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_command_provider.h"
+#include "pgsql_reader_provider.h"
+#include "pgsql_result_snapshot.h"
+#include "pgsql_snapshot_reader_provider.h"
+
+#include <list>
+#include <map>
+#include <set>
+#include <mutex>
+#include <chrono>
+
+namespace clan
+{
+
+class PgsqlResultCache_Impl
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Entry
+	{
+		std::shared_ptr<const PgsqlResultSnapshot> snapshot;
+		Clock::time_point expires;
+		std::vector<std::string> tags;
+		std::list<std::string>::iterator lru_position;
+	};
+
+	PgsqlResultCache_Impl(size_t memory_budget)
+	: memory_budget(memory_budget), memory_usage(0), hit_count(0), miss_count(0), invalidate_all_count(0)
+	{
+	}
+
+	std::shared_ptr<const PgsqlResultSnapshot> find(const std::string &key);
+
+	/// \brief Changes each time an entry with one of tags may be invalidated.
+	unsigned long long get_generation(const std::vector<std::string> &tags) const;
+	unsigned long long generation_of(const std::vector<std::string> &tags) const;
+
+	/// \brief Store the entry, unless it was invalidated since generation was read.
+	void insert(const std::string &key, const std::shared_ptr<const PgsqlResultSnapshot> &snapshot, int ttl_ms, const std::vector<std::string> &tags, unsigned long long generation);
+	void erase(std::map<std::string, Entry>::iterator it);
+	void evict();
+
+	mutable std::mutex mutex;
+	size_t memory_budget;
+	size_t memory_usage;
+	unsigned int hit_count;
+	unsigned int miss_count;
+
+	std::map<std::string, Entry> entries;
+	std::map<std::string, std::set<std::string> > tag_index;
+
+	/// \brief Invalidations of each tag and of the whole cache, for the queries still running.
+	std::map<std::string, unsigned long long> tag_generations;
+	unsigned long long invalidate_all_count;
+
+	/// \brief Most recently used key first.
+	std::list<std::string> lru;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultCache Construction:
+
+PgsqlResultCache::PgsqlResultCache(size_t memory_budget)
+: impl(std::make_shared<PgsqlResultCache_Impl>(memory_budget))
+{
+}
+
+PgsqlResultCache::~PgsqlResultCache()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultCache Attributes:
+
+size_t PgsqlResultCache::get_memory_usage() const
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	return impl->memory_usage;
+}
+
+int PgsqlResultCache::get_entry_count() const
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	return impl->entries.size();
+}
+
+unsigned int PgsqlResultCache::get_hit_count() const
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	return impl->hit_count;
+}
+
+unsigned int PgsqlResultCache::get_miss_count() const
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	return impl->miss_count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultCache Operations:
+
+DBReader PgsqlResultCache::execute_reader(DBConnection &connection, DBCommand &command, int ttl_ms, const std::vector<std::string> &tags)
+{
+	PgsqlConnectionProvider *connection_provider = dynamic_cast<PgsqlConnectionProvider*>(connection.get_provider());
+	PgsqlCommandProvider *command_provider = dynamic_cast<PgsqlCommandProvider*>(command.get_provider());
+	if (!connection_provider || !command_provider)
+		throw Exception("PgsqlResultCache only accepts PostgreSQL connections and commands");
+
+	// Rows read inside a transaction may not be committed, or visible to other sessions
+	if (connection_provider->in_transaction() || PQtransactionStatus(connection_provider->get_handle()) != PQTRANS_IDLE)
+		return connection.execute_reader(command);
+
+	// The session key keeps apart callers with another role, search_path or TimeZone
+	std::string key = connection_provider->get_server_key();
+	key += connection_provider->get_session_key();
+	key += command_provider->get_cache_key();
+
+	std::shared_ptr<const PgsqlResultSnapshot> snapshot = impl->find(key);
+	if (!snapshot)
+	{
+		// The query runs without holding the cache lock
+		const unsigned long long generation = impl->get_generation(tags);
+		std::unique_ptr<PgsqlReaderProvider> reader(new PgsqlReaderProvider(connection_provider, command_provider));
+		if (reader->is_spilled())
+			throw PgsqlResultTooLargeException(connection_provider->get_result_budget());
+		snapshot = PgsqlResultSnapshot::create(reader->get_result());
+		impl->insert(key, snapshot, ttl_ms, tags, generation);
+	}
+	return DBReader(new PgsqlSnapshotReaderProvider(snapshot));
+}
+
+void PgsqlResultCache::invalidate_tag(const std::string &tag)
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	impl->tag_generations[tag]++;
+	auto tagged = impl->tag_index.find(tag);
+	if (tagged == impl->tag_index.end())
+		return;
+
+	std::set<std::string> keys;
+	keys.swap(tagged->second);
+	for (auto &key : keys)
+	{
+		auto it = impl->entries.find(key);
+		if (it != impl->entries.end())
+			impl->erase(it);
+	}
+	impl->tag_index.erase(tag);
+}
+
+void PgsqlResultCache::invalidate_all()
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	impl->invalidate_all_count++;
+	impl->entries.clear();
+	impl->tag_index.clear();
+	impl->lru.clear();
+	impl->memory_usage = 0;
+}
+
+void PgsqlResultCache::set_memory_budget(size_t memory_budget)
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	impl->memory_budget = memory_budget;
+	impl->evict();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultCache_Impl Implementation:
+
+std::shared_ptr<const PgsqlResultSnapshot> PgsqlResultCache_Impl::find(const std::string &key)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	auto it = entries.find(key);
+	if (it != entries.end())
+	{
+		if (it->second.expires > Clock::now())
+		{
+			lru.splice(lru.begin(), lru, it->second.lru_position);
+			hit_count++;
+			return it->second.snapshot;
+		}
+		erase(it);
+	}
+	miss_count++;
+	return std::shared_ptr<const PgsqlResultSnapshot>();
+}
+
+unsigned long long PgsqlResultCache_Impl::get_generation(const std::vector<std::string> &tags) const
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return generation_of(tags);
+}
+
+unsigned long long PgsqlResultCache_Impl::generation_of(const std::vector<std::string> &tags) const
+{
+	// Generations only grow, so their sum changes whenever one of them does
+	unsigned long long generation = invalidate_all_count;
+	for (auto &tag : tags)
+	{
+		auto it = tag_generations.find(tag);
+		if (it != tag_generations.end())
+			generation += it->second;
+	}
+	return generation;
+}
+
+void PgsqlResultCache_Impl::insert(const std::string &key, const std::shared_ptr<const PgsqlResultSnapshot> &snapshot, int ttl_ms, const std::vector<std::string> &tags, unsigned long long generation)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (generation_of(tags) != generation || snapshot->get_memory_size() > memory_budget || ttl_ms <= 0)
+		return;
+
+	// Another thread may have stored the same key meanwhile
+	auto it = entries.find(key);
+	if (it != entries.end())
+		erase(it);
+
+	lru.push_front(key);
+	Entry &entry = entries[key];
+	entry.snapshot = snapshot;
+	entry.expires = Clock::now() + std::chrono::milliseconds(ttl_ms);
+	entry.tags = tags;
+	entry.lru_position = lru.begin();
+	for (auto &tag : tags)
+		tag_index[tag].insert(key);
+	memory_usage += snapshot->get_memory_size();
+
+	evict();
+}
+
+void PgsqlResultCache_Impl::erase(std::map<std::string, Entry>::iterator it)
+{
+	for (auto &tag : it->second.tags)
+	{
+		auto tagged = tag_index.find(tag);
+		if (tagged != tag_index.end())
+		{
+			tagged->second.erase(it->first);
+			if (tagged->second.empty())
+				tag_index.erase(tagged);
+		}
+	}
+	memory_usage -= it->second.snapshot->get_memory_size();
+	lru.erase(it->second.lru_position);
+	entries.erase(it);
+}
+
+void PgsqlResultCache_Impl::evict()
+{
+	while (memory_usage > memory_budget && !lru.empty())
+		erase(entries.find(lru.back()));
+}
+
+}; // namespace clan
@@ -0,0 +1,244 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "pgsql_result_snapshot.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+#include <cstring>
+#include <stdint.h>
+
+namespace clan
+{
+
+struct PgsqlResultSnapshot::Header
+{
+	char magic[8];
+	uint32_t column_count;
+	uint32_t reserved;
+	uint64_t row_count;
+	uint64_t size;
+};
+
+struct PgsqlResultSnapshot::Column
+{
+	uint64_t name_offset;
+	uint32_t name_length;
+	uint32_t type;
+	uint32_t format;
+	uint32_t reserved;
+	uint64_t offsets_offset;
+	uint64_t nulls_offset;
+};
+
+static const char snapshot_magic[8] = { 'C', 'L', 'P', 'G', 'S', 'N', 'P', '1' };
+
+static inline size_t align8(size_t value)
+{
+	return (value + 7) & ~size_t(7);
+}
+
+/// \brief Tells if length bytes at offset lie within size bytes, without overflowing.
+static inline bool fits(uint64_t offset, uint64_t length, uint64_t size)
+{
+	return offset <= size && length <= size - offset;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultSnapshot Construction:
+
+std::shared_ptr<const PgsqlResultSnapshot> PgsqlResultSnapshot::create(const PGresult *result)
+{
+	const int rows = PQntuples(result);
+	std::vector<RowRef> refs;
+	refs.reserve(rows);
+	for (int row = 0; row < rows; row++)
+		refs.push_back(RowRef(result, row));
+	return create(result, refs);
+}
+
+std::shared_ptr<const PgsqlResultSnapshot> PgsqlResultSnapshot::create(const PGresult *layout, const std::vector<RowRef> &rows)
+{
+	const int columns = PQnfields(layout);
+	const size_t row_count = rows.size();
+
+	// First pass: compute the size of each section
+	size_t names_size = 0;
+	for (int column = 0; column < columns; column++)
+		names_size += std::strlen(PQfname(layout, column)) + 1;
+
+	size_t values_size = 0;
+	for (auto &ref : rows)
+		for (int column = 0; column < columns; column++)
+			values_size += PQgetlength(ref.result, ref.row, column) + 1;
+
+	const size_t column_table_offset = sizeof(Header);
+	const size_t names_offset = column_table_offset + columns * sizeof(Column);
+	const size_t per_column_size = align8((row_count + 1) * sizeof(uint64_t)) + align8(row_count);
+	const size_t first_column_offset = align8(names_offset + names_size);
+	const size_t values_offset = first_column_offset + columns * per_column_size;
+	const size_t total_size = align8(values_offset + values_size);
+
+	auto storage = std::make_shared<std::vector<uint64_t> >(total_size / sizeof(uint64_t));
+	char *data = reinterpret_cast<char*>(storage->data());
+
+	// Second pass: fill them
+	Header *header = reinterpret_cast<Header*>(data);
+	std::memcpy(header->magic, snapshot_magic, sizeof(snapshot_magic));
+	header->column_count = columns;
+	header->reserved = 0;
+	header->row_count = row_count;
+	header->size = total_size;
+
+	size_t name_position = names_offset;
+	size_t value_position = values_offset;
+	for (int column = 0; column < columns; column++)
+	{
+		Column *entry = reinterpret_cast<Column*>(data + column_table_offset) + column;
+		const char *name = PQfname(layout, column);
+		entry->name_offset = name_position;
+		entry->name_length = std::strlen(name);
+		entry->type = PQftype(layout, column);
+		entry->format = PQfformat(layout, column);
+		entry->reserved = 0;
+		entry->offsets_offset = first_column_offset + column * per_column_size;
+		entry->nulls_offset = entry->offsets_offset + align8((row_count + 1) * sizeof(uint64_t));
+		std::memcpy(data + name_position, name, entry->name_length + 1);
+		name_position += entry->name_length + 1;
+
+		uint64_t *offsets = reinterpret_cast<uint64_t*>(data + entry->offsets_offset);
+		char *nulls = data + entry->nulls_offset;
+		for (size_t row = 0; row < row_count; row++)
+		{
+			const RowRef &ref = rows[row];
+			const int length = PQgetlength(ref.result, ref.row, column);
+			offsets[row] = value_position;
+			nulls[row] = PQgetisnull(ref.result, ref.row, column) ? 1 : 0;
+			std::memcpy(data + value_position, PQgetvalue(ref.result, ref.row, column), length);
+			data[value_position + length] = '\0';
+			value_position += length + 1;
+		}
+		offsets[row_count] = value_position;
+	}
+
+	return std::make_shared<PgsqlResultSnapshot>(data, total_size, storage);
+}
+
+PgsqlResultSnapshot::PgsqlResultSnapshot(const char *data, size_t size, const std::shared_ptr<void> &owner)
+: owner(owner), data(data), size(size), column_count(0), row_count(0)
+{
+	const Header *header = reinterpret_cast<const Header*>(data);
+	if (size < sizeof(Header) || std::memcmp(header->magic, snapshot_magic, sizeof(snapshot_magic)) != 0)
+		throw Exception("Invalid result snapshot");
+	if (header->size != size || header->row_count > 0x7fffffff || header->column_count > 0x7fffffff)
+		throw Exception("Truncated result snapshot");
+	if (!fits(sizeof(Header), uint64_t(header->column_count) * sizeof(Column), size))
+		throw Exception("Truncated result snapshot");
+
+	column_count = header->column_count;
+	row_count = header->row_count;
+
+	// Check every offset, so that reading any value stays within the buffer
+	for (int column = 0; column < column_count; column++)
+	{
+		const Column &entry = get_column(column);
+		if (!fits(entry.name_offset, entry.name_length, size)
+			|| entry.offsets_offset % sizeof(uint64_t) != 0
+			|| !fits(entry.offsets_offset, (header->row_count + 1) * sizeof(uint64_t), size)
+			|| !fits(entry.nulls_offset, header->row_count, size))
+			throw Exception("Truncated result snapshot");
+
+		const uint64_t *offsets = reinterpret_cast<const uint64_t*>(data + entry.offsets_offset);
+		for (int row = 0; row < row_count; row++)
+		{
+			// Each value is followed by a null terminator
+			if (offsets[row] >= offsets[row + 1] || !fits(offsets[row], offsets[row + 1] - offsets[row], size))
+				throw Exception("Truncated result snapshot");
+		}
+		if (offsets[row_count] > size)
+			throw Exception("Truncated result snapshot");
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultSnapshot Attributes:
+
+std::string PgsqlResultSnapshot::get_column_name(int column) const
+{
+	const Column &entry = get_column(column);
+	return std::string(data + entry.name_offset, entry.name_length);
+}
+
+int PgsqlResultSnapshot::get_name_index(const std::string &name) const
+{
+	for (int column = 0; column < column_count; column++)
+	{
+		const Column &entry = get_column(column);
+		if (name.size() == entry.name_length && name.compare(0, name.size(), data + entry.name_offset, entry.name_length) == 0)
+			return column;
+	}
+	throw Exception(string_format("No such column name %1", name));
+}
+
+Oid PgsqlResultSnapshot::get_column_type(int column) const
+{
+	return get_column(column).type;
+}
+
+int PgsqlResultSnapshot::get_column_format(int column) const
+{
+	return get_column(column).format;
+}
+
+bool PgsqlResultSnapshot::is_null(int row, int column) const
+{
+	if (row < 0 || row >= row_count)
+		throw Exception("Row out of range");
+	return data[get_column(column).nulls_offset + row] != 0;
+}
+
+const char *PgsqlResultSnapshot::get_value(int row, int column, size_t &length) const
+{
+	if (row < 0 || row >= row_count)
+		throw Exception("Row out of range");
+	const uint64_t *offsets = reinterpret_cast<const uint64_t*>(data + get_column(column).offsets_offset);
+	length = offsets[row + 1] - offsets[row] - 1;
+	return data + offsets[row];
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultSnapshot Implementation:
+
+const PgsqlResultSnapshot::Column &PgsqlResultSnapshot::get_column(int column) const
+{
+	if (column < 0 || column >= column_count)
+		throw Exception("Index out of range");
+	return reinterpret_cast<const Column*>(data + sizeof(Header))[column];
+}
+
+}; // namespace clan
@@ -0,0 +1,120 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+
+namespace clan
+{
+
+/// \brief Immutable copy of a query result, stored column by column in one flat buffer.
+///
+/// A snapshot owns no libpq resources and is never modified once built,
+/// so one instance can be read from several threads at the same time.
+///
+/// Layout of the buffer (native endianness, every section 8 bytes aligned):
+///   header      magic "CLPGSNP1", column count (u32), reserved (u32), row count (u64), total size (u64)
+///   columns     per column: name offset (u64), name length (u32), type oid (u32),
+///               format (u32), reserved (u32), offsets offset (u64), nulls offset (u64)
+///   names       column names
+///   per column  row count + 1 value offsets (u64), then one null flag byte per row
+///   values      all values, each followed by a '\0'
+class PgsqlResultSnapshot
+{
+/// \name Construction
+/// \{
+public:
+	/// \brief Reference to one row of a PGresult.
+	struct RowRef
+	{
+		RowRef(const PGresult *result, int row) : result(result), row(row) { }
+		const PGresult *result;
+		int row;
+	};
+
+	/// \brief Copy every row of result.
+	static std::shared_ptr<const PgsqlResultSnapshot> create(const PGresult *result);
+
+	/// \brief Copy the given rows, which must all have the column layout of layout.
+	static std::shared_ptr<const PgsqlResultSnapshot> create(const PGresult *layout, const std::vector<RowRef> &rows);
+
+	/// \brief Use an existing buffer, kept alive by owner.
+	///
+	/// Throws if data does not hold a valid snapshot.
+	PgsqlResultSnapshot(const char *data, size_t size, const std::shared_ptr<void> &owner);
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	int get_column_count() const { return column_count; }
+	int get_row_count() const { return row_count; }
+	std::string get_column_name(int column) const;
+	int get_name_index(const std::string &name) const;
+	Oid get_column_type(int column) const;
+	int get_column_format(int column) const;
+	bool is_null(int row, int column) const;
+
+	/// \brief Returns a pointer to the value, terminated by a '\0' not counted in length.
+	const char *get_value(int row, int column, size_t &length) const;
+
+	/// \brief Size of the flat buffer.
+	size_t get_memory_size() const { return size; }
+
+	/// \brief The flat buffer itself.
+	const char *get_data() const { return data; }
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	struct Header;
+	struct Column;
+
+	const Column &get_column(int column) const;
+
+	std::shared_ptr<void> owner;
+	const char *data;
+	size_t size;
+	int column_count;
+	int row_count;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
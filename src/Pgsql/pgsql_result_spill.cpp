@@ -0,0 +1,186 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "pgsql_result_spill.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <stdint.h>
+
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultSpill Construction:
+
+PgsqlResultSpill::PgsqlResultSpill(const std::string &directory)
+: view(nullptr), file_size(0), row_count(0)
+{
+#ifdef WIN32
+	char path[MAX_PATH];
+	char temp_directory[MAX_PATH];
+	if (directory.empty())
+		GetTempPathA(MAX_PATH, temp_directory);
+	else
+		strncpy_s(temp_directory, directory.c_str(), _TRUNCATE);
+	if (!GetTempFileNameA(temp_directory, "cpg", 0, path))
+		throw Exception("Unable to create a temporary file for a large result");
+	file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+		FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+	mapping = nullptr;
+	if (file == INVALID_HANDLE_VALUE)
+		throw Exception("Unable to create a temporary file for a large result");
+#else
+	std::string path = directory;
+	if (path.empty())
+	{
+		const char *tmpdir = std::getenv("TMPDIR");
+		path = tmpdir && *tmpdir ? tmpdir : "/tmp";
+	}
+	path += "/clanpgsql_spill_XXXXXX";
+	file = mkstemp(&path[0]);
+	if (file < 0)
+		throw Exception("Unable to create a temporary file for a large result in " + path);
+	unlink(path.c_str()); // Deleted as soon as it is closed, even if the process dies
+#endif
+	pending.reserve(1024 * 1024);
+}
+
+PgsqlResultSpill::~PgsqlResultSpill()
+{
+#ifdef WIN32
+	if (view)
+		UnmapViewOfFile(view);
+	if (mapping)
+		CloseHandle(mapping);
+	CloseHandle(file);
+#else
+	if (view)
+		munmap(const_cast<char*>(view), file_size);
+	close(file);
+#endif
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultSpill Operations:
+
+void PgsqlResultSpill::append_row(const PGresult *result, int row)
+{
+	const int columns = PQnfields(result);
+	for (int column = 0; column < columns; column++)
+	{
+		const int32_t length = PQgetisnull(result, row, column) ? -1 : PQgetlength(result, row, column);
+		pending.append(reinterpret_cast<const char*>(&length), sizeof(length));
+		if (length >= 0)
+			pending.append(PQgetvalue(result, row, column), length + 1);
+	}
+	row_count++;
+
+	if (pending.size() >= 1024 * 1024)
+		write_pending();
+}
+
+void PgsqlResultSpill::finish()
+{
+	write_pending();
+	if (file_size == 0)
+		return;
+
+#ifdef WIN32
+	mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping)
+		view = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!view)
+		throw Exception("Unable to map the temporary file of a large result");
+#else
+	void *address = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, file, 0);
+	if (address == MAP_FAILED)
+		throw Exception("Unable to map the temporary file of a large result");
+	view = static_cast<const char*>(address);
+	madvise(address, file_size, MADV_SEQUENTIAL);
+#endif
+}
+
+void PgsqlResultSpill::read_row(size_t &position, std::vector<const char*> &values, std::vector<int> &lengths) const
+{
+	for (size_t column = 0; column < values.size(); column++)
+	{
+		if (position + sizeof(int32_t) > file_size)
+			throw Exception("Truncated result spill file");
+		int32_t length;
+		std::memcpy(&length, view + position, sizeof(length));
+		position += sizeof(length);
+
+		if (length < 0)
+		{
+			values[column] = nullptr;
+			lengths[column] = 0;
+			continue;
+		}
+		if (file_size - position < size_t(length) + 1)
+			throw Exception("Truncated result spill file");
+		values[column] = view + position;
+		lengths[column] = length;
+		position += length + 1;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlResultSpill Implementation:
+
+void PgsqlResultSpill::write_pending()
+{
+	const char *data = pending.data();
+	size_t size = pending.size();
+	while (size > 0)
+	{
+#ifdef WIN32
+		DWORD written = 0;
+		if (!WriteFile(file, data, size > 0x40000000 ? 0x40000000 : DWORD(size), &written, nullptr) || written == 0)
+			throw Exception("Unable to write the temporary file of a large result");
+#else
+		const ssize_t written = write(file, data, size);
+		if (written <= 0)
+			throw Exception("Unable to write the temporary file of a large result (disk full?)");
+#endif
+		data += written;
+		size -= written;
+		file_size += written;
+	}
+	pending.clear();
+}
+
+}; // namespace clan
@@ -0,0 +1,105 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+
+namespace clan
+{
+
+/// \brief Rows of a result written to a temporary file, then read back through a memory mapping.
+///
+/// Rows are appended while the result is received, and read in order once
+/// finish was called. Each field is stored as its length (-1 for NULL),
+/// its bytes and a '\0'. The file is deleted when the spill is destroyed.
+class PgsqlResultSpill
+{
+/// \name Construction
+/// \{
+public:
+	/// \param directory = Where to create the file; empty for TMPDIR or the system default.
+	PgsqlResultSpill(const std::string &directory);
+	~PgsqlResultSpill();
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	int get_row_count() const { return row_count; }
+
+	/// \brief Bytes written to the file.
+	size_t get_size() const { return file_size + pending.size(); }
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	/// \brief Append one row of result.
+	void append_row(const PGresult *result, int row);
+
+	/// \brief Write the last rows and map the file for reading.
+	void finish();
+
+	/// \brief Read the row starting at position and move position to the next one.
+	///
+	/// values and lengths must have one entry per column. NULL fields get a null value.
+	void read_row(size_t &position, std::vector<const char*> &values, std::vector<int> &lengths) const;
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	PgsqlResultSpill(const PgsqlResultSpill &);
+	PgsqlResultSpill &operator=(const PgsqlResultSpill &);
+
+	void write_pending();
+
+#ifdef WIN32
+	void *file;
+	void *mapping;
+#else
+	int file;
+#endif
+	const char *view;
+	size_t file_size;
+	std::string pending;
+	int row_count;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,600 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_routing_connection.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_command_provider.h"
+#include "ClanLib/Database/db_transaction_provider.h"
+
+#include <algorithm>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+namespace clan
+{
+
+class PgsqlRoutingConnection_Impl
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	/// \brief One server, used by one thread at a time.
+	struct Node
+	{
+		Node(const PgsqlConnection::Parameters &parameters)
+		: parameters(parameters), provider(nullptr), healthy(false), lag(0), outstanding(0), depth(0)
+		{
+		}
+
+		void connect()
+		{
+			connection.reset(new PgsqlConnection(parameters));
+			provider = PgsqlConnectionProvider::from_connection(*connection);
+			healthy = true;
+		}
+
+		/// \brief Wait until no other thread uses the connection. Calls nest within a thread.
+		void acquire()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			outstanding++;
+			released.wait(lock, [this]() { return depth == 0 || owner == std::this_thread::get_id(); });
+			owner = std::this_thread::get_id();
+			depth++;
+		}
+
+		void release()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			outstanding--;
+			if (--depth == 0)
+			{
+				owner = std::thread::id();
+				released.notify_all();
+			}
+		}
+
+		PgsqlConnection::Parameters parameters;
+		std::unique_ptr<PgsqlConnection> connection;
+		PgsqlConnectionProvider *provider;
+		std::atomic<bool> healthy;
+		std::atomic<long long> lag;
+		std::atomic<int> outstanding;
+
+		std::mutex mutex;
+		std::condition_variable released;
+		std::thread::id owner;
+		int depth;
+	};
+
+	class NodeLock
+	{
+	public:
+		NodeLock(Node &node) : node(node) { node.acquire(); }
+		~NodeLock() { node.release(); }
+	private:
+		Node &node;
+	};
+
+	/// \brief Routing state of one thread.
+	struct Session
+	{
+		Session() : pinned(-1) { }
+		int pinned;
+		Clock::time_point last_write;
+	};
+
+	PgsqlRoutingConnection_Impl(PgsqlRoutingConnection::BalancePolicy policy)
+	: policy(policy), prune_threshold(64), read_your_writes_window(0), max_lag(0), health_check_interval(0), next_replica(0), checking_health(false), last_health_check(0)
+	{
+	}
+
+	static PgsqlConnection::Parameters parse(const std::string &connection_string, const char *target_session_attrs);
+
+	int route(bool read_only);
+	int pick_replica();
+	Node &node_of(DBCommand &command);
+	void check_health();
+	void check_failure(Node &node);
+	void pin(std::thread::id thread, int node);
+	void unpin(std::thread::id thread);
+	void prune_sessions();
+
+	PgsqlRoutingConnection::BalancePolicy policy;
+	std::vector<std::unique_ptr<Node> > nodes; // nodes[0] is the primary
+
+	std::mutex session_mutex;
+	std::map<std::thread::id, Session> sessions;
+	size_t prune_threshold;
+
+	std::atomic<int> read_your_writes_window;
+	std::atomic<long long> max_lag;
+	std::atomic<int> health_check_interval;
+	std::atomic<unsigned int> next_replica;
+	std::atomic<bool> checking_health;
+	std::atomic<long long> last_health_check; // Milliseconds since the clock epoch
+
+	static long long now_ms()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now().time_since_epoch()).count();
+	}
+};
+
+/// \brief Transaction owning its server until it ends.
+class PgsqlRoutedTransactionProvider : public DBTransactionProvider
+{
+public:
+	PgsqlRoutedTransactionProvider(const std::shared_ptr<PgsqlRoutingConnection_Impl> &impl, int index, DBTransaction::Type type)
+	: impl(impl), node(*impl->nodes[index]), thread(std::this_thread::get_id()), finished(false)
+	{
+		node.acquire();
+		try
+		{
+			transaction.reset(node.provider->begin_transaction(type));
+		}
+		catch (...)
+		{
+			node.release();
+			throw;
+		}
+		impl->pin(thread, index);
+	}
+
+	~PgsqlRoutedTransactionProvider()
+	{
+		finish();
+	}
+
+	void commit()
+	{
+		try
+		{
+			transaction->commit();
+		}
+		catch (...)
+		{
+			finish();
+			throw;
+		}
+		finish();
+	}
+
+	void rollback()
+	{
+		try
+		{
+			transaction->rollback();
+		}
+		catch (...)
+		{
+			finish();
+			throw;
+		}
+		finish();
+	}
+
+private:
+	void finish()
+	{
+		if (finished)
+			return;
+		finished = true;
+		transaction.reset(); // Rolls back if still active
+		impl->unpin(thread);
+		node.release();
+	}
+
+	std::shared_ptr<PgsqlRoutingConnection_Impl> impl;
+	PgsqlRoutingConnection_Impl::Node &node;
+	std::thread::id thread;
+	std::unique_ptr<DBTransactionProvider> transaction;
+	bool finished;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlRoutingConnection Construction:
+
+PgsqlRoutingConnection::PgsqlRoutingConnection(const std::string &primary, const std::vector<std::string> &replicas, BalancePolicy policy)
+: impl(std::make_shared<PgsqlRoutingConnection_Impl>(policy))
+{
+	impl->nodes.push_back(std::unique_ptr<PgsqlRoutingConnection_Impl::Node>(
+		new PgsqlRoutingConnection_Impl::Node(PgsqlRoutingConnection_Impl::parse(primary, "read-write"))));
+	impl->nodes[0]->connect();
+
+	// prefer-standby appeared in libpq 14
+	const char *replica_attrs = PQlibVersion() >= 140000 ? "prefer-standby" : nullptr;
+	for (auto &replica : replicas)
+	{
+		impl->nodes.push_back(std::unique_ptr<PgsqlRoutingConnection_Impl::Node>(
+			new PgsqlRoutingConnection_Impl::Node(PgsqlRoutingConnection_Impl::parse(replica, replica_attrs))));
+		try
+		{
+			impl->nodes.back()->connect();
+		}
+		catch (const Exception &)
+		{
+			// Retried by check_health; reads go elsewhere meanwhile
+		}
+	}
+	impl->last_health_check = PgsqlRoutingConnection_Impl::now_ms();
+}
+
+PgsqlRoutingConnection::~PgsqlRoutingConnection()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlRoutingConnection Attributes:
+
+PgsqlConnection &PgsqlRoutingConnection::get_primary()
+{
+	return *impl->nodes[0]->connection;
+}
+
+int PgsqlRoutingConnection::get_replica_count() const
+{
+	return impl->nodes.size() - 1;
+}
+
+bool PgsqlRoutingConnection::is_replica_healthy(int index) const
+{
+	if (index < 0 || index + 1 >= (int)impl->nodes.size())
+		throw Exception("Index out of range");
+	return impl->nodes[index + 1]->healthy;
+}
+
+long long PgsqlRoutingConnection::get_replica_lag(int index) const
+{
+	if (index < 0 || index + 1 >= (int)impl->nodes.size())
+		throw Exception("Index out of range");
+	return impl->nodes[index + 1]->lag;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlRoutingConnection Operations:
+
+void PgsqlRoutingConnection::set_read_your_writes_window(int window_ms)
+{
+	impl->read_your_writes_window = window_ms;
+}
+
+void PgsqlRoutingConnection::set_max_replica_lag(long long max_lag_bytes)
+{
+	impl->max_lag = max_lag_bytes;
+}
+
+void PgsqlRoutingConnection::set_health_check_interval(int interval_ms)
+{
+	impl->health_check_interval = interval_ms;
+}
+
+void PgsqlRoutingConnection::check_health()
+{
+	impl->check_health();
+}
+
+DBCommand PgsqlRoutingConnection::create_command(const std::string &text, DBCommand::Type type)
+{
+	const bool read_only = type == DBCommand::sql_statement && PgsqlCommandProvider::is_read_only_statement(text);
+	return create_command(text, read_only, type);
+}
+
+DBCommand PgsqlRoutingConnection::create_command(const std::string &text, bool read_only, DBCommand::Type type)
+{
+	PgsqlRoutingConnection_Impl::Node &node = *impl->nodes[impl->route(read_only)];
+	return node.connection->create_command(text, type);
+}
+
+DBTransaction PgsqlRoutingConnection::begin_transaction(bool read_only, DBTransaction::Type type)
+{
+	return DBTransaction(new PgsqlRoutedTransactionProvider(impl, impl->route(read_only), type));
+}
+
+DBReader PgsqlRoutingConnection::execute_reader(DBCommand &command)
+{
+	PgsqlRoutingConnection_Impl::Node &node = impl->node_of(command);
+	PgsqlRoutingConnection_Impl::NodeLock lock(node);
+	try
+	{
+		return node.connection->execute_reader(command);
+	}
+	catch (const Exception &)
+	{
+		impl->check_failure(node);
+		throw;
+	}
+}
+
+std::string PgsqlRoutingConnection::execute_scalar_string(DBCommand &command)
+{
+	PgsqlRoutingConnection_Impl::Node &node = impl->node_of(command);
+	PgsqlRoutingConnection_Impl::NodeLock lock(node);
+	try
+	{
+		return node.connection->execute_scalar_string(command);
+	}
+	catch (const Exception &)
+	{
+		impl->check_failure(node);
+		throw;
+	}
+}
+
+int PgsqlRoutingConnection::execute_scalar_int(DBCommand &command)
+{
+	PgsqlRoutingConnection_Impl::Node &node = impl->node_of(command);
+	PgsqlRoutingConnection_Impl::NodeLock lock(node);
+	try
+	{
+		return node.connection->execute_scalar_int(command);
+	}
+	catch (const Exception &)
+	{
+		impl->check_failure(node);
+		throw;
+	}
+}
+
+void PgsqlRoutingConnection::execute_non_query(DBCommand &command)
+{
+	PgsqlRoutingConnection_Impl::Node &node = impl->node_of(command);
+	PgsqlRoutingConnection_Impl::NodeLock lock(node);
+	try
+	{
+		node.connection->execute_non_query(command);
+	}
+	catch (const Exception &)
+	{
+		impl->check_failure(node);
+		throw;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlRoutingConnection_Impl Implementation:
+
+PgsqlConnection::Parameters PgsqlRoutingConnection_Impl::parse(const std::string &connection_string, const char *target_session_attrs)
+{
+	char *error = nullptr;
+	PQconninfoOption *options = PQconninfoParse(connection_string.c_str(), &error);
+	if (!options)
+	{
+		std::string message = error ? error : "Invalid connection string";
+		PQfreemem(error);
+		throw Exception(message);
+	}
+
+	PgsqlConnection::Parameters parameters;
+	for (PQconninfoOption *option = options; option->keyword; option++)
+	{
+		if (option->val)
+			parameters[option->keyword] = option->val;
+	}
+	PQconninfoFree(options);
+
+	if (target_session_attrs && parameters.find("target_session_attrs") == parameters.end())
+		parameters["target_session_attrs"] = target_session_attrs;
+	return parameters;
+}
+
+int PgsqlRoutingConnection_Impl::route(bool read_only)
+{
+	std::unique_lock<std::mutex> lock(session_mutex);
+	auto it = sessions.find(std::this_thread::get_id());
+	if (it != sessions.end() && it->second.pinned >= 0)
+		return it->second.pinned;
+
+	if (!read_only)
+	{
+		// Only threads which wrote recently or hold a transaction have a session
+		if (it == sessions.end())
+		{
+			prune_sessions();
+			it = sessions.insert(std::make_pair(std::this_thread::get_id(), Session())).first;
+		}
+		it->second.last_write = Clock::now();
+		return 0;
+	}
+	if (it != sessions.end() && Clock::now() - it->second.last_write < std::chrono::milliseconds(read_your_writes_window))
+		return 0;
+	lock.unlock();
+
+	return pick_replica();
+}
+
+int PgsqlRoutingConnection_Impl::pick_replica()
+{
+	const int interval = health_check_interval;
+	if (interval > 0)
+	{
+		bool expected = false;
+		if (now_ms() - last_health_check > interval && checking_health.compare_exchange_strong(expected, true))
+		{
+			try
+			{
+				check_health();
+			}
+			catch (const Exception &)
+			{
+			}
+			checking_health = false;
+		}
+	}
+
+	const int replicas = nodes.size() - 1;
+	int chosen = 0;
+	if (policy == PgsqlRoutingConnection::round_robin)
+	{
+		const unsigned int start = next_replica++;
+		for (int i = 0; i < replicas && chosen == 0; i++)
+		{
+			const int candidate = 1 + (start + i) % replicas;
+			if (nodes[candidate]->healthy)
+				chosen = candidate;
+		}
+	}
+	else
+	{
+		for (int candidate = 1; candidate <= replicas; candidate++)
+		{
+			if (nodes[candidate]->healthy && (chosen == 0 || nodes[candidate]->outstanding < nodes[chosen]->outstanding))
+				chosen = candidate;
+		}
+	}
+	return chosen; // The primary serves reads when no replica is healthy
+}
+
+PgsqlRoutingConnection_Impl::Node &PgsqlRoutingConnection_Impl::node_of(DBCommand &command)
+{
+	PgsqlCommandProvider *provider = dynamic_cast<PgsqlCommandProvider*>(command.get_provider());
+	for (auto &node : nodes)
+	{
+		if (provider && node->provider == provider->get_connection())
+			return *node;
+	}
+	throw Exception("Command was not created by this routing connection");
+}
+
+void PgsqlRoutingConnection_Impl::check_health()
+{
+	last_health_check = now_ms();
+
+	std::string primary_lsn;
+	{
+		Node &primary = *nodes[0];
+		NodeLock lock(primary);
+		if (PQstatus(primary.provider->get_handle()) == CONNECTION_BAD)
+			PQreset(primary.provider->get_handle());
+		try
+		{
+			DBCommand command = primary.connection->create_command("SELECT pg_current_wal_lsn()::text");
+			primary_lsn = primary.connection->execute_scalar_string(command);
+		}
+		catch (const Exception &)
+		{
+			// Without a reference position, lags are reported as 0
+		}
+	}
+
+	for (size_t i = 1; i < nodes.size(); i++)
+	{
+		Node &replica = *nodes[i];
+		NodeLock lock(replica);
+		if (!replica.connection)
+		{
+			try
+			{
+				replica.connect();
+			}
+			catch (const Exception &)
+			{
+				replica.healthy = false;
+				continue;
+			}
+		}
+
+		if (PQstatus(replica.provider->get_handle()) == CONNECTION_BAD)
+			PQreset(replica.provider->get_handle());
+		if (PQstatus(replica.provider->get_handle()) == CONNECTION_BAD)
+		{
+			replica.healthy = false;
+			continue;
+		}
+
+		try
+		{
+			long long lag = 0;
+			if (!primary_lsn.empty())
+			{
+				// pg_last_wal_replay_lsn() is NULL on a server which is not in recovery
+				DBCommand command = replica.connection->create_command(
+					"SELECT pg_wal_lsn_diff(?1::pg_lsn, COALESCE(pg_last_wal_replay_lsn(), ?2::pg_lsn))::bigint::text");
+				command.set_input_parameter_string(1, primary_lsn);
+				command.set_input_parameter_string(2, primary_lsn);
+				lag = std::stoll(replica.connection->execute_scalar_string(command));
+			}
+			replica.lag = lag < 0 ? 0 : lag;
+			replica.healthy = max_lag == 0 || replica.lag <= max_lag;
+		}
+		catch (const std::exception &)
+		{
+			replica.healthy = false;
+		}
+	}
+}
+
+void PgsqlRoutingConnection_Impl::check_failure(Node &node)
+{
+	if (&node != nodes[0].get() && PQstatus(node.provider->get_handle()) == CONNECTION_BAD)
+		node.healthy = false;
+}
+
+void PgsqlRoutingConnection_Impl::pin(std::thread::id thread, int node)
+{
+	std::lock_guard<std::mutex> lock(session_mutex);
+	if (sessions.find(thread) == sessions.end())
+		prune_sessions();
+	sessions[thread].pinned = node;
+}
+
+void PgsqlRoutingConnection_Impl::unpin(std::thread::id thread)
+{
+	std::lock_guard<std::mutex> lock(session_mutex);
+	auto it = sessions.find(thread);
+	if (it == sessions.end())
+		return;
+	it->second.pinned = -1;
+	if (Clock::now() - it->second.last_write >= std::chrono::milliseconds(read_your_writes_window))
+		sessions.erase(it);
+}
+
+void PgsqlRoutingConnection_Impl::prune_sessions()
+{
+	// Called with session_mutex held, before adding a session. Sweeping only when
+	// the map doubled keeps the cost constant per session.
+	if (sessions.size() < prune_threshold)
+		return;
+
+	const Clock::time_point now = Clock::now();
+	const std::chrono::milliseconds window(read_your_writes_window);
+	for (auto it = sessions.begin(); it != sessions.end();)
+	{
+		if (it->second.pinned < 0 && now - it->second.last_write >= window)
+			it = sessions.erase(it);
+		else
+			++it;
+	}
+	prune_threshold = std::max<size_t>(64, sessions.size() * 2);
+}
+
+}; // namespace clan
@@ -0,0 +1,141 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace clan
+{
+
+/// \brief Bounded multiple producers, single consumer queue of rows (Vyukov's array queue).
+///
+/// Each cell holds a sequence number telling whether it is free for the
+/// producer claiming position pos (sequence == pos) or filled for the
+/// consumer (sequence == pos + 1). Producers claim positions with one
+/// compare and swap and never wait for each other.
+class PgsqlRowQueue
+{
+public:
+	PgsqlRowQueue(size_t capacity) : mask(0), enqueue_position(0), dequeue_position(0)
+	{
+		size_t size = 2;
+		while (size < capacity)
+			size *= 2;
+		mask = size - 1;
+		cells.reset(new Cell[size]);
+		for (size_t i = 0; i < size; i++)
+			cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+
+	/// \brief Takes the content of row; returns false if the queue is full.
+	bool push(int table, std::string &row)
+	{
+		size_t position = enqueue_position.load(std::memory_order_relaxed);
+		Cell *cell;
+		while (true)
+		{
+			cell = &cells[position & mask];
+			const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+			const ptrdiff_t difference = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(position);
+			if (difference == 0)
+			{
+				if (enqueue_position.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+					break;
+			}
+			else if (difference < 0)
+			{
+				return false;
+			}
+			else
+			{
+				position = enqueue_position.load(std::memory_order_relaxed);
+			}
+		}
+		cell->table = table;
+		cell->row.swap(row);
+		cell->sequence.store(position + 1, std::memory_order_release);
+		return true;
+	}
+
+	/// \brief Appends the next row to the buffer of its table; returns false if the queue is empty.
+	bool pop(std::vector<std::string> &buffers, std::vector<int> &row_counts)
+	{
+		const size_t position = dequeue_position.load(std::memory_order_relaxed);
+		Cell *cell = &cells[position & mask];
+		if (cell->sequence.load(std::memory_order_acquire) != position + 1)
+			return false;
+
+		buffers[cell->table].append(cell->row);
+		row_counts[cell->table]++;
+		cell->row.clear();
+		dequeue_position.store(position + 1, std::memory_order_relaxed);
+		cell->sequence.store(position + mask + 1, std::memory_order_release);
+		return true;
+	}
+
+	bool is_empty() const
+	{
+		const size_t position = dequeue_position.load(std::memory_order_relaxed);
+		return cells[position & mask].sequence.load(std::memory_order_acquire) != position + 1;
+	}
+
+	/// \brief Number of positions claimed by producers so far.
+	size_t get_enqueue_position() const { return enqueue_position.load(std::memory_order_acquire); }
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		int table;
+		std::string row;
+	};
+
+	std::unique_ptr<Cell[]> cells;
+	size_t mask;
+
+	// Each on its own cache line, away from the other one
+	char padding0[64];
+	std::atomic<size_t> enqueue_position;
+	char padding1[64];
+	std::atomic<size_t> dequeue_position;
+	char padding2[64];
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,103 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "pgsql_row_source.h"
+#include "pgsql_value.h"
+#include "pgsql_reader_provider.h"
+#include "pgsql_result_snapshot.h"
+#include "pgsql_snapshot_reader_provider.h"
+#include "ClanLib/Database/db_reader.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlRowSource Construction:
+
+PgsqlRowSource::PgsqlRowSource(DBReader &reader)
+: result(nullptr)
+{
+	PgsqlReaderProvider *provider = dynamic_cast<PgsqlReaderProvider*>(reader.get_provider());
+	PgsqlSnapshotReaderProvider *snapshot_provider = dynamic_cast<PgsqlSnapshotReaderProvider*>(reader.get_provider());
+	if (provider && provider->is_spilled())
+		throw Exception("Rows spilled to disk can only be read in order by the reader");
+	if (provider)
+		result = provider->get_result();
+	else if (snapshot_provider)
+		snapshot = snapshot_provider->get_snapshot();
+	else
+		throw Exception("Only readers created by a PgsqlConnection can be read by rows");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlRowSource Attributes:
+
+int PgsqlRowSource::get_row_count() const
+{
+	return snapshot ? snapshot->get_row_count() : PQntuples(result);
+}
+
+int PgsqlRowSource::get_column_count() const
+{
+	return snapshot ? snapshot->get_column_count() : PQnfields(result);
+}
+
+int PgsqlRowSource::get_name_index(const std::string &name) const
+{
+	if (snapshot)
+		return snapshot->get_name_index(name);
+
+	const int index = PQfnumber(result, name.c_str());
+	if (index < 0)
+		throw Exception(string_format("No such column name %1", name));
+	return index;
+}
+
+bool PgsqlRowSource::is_null(int row, int column) const
+{
+	return snapshot ? snapshot->is_null(row, column) : PQgetisnull(result, row, column) != 0;
+}
+
+PgsqlValue PgsqlRowSource::get_value(int row, int column) const
+{
+	if (snapshot)
+	{
+		size_t length;
+		const char *value = snapshot->get_value(row, column, length);
+		return PgsqlValue(value, length, snapshot->get_column_type(column), snapshot->get_column_format(column));
+	}
+
+	const char *value = PQgetvalue(result, row, column);
+	if (value == nullptr)
+		throw Exception("Index out of range");
+	return PgsqlValue(value, PQgetlength(result, row, column), PQftype(result, column), PQfformat(result, column));
+}
+
+}; // namespace clan
@@ -0,0 +1,80 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <memory>
+#include <string>
+
+#include <libpq-fe.h>
+
+namespace clan
+{
+
+class DBReader;
+class PgsqlValue;
+class PgsqlResultSnapshot;
+
+/// \brief Random access to the rows of the current result of a reader.
+///
+/// Only reads immutable data (a PGresult or a snapshot), so it can be used
+/// from several threads at once, as long as the reader stays open.
+class PgsqlRowSource
+{
+/// \name Construction
+/// \{
+public:
+	/// \brief Rows of the current result of reader, which must come from a PgsqlConnection or a PgsqlResultCache.
+	PgsqlRowSource(DBReader &reader);
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	int get_row_count() const;
+	int get_column_count() const;
+	int get_name_index(const std::string &name) const;
+	bool is_null(int row, int column) const;
+	PgsqlValue get_value(int row, int column) const;
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	const PGresult *result;
+	std::shared_ptr<const PgsqlResultSnapshot> snapshot;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,95 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "pgsql_shard_map.h"
+#include "ClanLib/Core/Text/string_help.h"
+
+#include <algorithm>
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlShardMap Attributes:
+
+int PgsqlShardMap::shard_of_hash(unsigned long long key_hash) const
+{
+	if (ring.empty())
+		throw Exception("PgsqlShardedConnection has no shards");
+	auto it = std::lower_bound(ring.begin(), ring.end(), std::make_pair(key_hash, 0));
+	if (it == ring.end())
+		it = ring.begin();
+	return it->second;
+}
+
+int PgsqlShardMap::shard_of_range(long long key) const
+{
+	if (ranges.empty())
+		throw Exception("PgsqlShardedConnection has no key ranges");
+	auto it = ranges.upper_bound(key);
+	if (it == ranges.begin())
+		throw Exception("Shard key " + StringHelp::ll_to_text(key) + " is below the first key range");
+	--it;
+	return it->second;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlShardMap Operations:
+
+unsigned long long PgsqlShardMap::hash(const std::string &text)
+{
+	// FNV-1a, then the splitmix64 finalizer: FNV alone leaves close names on close points
+	unsigned long long value = 14695981039346656037ULL;
+	for (unsigned char c : text)
+	{
+		value ^= c;
+		value *= 1099511628211ULL;
+	}
+	value ^= value >> 30;
+	value *= 0xbf58476d1ce4e5b9ULL;
+	value ^= value >> 27;
+	value *= 0x94d049bb133111ebULL;
+	value ^= value >> 31;
+	return value;
+}
+
+void PgsqlShardMap::add_points(const std::string &name, int shard, int weight)
+{
+	for (int i = 0; i < weight; i++)
+		ring.push_back(std::make_pair(hash(name + "#" + StringHelp::int_to_text(i)), shard));
+	std::sort(ring.begin(), ring.end());
+}
+
+void PgsqlShardMap::set_key_range(long long first_key, int shard)
+{
+	ranges[first_key] = shard;
+}
+
+}; // namespace clan
@@ -0,0 +1,85 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clan
+{
+
+/// \brief Finds the shard of a key, on a consistent hash ring or in key ranges.
+class PgsqlShardMap
+{
+/// \name Attributes
+/// \{
+public:
+	/// \brief Shard whose ring point follows the hash of the key.
+	int shard_of_hash(unsigned long long key_hash) const;
+
+	/// \brief Shard of the range holding key.
+	int shard_of_range(long long key) const;
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	/// \brief 64 bit hash of a shard name or key.
+	static unsigned long long hash(const std::string &text);
+
+	/// \brief Put weight points of shard on the hash ring.
+	///
+	/// The points only depend on the name, so shards keep their keys when others come and go.
+	void add_points(const std::string &name, int shard, int weight);
+
+	/// \brief Send the keys from first_key up to the next range to shard.
+	void set_key_range(long long first_key, int shard);
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	/// \brief Hash ring, sorted by point.
+	std::vector<std::pair<unsigned long long, int> > ring;
+
+	/// \brief First key of each range, and its shard.
+	std::map<long long, int> ranges;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,184 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "pgsql_shard_merge.h"
+
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+namespace clan
+{
+
+namespace
+{
+	/// \brief Rank of a NUMERIC text: -Infinity, any number, Infinity, then NaN above all like on the server.
+	int numeric_rank(const std::string &text)
+	{
+		if (text == "-Infinity")
+			return 0;
+		if (text == "Infinity")
+			return 2;
+		if (text == "NaN")
+			return 3;
+		return 1;
+	}
+
+	/// \brief Days from 1970-01-01 to a date of the proleptic Gregorian calendar (year 0 is 1 BC).
+	long long days_from_civil(long long year, int month, int day)
+	{
+		year -= month <= 2;
+		const long long era = (year >= 0 ? year : year - 399) / 400;
+		const long long year_of_era = year - era * 400;
+		const long long day_of_year = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+		const long long day_of_era = year_of_era * 365 + year_of_era / 4 - year_of_era / 100 + day_of_year;
+		return era * 146097 + day_of_era - 719468;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlShardMerge Operations:
+
+int PgsqlShardMerge::compare_numeric_text(const std::string &a, const std::string &b)
+{
+	const int a_rank = numeric_rank(a);
+	const int b_rank = numeric_rank(b);
+	if (a_rank != 1 || b_rank != 1)
+		return a_rank < b_rank ? -1 : (a_rank > b_rank ? 1 : 0);
+
+	// Split into sign, integer digits without leading zeros and fraction digits without trailing zeros
+	struct Decimal
+	{
+		Decimal(const std::string &text) : negative(!text.empty() && text[0] == '-')
+		{
+			size_t start = negative || (!text.empty() && text[0] == '+') ? 1 : 0;
+			const size_t point = std::min(text.find('.', start), text.size());
+			while (start < point && text[start] == '0')
+				start++;
+			integer = text.substr(start, point - start);
+			fraction = point < text.size() ? text.substr(point + 1) : std::string();
+			while (!fraction.empty() && fraction.back() == '0')
+				fraction.pop_back();
+		}
+		bool is_zero() const { return integer.empty() && fraction.empty(); }
+		bool negative;
+		std::string integer;
+		std::string fraction;
+	};
+	const Decimal x(a);
+	const Decimal y(b);
+	if (x.is_zero() && y.is_zero())
+		return 0;
+	const bool x_negative = x.negative && !x.is_zero();
+	const bool y_negative = y.negative && !y.is_zero();
+	if (x_negative != y_negative)
+		return x_negative ? -1 : 1;
+
+	int magnitude;
+	if (x.integer.size() != y.integer.size())
+		magnitude = x.integer.size() < y.integer.size() ? -1 : 1;
+	else if (x.integer != y.integer)
+		magnitude = x.integer < y.integer ? -1 : 1;
+	else
+		magnitude = x.fraction < y.fraction ? -1 : (x.fraction > y.fraction ? 1 : 0);
+	return x_negative ? -magnitude : magnitude;
+}
+
+long long PgsqlShardMerge::parse_iso_datetime(const std::string &text)
+{
+	if (text == "infinity")
+		return LLONG_MAX;
+	if (text == "-infinity")
+		return LLONG_MIN;
+
+	const char *pos = text.c_str();
+	auto read_number = [&](int min_digits, long long &value) -> bool
+	{
+		const char *start = pos;
+		value = 0;
+		while (*pos >= '0' && *pos <= '9' && pos - start < 18)
+			value = value * 10 + (*pos++ - '0');
+		return pos - start >= min_digits;
+	};
+	auto expect = [&](char c) -> bool
+	{
+		if (*pos != c)
+			return false;
+		pos++;
+		return true;
+	};
+
+	long long year, month, day, hour = 0, minute = 0, second = 0, microsecond = 0, offset = 0;
+	bool valid = read_number(4, year) && expect('-') && read_number(2, month) && expect('-') && read_number(2, day)
+		&& month >= 1 && month <= 12 && day >= 1 && day <= 31;
+	if (valid && pos[0] == ' ' && pos[1] >= '0' && pos[1] <= '9')
+	{
+		pos++;
+		valid = read_number(2, hour) && expect(':') && read_number(2, minute) && expect(':') && read_number(2, second);
+		if (valid && expect('.'))
+		{
+			const char *start = pos;
+			valid = read_number(1, microsecond) && pos - start <= 6;
+			for (int digits = pos - start; digits < 6; digits++)
+				microsecond *= 10;
+		}
+		if (valid && (*pos == '+' || *pos == '-'))
+		{
+			// Offset of timestamptz: +HH, +HH:MM or +HH:MM:SS
+			const long long sign = *pos++ == '-' ? -1 : 1;
+			long long part;
+			valid = read_number(2, part);
+			offset = part * 3600;
+			if (valid && expect(':'))
+			{
+				valid = read_number(2, part);
+				offset += part * 60;
+				if (valid && expect(':'))
+				{
+					valid = read_number(2, part);
+					offset += part;
+				}
+			}
+			offset *= sign;
+		}
+	}
+	if (valid && std::strcmp(pos, " BC") == 0)
+	{
+		year = 1 - year;
+		pos += 3;
+	}
+	if (!valid || *pos != '\0')
+		throw Exception("Unable to merge the date " + text + ": use the ISO DateStyle or binary results");
+
+	const long long seconds = days_from_civil(year, month, day) * 86400 + hour * 3600 + minute * 60 + second - offset;
+	return seconds * 1000000 + microsecond;
+}
+
+}; // namespace clan
@@ -0,0 +1,55 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <string>
+
+namespace clan
+{
+
+/// \brief Ordering of the text values the shards return, as on the server.
+namespace PgsqlShardMerge
+{
+	/// \brief Compare two NUMERIC texts exactly, digit by digit.
+	int compare_numeric_text(const std::string &a, const std::string &b);
+
+	/// \brief Microseconds since 1970-01-01 UTC of a date or timestamp printed in the ISO DateStyle.
+	///
+	/// Handles the UTC offsets of timestamptz, years past 9999, BC dates and infinities.
+	long long parse_iso_datetime(const std::string &text);
+}
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,498 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_sharded_connection.h"
+#include "ClanLib/Pgsql/pgsql_exception.h"
+#include "ClanLib/Core/Text/string_help.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_command_provider.h"
+#include "pgsql_reader_provider.h"
+#include "pgsql_result_snapshot.h"
+#include "pgsql_snapshot_reader_provider.h"
+#include "pgsql_value.h"
+#include "pgsql_shard_map.h"
+#include "pgsql_shard_merge.h"
+#include "pgsql_binary.h"
+#include "pg_type.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+
+namespace clan
+{
+
+class PgsqlShardedConnection_Impl
+{
+public:
+	/// \brief One connection of a shard, used by one thread at a time.
+	struct Node
+	{
+		Node(const std::string &connection_string)
+		: connection(connection_string), provider(PgsqlConnectionProvider::from_connection(connection)), outstanding(0), depth(0)
+		{
+		}
+
+		/// \brief Wait until no other thread uses the connection. Calls nest within a thread.
+		void acquire()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			outstanding++;
+			released.wait(lock, [this]() { return depth == 0 || owner == std::this_thread::get_id(); });
+			owner = std::this_thread::get_id();
+			depth++;
+
+			// Reconnect once the previous user left the connection broken
+			if (depth == 1 && PQstatus(provider->get_handle()) == CONNECTION_BAD)
+				PQreset(provider->get_handle());
+		}
+
+		void release()
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			outstanding--;
+			if (--depth == 0)
+			{
+				owner = std::thread::id();
+				released.notify_all();
+			}
+		}
+
+		PgsqlConnection connection;
+		PgsqlConnectionProvider *provider;
+		std::atomic<int> outstanding;
+
+		std::mutex mutex;
+		std::condition_variable released;
+		std::thread::id owner;
+		int depth;
+	};
+
+	class NodeLock
+	{
+	public:
+		NodeLock(Node &node) : node(node) { node.acquire(); }
+		~NodeLock() { node.release(); }
+	private:
+		Node &node;
+	};
+
+	struct Shard
+	{
+		std::string name;
+		std::vector<std::unique_ptr<Node> > nodes;
+	};
+
+	/// \brief Column the rows of the shards are merged on.
+	struct SortKey
+	{
+		int column;
+		Oid type;
+		bool descending;
+	};
+
+	PgsqlShardedConnection_Impl(PgsqlShardedConnection::ShardMap map) : map(map)
+	{
+	}
+
+	Shard &get_shard(int shard);
+	Node &pick_node(int shard);
+	Node &node_of(DBCommand &command);
+	DBReader execute_reader_all_shards(const std::string &sql, const std::vector<std::string> &order_by, const std::function<void(DBCommand &command)> &bind);
+
+	PgsqlShardedConnection::ShardMap map;
+	std::vector<std::unique_ptr<Shard> > shards;
+	PgsqlShardMap shard_map;
+
+private:
+	static int compare_rows(const PgsqlResultSnapshot::RowRef &a, const PgsqlResultSnapshot::RowRef &b, const std::vector<SortKey> &keys);
+	static int compare_values(const PgsqlResultSnapshot::RowRef &a, const PgsqlResultSnapshot::RowRef &b, const SortKey &key);
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlShardedConnection Construction:
+
+PgsqlShardedConnection::PgsqlShardedConnection(ShardMap map)
+: impl(std::make_shared<PgsqlShardedConnection_Impl>(map))
+{
+}
+
+PgsqlShardedConnection::~PgsqlShardedConnection()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlShardedConnection Attributes:
+
+int PgsqlShardedConnection::get_shard_count() const
+{
+	return impl->shards.size();
+}
+
+std::string PgsqlShardedConnection::get_shard_name(int shard) const
+{
+	return impl->get_shard(shard).name;
+}
+
+int PgsqlShardedConnection::get_connection_count(int shard) const
+{
+	return impl->get_shard(shard).nodes.size();
+}
+
+PgsqlConnection &PgsqlShardedConnection::get_connection(int shard, int index)
+{
+	PgsqlShardedConnection_Impl::Shard &entry = impl->get_shard(shard);
+	if (index < 0 || index >= (int)entry.nodes.size())
+		throw Exception("Index out of range");
+	return entry.nodes[index]->connection;
+}
+
+int PgsqlShardedConnection::get_shard_of(long long key) const
+{
+	if (impl->map == key_ranges)
+		return impl->shard_map.shard_of_range(key);
+	return impl->shard_map.shard_of_hash(PgsqlShardMap::hash(StringHelp::ll_to_text(key)));
+}
+
+int PgsqlShardedConnection::get_shard_of(const std::string &key) const
+{
+	if (impl->map == key_ranges)
+		throw Exception("PgsqlShardedConnection key ranges only take integer keys");
+	return impl->shard_map.shard_of_hash(PgsqlShardMap::hash(key));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlShardedConnection Operations:
+
+int PgsqlShardedConnection::add_shard(const std::string &name, const std::string &connection_string, int connection_count, int weight)
+{
+	for (auto &shard : impl->shards)
+	{
+		if (shard->name == name)
+			throw Exception("PgsqlShardedConnection already has a shard named " + name);
+	}
+	if (connection_count < 1 || weight < 1)
+		throw Exception("PgsqlShardedConnection shards need at least one connection and a positive weight");
+
+	std::unique_ptr<PgsqlShardedConnection_Impl::Shard> shard(new PgsqlShardedConnection_Impl::Shard());
+	shard->name = name;
+	for (int i = 0; i < connection_count; i++)
+		shard->nodes.push_back(std::unique_ptr<PgsqlShardedConnection_Impl::Node>(new PgsqlShardedConnection_Impl::Node(connection_string)));
+
+	const int index = impl->shards.size();
+	impl->shards.push_back(std::move(shard));
+	impl->shard_map.add_points(name, index, weight);
+	return index;
+}
+
+void PgsqlShardedConnection::set_key_range(long long first_key, int shard)
+{
+	impl->get_shard(shard);
+	impl->shard_map.set_key_range(first_key, shard);
+}
+
+DBCommand PgsqlShardedConnection::create_command(long long shard_key, const std::string &text, DBCommand::Type type)
+{
+	return impl->pick_node(get_shard_of(shard_key)).connection.create_command(text, type);
+}
+
+DBCommand PgsqlShardedConnection::create_command(const std::string &shard_key, const std::string &text, DBCommand::Type type)
+{
+	return impl->pick_node(get_shard_of(shard_key)).connection.create_command(text, type);
+}
+
+DBReader PgsqlShardedConnection::execute_reader(DBCommand &command)
+{
+	PgsqlShardedConnection_Impl::Node &node = impl->node_of(command);
+	PgsqlShardedConnection_Impl::NodeLock lock(node);
+	return node.connection.execute_reader(command);
+}
+
+std::string PgsqlShardedConnection::execute_scalar_string(DBCommand &command)
+{
+	PgsqlShardedConnection_Impl::Node &node = impl->node_of(command);
+	PgsqlShardedConnection_Impl::NodeLock lock(node);
+	return node.connection.execute_scalar_string(command);
+}
+
+int PgsqlShardedConnection::execute_scalar_int(DBCommand &command)
+{
+	PgsqlShardedConnection_Impl::Node &node = impl->node_of(command);
+	PgsqlShardedConnection_Impl::NodeLock lock(node);
+	return node.connection.execute_scalar_int(command);
+}
+
+void PgsqlShardedConnection::execute_non_query(DBCommand &command)
+{
+	PgsqlShardedConnection_Impl::Node &node = impl->node_of(command);
+	PgsqlShardedConnection_Impl::NodeLock lock(node);
+	node.connection.execute_non_query(command);
+}
+
+void PgsqlShardedConnection::run_on_shard(int shard, const std::function<void(PgsqlConnection &connection)> &fn)
+{
+	PgsqlShardedConnection_Impl::Node &node = impl->pick_node(shard);
+	PgsqlShardedConnection_Impl::NodeLock lock(node);
+	fn(node.connection);
+}
+
+DBReader PgsqlShardedConnection::execute_reader_all_shards(const std::string &sql, const std::vector<std::string> &order_by, const std::function<void(DBCommand &command)> &bind)
+{
+	return impl->execute_reader_all_shards(sql, order_by, bind);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlShardedConnection_Impl Operations:
+
+PgsqlShardedConnection_Impl::Shard &PgsqlShardedConnection_Impl::get_shard(int shard)
+{
+	if (shard < 0 || shard >= (int)shards.size())
+		throw Exception("Index out of range");
+	return *shards[shard];
+}
+
+PgsqlShardedConnection_Impl::Node &PgsqlShardedConnection_Impl::pick_node(int shard)
+{
+	Shard &entry = get_shard(shard);
+	Node *chosen = entry.nodes[0].get();
+	for (auto &node : entry.nodes)
+	{
+		if (node->outstanding < chosen->outstanding)
+			chosen = node.get();
+	}
+	return *chosen;
+}
+
+PgsqlShardedConnection_Impl::Node &PgsqlShardedConnection_Impl::node_of(DBCommand &command)
+{
+	PgsqlCommandProvider *provider = dynamic_cast<PgsqlCommandProvider*>(command.get_provider());
+	for (auto &shard : shards)
+	{
+		for (auto &node : shard->nodes)
+		{
+			if (provider && node->provider == provider->get_connection())
+				return *node;
+		}
+	}
+	throw Exception("Command was not created by this sharded connection");
+}
+
+DBReader PgsqlShardedConnection_Impl::execute_reader_all_shards(const std::string &sql, const std::vector<std::string> &order_by, const std::function<void(DBCommand &command)> &bind)
+{
+	if (shards.empty())
+		throw Exception("PgsqlShardedConnection has no shards");
+
+	// The connections stay reserved until the readers are closed, which updates their memory accounting
+	struct Reservations
+	{
+		Reservations(size_t count) : nodes(count, nullptr) { }
+		~Reservations()
+		{
+			for (Node *node : nodes)
+			{
+				if (node)
+					node->release();
+			}
+		}
+		std::vector<Node *> nodes;
+	};
+	Reservations reservations(shards.size());
+	std::vector<std::unique_ptr<PgsqlReaderProvider> > readers(shards.size());
+
+	std::vector<std::exception_ptr> errors(shards.size());
+	auto worker = [&](int shard)
+	{
+		try
+		{
+			Node &node = pick_node(shard);
+			node.acquire();
+			reservations.nodes[shard] = &node;
+			DBCommand command = node.connection.create_command(sql);
+			if (bind)
+				bind(command);
+			PgsqlCommandProvider *command_provider = dynamic_cast<PgsqlCommandProvider*>(command.get_provider());
+			readers[shard].reset(new PgsqlReaderProvider(node.provider, command_provider));
+			if (readers[shard]->is_spilled())
+				throw PgsqlResultTooLargeException(node.provider->get_result_budget());
+		}
+		catch (...)
+		{
+			errors[shard] = std::current_exception();
+		}
+	};
+
+	// The first shard is served by the calling thread
+	std::vector<std::thread> threads;
+	for (size_t i = 1; i < shards.size(); i++)
+		threads.push_back(std::thread(worker, i));
+	worker(0);
+	for (auto &thread : threads)
+		thread.join();
+
+	for (auto &error : errors)
+	{
+		if (error)
+			std::rethrow_exception(error);
+	}
+
+	const PGresult *layout = readers[0]->get_result();
+	for (auto &reader : readers)
+	{
+		const PGresult *result = reader->get_result();
+		bool same_layout = PQnfields(result) == PQnfields(layout);
+		for (int column = 0; same_layout && column < PQnfields(layout); column++)
+			same_layout = PQftype(result, column) == PQftype(layout, column) && PQfformat(result, column) == PQfformat(layout, column);
+		if (!same_layout)
+			throw Exception("The shards returned different columns");
+	}
+
+	std::vector<SortKey> keys;
+	for (auto &item : order_by)
+	{
+		std::vector<std::string> words = StringHelp::split_text(item, " ");
+		SortKey key;
+		key.descending = words.size() == 2 && StringHelp::compare(words[1], "DESC", true) == 0;
+		if (words.empty() || words.size() > 2 || (words.size() == 2 && !key.descending && StringHelp::compare(words[1], "ASC", true) != 0))
+			throw Exception("Invalid sort column: " + item);
+		key.column = PQfnumber(layout, words[0].c_str());
+		if (key.column < 0)
+			throw Exception("Sort column " + words[0] + " missing from the result");
+		key.type = PQftype(layout, key.column);
+		keys.push_back(key);
+	}
+
+	// Merge the sorted rows of the shards, taking the first one from the lowest shard on ties
+	std::vector<PgsqlResultSnapshot::RowRef> rows;
+	std::vector<int> next(readers.size(), 0);
+	while (true)
+	{
+		int best = -1;
+		for (size_t shard = 0; shard < readers.size(); shard++)
+		{
+			const PGresult *result = readers[shard]->get_result();
+			if (next[shard] >= PQntuples(result))
+				continue;
+			if (best < 0 || (!keys.empty() && compare_rows(
+				PgsqlResultSnapshot::RowRef(result, next[shard]),
+				PgsqlResultSnapshot::RowRef(readers[best]->get_result(), next[best]), keys) < 0))
+			{
+				best = shard;
+			}
+		}
+		if (best < 0)
+			break;
+		rows.push_back(PgsqlResultSnapshot::RowRef(readers[best]->get_result(), next[best]++));
+	}
+
+	return DBReader(new PgsqlSnapshotReaderProvider(PgsqlResultSnapshot::create(layout, rows)));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlShardedConnection_Impl Implementation:
+
+int PgsqlShardedConnection_Impl::compare_rows(const PgsqlResultSnapshot::RowRef &a, const PgsqlResultSnapshot::RowRef &b, const std::vector<SortKey> &keys)
+{
+	for (auto &key : keys)
+	{
+		const int order = compare_values(a, b, key);
+		if (order != 0)
+			return key.descending ? -order : order;
+	}
+	return 0;
+}
+
+int PgsqlShardedConnection_Impl::compare_values(const PgsqlResultSnapshot::RowRef &a, const PgsqlResultSnapshot::RowRef &b, const SortKey &key)
+{
+	const bool a_null = PQgetisnull(a.result, a.row, key.column) != 0;
+	const bool b_null = PQgetisnull(b.result, b.row, key.column) != 0;
+	if (a_null || b_null)
+		return a_null == b_null ? 0 : (a_null ? 1 : -1);
+
+	// Both rows come from results with the same layout
+	const PgsqlValue x(PQgetvalue(a.result, a.row, key.column), PQgetlength(a.result, a.row, key.column), key.type, PQfformat(a.result, key.column));
+	const PgsqlValue y(PQgetvalue(b.result, b.row, key.column), PQgetlength(b.result, b.row, key.column), key.type, PQfformat(b.result, key.column));
+	switch (key.type)
+	{
+	case INT2OID:
+	case INT4OID:
+	case INT8OID:
+	case OIDOID:
+	{
+		const long long x_value = x.to_int64();
+		const long long y_value = y.to_int64();
+		return x_value < y_value ? -1 : (x_value > y_value ? 1 : 0);
+	}
+	case FLOAT4OID:
+	case FLOAT8OID:
+	{
+		// NaN sorts above every number on the server
+		const double x_value = x.format == 0 ? std::strtod(x.to_string().c_str(), nullptr) : x.to_double();
+		const double y_value = y.format == 0 ? std::strtod(y.to_string().c_str(), nullptr) : y.to_double();
+		if (std::isnan(x_value) || std::isnan(y_value))
+			return std::isnan(x_value) == std::isnan(y_value) ? 0 : (std::isnan(x_value) ? 1 : -1);
+		return x_value < y_value ? -1 : (x_value > y_value ? 1 : 0);
+	}
+	case NUMERICOID:
+		return PgsqlShardMerge::compare_numeric_text(x.to_string(), y.to_string());
+	case DATEOID:
+	case TIMESTAMPOID:
+	case TIMESTAMPTZOID:
+		if (x.format == 1)
+		{
+			// Days or microseconds since 2000-01-01, infinities being the extreme values
+			const long long x_value = x.length == 4 ? PgsqlBinary::read_int32(x.data) : PgsqlBinary::read_int64(x.data);
+			const long long y_value = y.length == 4 ? PgsqlBinary::read_int32(y.data) : PgsqlBinary::read_int64(y.data);
+			return x_value < y_value ? -1 : (x_value > y_value ? 1 : 0);
+		}
+		else
+		{
+			// Bytes do not order offsets, BC dates nor years past 9999
+			const long long x_value = PgsqlShardMerge::parse_iso_datetime(x.to_string());
+			const long long y_value = PgsqlShardMerge::parse_iso_datetime(y.to_string());
+			return x_value < y_value ? -1 : (x_value > y_value ? 1 : 0);
+		}
+	default:
+	{
+		// Byte order, like the C collation
+		const int order = std::memcmp(x.data, y.data, std::min(x.length, y.length));
+		if (order != 0)
+			return order;
+		return x.length < y.length ? -1 : (x.length > y.length ? 1 : 0);
+	}
+	}
+}
+
+}; // namespace clan
@@ -0,0 +1,142 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "pgsql_single_flight.h"
+#include "pgsql_reader_provider.h"
+#include "pgsql_result_snapshot.h"
+#include "pgsql_snapshot_reader_provider.h"
+#include "ClanLib/Pgsql/pgsql_exception.h"
+
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+
+namespace clan
+{
+
+namespace
+{
+	struct Flight
+	{
+		Flight() : waiters(0), done(false) { }
+
+		int waiters;
+		bool done;
+		std::shared_ptr<const PgsqlResultSnapshot> snapshot;
+		std::exception_ptr error;
+		std::condition_variable done_event;
+	};
+
+	std::mutex flights_mutex;
+	std::map<std::string, std::shared_ptr<Flight> > flights;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlSingleFlight Operations:
+
+DBReaderProvider *PgsqlSingleFlight::execute(const std::string &key, int timeout_ms, const std::function<PgsqlReaderProvider*()> &execute)
+{
+	std::unique_lock<std::mutex> lock(flights_mutex);
+	auto it = flights.find(key);
+	if (it != flights.end())
+	{
+		std::shared_ptr<Flight> flight = it->second;
+		flight->waiters++;
+		if (timeout_ms > 0)
+		{
+			if (!flight->done_event.wait_for(lock, std::chrono::milliseconds(timeout_ms), [&] { return flight->done; }))
+			{
+				flight->waiters--;
+				throw PgsqlTimeoutException(timeout_ms);
+			}
+		}
+		else
+		{
+			flight->done_event.wait(lock, [&] { return flight->done; });
+		}
+		lock.unlock();
+
+		if (flight->error)
+			std::rethrow_exception(flight->error);
+		if (flight->snapshot)
+			return new PgsqlSnapshotReaderProvider(flight->snapshot);
+		return execute();
+	}
+
+	std::shared_ptr<Flight> flight = std::make_shared<Flight>();
+	flights[key] = flight;
+	lock.unlock();
+
+	std::unique_ptr<PgsqlReaderProvider> reader;
+	std::exception_ptr error;
+	try
+	{
+		reader.reset(execute());
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	// Callers coming from now on run the query again, since the data may have changed
+	lock.lock();
+	flights.erase(key);
+	const int waiters = flight->waiters;
+	lock.unlock();
+
+	std::shared_ptr<const PgsqlResultSnapshot> snapshot;
+	if (waiters > 0 && reader && !reader->is_spilled())
+	{
+		try
+		{
+			snapshot = PgsqlResultSnapshot::create(reader->get_result());
+		}
+		catch (...)
+		{
+			// The waiters run the query themselves
+		}
+	}
+
+	lock.lock();
+	flight->snapshot = snapshot;
+	flight->error = error;
+	flight->done = true;
+	flight->done_event.notify_all();
+	lock.unlock();
+
+	if (error)
+		std::rethrow_exception(error);
+	return reader.release();
+}
+
+}; // namespace clan
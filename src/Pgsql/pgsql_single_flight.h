@@ -0,0 +1,64 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <string>
+#include <functional>
+
+namespace clan
+{
+
+class DBReaderProvider;
+class PgsqlReaderProvider;
+
+/// \brief Lets identical queries running at the same time on several connections share one execution.
+class PgsqlSingleFlight
+{
+/// \name Operations
+/// \{
+public:
+	/// \brief Run the query identified by key once for all its concurrent callers.
+	///
+	/// The first caller runs execute and gets its reader. Callers arriving
+	/// before that reader is ready wait for it, then read a snapshot of its
+	/// result, or get its exception. They run execute themselves if the result
+	/// was moved to disk.
+	///
+	/// \param timeout_ms = How long a caller waits for the running query before throwing a PgsqlTimeoutException, 0 for no limit.
+	static DBReaderProvider *execute(const std::string &key, int timeout_ms, const std::function<PgsqlReaderProvider*()> &execute);
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,305 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_snapshot_file.h"
+#include "ClanLib/Pgsql/pgsql_exception.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_command_provider.h"
+#include "pgsql_reader_provider.h"
+#include "pgsql_result_snapshot.h"
+#include "pgsql_snapshot_reader_provider.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+#ifdef WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace clan
+{
+
+namespace
+{
+	// Layout of a snapshot file (native endianness):
+	//   header, key, version, padding to 8 bytes, then the PgsqlResultSnapshot buffer
+	struct FileHeader
+	{
+		char magic[8];
+		uint32_t byte_order;
+		uint32_t key_length;
+		uint32_t version_length;
+		uint32_t reserved;
+		uint64_t snapshot_offset;
+		uint64_t snapshot_size;
+	};
+
+	const char file_magic[8] = { 'C', 'L', 'P', 'G', 'S', 'N', 'F', '1' };
+	const uint32_t file_byte_order = 0x01020304;
+
+	class MappedFile
+	{
+	public:
+		// Returns null if the file cannot be opened or mapped
+		static std::shared_ptr<MappedFile> open(const std::string &path)
+		{
+			std::shared_ptr<MappedFile> file(new MappedFile());
+#ifdef WIN32
+			HANDLE handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+			if (handle == INVALID_HANDLE_VALUE)
+				return std::shared_ptr<MappedFile>();
+			LARGE_INTEGER file_size;
+			HANDLE mapping = nullptr;
+			if (GetFileSizeEx(handle, &file_size) && file_size.QuadPart > 0)
+				mapping = CreateFileMappingA(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+			CloseHandle(handle);
+			if (!mapping)
+				return std::shared_ptr<MappedFile>();
+			file->data = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+			CloseHandle(mapping);
+			if (!file->data)
+				return std::shared_ptr<MappedFile>();
+			file->size = file_size.QuadPart;
+#else
+			int handle = ::open(path.c_str(), O_RDONLY);
+			if (handle < 0)
+				return std::shared_ptr<MappedFile>();
+			struct stat status;
+			void *address = MAP_FAILED;
+			if (fstat(handle, &status) == 0 && status.st_size > 0)
+				address = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, handle, 0);
+			close(handle);
+			if (address == MAP_FAILED)
+				return std::shared_ptr<MappedFile>();
+			file->data = static_cast<const char*>(address);
+			file->size = status.st_size;
+#endif
+			return file;
+		}
+
+		~MappedFile()
+		{
+			if (!data)
+				return;
+#ifdef WIN32
+			UnmapViewOfFile(data);
+#else
+			munmap(const_cast<char*>(data), size);
+#endif
+		}
+
+		const char *data;
+		size_t size;
+
+	private:
+		MappedFile() : data(nullptr), size(0) { }
+	};
+
+	// Returns the snapshot of the file, or null if it is invalid or not saved for key and version (when given)
+	std::shared_ptr<const PgsqlResultSnapshot> load_snapshot(const std::string &path, const std::string *key, const std::string *version)
+	{
+		std::shared_ptr<MappedFile> file = MappedFile::open(path);
+		if (!file || file->size < sizeof(FileHeader))
+			return std::shared_ptr<const PgsqlResultSnapshot>();
+
+		FileHeader header;
+		memcpy(&header, file->data, sizeof(header));
+		if (memcmp(header.magic, file_magic, sizeof(file_magic)) != 0 || header.byte_order != file_byte_order)
+			return std::shared_ptr<const PgsqlResultSnapshot>();
+
+		const uint64_t strings_end = uint64_t(sizeof(FileHeader)) + header.key_length + header.version_length;
+		if (strings_end > header.snapshot_offset || header.snapshot_offset % 8 != 0 ||
+			header.snapshot_offset > file->size || header.snapshot_size > file->size - header.snapshot_offset)
+			return std::shared_ptr<const PgsqlResultSnapshot>();
+
+		const char *stored_key = file->data + sizeof(FileHeader);
+		const char *stored_version = stored_key + header.key_length;
+		if (key && (key->size() != header.key_length || memcmp(key->data(), stored_key, header.key_length) != 0))
+			return std::shared_ptr<const PgsqlResultSnapshot>();
+		if (version && (version->size() != header.version_length || memcmp(version->data(), stored_version, header.version_length) != 0))
+			return std::shared_ptr<const PgsqlResultSnapshot>();
+
+		try
+		{
+			return std::make_shared<PgsqlResultSnapshot>(file->data + header.snapshot_offset, header.snapshot_size, file);
+		}
+		catch (const Exception &)
+		{
+			return std::shared_ptr<const PgsqlResultSnapshot>();
+		}
+	}
+
+	void write_snapshot(const std::string &path, const std::string &key, const std::string &version, const PgsqlResultSnapshot &snapshot)
+	{
+		FileHeader header;
+		memset(&header, 0, sizeof(header));
+		memcpy(header.magic, file_magic, sizeof(file_magic));
+		header.byte_order = file_byte_order;
+		header.key_length = key.size();
+		header.version_length = version.size();
+		header.snapshot_offset = (sizeof(FileHeader) + key.size() + version.size() + 7) & ~uint64_t(7);
+		header.snapshot_size = snapshot.get_memory_size();
+
+		const char padding[8] = { 0 };
+		const size_t padding_size = header.snapshot_offset - (sizeof(FileHeader) + key.size() + version.size());
+
+		// Threads of a process saving the same snapshot each write their own file
+		static std::atomic<int> temp_serial(0);
+		const int serial = temp_serial++;
+#ifdef WIN32
+		std::string temp_path = string_format("%1.tmp.%2.%3", path, (int)_getpid(), serial);
+		FILE *file = fopen(temp_path.c_str(), "wb");
+#else
+		std::string temp_path = string_format("%1.tmp.%2.%3", path, (int)getpid(), serial);
+		const int descriptor = open(temp_path.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+		FILE *file = descriptor >= 0 ? fdopen(descriptor, "wb") : nullptr;
+		if (descriptor >= 0 && !file)
+			close(descriptor);
+#endif
+		if (!file)
+			throw Exception("Unable to create snapshot file " + temp_path);
+
+		bool written =
+			fwrite(&header, sizeof(header), 1, file) == 1 &&
+			fwrite(key.data(), 1, key.size(), file) == key.size() &&
+			fwrite(version.data(), 1, version.size(), file) == version.size() &&
+			fwrite(padding, 1, padding_size, file) == padding_size &&
+			fwrite(snapshot.get_data(), 1, snapshot.get_memory_size(), file) == snapshot.get_memory_size();
+		written = fflush(file) == 0 && written;
+#ifndef WIN32
+		written = written && fsync(fileno(file)) == 0;
+#endif
+		written = fclose(file) == 0 && written;
+
+#ifdef WIN32
+		// Windows refuses to replace a file mapped by a reader; give the readers a moment to close it
+		for (int attempt = 0; written; attempt++)
+		{
+			if (MoveFileExA(temp_path.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH))
+				break;
+			written = attempt < 10;
+			if (written)
+				Sleep(50);
+		}
+#else
+		if (written)
+			written = rename(temp_path.c_str(), path.c_str()) == 0;
+#endif
+		if (!written)
+		{
+			remove(temp_path.c_str());
+			throw Exception("Unable to write snapshot file " + path);
+		}
+	}
+
+	void get_providers(DBConnection &connection, DBCommand &command, PgsqlConnectionProvider *&connection_provider, PgsqlCommandProvider *&command_provider)
+	{
+		connection_provider = PgsqlConnectionProvider::from_connection(connection);
+		command_provider = dynamic_cast<PgsqlCommandProvider*>(command.get_provider());
+		if (!command_provider)
+			throw Exception("PgsqlSnapshotFile only accepts commands created by a PostgreSQL connection using the libpq engine");
+	}
+
+	std::string get_key(PgsqlConnectionProvider *connection_provider, PgsqlCommandProvider *command_provider)
+	{
+		std::string key = connection_provider->get_server_key();
+		key += command_provider->get_cache_key();
+		return key;
+	}
+
+	std::string get_version(DBConnection &connection, const std::string &version_query)
+	{
+		if (version_query.empty())
+			return std::string();
+		DBCommand version_command = connection.create_command(version_query);
+		return connection.execute_scalar_string(version_command);
+	}
+
+	std::shared_ptr<const PgsqlResultSnapshot> run_and_save(PgsqlConnectionProvider *connection_provider, PgsqlCommandProvider *command_provider,
+		const std::string &path, const std::string &key, const std::string &version)
+	{
+		std::unique_ptr<PgsqlReaderProvider> reader(new PgsqlReaderProvider(connection_provider, command_provider));
+		if (reader->is_spilled())
+			throw PgsqlResultTooLargeException(connection_provider->get_result_budget());
+		std::shared_ptr<const PgsqlResultSnapshot> snapshot = PgsqlResultSnapshot::create(reader->get_result());
+		reader.reset();
+
+		write_snapshot(path, key, version, *snapshot);
+		return snapshot;
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlSnapshotFile Operations:
+
+DBReader PgsqlSnapshotFile::execute_reader(DBConnection &connection, DBCommand &command, const std::string &path, const std::string &version_query)
+{
+	PgsqlConnectionProvider *connection_provider;
+	PgsqlCommandProvider *command_provider;
+	get_providers(connection, command, connection_provider, command_provider);
+
+	const std::string key = get_key(connection_provider, command_provider);
+	const std::string version = get_version(connection, version_query);
+
+	std::shared_ptr<const PgsqlResultSnapshot> snapshot = load_snapshot(path, &key, version_query.empty() ? nullptr : &version);
+	if (!snapshot)
+		snapshot = run_and_save(connection_provider, command_provider, path, key, version);
+	return DBReader(new PgsqlSnapshotReaderProvider(snapshot));
+}
+
+DBReader PgsqlSnapshotFile::open(const std::string &path)
+{
+	std::shared_ptr<const PgsqlResultSnapshot> snapshot = load_snapshot(path, nullptr, nullptr);
+	if (!snapshot)
+		throw Exception("Invalid or missing snapshot file " + path);
+	return DBReader(new PgsqlSnapshotReaderProvider(snapshot));
+}
+
+void PgsqlSnapshotFile::save(DBConnection &connection, DBCommand &command, const std::string &path, const std::string &version_query)
+{
+	PgsqlConnectionProvider *connection_provider;
+	PgsqlCommandProvider *command_provider;
+	get_providers(connection, command, connection_provider, command_provider);
+
+	const std::string key = get_key(connection_provider, command_provider);
+	const std::string version = get_version(connection, version_query);
+	run_and_save(connection_provider, command_provider, path, key, version);
+}
+
+}; // namespace clan
@@ -0,0 +1,144 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include <memory>
+
+#include "Pgsql/precomp.h"
+#include "pgsql_snapshot_reader_provider.h"
+#include "pgsql_result_snapshot.h"
+#include "pgsql_value.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/System/datetime.h"
+#include "ClanLib/Core/Text/string_help.h"
+#include <libpq-fe.h>
+#include <cstdlib>
+
+namespace clan
+{
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlSnapshotReaderProvider Construction:
+
+PgsqlSnapshotReaderProvider::PgsqlSnapshotReaderProvider(const std::shared_ptr<const PgsqlResultSnapshot> &snapshot)
+: snapshot(snapshot), current_row(-1)
+{
+}
+
+PgsqlSnapshotReaderProvider::~PgsqlSnapshotReaderProvider()
+{
+	close();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlSnapshotReaderProvider Attributes:
+
+int PgsqlSnapshotReaderProvider::get_column_count() const
+{
+	return snapshot->get_column_count();
+}
+
+std::string PgsqlSnapshotReaderProvider::get_column_name(int index) const
+{
+	return snapshot->get_column_name(index);
+}
+
+int PgsqlSnapshotReaderProvider::get_name_index(const std::string &name) const
+{
+	return snapshot->get_name_index(name);
+}
+
+std::string PgsqlSnapshotReaderProvider::get_column_string(int index) const
+{
+	return get_column_value(index).to_string();
+}
+
+bool PgsqlSnapshotReaderProvider::get_column_bool(int index) const
+{
+	return get_column_value(index).to_bool();
+}
+
+char PgsqlSnapshotReaderProvider::get_column_char(int index) const
+{
+	return static_cast<int>(get_column_value(index).to_int());
+}
+
+unsigned char PgsqlSnapshotReaderProvider::get_column_uchar(int index) const
+{
+	return static_cast<unsigned char>(get_column_value(index).to_uint());
+}
+
+int PgsqlSnapshotReaderProvider::get_column_int(int index) const
+{
+	return get_column_value(index).to_int();
+}
+
+unsigned int PgsqlSnapshotReaderProvider::get_column_uint(int index) const
+{
+	return get_column_value(index).to_uint();
+}
+
+double PgsqlSnapshotReaderProvider::get_column_double(int index) const
+{
+	return get_column_value(index).to_double();
+}
+
+DateTime PgsqlSnapshotReaderProvider::get_column_datetime(int index) const
+{
+	return get_column_value(index).to_datetime();
+}
+
+DataBuffer PgsqlSnapshotReaderProvider::get_column_binary(int index) const
+{
+	return get_column_value(index).to_binary();
+}
+
+PgsqlValue PgsqlSnapshotReaderProvider::get_column_value(int index) const
+{
+	size_t length;
+	const char *value = snapshot->get_value(current_row, index, length);
+	return PgsqlValue(value, length, snapshot->get_column_type(index), snapshot->get_column_format(index));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlSnapshotReaderProvider Operations:
+
+bool PgsqlSnapshotReaderProvider::retrieve_row()
+{
+	if (1 + current_row >= snapshot->get_row_count())
+		return false;
+	++current_row;
+	return true;
+}
+
+void PgsqlSnapshotReaderProvider::close()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlSnapshotReaderProvider Implementation:
+
+}; //namespace clan
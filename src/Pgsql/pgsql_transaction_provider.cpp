@@ -39,12 +39,39 @@ namespace clan
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlTransactionProvider Construction:
 
-PgsqlTransactionProvider::PgsqlTransactionProvider(PgsqlConnectionProvider *connection, const DBTransaction::Type type)
-: connection(connection), type(type)
+PgsqlTransactionProvider::PgsqlTransactionProvider(PgsqlConnectionProvider *connection, const DBTransaction::Type type,
+	PgsqlConnection::IsolationLevel isolation)
+: connection(connection), type(type), lost(false)
 {
 	//We assert that (connection != nullptr)
 	if (connection->active_transaction)
 		throw Exception("Only one database transaction may be active for a connection");
+	for (const std::string &statement : get_start_statements(type, isolation))
+		execute(statement);
+	connection->active_transaction = this;
+}
+
+PgsqlTransactionProvider::~PgsqlTransactionProvider()
+{
+	try
+	{
+		rollback();
+	}
+	catch (...)
+	{
+		// A failed ROLLBACK leaves nothing to undo: the server aborts the
+		// transaction itself when the connection is lost.
+	}
+	// A lost transaction no longer owns the connection, which may run a newer one
+	if (connection && connection->active_transaction == this)
+		connection->active_transaction = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlTransactionProvider Attributes:
+
+std::vector<std::string> PgsqlTransactionProvider::get_start_statements(DBTransaction::Type type, PgsqlConnection::IsolationLevel isolation)
+{
 	std::string transaction_type;
 	switch (type)
 	{
@@ -59,30 +86,40 @@ PgsqlTransactionProvider::PgsqlTransactionProvider(PgsqlConnectionProvider *conn
 	default:
 		throw Exception("Unknown transaction type");
 	}
-	execute("START TRANSACTION;");
+	std::string start_transaction = "START TRANSACTION";
+	switch (isolation)
+	{
+	case PgsqlConnection::read_committed:
+		start_transaction += " ISOLATION LEVEL READ COMMITTED";
+		break;
+	case PgsqlConnection::repeatable_read:
+		start_transaction += " ISOLATION LEVEL REPEATABLE READ";
+		break;
+	case PgsqlConnection::serializable:
+		start_transaction += " ISOLATION LEVEL SERIALIZABLE";
+		break;
+	case PgsqlConnection::default_isolation:
+		break;
+	default:
+		throw Exception("Unknown isolation level");
+	}
+	std::vector<std::string> statements;
+	statements.push_back(start_transaction + ";");
 	if (!transaction_type.empty())
-		execute(transaction_type);
-	connection->active_transaction = this;
-}
-
-PgsqlTransactionProvider::~PgsqlTransactionProvider()
-{
-	rollback();
-	if (connection)
-		connection->active_transaction = nullptr;
+		statements.push_back(transaction_type);
+	return statements;
 }
 
-/////////////////////////////////////////////////////////////////////////////
-// PgsqlTransactionProvider Attributes:
-
-
 /////////////////////////////////////////////////////////////////////////////
 // PgsqlTransactionProvider Operations:
 
 void PgsqlTransactionProvider::commit()
 {
-	//We assert that (connection != nullptr) and (connection->active_transaction == this|nullptr)
-	if (connection->active_transaction)
+	if (lost)
+		throw Exception("The transaction was rolled back when the connection was reset after a timeout");
+
+	//We assert that (connection != nullptr)
+	if (connection->active_transaction == this)
 	{
 		execute("COMMIT;");
 		connection->active_transaction = nullptr;
@@ -91,8 +128,9 @@ void PgsqlTransactionProvider::commit()
 
 void PgsqlTransactionProvider::rollback()
 {
-	//We assert that (connection != nullptr) and (connection->active_transaction == this|nullptr)
-	if (connection->active_transaction)
+	// Once lost, the connection may run another transaction since the reset
+	//We assert that (connection != nullptr)
+	if (connection->active_transaction == this)
 	{
 		execute("ROLLBACK;");
 		connection->active_transaction = nullptr;
@@ -33,8 +33,11 @@
 #pragma once
 
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <libpq-fe.h>
+#include "ClanLib/Pgsql/pgsql_connection.h"
 #include "ClanLib/Database/db_transaction.h"
 #include "ClanLib/Database/db_transaction_provider.h"
 
@@ -49,13 +52,16 @@ class PgsqlTransactionProvider : public DBTransactionProvider
 /// \name Construction
 /// \{
 public:
-	PgsqlTransactionProvider(PgsqlConnectionProvider *connection, DBTransaction::Type type);
+	PgsqlTransactionProvider(PgsqlConnectionProvider *connection, DBTransaction::Type type,
+		PgsqlConnection::IsolationLevel isolation = PgsqlConnection::default_isolation);
 	~PgsqlTransactionProvider();
 /// \}
 
 /// \name Attributes
 /// \{
 public:
+	/// \brief Statements starting a transaction of this type and isolation level, to run in order.
+	static std::vector<std::string> get_start_statements(DBTransaction::Type type, PgsqlConnection::IsolationLevel isolation);
 /// \}
 
 /// \name Operations
@@ -70,6 +76,9 @@ public:
 private:
 	PgsqlConnectionProvider *connection;
 	DBTransaction::Type type;
+
+	/// \brief Set when the connection was reset, which rolled the transaction back.
+	bool lost;
 inline void execute(const std::string &cmd);
 
 	friend class PgsqlConnectionProvider;
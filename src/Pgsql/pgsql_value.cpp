@@ -0,0 +1,324 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "pgsql_value.h"
+#include "pgsql_binary.h"
+#include "pgsql_numeric.h"
+#include "pgsql_geometry.h"
+#include "pgsql_connection_provider.h"
+#include "pg_type.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/System/datetime.h"
+#include "ClanLib/Core/Text/string_help.h"
+#include "ClanLib/Core/Text/string_format.h"
+#include <memory>
+#include <cstdio>
+#include <cstdlib>
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlValue Attributes:
+
+std::string PgsqlValue::to_string() const
+{
+	if (format == 0)
+		return std::string(data, length);
+
+	char buffer[64];
+	switch (type)
+	{
+	case BOOLOID:
+		return to_bool() ? "t" : "f";
+	case INT2OID:
+	case INT4OID:
+	case INT8OID:
+	case OIDOID:
+		snprintf(buffer, sizeof(buffer), "%lld", to_int64());
+		return buffer;
+	case FLOAT4OID:
+	case FLOAT8OID:
+		{
+			const double value = to_double();
+			return type == FLOAT4OID ? PgsqlBinary::float4_to_text(static_cast<float>(value)) : PgsqlBinary::float8_to_text(value);
+		}
+	case NUMERICOID:
+		return PgsqlNumeric::to_text(data, length);
+	case POINTOID:
+	case LSEGOID:
+	case BOXOID:
+	case CIRCLEOID:
+	case POLYGONOID:
+	case PATHOID:
+		return PgsqlGeometry::to_text(data, length, type);
+	case JSONBOID:
+		// Binary jsonb is a version byte followed by the text form
+		if (length < 1 || data[0] != 1)
+			throw Exception("Unsupported jsonb binary format version");
+		return std::string(data + 1, length - 1);
+	case DATEOID:
+	case TIMESTAMPOID:
+	case TIMESTAMPTZOID:
+		return binary_datetime_to_text();
+	case TEXTOID:
+	case VARCHAROID:
+	case BPCHAROID:
+	case NAMEOID:
+	case CHAROID:
+	case UNKNOWNOID:
+	case JSONOID:
+	case XMLOID:
+	case BYTEAOID:
+		return std::string(data, length);
+	default:
+		throw_unsupported("string");
+		return std::string();
+	}
+}
+
+bool PgsqlValue::to_bool() const
+{
+	if (format == 0)
+		return StringHelp::text_to_bool(to_string());
+	if (type == BOOLOID && length == 1)
+		return data[0] != 0;
+	return to_int64() != 0;
+}
+
+int PgsqlValue::to_int() const
+{
+	if (format == 0)
+		return StringHelp::text_to_int(to_string());
+	return static_cast<int>(to_int64());
+}
+
+unsigned int PgsqlValue::to_uint() const
+{
+	if (format == 0)
+		return StringHelp::text_to_uint(to_string());
+	return static_cast<unsigned int>(to_int64());
+}
+
+long long PgsqlValue::to_int64() const
+{
+	// Both formats drop the fraction, as text_to_int does in to_int
+	if (type == NUMERICOID)
+		return PgsqlNumeric::truncate_int64(data, length, format);
+	if (format == 0)
+	{
+		const std::string text = to_string();
+		char *end = nullptr;
+		const long long value = std::strtoll(text.c_str(), &end, 10);
+		if (end == text.c_str() || *end != '\0')
+			throw Exception(string_format("Invalid integer %1", text));
+		return value;
+	}
+
+	if (type == INT2OID && length == 2)
+		return PgsqlBinary::read_int16(data);
+	if (type == INT4OID && length == 4)
+		return PgsqlBinary::read_int32(data);
+	if (type == INT8OID && length == 8)
+		return PgsqlBinary::read_int64(data);
+	if (type == OIDOID && length == 4)
+		return PgsqlBinary::read_uint32(data);
+	if (type == BOOLOID && length == 1)
+		return data[0] != 0;
+	throw_unsupported("integer");
+	return 0;
+}
+
+double PgsqlValue::to_double() const
+{
+	if (format == 0)
+		return StringHelp::text_to_double(to_string());
+	if (type == FLOAT4OID && length == 4)
+		return PgsqlBinary::read_float4(data);
+	if (type == FLOAT8OID && length == 8)
+		return PgsqlBinary::read_float8(data);
+	if (type == NUMERICOID)
+		return StringHelp::text_to_double(to_string());
+	return static_cast<double>(to_int64());
+}
+
+long long PgsqlValue::to_fixed(int scale) const
+{
+	if (format == 1 && (type == FLOAT4OID || type == FLOAT8OID))
+	{
+		const std::string text = to_string();
+		return PgsqlNumeric::decode_int64(text.data(), text.size(), type, 0, scale);
+	}
+	return PgsqlNumeric::decode_int64(data, length, type, format, scale);
+}
+
+#ifdef __SIZEOF_INT128__
+__int128 PgsqlValue::to_fixed128(int scale) const
+{
+	if (format == 1 && (type == FLOAT4OID || type == FLOAT8OID))
+	{
+		const std::string text = to_string();
+		return PgsqlNumeric::decode_int128(text.data(), text.size(), type, 0, scale);
+	}
+	return PgsqlNumeric::decode_int128(data, length, type, format, scale);
+}
+#endif
+
+Vec2d PgsqlValue::to_point() const
+{
+	return PgsqlGeometry::decode_point(data, length, type, format);
+}
+
+LineSegment2d PgsqlValue::to_line_segment() const
+{
+	return PgsqlGeometry::decode_line_segment(data, length, type, format);
+}
+
+Rectd PgsqlValue::to_box() const
+{
+	return PgsqlGeometry::decode_box(data, length, type, format);
+}
+
+Circled PgsqlValue::to_circle() const
+{
+	return PgsqlGeometry::decode_circle(data, length, type, format);
+}
+
+std::vector<Vec2d> PgsqlValue::to_polygon() const
+{
+	std::vector<Vec2d> points;
+	PgsqlGeometry::decode_polygon(data, length, type, format, points);
+	return points;
+}
+
+DateTime PgsqlValue::to_datetime() const
+{
+	return PgsqlConnectionProvider::from_sql_datetime(to_string());
+}
+
+DataBuffer PgsqlValue::to_binary() const
+{
+	if (format == 1)
+		return DataBuffer(data, length);
+
+	// The data of the native engine is not null terminated
+	const std::string text(data, length);
+	size_t size;
+	auto deleter = [](void *ptr) {if (ptr) {free(ptr);} };
+	std::unique_ptr<unsigned char, decltype(deleter)> value(PQunescapeBytea(
+				reinterpret_cast<const unsigned char*>(text.c_str()),
+				&size),
+				deleter);
+	DataBuffer output(value.get(), size);
+	return output;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlValue Implementation:
+
+std::string PgsqlValue::binary_datetime_to_text() const
+{
+	const long long microseconds_per_day = 86400000000LL;
+	long long days;
+	long long time_of_day = 0;
+	if (type == DATEOID && length == 4)
+	{
+		days = PgsqlBinary::read_int32(data);
+		if (days == 0x7fffffff)
+			return "infinity";
+		if (days == -0x7fffffff - 1)
+			return "-infinity";
+	}
+	else if (length == 8)
+	{
+		const long long microseconds = PgsqlBinary::read_int64(data);
+		if (microseconds == 0x7fffffffffffffffLL)
+			return "infinity";
+		if (microseconds == -0x7fffffffffffffffLL - 1)
+			return "-infinity";
+		days = microseconds / microseconds_per_day;
+		time_of_day = microseconds % microseconds_per_day;
+		if (time_of_day < 0)
+		{
+			days--;
+			time_of_day += microseconds_per_day;
+		}
+	}
+	else
+	{
+		throw Exception("Invalid binary date");
+	}
+
+	// Civil date of a day count from 2000-01-01, shifted to start eras on March 1st, 0000
+	const long long shifted = days + 730425;
+	const long long era = (shifted >= 0 ? shifted : shifted - 146096) / 146097;
+	const long long day_of_era = shifted - era * 146097;
+	const long long year_of_era = (day_of_era - day_of_era / 1460 + day_of_era / 36524 - day_of_era / 146096) / 365;
+	const long long day_of_year = day_of_era - (365 * year_of_era + year_of_era / 4 - year_of_era / 100);
+	const long long month_index = (5 * day_of_year + 2) / 153;
+	const int day = static_cast<int>(day_of_year - (153 * month_index + 2) / 5 + 1);
+	const int month = static_cast<int>(month_index < 10 ? month_index + 3 : month_index - 9);
+	const long long year = year_of_era + era * 400 + (month <= 2 ? 1 : 0);
+
+	char buffer[64];
+	if (type == DATEOID)
+	{
+		snprintf(buffer, sizeof(buffer), "%04lld-%02d-%02d", year, month, day);
+		return buffer;
+	}
+
+	const long long seconds = time_of_day / 1000000;
+	snprintf(buffer, sizeof(buffer), "%04lld-%02d-%02d %02d:%02d:%02d", year, month, day,
+		static_cast<int>(seconds / 3600), static_cast<int>(seconds / 60 % 60), static_cast<int>(seconds % 60));
+	std::string text = buffer;
+
+	// Like the server, print the fraction without its trailing zeros
+	int fraction = static_cast<int>(time_of_day % 1000000);
+	if (fraction)
+	{
+		int digits = 6;
+		while (fraction % 10 == 0)
+		{
+			fraction /= 10;
+			digits--;
+		}
+		snprintf(buffer, sizeof(buffer), ".%0*d", digits, fraction);
+		text += buffer;
+	}
+	if (type == TIMESTAMPTZOID)
+		text += "+00";
+	return text;
+}
+
+void PgsqlValue::throw_unsupported(const char *target) const
+{
+	throw Exception(string_format("Binary value of type %1 can't be read as %2", (int)type, target));
+}
+
+}; // namespace clan
@@ -0,0 +1,115 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+#include "pgsql_array.h"
+
+namespace clan
+{
+
+class DataBuffer;
+class DateTime;
+
+/// \brief A field of a result, in the text or binary format.
+///
+/// Converts the value the same way whatever the format of the result.
+/// data is not null terminated; it may point into a network buffer.
+class PgsqlValue
+{
+/// \name Construction
+/// \{
+public:
+	PgsqlValue(const char *data, int length, Oid type, int format)
+	: data(data), length(length), type(type), format(format) { }
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	std::string to_string() const;
+	bool to_bool() const;
+	int to_int() const;
+	unsigned int to_uint() const;
+	long long to_int64() const;
+	double to_double() const;
+
+	/// \brief The value times 10^scale, exactly (see PgsqlNumeric).
+	long long to_fixed(int scale) const;
+#ifdef __SIZEOF_INT128__
+	__int128 to_fixed128(int scale) const;
+#endif
+
+	DateTime to_datetime() const;
+	DataBuffer to_binary() const;
+
+	/// \brief Geometric values (see PgsqlGeometry).
+	Vec2d to_point() const;
+	LineSegment2d to_line_segment() const;
+	Rectd to_box() const;
+	Circled to_circle() const;
+	std::vector<Vec2d> to_polygon() const;
+
+	template<typename T>
+	std::vector<T> to_array() const;
+
+	const char *data;
+	int length;
+	Oid type;
+	int format;
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	/// \brief Text form of a binary date or timestamp (UTC for timestamptz).
+	std::string binary_datetime_to_text() const;
+
+	void throw_unsupported(const char *target) const;
+/// \}
+};
+
+template<typename T>
+std::vector<T> PgsqlValue::to_array() const
+{
+	std::vector<T> values;
+	PgsqlArray::decode(data, length, type, format, values);
+	return values;
+}
+
+}; // namespace clan
+
+/// \}
@@ -0,0 +1,145 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "pgsql_wire_command_provider.h"
+#include "pgsql_wire_connection.h"
+#include "pgsql_command_provider.h"
+#include "pgsql_connection_provider.h"
+#include "pg_type.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/System/datetime.h"
+#include "ClanLib/Core/Text/string_help.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireCommandProvider Construction:
+
+PgsqlWireCommandProvider::PgsqlWireCommandProvider(const std::string &user_text, DBCommand::Type type)
+: arguments_count(0)
+{
+	if (type == DBCommand::stored_procedure)
+		throw Exception("Stored procedure calls are not supported by the native PostgreSQL engine");
+	text = PgsqlCommandProvider::compute_command(user_text, arguments_count);
+	parameters.resize(arguments_count);
+}
+
+PgsqlWireCommandProvider::~PgsqlWireCommandProvider()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireCommandProvider Attributes:
+
+int PgsqlWireCommandProvider::get_input_parameter_column(const std::string &name) const
+{
+	throw Exception("get_input_parameter_column not yet implemented for PostgreSQL");
+}
+
+int PgsqlWireCommandProvider::get_output_last_insert_rowid() const
+{
+	throw Exception("The native PostgreSQL engine does not track inserted ids; use a RETURNING clause");
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireCommandProvider Operations:
+
+void PgsqlWireCommandProvider::set_input_parameter_string(int index, const std::string &value)
+{
+	Parameter &parameter = put(index);
+	parameter.data = value;
+	parameter.is_null = value.empty(); //An empty string is sent as NULL
+}
+
+void PgsqlWireCommandProvider::set_input_parameter_bool(int index, bool value)
+{
+	set_input_parameter_string(index, StringHelp::bool_to_text(value));
+}
+
+void PgsqlWireCommandProvider::set_input_parameter_int(int index, int value)
+{
+	set_input_parameter_string(index, StringHelp::int_to_text(value));
+}
+
+void PgsqlWireCommandProvider::set_input_parameter_double(int index, double value)
+{
+	set_input_parameter_string(index, StringHelp::double_to_text(value));
+}
+
+void PgsqlWireCommandProvider::set_input_parameter_datetime(int index, const DateTime &value)
+{
+	set_input_parameter_string(index, PgsqlConnectionProvider::to_sql_datetime(value));
+}
+
+void PgsqlWireCommandProvider::set_input_parameter_binary(int index, const DataBuffer &value)
+{
+	Parameter &parameter = put(index);
+	parameter.data.assign(value.get_data(), value.get_size());
+	parameter.is_null = false;
+	parameter.is_binary = true;
+}
+
+void PgsqlWireCommandProvider::send(PgsqlWireConnection &wire) const
+{
+	if (arguments_count == 0)
+	{
+		wire.send_query(text);
+		return;
+	}
+
+	std::vector<Oid> types(arguments_count);
+	std::vector<const char*> values(arguments_count);
+	std::vector<int> lengths(arguments_count);
+	std::vector<int> formats(arguments_count);
+	for (int i = 0; i < arguments_count; i++)
+	{
+		const Parameter &parameter = parameters[i];
+		types[i] = parameter.is_binary ? BYTEAOID : NULLOID; //Let the server infer the type
+		values[i] = parameter.is_null ? nullptr : parameter.data.data();
+		lengths[i] = parameter.data.size();
+		formats[i] = parameter.is_binary ? 1 : 0;
+	}
+	wire.send_extended_query(text, arguments_count, types.data(), values.data(), lengths.data(), formats.data(), 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireCommandProvider Implementation:
+
+PgsqlWireCommandProvider::Parameter &PgsqlWireCommandProvider::put(int index)
+{
+	if (index < 1 || index > arguments_count)
+		throw Exception("Index out of range");
+
+	Parameter &parameter = parameters[index - 1];
+	parameter = Parameter();
+	return parameter;
+}
+
+}; // namespace clan
@@ -0,0 +1,808 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "pgsql_wire_connection.h"
+#include "pgsql_binary.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/Crypto/sha256.h"
+#include "ClanLib/Core/Crypto/md5.h"
+#include "ClanLib/Core/Crypto/random.h"
+#include "ClanLib/Core/Crypto/base64_encoder.h"
+#include "ClanLib/Core/Crypto/base64_decoder.h"
+#include "ClanLib/Core/Text/string_help.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+#include <memory>
+#include <cstring>
+#include <cstdlib>
+
+#ifdef WIN32
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <poll.h>
+#endif
+
+namespace clan
+{
+
+namespace
+{
+	const int protocol_version = 196608; // 3.0
+	const int cancel_request_code = 80877102;
+
+	void hmac_sha256(const std::string &key, const std::string &data, unsigned char out[32])
+	{
+		SHA256 sha;
+		sha.set_hmac(key.data(), key.size());
+		sha.add(data.data(), data.size());
+		sha.calculate();
+		sha.get_hash(out);
+	}
+
+	std::string to_base64(const std::string &data)
+	{
+		DataBuffer encoded = Base64Encoder::encode(data.data(), data.size());
+		return std::string(encoded.get_data(), encoded.get_size());
+	}
+
+	std::string from_base64(const std::string &data)
+	{
+		DataBuffer decoded = Base64Decoder::decode(data.data(), data.size());
+		return std::string(decoded.get_data(), decoded.get_size());
+	}
+
+	/// \brief Value of attribute name in a SCRAM message ("r=...,s=...,i=...").
+	std::string scram_attribute(const std::string &message, char name)
+	{
+		size_t start = 0;
+		while (start < message.size())
+		{
+			size_t end = message.find(',', start);
+			if (end == std::string::npos)
+				end = message.size();
+			if (end - start >= 2 && message[start] == name && message[start + 1] == '=')
+				return message.substr(start + 2, end - start - 2);
+			start = end + 1;
+		}
+		throw Exception(string_format("Invalid SCRAM message from the server (no %1 attribute)", std::string(1, name)));
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireConnection Construction:
+
+PgsqlWireConnection::PgsqlWireConnection(const Parameters &given_parameters)
+: parameters(given_parameters), socket(-1), receive_buffer(64 * 1024), read_position(0), write_position(0), transaction_status('I'),
+  backend_pid(0), backend_key(0), lost(false)
+{
+	// Fill what was not given from the environment and compiled-in defaults, like libpq
+	PQconninfoOption *defaults = PQconndefaults();
+	for (PQconninfoOption *option = defaults; option && option->keyword; option++)
+	{
+		if (option->val && parameters.find(option->keyword) == parameters.end())
+			parameters[option->keyword] = option->val;
+	}
+	PQconninfoFree(defaults);
+
+	const std::string sslmode = parameters["sslmode"];
+	if (sslmode == "require" || sslmode == "verify-ca" || sslmode == "verify-full")
+		throw Exception("The native PostgreSQL engine does not support SSL connections");
+	if (parameters["gssencmode"] == "require")
+		throw Exception("The native PostgreSQL engine does not support GSSAPI encryption");
+	if (!parameters["replication"].empty())
+		throw Exception("The native PostgreSQL engine does not support replication connections");
+
+	host = !parameters["hostaddr"].empty() ? parameters["hostaddr"] : parameters["host"];
+	port = parameters["port"].empty() ? "5432" : parameters["port"];
+	if (host.find(',') != std::string::npos || port.find(',') != std::string::npos)
+		throw Exception("The native PostgreSQL engine connects to a single host");
+
+	socket = open_socket();
+	try
+	{
+		startup(parameters);
+	}
+	catch (...)
+	{
+		close_socket(socket);
+		throw;
+	}
+}
+
+PgsqlWireConnection::~PgsqlWireConnection()
+{
+	// Terminate
+	send_buffer.clear();
+	end_message(begin_message('X'));
+	try
+	{
+		flush();
+	}
+	catch (const Exception &)
+	{
+	}
+	close_socket(socket);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireConnection Attributes:
+
+std::string PgsqlWireConnection::get_parameter_status(const std::string &name) const
+{
+	auto it = parameter_status.find(name);
+	return it != parameter_status.end() ? it->second : std::string();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireConnection Operations:
+
+PgsqlWireConnection::Parameters PgsqlWireConnection::parse_connection_string(const std::string &connection_string)
+{
+	char *error = nullptr;
+	PQconninfoOption *options = PQconninfoParse(connection_string.c_str(), &error);
+	if (!options)
+	{
+		const std::string message = error ? error : "Invalid connection string";
+		PQfreemem(error);
+		throw Exception(message);
+	}
+
+	Parameters parameters;
+	for (PQconninfoOption *option = options; option->keyword; option++)
+	{
+		if (option->val)
+			parameters[option->keyword] = option->val;
+	}
+	PQconninfoFree(options);
+	return parameters;
+}
+
+void PgsqlWireConnection::send_query(const std::string &sql)
+{
+	const size_t message = begin_message('Q');
+	put_string(sql);
+	end_message(message);
+}
+
+void PgsqlWireConnection::send_extended_query(const std::string &sql, int count, const Oid *types,
+	const char *const *values, const int *lengths, const int *formats, int result_format)
+{
+	size_t message = begin_message('P');
+	put_string(std::string()); // Unnamed statement
+	put_string(sql);
+	put_int16(count);
+	for (int i = 0; i < count; i++)
+		put_int32(types ? types[i] : 0);
+	end_message(message);
+
+	message = begin_message('B');
+	put_string(std::string()); // Unnamed portal
+	put_string(std::string());
+	put_int16(count);
+	for (int i = 0; i < count; i++)
+		put_int16(formats ? formats[i] : 0);
+	put_int16(count);
+	for (int i = 0; i < count; i++)
+	{
+		if (!values[i])
+		{
+			put_int32(-1);
+			continue;
+		}
+		const int length = (formats && formats[i]) ? lengths[i] : std::strlen(values[i]);
+		put_int32(length);
+		send_buffer.append(values[i], length);
+	}
+	put_int16(1);
+	put_int16(result_format);
+	end_message(message);
+
+	message = begin_message('D');
+	send_buffer.push_back('P');
+	put_string(std::string());
+	end_message(message);
+
+	message = begin_message('E');
+	put_string(std::string());
+	put_int32(0); // All rows
+	end_message(message);
+
+	end_message(begin_message('S'));
+}
+
+void PgsqlWireConnection::send_copy_data(const char *data, int size)
+{
+	const size_t message = begin_message('d');
+	send_buffer.append(data, size);
+	end_message(message);
+}
+
+void PgsqlWireConnection::send_copy_done()
+{
+	end_message(begin_message('c'));
+}
+
+void PgsqlWireConnection::send_copy_fail(const std::string &reason)
+{
+	const size_t message = begin_message('f');
+	put_string(reason);
+	end_message(message);
+}
+
+void PgsqlWireConnection::flush()
+{
+	try
+	{
+		send_all(socket, send_buffer.data(), send_buffer.size());
+	}
+	catch (const Exception &)
+	{
+		lost = true;
+		throw;
+	}
+	send_buffer.clear();
+}
+
+PgsqlWireConnection::Message PgsqlWireConnection::read_message()
+{
+	while (true)
+	{
+		receive(5);
+		const int length = PgsqlBinary::read_int32(receive_buffer.data() + read_position + 1);
+		if (length < 4)
+			throw Exception("Invalid message from the PostgreSQL server");
+		receive(1 + length);
+
+		const Message message = take_message(1 + length);
+		if (!handle_async(message))
+			return message;
+	}
+}
+
+void PgsqlWireConnection::skip_to_ready()
+{
+	while (read_message().type != 'Z')
+	{
+	}
+}
+
+bool PgsqlWireConnection::wait_for_input(int timeout_ms)
+{
+	if (write_position > read_position)
+		return true;
+	return poll_socket(timeout_ms) != 0; // Also true when interrupted; the caller reads again
+}
+
+void PgsqlWireConnection::consume_input()
+{
+	// Only read what already arrived, then handle the complete messages
+	while (poll_socket(0) > 0)
+		receive_some();
+
+	for (size_t size = buffered_message_size(); size > 0; size = buffered_message_size())
+	{
+		const Message message = take_message(size);
+		if (handle_async(message))
+			continue;
+		if (message.type == 'E') // The server is closing the session (FATAL)
+			throw to_exception(message);
+		throw Exception("Unexpected message from the PostgreSQL server while no command runs");
+	}
+}
+
+bool PgsqlWireConnection::get_notification(PgsqlNotification &notification)
+{
+	if (notifications.empty())
+		return false;
+	notification = notifications.front();
+	notifications.pop_front();
+	return true;
+}
+
+void PgsqlWireConnection::reset()
+{
+	close_socket(socket);
+	socket = -1;
+	send_buffer.clear();
+	read_position = 0;
+	write_position = 0;
+	transaction_status = 'I';
+	parameter_status.clear();
+
+	socket = open_socket();
+	try
+	{
+		startup(parameters);
+	}
+	catch (...)
+	{
+		close_socket(socket);
+		socket = -1;
+		throw;
+	}
+	lost = false;
+}
+
+PgsqlException PgsqlWireConnection::to_exception(const Message &message)
+{
+	std::map<char, std::string> fields;
+	const char *pos = message.data;
+	const char *end = message.data + message.length;
+	while (pos < end && *pos)
+	{
+		// A field missing its terminator ends with the message
+		const char code = *pos++;
+		const char *value_end = static_cast<const char*>(std::memchr(pos, 0, end - pos));
+		if (!value_end)
+			value_end = end;
+		fields[code] = std::string(pos, value_end);
+		pos = value_end + 1;
+	}
+
+	// Formatted like the messages of libpq
+	std::string text = fields['S'] + ":  " + fields['M'];
+	if (!fields['D'].empty())
+		text += "\nDETAIL:  " + fields['D'];
+	if (!fields['H'].empty())
+		text += "\nHINT:  " + fields['H'];
+	const std::string severity = !fields['V'].empty() ? fields['V'] : fields['S'];
+	return PgsqlException(StringHelp::text_to_local8(text), fields['C'], severity, fields['D'], fields['H']);
+}
+
+void PgsqlWireConnection::cancel()
+{
+	std::string request;
+	PgsqlBinary::write_int32(request, 16);
+	PgsqlBinary::write_int32(request, cancel_request_code);
+	PgsqlBinary::write_int32(request, backend_pid);
+	PgsqlBinary::write_int32(request, backend_key);
+
+	Socket cancel_socket = open_socket();
+	try
+	{
+		send_all(cancel_socket, request.data(), request.size());
+	}
+	catch (...)
+	{
+		close_socket(cancel_socket);
+		throw;
+	}
+	close_socket(cancel_socket);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireConnection Implementation:
+
+PgsqlWireConnection::Socket PgsqlWireConnection::open_socket() const
+{
+#ifndef WIN32
+	// Unix domain socket, in the given directory or else in the usual ones
+	if (host.empty() || host[0] == '/')
+	{
+		const char *directories[] = { host.c_str(), "/var/run/postgresql", "/tmp" };
+		for (int i = host.empty() ? 1 : 0; i < 3; i++)
+		{
+			sockaddr_un address;
+			std::memset(&address, 0, sizeof(address));
+			address.sun_family = AF_UNIX;
+			const std::string path = string_format("%1/.s.PGSQL.%2", directories[i], port);
+			if (path.size() >= sizeof(address.sun_path))
+				continue;
+			std::strcpy(address.sun_path, path.c_str());
+
+			Socket unix_socket = ::socket(AF_UNIX, SOCK_STREAM, 0);
+			if (unix_socket < 0)
+				break;
+			if (connect(unix_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0)
+			{
+#ifdef SO_NOSIGPIPE
+				const int enable = 1;
+				setsockopt(unix_socket, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+				return unix_socket;
+			}
+			close_socket(unix_socket);
+			if (!host.empty())
+				break;
+		}
+		throw Exception(string_format("Unable to connect to the PostgreSQL server on socket %1/.s.PGSQL.%2", host.empty() ? "/var/run/postgresql" : host, port));
+	}
+#endif
+
+	addrinfo hints;
+	std::memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_UNSPEC;
+	hints.ai_socktype = SOCK_STREAM;
+	addrinfo *addresses = nullptr;
+	if (getaddrinfo(host.empty() ? "localhost" : host.c_str(), port.c_str(), &hints, &addresses) != 0)
+		throw Exception(string_format("Unable to resolve the PostgreSQL server address %1", host));
+
+	Socket tcp_socket = -1;
+	for (addrinfo *address = addresses; address; address = address->ai_next)
+	{
+		tcp_socket = ::socket(address->ai_family, address->ai_socktype, address->ai_protocol);
+		if (tcp_socket < 0)
+			continue;
+		if (connect(tcp_socket, address->ai_addr, address->ai_addrlen) == 0)
+		{
+#ifdef SO_NOSIGPIPE
+			const int enable = 1;
+			setsockopt(tcp_socket, SOL_SOCKET, SO_NOSIGPIPE, &enable, sizeof(enable));
+#endif
+			break;
+		}
+		close_socket(tcp_socket);
+		tcp_socket = -1;
+	}
+	freeaddrinfo(addresses);
+
+	if (tcp_socket < 0)
+		throw Exception(string_format("Unable to connect to the PostgreSQL server %1:%2", host, port));
+	return tcp_socket;
+}
+
+void PgsqlWireConnection::close_socket(Socket socket)
+{
+#ifdef WIN32
+	closesocket(socket);
+#else
+	close(socket);
+#endif
+}
+
+void PgsqlWireConnection::send_all(Socket socket, const char *data, size_t size)
+{
+	while (size > 0)
+	{
+		// A closed connection must throw, not raise SIGPIPE
+#ifdef MSG_NOSIGNAL
+		const int sent = send(socket, data, size, MSG_NOSIGNAL);
+#else
+		const int sent = send(socket, data, size, 0);
+#endif
+		if (sent <= 0)
+			throw Exception("Connection to the PostgreSQL server lost");
+		data += sent;
+		size -= sent;
+	}
+}
+
+void PgsqlWireConnection::startup(const Parameters &parameters)
+{
+	auto get = [&](const char *name) -> std::string
+	{
+		auto it = parameters.find(name);
+		return it != parameters.end() ? it->second : std::string();
+	};
+	const std::string user = get("user");
+	const std::string password = get("password");
+
+	// The startup message has no type byte
+	send_buffer.clear();
+	put_int32(0);
+	put_int32(protocol_version);
+	const char *keys[] = { "user", "dbname", "application_name", "options", "client_encoding" };
+	const char *names[] = { "user", "database", "application_name", "options", "client_encoding" };
+	for (int i = 0; i < 5; i++)
+	{
+		const std::string value = get(keys[i]);
+		if (!value.empty())
+		{
+			put_string(names[i]);
+			put_string(value);
+		}
+	}
+	send_buffer.push_back('\0');
+	PgsqlBinary::store_uint32(&send_buffer[0], send_buffer.size());
+	flush();
+
+	while (true)
+	{
+		const Message message = read_message();
+		switch (message.type)
+		{
+		case 'R':
+			{
+				const int code = PgsqlBinary::read_int32(message.data);
+				if (code == 0) // AuthenticationOk
+					break;
+
+				if (code == 3) // AuthenticationCleartextPassword
+				{
+					const size_t reply = begin_message('p');
+					put_string(password);
+					end_message(reply);
+					flush();
+				}
+				else if (code == 5) // AuthenticationMD5Password
+				{
+					MD5 inner;
+					inner.add(password.data(), password.size());
+					inner.add(user.data(), user.size());
+					inner.calculate();
+					const std::string inner_hash = inner.get_hash();
+
+					MD5 outer;
+					outer.add(inner_hash.data(), inner_hash.size());
+					outer.add(message.data + 4, 4);
+					outer.calculate();
+
+					const size_t reply = begin_message('p');
+					put_string("md5" + outer.get_hash());
+					end_message(reply);
+					flush();
+				}
+				else if (code == 10) // AuthenticationSASL
+				{
+					authenticate_scram(password, message);
+				}
+				else
+				{
+					throw Exception(string_format("Authentication method %1 is not supported by the native PostgreSQL engine", code));
+				}
+			}
+			break;
+		case 'K': // BackendKeyData
+			backend_pid = PgsqlBinary::read_int32(message.data);
+			backend_key = PgsqlBinary::read_int32(message.data + 4);
+			break;
+		case 'E':
+			throw to_exception(message);
+		case 'Z':
+			return;
+		default:
+			throw Exception("Unexpected message from the PostgreSQL server during startup");
+		}
+	}
+}
+
+void PgsqlWireConnection::authenticate_scram(const std::string &password, const Message &mechanisms)
+{
+	bool supported = false;
+	for (const char *name = mechanisms.data + 4; name < mechanisms.data + mechanisms.length && *name; name += std::strlen(name) + 1)
+		supported = supported || std::strcmp(name, "SCRAM-SHA-256") == 0;
+	if (!supported)
+		throw Exception("None of the SASL mechanisms offered by the server is supported");
+
+	unsigned char random_bytes[18];
+	Random random;
+	random.get_random_bytes(random_bytes, sizeof(random_bytes));
+	const std::string client_nonce = to_base64(std::string(reinterpret_cast<char*>(random_bytes), sizeof(random_bytes)));
+
+	// The user name is the one of the startup message; no channel binding
+	const std::string client_first_bare = "n=,r=" + client_nonce;
+	const std::string client_first = "n,," + client_first_bare;
+	size_t reply = begin_message('p');
+	put_string("SCRAM-SHA-256");
+	put_int32(client_first.size());
+	send_buffer += client_first;
+	end_message(reply);
+	flush();
+
+	Message message = read_message();
+	if (message.type == 'E')
+		throw to_exception(message);
+	if (message.type != 'R' || PgsqlBinary::read_int32(message.data) != 11)
+		throw Exception("Unexpected message from the PostgreSQL server during SCRAM authentication");
+	const std::string server_first(message.data + 4, message.length - 4);
+
+	const std::string nonce = scram_attribute(server_first, 'r');
+	const std::string salt = from_base64(scram_attribute(server_first, 's'));
+	const int iterations = StringHelp::text_to_int(scram_attribute(server_first, 'i'));
+	if (nonce.compare(0, client_nonce.size(), client_nonce) != 0 || iterations < 1)
+		throw Exception("Invalid SCRAM message from the server");
+
+	// SaltedPassword = Hi(password, salt, iterations), that is PBKDF2 with HMAC-SHA-256
+	unsigned char salted_password[32];
+	unsigned char block[32];
+	hmac_sha256(password, salt + std::string("\0\0\0\1", 4), block);
+	std::memcpy(salted_password, block, 32);
+	for (int i = 1; i < iterations; i++)
+	{
+		hmac_sha256(password, std::string(reinterpret_cast<char*>(block), 32), block);
+		for (int j = 0; j < 32; j++)
+			salted_password[j] ^= block[j];
+	}
+	const std::string salted(reinterpret_cast<char*>(salted_password), 32);
+
+	unsigned char client_key[32];
+	hmac_sha256(salted, "Client Key", client_key);
+	unsigned char stored_key[32];
+	SHA256 sha;
+	sha.add(client_key, 32);
+	sha.calculate();
+	sha.get_hash(stored_key);
+
+	const std::string client_final_without_proof = "c=biws,r=" + nonce;
+	const std::string auth_message = client_first_bare + "," + server_first + "," + client_final_without_proof;
+	unsigned char client_signature[32];
+	hmac_sha256(std::string(reinterpret_cast<char*>(stored_key), 32), auth_message, client_signature);
+	std::string proof(32, '\0');
+	for (int i = 0; i < 32; i++)
+		proof[i] = client_key[i] ^ client_signature[i];
+
+	const std::string client_final = client_final_without_proof + ",p=" + to_base64(proof);
+	reply = begin_message('p');
+	send_buffer += client_final;
+	end_message(reply);
+	flush();
+
+	message = read_message();
+	if (message.type == 'E')
+		throw to_exception(message);
+	if (message.type != 'R' || PgsqlBinary::read_int32(message.data) != 12)
+		throw Exception("Unexpected message from the PostgreSQL server during SCRAM authentication");
+
+	// Check the server knows the password too
+	unsigned char server_key[32];
+	hmac_sha256(salted, "Server Key", server_key);
+	unsigned char server_signature[32];
+	hmac_sha256(std::string(reinterpret_cast<char*>(server_key), 32), auth_message, server_signature);
+	const std::string server_final(message.data + 4, message.length - 4);
+	if (from_base64(scram_attribute(server_final, 'v')) != std::string(reinterpret_cast<char*>(server_signature), 32))
+		throw Exception("The PostgreSQL server failed the SCRAM authentication");
+}
+
+size_t PgsqlWireConnection::begin_message(char type)
+{
+	send_buffer.push_back(type);
+	const size_t position = send_buffer.size();
+	put_int32(0);
+	return position;
+}
+
+void PgsqlWireConnection::end_message(size_t position)
+{
+	PgsqlBinary::store_uint32(&send_buffer[position], send_buffer.size() - position);
+}
+
+void PgsqlWireConnection::put_int16(int value)
+{
+	PgsqlBinary::write_int16(send_buffer, value);
+}
+
+void PgsqlWireConnection::put_int32(int value)
+{
+	PgsqlBinary::write_int32(send_buffer, value);
+}
+
+void PgsqlWireConnection::put_string(const std::string &value)
+{
+	send_buffer.append(value.c_str(), value.size() + 1);
+}
+
+int PgsqlWireConnection::poll_socket(int timeout_ms) const
+{
+	// poll rather than select, which can't watch descriptors above FD_SETSIZE
+#ifdef WIN32
+	WSAPOLLFD descriptor;
+	descriptor.fd = socket;
+	descriptor.events = POLLRDNORM;
+	descriptor.revents = 0;
+	const int result = WSAPoll(&descriptor, 1, timeout_ms < 0 ? -1 : timeout_ms);
+#else
+	pollfd descriptor;
+	descriptor.fd = socket;
+	descriptor.events = POLLIN;
+	descriptor.revents = 0;
+	const int result = poll(&descriptor, 1, timeout_ms < 0 ? -1 : timeout_ms);
+#endif
+	return result;
+}
+
+bool PgsqlWireConnection::handle_async(const Message &message)
+{
+	const char *end = message.data + message.length;
+	switch (message.type)
+	{
+	case 'N': // NoticeResponse
+		return true;
+	case 'S': // ParameterStatus
+		{
+			const char *name_end = static_cast<const char*>(std::memchr(message.data, 0, message.length));
+			const char *value_end = name_end ? static_cast<const char*>(std::memchr(name_end + 1, 0, end - name_end - 1)) : nullptr;
+			if (!value_end)
+				throw Exception("Invalid message from the PostgreSQL server");
+			parameter_status[std::string(message.data, name_end)] = std::string(name_end + 1, value_end);
+		}
+		return true;
+	case 'A': // NotificationResponse
+		{
+			const char *channel = message.data + 4;
+			const char *channel_end = message.length >= 4 ? static_cast<const char*>(std::memchr(channel, 0, end - channel)) : nullptr;
+			const char *payload_end = channel_end ? static_cast<const char*>(std::memchr(channel_end + 1, 0, end - channel_end - 1)) : nullptr;
+			if (!payload_end)
+				throw Exception("Invalid message from the PostgreSQL server");
+			notifications.push_back(PgsqlNotification(std::string(channel, channel_end), std::string(channel_end + 1, payload_end), PgsqlBinary::read_int32(message.data)));
+		}
+		return true;
+	case 'Z': // ReadyForQuery
+		transaction_status = message.data[0];
+		return false;
+	default:
+		return false;
+	}
+}
+
+size_t PgsqlWireConnection::buffered_message_size() const
+{
+	if (write_position - read_position < 5)
+		return 0;
+	const int length = PgsqlBinary::read_int32(receive_buffer.data() + read_position + 1);
+	if (length < 4)
+		throw Exception("Invalid message from the PostgreSQL server");
+	return write_position - read_position >= 1 + static_cast<size_t>(length) ? 1 + length : 0;
+}
+
+PgsqlWireConnection::Message PgsqlWireConnection::take_message(size_t size)
+{
+	Message message;
+	message.type = receive_buffer[read_position];
+	message.data = receive_buffer.data() + read_position + 5;
+	message.length = size - 5;
+	read_position += size;
+	return message;
+}
+
+void PgsqlWireConnection::receive(size_t size)
+{
+	while (write_position - read_position < size)
+	{
+		// Move the unread bytes to the front, then grow the buffer if the message is still too big
+		if (read_position + size > receive_buffer.size())
+		{
+			std::memmove(receive_buffer.data(), receive_buffer.data() + read_position, write_position - read_position);
+			write_position -= read_position;
+			read_position = 0;
+			if (size > receive_buffer.size())
+				receive_buffer.resize(std::max(size, receive_buffer.size() * 2));
+		}
+
+		const int received = recv(socket, receive_buffer.data() + write_position, receive_buffer.size() - write_position, 0);
+		if (received <= 0)
+		{
+			lost = true;
+			throw Exception("Connection to the PostgreSQL server lost");
+		}
+		write_position += received;
+	}
+}
+
+void PgsqlWireConnection::receive_some()
+{
+	// Room for at least one more byte: receive makes it, keeping the unread bytes
+	receive(write_position - read_position + 1);
+}
+
+}; // namespace clan
@@ -0,0 +1,218 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+#include "ClanLib/Pgsql/pgsql_exception.h"
+#include "ClanLib/Pgsql/pgsql_notification_dispatcher.h"
+
+#ifdef WIN32
+#include <winsock2.h>
+#endif
+
+namespace clan
+{
+
+/// \brief Client side of the PostgreSQL frontend/backend protocol (version 3), without libpq.
+///
+/// Messages are received in one buffer reused for the whole connection; a
+/// message is parsed where it lies in that buffer and stays valid until the
+/// next message is read. Only plain TCP and Unix domain socket connections
+/// to a single host are supported (no SSL, GSSAPI encryption nor replication).
+class PgsqlWireConnection
+{
+/// \name Construction
+/// \{
+public:
+	typedef std::map<std::string, std::string> Parameters;
+
+	/// \brief Connect and authenticate (trust, password, md5 or SCRAM-SHA-256).
+	///
+	/// \param parameters = libpq connection keywords; host, hostaddr, port, dbname, user,
+	///        password, application_name, options and client_encoding are used, defaults
+	///        are taken from the environment like libpq does.
+	PgsqlWireConnection(const Parameters &parameters);
+	~PgsqlWireConnection();
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	/// \brief A message received from the server.
+	struct Message
+	{
+		char type;
+		const char *data;
+		int length;
+	};
+
+	/// \brief Transaction status given by the last ReadyForQuery: 'I' idle, 'T' in transaction, 'E' failed transaction.
+	char get_transaction_status() const { return transaction_status; }
+
+	int get_backend_pid() const { return backend_pid; }
+
+	/// \brief Value of a run-time parameter reported by the server (server_version, client_encoding...).
+	std::string get_parameter_status(const std::string &name) const;
+
+	/// \brief True once sending or receiving failed; reset() connects again.
+	bool is_lost() const { return lost; }
+
+	/// \brief True if notifications wait for get_notification.
+	bool has_notification() const { return !notifications.empty(); }
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	/// \brief Parse the conninfo string or URI given to PgsqlConnection.
+	static Parameters parse_connection_string(const std::string &connection_string);
+
+	/// \brief Queue a simple query (several statements allowed, text results).
+	void send_query(const std::string &sql);
+
+	/// \brief Queue Parse, Bind, Describe and Execute of the unnamed statement, then Sync.
+	void send_extended_query(const std::string &sql, int count, const Oid *types,
+		const char *const *values, const int *lengths, const int *formats, int result_format);
+
+	/// \brief Queue a CopyData message, a chunk of the input of COPY FROM STDIN.
+	void send_copy_data(const char *data, int size);
+
+	/// \brief Queue a CopyDone, ending the input of COPY FROM STDIN.
+	void send_copy_done();
+
+	/// \brief Queue a CopyFail, refusing the COPY FROM STDIN started by the server.
+	void send_copy_fail(const std::string &reason);
+
+	/// \brief Send the queued messages.
+	void flush();
+
+	/// \brief Read the next message. Notices, notifications and parameter changes are handled here.
+	///
+	/// Notifications are queued for get_notification.
+	///
+	/// The returned payload stays valid until the next call.
+	Message read_message();
+
+	/// \brief Read and drop messages until ReadyForQuery.
+	void skip_to_ready();
+
+	/// \brief Wait until a message is buffered or the socket is readable.
+	///
+	/// \param timeout_ms = Maximum wait in milliseconds, -1 to wait forever.
+	/// \return false if the timeout expired.
+	bool wait_for_input(int timeout_ms);
+
+	/// \brief Handle the messages received while no command runs (notifications, notices...), without blocking.
+	void consume_input();
+
+	/// \brief Take the oldest notification received; false if there is none.
+	bool get_notification(PgsqlNotification &notification);
+
+	/// \brief Close the socket and connect again, with the parameters given at construction.
+	///
+	/// The new server session has none of the state of the old one.
+	void reset();
+
+	/// \brief Build the exception described by an ErrorResponse.
+	static PgsqlException to_exception(const Message &message);
+
+	/// \brief Ask the server to cancel the command in progress (CancelRequest on a new socket).
+	void cancel();
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+#ifdef WIN32
+	typedef SOCKET Socket;
+#else
+	typedef int Socket;
+#endif
+
+	Socket open_socket() const;
+	static void close_socket(Socket socket);
+	void send_all(Socket socket, const char *data, size_t size);
+
+	void startup(const Parameters &parameters);
+	void authenticate_scram(const std::string &password, const Message &mechanisms);
+
+	/// \brief Start a message of the given type in the send buffer; returns the position of its length.
+	size_t begin_message(char type);
+	void end_message(size_t position);
+	void put_int16(int value);
+	void put_int32(int value);
+	void put_string(const std::string &value);
+
+	/// \brief Make size bytes available in the receive buffer, past the read position.
+	void receive(size_t size);
+
+	/// \brief poll the socket for reading: 1 if readable, 0 on timeout, -1 if interrupted.
+	int poll_socket(int timeout_ms) const;
+
+	/// \brief Receive what the socket holds, once, growing the receive buffer if it is full.
+	void receive_some();
+
+	/// \brief Size of the message at the read position if it is fully buffered, else 0.
+	size_t buffered_message_size() const;
+
+	/// \brief Take the fully buffered message of the given size at the read position.
+	Message take_message(size_t size);
+
+	/// \brief Handle a notice, parameter change or notification; false for the other messages.
+	bool handle_async(const Message &message);
+
+	Parameters parameters;
+	Socket socket;
+	std::string host;
+	std::string port;
+	std::string send_buffer;
+	std::vector<char> receive_buffer;
+	size_t read_position;
+	size_t write_position;
+	char transaction_status;
+	int backend_pid;
+	int backend_key;
+	std::map<std::string, std::string> parameter_status;
+	std::deque<PgsqlNotification> notifications;
+	bool lost;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
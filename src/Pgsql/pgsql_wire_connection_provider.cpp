@@ -0,0 +1,248 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include <memory>
+#include <algorithm>
+#include <cstring>
+#include <exception>
+
+#include "Pgsql/precomp.h"
+#include "pgsql_wire_connection_provider.h"
+#include "pgsql_wire_command_provider.h"
+#include "pgsql_wire_reader_provider.h"
+#include "pgsql_wire_transaction_provider.h"
+#include "ClanLib/Core/Text/string_help.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireConnectionProvider Construction:
+
+PgsqlWireConnectionProvider::PgsqlWireConnectionProvider(const Parameters &parameters)
+: wire(parameters), active_transaction(nullptr), active_reader(nullptr)
+{
+}
+
+PgsqlWireConnectionProvider::~PgsqlWireConnectionProvider()
+{
+	try
+	{
+		if (active_reader)
+			active_reader->close();
+		if (active_transaction)
+			active_transaction->rollback();
+	}
+	catch (const Exception &)
+	{
+	}
+	if (active_reader)
+		active_reader->connection = nullptr;
+	if (active_transaction)
+		active_transaction->connection = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireConnectionProvider Operations:
+
+DBCommandProvider *PgsqlWireConnectionProvider::create_command(const std::string &text, DBCommand::Type type)
+{
+	return new PgsqlWireCommandProvider(text, type);
+}
+
+DBTransactionProvider *PgsqlWireConnectionProvider::begin_transaction(DBTransaction::Type type)
+{
+	return new PgsqlWireTransactionProvider(this, type);
+}
+
+DBTransactionProvider *PgsqlWireConnectionProvider::begin_transaction(DBTransaction::Type type, PgsqlConnection::IsolationLevel isolation)
+{
+	return new PgsqlWireTransactionProvider(this, type, isolation);
+}
+
+DBReaderProvider *PgsqlWireConnectionProvider::execute_reader(DBCommandProvider *command)
+{
+	PgsqlWireCommandProvider *wire_command = dynamic_cast<PgsqlWireCommandProvider*>(command);
+	if (!wire_command)
+		throw Exception("The command was not created by this connection");
+	return new PgsqlWireReaderProvider(this, wire_command);
+}
+
+std::string PgsqlWireConnectionProvider::execute_scalar_string(DBCommandProvider *command)
+{
+	std::unique_ptr<PgsqlWireReaderProvider> reader(static_cast<PgsqlWireReaderProvider*>(execute_reader(command)));
+	if (!reader->retrieve_row())
+		throw Exception("Database command statement returned no value");
+	std::string value = reader->get_column_string(0);
+	reader->finish();
+	return value;
+}
+
+int PgsqlWireConnectionProvider::execute_scalar_int(DBCommandProvider *command)
+{
+	std::unique_ptr<PgsqlWireReaderProvider> reader(static_cast<PgsqlWireReaderProvider*>(execute_reader(command)));
+	if (!reader->retrieve_row())
+		throw Exception("Database command statement returned no value");
+	int value = reader->get_column_int(0);
+	reader->finish();
+	return value;
+}
+
+void PgsqlWireConnectionProvider::execute_non_query(DBCommandProvider *command)
+{
+	std::unique_ptr<PgsqlWireReaderProvider> reader(static_cast<PgsqlWireReaderProvider*>(execute_reader(command)));
+	reader->finish();
+}
+
+long long PgsqlWireConnectionProvider::copy_from(const std::string &sql, const std::string &data)
+{
+	finish_active_reader();
+	wire.send_query(sql);
+	wire.flush();
+
+	long long rows = 0;
+	while (true)
+	{
+		const PgsqlWireConnection::Message message = wire.read_message();
+		switch (message.type)
+		{
+		case 'G': // CopyInResponse
+			{
+				// Sent in chunks straight from data, not gathered in the send buffer
+				const size_t chunk_size = 1024 * 1024;
+				for (size_t pos = 0; pos < data.size(); pos += chunk_size)
+				{
+					wire.send_copy_data(data.data() + pos, std::min(chunk_size, data.size() - pos));
+					wire.flush();
+				}
+				wire.send_copy_done();
+				wire.flush();
+			}
+			break;
+		case 'W': // CopyBothResponse
+			wire.send_copy_fail("COPY BOTH is not supported by copy_from");
+			wire.flush();
+			break;
+		case 'C': // CommandComplete
+			rows = command_rows(message);
+			break;
+		case 'E':
+			{
+				const PgsqlException error = PgsqlWireConnection::to_exception(message);
+				wire.skip_to_ready();
+				throw error;
+			}
+		case 'Z':
+			return rows;
+		default:
+			break;
+		}
+	}
+}
+
+long long PgsqlWireConnectionProvider::copy_to(const std::string &sql, const PgsqlConnection::CopyHandler &handler)
+{
+	finish_active_reader();
+	wire.send_query(sql);
+	wire.flush();
+
+	// After a failure of handler, the rows still coming are dropped
+	long long rows = 0;
+	std::exception_ptr error;
+	std::exception_ptr server_error;
+	while (true)
+	{
+		const PgsqlWireConnection::Message message = wire.read_message();
+		switch (message.type)
+		{
+		case 'd': // CopyData, pointing into the receive buffer
+			if (!error)
+			{
+				try
+				{
+					handler(message.data, message.length);
+				}
+				catch (...)
+				{
+					error = std::current_exception();
+					wire.cancel();
+				}
+			}
+			break;
+		case 'G':
+		case 'W':
+			wire.send_copy_fail("COPY FROM STDIN is not supported by copy_to");
+			wire.flush();
+			break;
+		case 'C':
+			rows = command_rows(message);
+			break;
+		case 'E':
+			if (!server_error)
+				server_error = std::make_exception_ptr(PgsqlWireConnection::to_exception(message));
+			break;
+		case 'Z':
+			if (error)
+				std::rethrow_exception(error);
+			if (server_error)
+				std::rethrow_exception(server_error);
+			return rows;
+		default:
+			break;
+		}
+	}
+}
+
+void PgsqlWireConnectionProvider::finish_active_reader()
+{
+	if (active_reader)
+		active_reader->detach();
+}
+
+void PgsqlWireConnectionProvider::reset()
+{
+	if (active_transaction)
+		throw Exception("Unable to reconnect: the connection was lost inside a transaction");
+	// The reader fails to read the rest of its rows, and keeps the error for its user
+	finish_active_reader();
+	wire.reset();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireConnectionProvider Implementation:
+
+long long PgsqlWireConnectionProvider::command_rows(const PgsqlWireConnection::Message &message)
+{
+	// The tag ends with the row count: "COPY 42", "INSERT 0 42"...
+	const char *end = static_cast<const char*>(std::memchr(message.data, 0, message.length));
+	const std::string tag(message.data, end ? end : message.data + message.length);
+	const size_t space = tag.rfind(' ');
+	return space != std::string::npos ? StringHelp::text_to_ll(tag.substr(space + 1)) : 0;
+}
+
+}; // namespace clan
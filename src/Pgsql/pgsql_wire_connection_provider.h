@@ -0,0 +1,113 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "ClanLib/Database/db_connection_provider.h"
+#include "pgsql_wire_connection.h"
+
+namespace clan
+{
+
+class PgsqlWireReaderProvider;
+class PgsqlWireTransactionProvider;
+
+/// \brief Pgsql database connection provider of the native engine.
+///
+/// Speaks the frontend/backend protocol directly instead of going through
+/// libpq, so rows are read from the network buffer without being copied
+/// into a PGresult first. Selected with clanpgsql_engine=native.
+class PgsqlWireConnectionProvider : public DBConnectionProvider
+{
+/// \name Construction
+/// \{
+public:
+	typedef PgsqlConnection::Parameters Parameters;
+
+	PgsqlWireConnectionProvider(const Parameters &parameters);
+	~PgsqlWireConnectionProvider();
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	PgsqlWireConnection &get_wire() { return wire; }
+
+	/// \brief True while a transaction started by begin_transaction is active.
+	bool in_transaction() const { return active_transaction != nullptr; }
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	DBCommandProvider *create_command(const std::string &text, DBCommand::Type type);
+	DBTransactionProvider *begin_transaction(DBTransaction::Type type);
+	DBTransactionProvider *begin_transaction(DBTransaction::Type type, PgsqlConnection::IsolationLevel isolation);
+	DBReaderProvider *execute_reader(DBCommandProvider *command);
+	std::string execute_scalar_string(DBCommandProvider *command);
+	int execute_scalar_int(DBCommandProvider *command);
+	void execute_non_query(DBCommandProvider *command);
+
+	/// \brief See PgsqlConnection::copy_from.
+	long long copy_from(const std::string &sql, const std::string &data);
+
+	/// \brief See PgsqlConnection::copy_to.
+	long long copy_to(const std::string &sql, const PgsqlConnection::CopyHandler &handler);
+
+	/// \brief Read the rest of the reader still receiving rows, so that a new command can be sent.
+	void finish_active_reader();
+
+	/// \brief Connect again after the connection was lost (see PgsqlWireConnection::reset).
+	///
+	/// Throws if a transaction is active, since the new session does not have it.
+	void reset();
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	/// \brief Row count at the end of a CommandComplete tag, 0 if it has none.
+	static long long command_rows(const PgsqlWireConnection::Message &message);
+
+	PgsqlWireConnection wire;
+	PgsqlWireTransactionProvider *active_transaction;
+	PgsqlWireReaderProvider *active_reader;
+
+	friend class PgsqlWireReaderProvider;
+	friend class PgsqlWireTransactionProvider;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
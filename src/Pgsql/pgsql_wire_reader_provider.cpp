@@ -0,0 +1,411 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include "Pgsql/precomp.h"
+#include "pgsql_wire_reader_provider.h"
+#include "pgsql_wire_connection_provider.h"
+#include "pgsql_wire_command_provider.h"
+#include "pgsql_binary.h"
+#include "pgsql_value.h"
+#include "pg_type.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/System/datetime.h"
+#include "ClanLib/Core/Text/string_format.h"
+
+#include <cstring>
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireReaderProvider Construction:
+
+PgsqlWireReaderProvider::PgsqlWireReaderProvider(PgsqlWireConnectionProvider *connection, PgsqlWireCommandProvider *command)
+: connection(connection), row_data(nullptr), row_length(0), has_row(false), receiving_rows(false), copy_rows(false), finished(false), detached(false)
+{
+	connection->finish_active_reader();
+
+	PgsqlWireConnection &wire = connection->get_wire();
+	command->send(wire);
+	wire.flush();
+	connection->active_reader = this;
+	try
+	{
+		read_row_description();
+	}
+	catch (...)
+	{
+		// The connection was lost, or the error was read up to ReadyForQuery
+		if (connection->active_reader == this)
+			connection->active_reader = nullptr;
+		throw;
+	}
+}
+
+PgsqlWireReaderProvider::~PgsqlWireReaderProvider()
+{
+	close();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireReaderProvider Attributes:
+
+int PgsqlWireReaderProvider::get_column_count() const
+{
+	return columns.size();
+}
+
+std::string PgsqlWireReaderProvider::get_column_name(int index) const
+{
+	if (index < 0 || index >= (int)columns.size())
+		throw Exception("Index out of range");
+	return columns[index].name;
+}
+
+int PgsqlWireReaderProvider::get_name_index(const std::string &name) const
+{
+	for (size_t i = 0; i < columns.size(); i++)
+	{
+		if (columns[i].name == name)
+			return i;
+	}
+	throw Exception(string_format("No such column name %1", name));
+}
+
+std::string PgsqlWireReaderProvider::get_column_string(int index) const
+{
+	return get_column_value(index).to_string();
+}
+
+bool PgsqlWireReaderProvider::get_column_bool(int index) const
+{
+	return get_column_value(index).to_bool();
+}
+
+char PgsqlWireReaderProvider::get_column_char(int index) const
+{
+	return static_cast<int>(get_column_value(index).to_int());
+}
+
+unsigned char PgsqlWireReaderProvider::get_column_uchar(int index) const
+{
+	return static_cast<unsigned char>(get_column_value(index).to_uint());
+}
+
+int PgsqlWireReaderProvider::get_column_int(int index) const
+{
+	return get_column_value(index).to_int();
+}
+
+unsigned int PgsqlWireReaderProvider::get_column_uint(int index) const
+{
+	return get_column_value(index).to_uint();
+}
+
+double PgsqlWireReaderProvider::get_column_double(int index) const
+{
+	return get_column_value(index).to_double();
+}
+
+DateTime PgsqlWireReaderProvider::get_column_datetime(int index) const
+{
+	return get_column_value(index).to_datetime();
+}
+
+DataBuffer PgsqlWireReaderProvider::get_column_binary(int index) const
+{
+	return get_column_value(index).to_binary();
+}
+
+PgsqlValue PgsqlWireReaderProvider::get_column_value(int index) const
+{
+	if (!has_row || index < 0 || index >= (int)columns.size())
+		throw Exception("Index out of range");
+
+	// Like libpq, NULL reads as an empty value
+	return PgsqlValue(values[index] ? values[index] : "", lengths[index], columns[index].type, columns[index].format);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireReaderProvider Operations:
+
+bool PgsqlWireReaderProvider::retrieve_row()
+{
+	if (detached)
+	{
+		if (detached_rows.empty())
+		{
+			has_row = false;
+			if (detached_error)
+			{
+				std::exception_ptr error = detached_error;
+				detached_error = std::exception_ptr();
+				std::rethrow_exception(error);
+			}
+			return false;
+		}
+		detached_row.swap(detached_rows.front());
+		detached_rows.pop_front();
+		parse_row(detached_row.data(), detached_row.size());
+		return true;
+	}
+
+	has_row = false;
+	PgsqlWireConnection &wire = connection->get_wire();
+	while (receiving_rows)
+	{
+		const PgsqlWireConnection::Message message = wire.read_message();
+		switch (message.type)
+		{
+		case 'D': // DataRow
+		case 'd': // CopyData
+			parse_row(message.data, message.length);
+			return true;
+		case 'C': // CommandComplete
+		case 's': // PortalSuspended
+			finish();
+			return false;
+		case 'E':
+			throw_error(message);
+		default:
+			break;
+		}
+	}
+	return false;
+}
+
+void PgsqlWireReaderProvider::close()
+{
+	has_row = false;
+	detached_rows.clear();
+	detached_error = std::exception_ptr();
+	if (!finished && connection)
+	{
+		try
+		{
+			finish();
+		}
+		catch (const Exception &)
+		{
+		}
+	}
+}
+
+void PgsqlWireReaderProvider::finish()
+{
+	if (finished)
+		return;
+	receiving_rows = false;
+
+	PgsqlWireConnection &wire = connection->get_wire();
+	while (true)
+	{
+		const PgsqlWireConnection::Message message = wire.read_message();
+		switch (message.type)
+		{
+		case 'E':
+			throw_error(message);
+		case 'G': // CopyInResponse
+		case 'W': // CopyBothResponse
+			refuse_copy();
+			break;
+		case 'Z':
+			finished = true;
+			connection->active_reader = nullptr;
+			return;
+		default:
+			break;
+		}
+	}
+}
+
+void PgsqlWireReaderProvider::detach()
+{
+	if (finished)
+		return;
+
+	// The current row points into the receive buffer, which is about to be reused
+	if (has_row)
+	{
+		detached_row.assign(row_data, row_length);
+		parse_row(detached_row.data(), detached_row.size());
+	}
+	detached = true;
+
+	PgsqlWireConnection &wire = connection->get_wire();
+	try
+	{
+		while (receiving_rows)
+		{
+			const PgsqlWireConnection::Message message = wire.read_message();
+			if (message.type == 'D' || message.type == 'd')
+				detached_rows.push_back(std::string(message.data, message.length));
+			else if (message.type == 'C' || message.type == 's')
+				receiving_rows = false;
+			else if (message.type == 'E')
+				throw_error(message);
+		}
+		finish();
+	}
+	catch (const Exception &)
+	{
+		detached_error = std::current_exception();
+		if (!finished)
+		{
+			// The connection was lost
+			finished = true;
+			connection->active_reader = nullptr;
+		}
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireReaderProvider Implementation:
+
+void PgsqlWireReaderProvider::read_row_description()
+{
+	PgsqlWireConnection &wire = connection->get_wire();
+	while (true)
+	{
+		const PgsqlWireConnection::Message message = wire.read_message();
+		switch (message.type)
+		{
+		case 'T': // RowDescription
+			{
+				const char *pos = message.data + 2;
+				const char *end = message.data + message.length;
+				if (message.length < 2)
+					throw Exception("Invalid row description from the PostgreSQL server");
+				columns.resize(PgsqlBinary::read_int16(message.data));
+				for (Column &column : columns)
+				{
+					const char *name_end = static_cast<const char*>(std::memchr(pos, 0, end - pos));
+					if (!name_end || end - name_end < 19)
+						throw Exception("Invalid row description from the PostgreSQL server");
+					column.name.assign(pos, name_end);
+					pos = name_end + 1;
+					column.type = PgsqlBinary::read_uint32(pos + 6);
+					column.format = PgsqlBinary::read_int16(pos + 16);
+					pos += 18;
+				}
+				values.resize(columns.size());
+				lengths.resize(columns.size());
+				receiving_rows = true;
+			}
+			return;
+		case 'H': // CopyOutResponse
+			{
+				// Each CopyData message is a row of one column, text or bytea for FORMAT binary
+				if (message.length < 1)
+					throw Exception("Invalid copy response from the PostgreSQL server");
+				columns.resize(1);
+				columns[0].name = "copy";
+				columns[0].format = message.data[0];
+				columns[0].type = columns[0].format ? BYTEAOID : TEXTOID;
+				values.resize(1);
+				lengths.resize(1);
+				copy_rows = true;
+				receiving_rows = true;
+			}
+			return;
+		case 'E':
+			throw_error(message);
+		case 'G':
+		case 'W':
+			refuse_copy();
+			break;
+		case 'Z':
+			finished = true;
+			connection->active_reader = nullptr;
+			return;
+		default:
+			// ParseComplete, BindComplete, NoData, CommandComplete of statements without rows...
+			break;
+		}
+	}
+}
+
+void PgsqlWireReaderProvider::parse_row(const char *data, int length)
+{
+	if (copy_rows)
+	{
+		values[0] = data;
+		lengths[0] = length;
+		row_data = data;
+		row_length = length;
+		has_row = true;
+		return;
+	}
+
+	if (PgsqlBinary::read_int16(data) != (int)columns.size())
+		throw Exception("Invalid row from the PostgreSQL server");
+
+	const char *pos = data + 2;
+	const char *end = data + length;
+	for (size_t i = 0; i < columns.size(); i++)
+	{
+		if (end - pos < 4)
+			throw Exception("Invalid row from the PostgreSQL server");
+		const int value_length = PgsqlBinary::read_int32(pos);
+		pos += 4;
+		if (value_length < 0)
+		{
+			values[i] = nullptr;
+			lengths[i] = 0;
+			continue;
+		}
+		if (end - pos < value_length)
+			throw Exception("Invalid row from the PostgreSQL server");
+		values[i] = pos;
+		lengths[i] = value_length;
+		pos += value_length;
+	}
+	row_data = data;
+	row_length = length;
+	has_row = true;
+}
+
+void PgsqlWireReaderProvider::throw_error(const PgsqlWireConnection::Message &message)
+{
+	// The message is overwritten by the next read
+	const PgsqlException error = PgsqlWireConnection::to_exception(message);
+	receiving_rows = false;
+	connection->get_wire().skip_to_ready();
+	finished = true;
+	connection->active_reader = nullptr;
+	throw error;
+}
+
+void PgsqlWireReaderProvider::refuse_copy()
+{
+	PgsqlWireConnection &wire = connection->get_wire();
+	wire.send_copy_fail("COPY FROM STDIN has no input in a DBCommand: use PgsqlConnection::copy_from");
+	wire.flush();
+}
+
+}; // namespace clan
@@ -0,0 +1,152 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+/// \addtogroup clanPgsql_System clanPgsql System
+/// \{
+
+
+#pragma once
+
+#include <deque>
+#include <exception>
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+#include "ClanLib/Database/db_reader_provider.h"
+#include "pgsql_wire_connection.h"
+
+namespace clan
+{
+
+class PgsqlWireConnectionProvider;
+class PgsqlWireCommandProvider;
+class PgsqlValue;
+
+/// \brief Pgsql database reader provider of the native engine.
+///
+/// Rows are read one DataRow message at a time and the column values point
+/// into the receive buffer of the connection: a row is valid until the next
+/// call to retrieve_row. Another command run before the last row copies the
+/// remaining rows out of the connection (see detach).
+///
+/// Only the rows of the first statement returning rows are read; the results
+/// of the following statements are checked for errors and dropped. The rows
+/// of COPY TO STDOUT have one column, named copy, holding a CopyData message:
+/// a line of text or csv, or a bytea chunk of FORMAT binary.
+class PgsqlWireReaderProvider : public DBReaderProvider
+{
+/// \name Construction
+/// \{
+public:
+	PgsqlWireReaderProvider(PgsqlWireConnectionProvider *connection, PgsqlWireCommandProvider *command);
+	~PgsqlWireReaderProvider();
+/// \}
+
+/// \name Attributes
+/// \{
+public:
+	int get_column_count() const;
+	std::string get_column_name(int index) const;
+	int get_name_index(const std::string &name) const;
+	std::string get_column_string(int index) const;
+	bool get_column_bool(int index) const;
+	char get_column_char(int index) const;
+	unsigned char get_column_uchar(int index) const;
+	int get_column_int(int index) const;
+	unsigned int get_column_uint(int index) const;
+	double get_column_double(int index) const;
+	DateTime get_column_datetime(int index) const;
+	DataBuffer get_column_binary(int index) const;
+
+	/// \brief Returns the field of the current row.
+	PgsqlValue get_column_value(int index) const;
+/// \}
+
+/// \name Operations
+/// \{
+public:
+	bool retrieve_row();
+	void close();
+
+	/// \brief Read the remaining messages of the command, throwing if one of its statements failed.
+	void finish();
+
+	/// \brief Copy the remaining rows out of the connection, which is needed for another command.
+	///
+	/// The reader then serves the copied rows; an error met while copying
+	/// is thrown when the rows before it have been read.
+	void detach();
+/// \}
+
+/// \name Implementation
+/// \{
+private:
+	/// \brief A column of the RowDescription.
+	struct Column
+	{
+		std::string name;
+		Oid type;
+		int format;
+	};
+
+	/// \brief Read messages until the first rows, or the end of the command.
+	void read_row_description();
+
+	/// \brief Point the values of the current row into a DataRow payload.
+	void parse_row(const char *data, int length);
+
+	/// \brief Handle an ErrorResponse: read until ReadyForQuery, then throw.
+	void throw_error(const PgsqlWireConnection::Message &message);
+
+	/// \brief Abort a COPY FROM STDIN started by the command, which has no input to send.
+	void refuse_copy();
+
+	PgsqlWireConnectionProvider *connection;
+	std::vector<Column> columns;
+	std::vector<const char*> values;
+	std::vector<int> lengths;
+	const char *row_data;
+	int row_length;
+	bool has_row;
+	bool receiving_rows;
+	bool copy_rows;
+	bool finished;
+
+	std::deque<std::string> detached_rows;
+	std::string detached_row;
+	std::exception_ptr detached_error;
+	bool detached;
+
+	friend class PgsqlWireConnectionProvider;
+/// \}
+};
+
+}; // namespace clan
+
+/// \}
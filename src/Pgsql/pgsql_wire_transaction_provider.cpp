@@ -0,0 +1,97 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+#include <memory>
+
+#include "Pgsql/precomp.h"
+#include "pgsql_wire_transaction_provider.h"
+#include "pgsql_wire_connection_provider.h"
+#include "pgsql_transaction_provider.h"
+#include "ClanLib/Database/db_command_provider.h"
+
+namespace clan
+{
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireTransactionProvider Construction:
+
+PgsqlWireTransactionProvider::PgsqlWireTransactionProvider(PgsqlWireConnectionProvider *connection, DBTransaction::Type type,
+	PgsqlConnection::IsolationLevel isolation)
+: connection(connection)
+{
+	if (connection->active_transaction)
+		throw Exception("Only one database transaction may be active for a connection");
+	for (const std::string &statement : PgsqlTransactionProvider::get_start_statements(type, isolation))
+		execute(statement);
+	connection->active_transaction = this;
+}
+
+PgsqlWireTransactionProvider::~PgsqlWireTransactionProvider()
+{
+	try
+	{
+		rollback();
+	}
+	catch (const Exception &)
+	{
+	}
+	if (connection && connection->active_transaction == this)
+		connection->active_transaction = nullptr;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireTransactionProvider Operations:
+
+void PgsqlWireTransactionProvider::commit()
+{
+	if (connection && connection->active_transaction == this)
+	{
+		connection->active_transaction = nullptr;
+		execute("COMMIT;");
+	}
+}
+
+void PgsqlWireTransactionProvider::rollback()
+{
+	if (connection && connection->active_transaction == this)
+	{
+		connection->active_transaction = nullptr;
+		execute("ROLLBACK;");
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWireTransactionProvider Implementation:
+
+void PgsqlWireTransactionProvider::execute(const std::string &statement)
+{
+	std::unique_ptr<DBCommandProvider> command(connection->create_command(statement, DBCommand::sql_statement));
+	connection->execute_non_query(command.get());
+}
+
+}; // namespace clan
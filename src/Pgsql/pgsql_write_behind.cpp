@@ -0,0 +1,583 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "Pgsql/precomp.h"
+#include "ClanLib/Pgsql/pgsql_write_behind.h"
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "ClanLib/Core/System/databuffer.h"
+#include "ClanLib/Core/System/datetime.h"
+#include "ClanLib/Core/Text/string_help.h"
+#include "pgsql_connection_provider.h"
+#include "pgsql_row_queue.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+namespace clan
+{
+
+class PgsqlWriteBehind_Impl
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	struct Table
+	{
+		std::string copy_statement;
+		int column_count;
+	};
+
+	PgsqlWriteBehind_Impl(PgsqlConnection &connection, int capacity, PgsqlWriteBehind::OverflowPolicy overflow)
+	: connection(connection), provider(PgsqlConnectionProvider::from_connection(connection)),
+	  queue(capacity > 0 ? capacity : 1), overflow(overflow), max_rows(5000), max_delay_ms(200), synchronous_commit(true),
+	  running(false), stopping(false), flush_target(0), handled_count(0), written_count(0), dropped_count(0), failed_count(0)
+	{
+	}
+
+	~PgsqlWriteBehind_Impl()
+	{
+		stop();
+	}
+
+	bool write(int table, const PgsqlWriteBehindRow &row);
+	void flush();
+	void start();
+	void stop();
+
+	PgsqlConnection connection;
+	PgsqlConnectionProvider *provider;
+	std::vector<Table> tables;
+	PgsqlRowQueue queue;
+	PgsqlWriteBehind::OverflowPolicy overflow;
+	PgsqlWriteBehind::ErrorHandler error_handler;
+	std::atomic<int> max_rows;
+	std::atomic<int> max_delay_ms;
+	std::atomic<bool> synchronous_commit;
+
+	std::atomic<bool> running;
+	std::atomic<bool> stopping;
+
+	/// \brief Guards flush_target, error_handler and the waits on the events.
+	std::mutex mutex;
+	std::condition_variable wake_event;
+	std::condition_variable done_event;
+	size_t flush_target;
+
+	/// \brief Rows taken out of the queue and written or lost; compared to the queue positions.
+	std::atomic<size_t> handled_count;
+
+	std::atomic<unsigned long long> written_count;
+	std::atomic<unsigned long long> dropped_count;
+	std::atomic<unsigned long long> failed_count;
+
+private:
+	void run();
+	void write_batches(std::vector<std::string> &buffers, std::vector<int> &row_counts, int pending);
+
+	/// \brief Write the rows of one table, or of all of them with table -1, in one transaction.
+	///
+	/// Tries again once on a new connection if the connection was lost.
+	/// \return false, setting error, if the transaction failed.
+	bool try_write_transaction(const std::vector<std::string> &buffers, const std::vector<int> &row_counts, int table, Exception &error);
+	void write_transaction(const std::vector<std::string> &buffers, const std::vector<int> &row_counts, int only_table);
+	void report_failure(const Exception &error, int lost_rows);
+	void execute(const char *sql);
+
+	std::thread thread;
+};
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWriteBehindRow Operations:
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add_null()
+{
+	begin_field();
+	data += "\\N";
+	return *this;
+}
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add(bool value)
+{
+	begin_field();
+	data += value ? 't' : 'f';
+	return *this;
+}
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add(int value)
+{
+	begin_field();
+	data += StringHelp::int_to_text(value);
+	return *this;
+}
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add(long long value)
+{
+	begin_field();
+	data += StringHelp::ll_to_text(value);
+	return *this;
+}
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add(double value)
+{
+	begin_field();
+	if (std::isnan(value))
+	{
+		data += "NaN";
+	}
+	else if (std::isinf(value))
+	{
+		data += value > 0 ? "Infinity" : "-Infinity";
+	}
+	else
+	{
+		char buffer[32];
+		snprintf(buffer, sizeof(buffer), "%.17g", value);
+		data += buffer;
+	}
+	return *this;
+}
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add(const char *value)
+{
+	return add(std::string(value));
+}
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add(const std::string &value)
+{
+	begin_field();
+	data.reserve(data.size() + value.size());
+	for (char c : value)
+	{
+		switch (c)
+		{
+		case '\\': data += "\\\\"; break;
+		case '\n': data += "\\n"; break;
+		case '\r': data += "\\r"; break;
+		case '\t': data += "\\t"; break;
+		default: data += c; break;
+		}
+	}
+	return *this;
+}
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add(const DateTime &value)
+{
+	return add(value.to_short_datetime_string());
+}
+
+PgsqlWriteBehindRow &PgsqlWriteBehindRow::add(const DataBuffer &value)
+{
+	static const char digits[] = "0123456789abcdef";
+	begin_field();
+
+	// bytea hex input, its backslash escaped for COPY
+	data += "\\\\x";
+	const unsigned char *bytes = reinterpret_cast<const unsigned char*>(value.get_data());
+	for (unsigned int i = 0; i < value.get_size(); i++)
+	{
+		data += digits[bytes[i] >> 4];
+		data += digits[bytes[i] & 15];
+	}
+	return *this;
+}
+
+void PgsqlWriteBehindRow::clear()
+{
+	data.clear();
+	field_count = 0;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWriteBehindRow Implementation:
+
+void PgsqlWriteBehindRow::begin_field()
+{
+	if (field_count)
+		data += '\t';
+	field_count++;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWriteBehind Construction:
+
+PgsqlWriteBehind::PgsqlWriteBehind(PgsqlConnection &connection, int capacity, OverflowPolicy overflow)
+: impl(std::make_shared<PgsqlWriteBehind_Impl>(connection, capacity, overflow))
+{
+}
+
+PgsqlWriteBehind::~PgsqlWriteBehind()
+{
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWriteBehind Attributes:
+
+bool PgsqlWriteBehind::is_running() const
+{
+	return impl->running;
+}
+
+unsigned long long PgsqlWriteBehind::get_written_count() const
+{
+	return impl->written_count;
+}
+
+unsigned long long PgsqlWriteBehind::get_dropped_count() const
+{
+	return impl->dropped_count;
+}
+
+unsigned long long PgsqlWriteBehind::get_failed_count() const
+{
+	return impl->failed_count;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWriteBehind Operations:
+
+int PgsqlWriteBehind::add_table(const std::string &table, const std::vector<std::string> &columns)
+{
+	if (impl->running)
+		throw Exception("PgsqlWriteBehind tables must be added before start()");
+	if (columns.empty())
+		throw Exception("PgsqlWriteBehind tables need at least one column");
+
+	PgsqlWriteBehind_Impl::Table entry;
+	entry.copy_statement = "COPY " + table + " (";
+	for (size_t i = 0; i < columns.size(); i++)
+		entry.copy_statement += (i ? ", " : "") + columns[i];
+	entry.copy_statement += ") FROM STDIN";
+	entry.column_count = columns.size();
+	impl->tables.push_back(entry);
+	return impl->tables.size() - 1;
+}
+
+void PgsqlWriteBehind::set_flush_threshold(int max_rows, int max_delay_ms)
+{
+	impl->max_rows = max_rows > 0 ? max_rows : 1;
+	impl->max_delay_ms = max_delay_ms > 0 ? max_delay_ms : 1;
+}
+
+void PgsqlWriteBehind::set_synchronous_commit(bool enable)
+{
+	impl->synchronous_commit = enable;
+}
+
+void PgsqlWriteBehind::set_error_handler(const ErrorHandler &handler)
+{
+	std::lock_guard<std::mutex> lock(impl->mutex);
+	impl->error_handler = handler;
+}
+
+void PgsqlWriteBehind::start()
+{
+	impl->start();
+}
+
+bool PgsqlWriteBehind::write(int table, const PgsqlWriteBehindRow &row)
+{
+	return impl->write(table, row);
+}
+
+void PgsqlWriteBehind::flush()
+{
+	impl->flush();
+}
+
+void PgsqlWriteBehind::stop()
+{
+	impl->stop();
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWriteBehind_Impl Operations:
+
+bool PgsqlWriteBehind_Impl::write(int table, const PgsqlWriteBehindRow &row)
+{
+	if (table < 0 || table >= static_cast<int>(tables.size()))
+		throw Exception("Invalid PgsqlWriteBehind table index");
+	if (row.get_field_count() != tables[table].column_count)
+		throw Exception("PgsqlWriteBehindRow value count does not match the columns of its table");
+
+	std::string line;
+	line.reserve(row.get_data().size() + 1);
+	line = row.get_data();
+	line += '\n';
+
+	for (int attempt = 0; !queue.push(table, line); attempt++)
+	{
+		if (overflow == PgsqlWriteBehind::drop_when_full)
+		{
+			dropped_count++;
+			return false;
+		}
+		if (!running)
+			throw Exception("PgsqlWriteBehind queue is full and its writer thread is not running");
+		wake_event.notify_one();
+		if (attempt < 16)
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	// Wake the writer early when a full batch is waiting
+	if (queue.get_enqueue_position() - handled_count.load() >= static_cast<size_t>(max_rows))
+		wake_event.notify_one();
+	return true;
+}
+
+void PgsqlWriteBehind_Impl::flush()
+{
+	if (!running)
+		throw Exception("PgsqlWriteBehind::flush needs the writer thread; call start() first");
+
+	const size_t target = queue.get_enqueue_position();
+	std::unique_lock<std::mutex> lock(mutex);
+	flush_target = std::max(flush_target, target);
+	wake_event.notify_one();
+	done_event.wait(lock, [&] { return handled_count >= target || !running; });
+}
+
+void PgsqlWriteBehind_Impl::start()
+{
+	if (running)
+		return;
+	stopping = false;
+	running = true;
+	thread = std::thread(&PgsqlWriteBehind_Impl::run, this);
+}
+
+void PgsqlWriteBehind_Impl::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		wake_event.notify_one();
+	}
+
+	if (thread.joinable())
+		thread.join();
+	else if (!queue.is_empty())
+		run(); // Never started: write the queued rows from here
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// PgsqlWriteBehind_Impl Implementation:
+
+void PgsqlWriteBehind_Impl::run()
+{
+	std::vector<std::string> buffers(tables.size());
+	std::vector<int> row_counts(tables.size());
+	int pending = 0;
+	Clock::time_point oldest;
+
+	while (true)
+	{
+		const int batch_rows = max_rows;
+		const int delay_limit_ms = max_delay_ms;
+		while (pending < batch_rows && queue.pop(buffers, row_counts))
+		{
+			if (pending++ == 0)
+				oldest = Clock::now();
+		}
+
+		bool write_now;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			write_now = pending >= batch_rows || stopping || handled_count + pending <= flush_target ||
+				Clock::now() - oldest >= std::chrono::milliseconds(delay_limit_ms);
+		}
+		if (pending > 0 && write_now)
+		{
+			write_batches(buffers, row_counts, pending);
+			pending = 0;
+			continue;
+		}
+
+		std::unique_lock<std::mutex> lock(mutex);
+		if (queue.is_empty())
+		{
+			if (stopping)
+				break;
+			if (pending == 0 && handled_count < flush_target)
+				continue; // Rows of the flush still being pushed
+
+			const int delay_ms = pending > 0 ? delay_limit_ms - static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - oldest).count()) : delay_limit_ms;
+			wake_event.wait_for(lock, std::chrono::milliseconds(std::max(delay_ms, 1)));
+		}
+	}
+
+	running = false;
+	std::lock_guard<std::mutex> lock(mutex);
+	done_event.notify_all();
+}
+
+void PgsqlWriteBehind_Impl::write_batches(std::vector<std::string> &buffers, std::vector<int> &row_counts, int pending)
+{
+	Exception error("");
+	int table_count = 0;
+	for (int rows : row_counts)
+		table_count += rows > 0 ? 1 : 0;
+
+	if (try_write_transaction(buffers, row_counts, -1, error))
+	{
+		written_count += pending;
+	}
+	else if (table_count == 1)
+	{
+		report_failure(error, pending);
+	}
+	else
+	{
+		// Write each table on its own, so that only the rows of the failing tables are lost
+		for (size_t table = 0; table < tables.size(); table++)
+		{
+			if (row_counts[table] == 0)
+				continue;
+			if (try_write_transaction(buffers, row_counts, table, error))
+				written_count += row_counts[table];
+			else
+				report_failure(error, row_counts[table]);
+		}
+	}
+
+	for (size_t i = 0; i < buffers.size(); i++)
+	{
+		buffers[i].clear();
+		row_counts[i] = 0;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	handled_count += pending;
+	done_event.notify_all();
+}
+
+bool PgsqlWriteBehind_Impl::try_write_transaction(const std::vector<std::string> &buffers, const std::vector<int> &row_counts, int table, Exception &error)
+{
+	for (int attempt = 0; ; attempt++)
+	{
+		try
+		{
+			write_transaction(buffers, row_counts, table);
+			return true;
+		}
+		catch (const Exception &e)
+		{
+			error = e;
+		}
+		catch (const std::exception &e)
+		{
+			error = Exception(e.what());
+		}
+		catch (...)
+		{
+			error = Exception("Unknown exception while writing a PgsqlWriteBehind batch");
+		}
+
+		PGconn *db = provider->get_handle();
+		if (PQstatus(db) != CONNECTION_OK)
+		{
+			// Once per transaction, try again on a new connection
+			PQreset(db);
+			if (attempt == 0 && PQstatus(db) == CONNECTION_OK)
+				continue;
+		}
+		else
+		{
+			PQclear(PQexec(db, "ROLLBACK"));
+		}
+		return false;
+	}
+}
+
+void PgsqlWriteBehind_Impl::report_failure(const Exception &error, int lost_rows)
+{
+	failed_count += lost_rows;
+	PgsqlWriteBehind::ErrorHandler handler;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		handler = error_handler;
+	}
+	if (handler)
+	{
+		try
+		{
+			handler(error, lost_rows);
+		}
+		catch (...)
+		{
+		}
+	}
+}
+
+void PgsqlWriteBehind_Impl::write_transaction(const std::vector<std::string> &buffers, const std::vector<int> &row_counts, int only_table)
+{
+	PGconn *db = provider->get_handle();
+	execute("BEGIN");
+	if (!synchronous_commit)
+		execute("SET LOCAL synchronous_commit = off");
+
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	for (size_t table = 0; table < tables.size(); table++)
+	{
+		if (row_counts[table] == 0 || (only_table >= 0 && static_cast<int>(table) != only_table))
+			continue;
+
+		std::unique_ptr<PGresult, decltype(deleter)> copy_result(PQexec(db, tables[table].copy_statement.c_str()), deleter);
+		if (PQresultStatus(copy_result.get()) != PGRES_COPY_IN)
+			provider->throw_result_error(copy_result.get());
+
+		if (PQputCopyData(db, buffers[table].data(), buffers[table].size()) != 1 || PQputCopyEnd(db, nullptr) != 1)
+			throw Exception(PQerrorMessage(db));
+
+		std::unique_ptr<PGresult, decltype(deleter)> result(PQgetResult(db), deleter);
+		for (PGresult *next = PQgetResult(db); next; next = PQgetResult(db))
+			PQclear(next);
+		if (PQresultStatus(result.get()) != PGRES_COMMAND_OK)
+			provider->throw_result_error(result.get());
+	}
+
+	execute("COMMIT");
+}
+
+void PgsqlWriteBehind_Impl::execute(const char *sql)
+{
+	PGresult *result = PQexec(provider->get_handle(), sql);
+	auto deleter = [](PGresult *ptr) {if (ptr) {PQclear(ptr);} };
+	std::unique_ptr<PGresult, decltype(deleter)> result_uniqueptr(result, deleter);
+	if (PQresultStatus(result) != PGRES_COMMAND_OK)
+		provider->throw_result_error(result);
+}
+
+}; // namespace clan
@@ -0,0 +1,140 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "Pgsql/pgsql_array.h"
+#include "Pgsql/pgsql_binary.h"
+#include "Pgsql/pg_type.h"
+
+#include <climits>
+#include <string>
+#include <vector>
+
+using namespace clan;
+
+namespace
+{
+	template<typename T>
+	std::vector<T> decode(const std::string &value, Oid array_type, int format)
+	{
+		std::vector<T> out;
+		PgsqlArray::decode(value.data(), value.size(), array_type, format, out);
+		return out;
+	}
+
+	/// \brief Binary text[] of one NULL followed by "x".
+	std::string binary_text_array_with_null()
+	{
+		std::string out;
+		PgsqlBinary::write_int32(out, 1); // Dimensions
+		PgsqlBinary::write_int32(out, 1); // Has NULL
+		PgsqlBinary::write_int32(out, TEXTOID);
+		PgsqlBinary::write_int32(out, 2); // Size
+		PgsqlBinary::write_int32(out, 1); // Lower bound
+		PgsqlBinary::write_int32(out, -1);
+		PgsqlBinary::write_int32(out, 1);
+		out += 'x';
+		return out;
+	}
+
+	void test_binary()
+	{
+		const std::vector<int> ints{ INT_MIN, -1, 0, INT_MAX };
+		const std::string encoded = PgsqlArray::encode(ints);
+		CHECK(decode<int>(encoded, INT4ARRAYOID, 1) == ints);
+		const std::vector<long long> wide = decode<long long>(encoded, INT4ARRAYOID, 1);
+		CHECK(wide.size() == 4 && wide[0] == INT_MIN && wide[3] == INT_MAX);
+		CHECK_THROWS(decode<short>(encoded, INT4ARRAYOID, 1));
+
+		const std::vector<float> floats{ 1.5f, -0.25f };
+		const std::vector<double> doubles = decode<double>(PgsqlArray::encode(floats), FLOAT4ARRAYOID, 1);
+		CHECK(doubles.size() == 2 && doubles[0] == 1.5 && doubles[1] == -0.25);
+
+		const std::vector<std::string> strings{ "", "a,b", "{\"}" };
+		CHECK(decode<std::string>(PgsqlArray::encode(strings), TEXTARRAYOID, 1) == strings);
+		CHECK(decode<std::string>(PgsqlArray::encode(std::vector<std::string>()), TEXTARRAYOID, 1).empty());
+
+		const std::vector<std::string> with_null = decode<std::string>(binary_text_array_with_null(), TEXTARRAYOID, 1);
+		CHECK(with_null.size() == 2 && with_null[0].empty() && with_null[1] == "x");
+
+		// Truncated values throw rather than reading past their end
+		CHECK_THROWS(decode<int>(encoded.substr(0, encoded.size() - 1), INT4ARRAYOID, 1));
+		CHECK_THROWS(decode<int>(encoded.substr(0, 8), INT4ARRAYOID, 1));
+	}
+
+	void test_text()
+	{
+		const std::vector<long long> ints = decode<long long>("{1,-2,9223372036854775807}", INT8ARRAYOID, 0);
+		CHECK(ints.size() == 3 && ints[1] == -2 && ints[2] == LLONG_MAX);
+		CHECK(decode<int>("{}", INT4ARRAYOID, 0).empty());
+		CHECK_THROWS(decode<int>("{1,NULL}", INT4ARRAYOID, 0));
+
+		const std::vector<std::string> strings = decode<std::string>("{plain,\"a,b\",\"q\\\"uote\",\"back\\\\slash\",NULL,\"NULL\"}", TEXTARRAYOID, 0);
+		CHECK(strings.size() == 6);
+		CHECK(strings[0] == "plain");
+		CHECK(strings[1] == "a,b");
+		CHECK(strings[2] == "q\"uote");
+		CHECK(strings[3] == "back\\slash");
+		CHECK(strings[4].empty());
+		CHECK(strings[5] == "NULL");
+
+		// Boxes are separated by semicolons, their coordinates by commas
+		const std::vector<std::string> box_texts = decode<std::string>("{(2,2),(0,0);(3,1),(1,-1)}", BOXARRAYOID, 0);
+		CHECK(box_texts.size() == 2 && box_texts[0] == "(2,2),(0,0)" && box_texts[1] == "(3,1),(1,-1)");
+		const std::vector<Rectd> boxes = decode<Rectd>("{(2,2),(0,0);(3,1),(1,-1)}", BOXARRAYOID, 0);
+		CHECK(boxes.size() == 2);
+		CHECK(boxes[1].left == 1 && boxes[1].top == -1 && boxes[1].right == 3 && boxes[1].bottom == 1);
+		const std::vector<Rectd> binary_boxes = decode<Rectd>(PgsqlArray::encode(boxes), BOXARRAYOID, 1);
+		CHECK(binary_boxes.size() == 2);
+		CHECK(binary_boxes[1].left == 1 && binary_boxes[1].top == -1 && binary_boxes[1].right == 3 && binary_boxes[1].bottom == 1);
+
+		const std::vector<Vec2d> points = decode<Vec2d>("{\"(1,2)\",\"(-0.5,3)\"}", POINTARRAYOID, 0);
+		CHECK(points.size() == 2 && points[1].x == -0.5 && points[1].y == 3);
+		const std::vector<Vec2d> binary_points = decode<Vec2d>(PgsqlArray::encode(points), POINTARRAYOID, 1);
+		CHECK(binary_points.size() == 2 && binary_points[0].x == 1 && binary_points[0].y == 2);
+
+		CHECK_THROWS(decode<int>("{1,2", INT4ARRAYOID, 0));
+		CHECK_THROWS(decode<std::string>("{\"open}", TEXTARRAYOID, 0));
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_binary();
+		test_text();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,117 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "ClanLib/Pgsql/pgsql_bulk_sync.h"
+#include "ClanLib/Core/System/databuffer.h"
+
+#include <cstdio>
+#include <string>
+
+using namespace clan;
+
+namespace
+{
+	const std::string header("PGCOPY\n\377\r\n\0\0\0\0\0\0\0\0\0", 19);
+	const std::string trailer("\377\377", 2);
+
+	void test_encoding()
+	{
+		PgsqlBulkSync sync("players", { "id", "name", "score", "active", "avatar" }, { "id" });
+		CHECK(sync.get_row_count() == 0);
+		CHECK(sync.get_copy_data() == header + trailer);
+
+		sync.add(7).add("ab").add(0.5).add(true).add(DataBuffer("\0\1", 2));
+		sync.add(-2LL).add_null().add(-1.0).add(false).add_null();
+		CHECK(sync.get_row_count() == 2);
+
+		// Each row is its column count, then the length and bytes of each value, big endian
+		const std::string first_row(
+			"\0\5"
+			"\0\0\0\10" "\0\0\0\0\0\0\0\7"
+			"\0\0\0\2" "ab"
+			"\0\0\0\10" "\77\340\0\0\0\0\0\0"
+			"\0\0\0\1" "\1"
+			"\0\0\0\2" "\0\1", 43);
+		const std::string second_row(
+			"\0\5"
+			"\0\0\0\10" "\377\377\377\377\377\377\377\376"
+			"\377\377\377\377"
+			"\0\0\0\10" "\277\360\0\0\0\0\0\0"
+			"\0\0\0\1" "\0"
+			"\377\377\377\377", 39);
+		CHECK(sync.get_copy_data() == header + first_row + second_row + trailer);
+
+		sync.clear();
+		CHECK(sync.get_row_count() == 0);
+		CHECK(sync.get_copy_data() == header + trailer);
+	}
+
+	void test_errors()
+	{
+		CHECK_THROWS(PgsqlBulkSync("players", { }, { }));
+		CHECK_THROWS(PgsqlBulkSync("players", { "id" }, { }));
+		CHECK_THROWS(PgsqlBulkSync("players", { "id" }, { "name" }));
+
+		PgsqlBulkSync sync("players", { "id", "name" }, { "id" });
+		sync.add(1);
+		CHECK(sync.get_row_count() == 0);
+		CHECK_THROWS(sync.get_copy_data());
+		sync.add("one");
+		CHECK(sync.get_row_count() == 1);
+
+		// Nulls fit any column, other values must be of the kind of the column
+		sync.add_null().add_null();
+		CHECK_THROWS(sync.add("two"));
+		sync.add(2);
+		CHECK_THROWS(sync.add(2.0));
+		sync.add("two");
+		CHECK(sync.get_row_count() == 3);
+
+		// clear forgets the kinds of the columns
+		sync.clear();
+		sync.add("three").add(3);
+		CHECK(sync.get_row_count() == 1);
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_encoding();
+		test_errors();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,126 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "Pgsql/pgsql_geometry.h"
+#include "Pgsql/pg_type.h"
+
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace clan;
+
+namespace
+{
+	std::string binary_text(const std::string &value, Oid type)
+	{
+		return PgsqlGeometry::to_text(value.data(), value.size(), type);
+	}
+
+	void test_binary()
+	{
+		char point[PgsqlGeometry::point_size];
+		PgsqlGeometry::store_point(point, Vec2d(1.5, -2));
+		const Vec2d read = PgsqlGeometry::decode_point(point, sizeof(point), POINTOID, 1);
+		CHECK(read.x == 1.5 && read.y == -2);
+		CHECK(binary_text(std::string(point, sizeof(point)), POINTOID) == "(1.5,-2)");
+		CHECK_THROWS(PgsqlGeometry::decode_point(point, sizeof(point) - 1, POINTOID, 1));
+
+		// Coordinates print in their shortest exact form
+		PgsqlGeometry::store_point(point, Vec2d(0.1, 1e300));
+		CHECK(binary_text(std::string(point, sizeof(point)), POINTOID) == "(0.1,1e+300)");
+		PgsqlGeometry::store_point(point, Vec2d(std::numeric_limits<double>::quiet_NaN(), -std::numeric_limits<double>::infinity()));
+		CHECK(binary_text(std::string(point, sizeof(point)), POINTOID) == "(NaN,-Infinity)");
+
+		char box[PgsqlGeometry::box_size];
+		PgsqlGeometry::store_box(box, Rectd(0, -1, 3, 2));
+		const Rectd read_box = PgsqlGeometry::decode_box(box, sizeof(box), BOXOID, 1);
+		CHECK(read_box.left == 0 && read_box.top == -1 && read_box.right == 3 && read_box.bottom == 2);
+		CHECK(binary_text(std::string(box, sizeof(box)), BOXOID) == "(3,2),(0,-1)");
+
+		char circle[PgsqlGeometry::circle_size];
+		PgsqlGeometry::store_circle(circle, Circled(Vec2d(1, 2), 0.5));
+		const Circled read_circle = PgsqlGeometry::decode_circle(circle, sizeof(circle), CIRCLEOID, 1);
+		CHECK(read_circle.position.x == 1 && read_circle.position.y == 2 && read_circle.radius == 0.5);
+		CHECK(binary_text(std::string(circle, sizeof(circle)), CIRCLEOID) == "<(1,2),0.5>");
+
+		const std::vector<Vec2d> triangle{ Vec2d(0, 0), Vec2d(1, 0), Vec2d(0, 1) };
+		const std::string polygon = PgsqlGeometry::encode(triangle);
+		std::vector<Vec2d> points;
+		PgsqlGeometry::decode_polygon(polygon.data(), polygon.size(), POLYGONOID, 1, points);
+		CHECK(points.size() == 3 && points[1].x == 1 && points[2].y == 1);
+		CHECK(binary_text(polygon, POLYGONOID) == "((0,0),(1,0),(0,1))");
+		CHECK_THROWS(PgsqlGeometry::decode_polygon(polygon.data(), polygon.size() - 8, POLYGONOID, 1, points));
+	}
+
+	void test_text()
+	{
+		const std::string point = "(1.5,-2e1)";
+		const Vec2d read = PgsqlGeometry::decode_point(point.data(), point.size(), POINTOID, 0);
+		CHECK(read.x == 1.5 && read.y == -20);
+
+		const std::string segment = "[(1,2),(3,4)]";
+		const LineSegment2d read_segment = PgsqlGeometry::decode_line_segment(segment.data(), segment.size(), LSEGOID, 0);
+		CHECK(read_segment.p.x == 1 && read_segment.p.y == 2 && read_segment.q.x == 3 && read_segment.q.y == 4);
+
+		// The server prints the upper corner first
+		const std::string box = "(3,2),(0,-1)";
+		const Rectd read_box = PgsqlGeometry::decode_box(box.data(), box.size(), BOXOID, 0);
+		CHECK(read_box.left == 0 && read_box.top == -1 && read_box.right == 3 && read_box.bottom == 2);
+
+		const std::string circle = "<(1,2),0.5>";
+		const Circled read_circle = PgsqlGeometry::decode_circle(circle.data(), circle.size(), CIRCLEOID, 0);
+		CHECK(read_circle.position.x == 1 && read_circle.position.y == 2 && read_circle.radius == 0.5);
+
+		std::vector<Vec2d> points;
+		const std::string open_path = "[(0,0),(1,1),(2,0)]";
+		PgsqlGeometry::decode_polygon(open_path.data(), open_path.size(), PATHOID, 0, points);
+		CHECK(points.size() == 3 && points[2].x == 2);
+
+		const std::string bad = "(1,";
+		CHECK_THROWS(PgsqlGeometry::decode_point(bad.data(), bad.size(), POINTOID, 0));
+		CHECK_THROWS(PgsqlGeometry::decode_circle(point.data(), point.size(), CIRCLEOID, 0));
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_binary();
+		test_text();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
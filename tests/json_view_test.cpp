@@ -0,0 +1,144 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "ClanLib/Pgsql/pgsql_json_view.h"
+
+#include <string>
+#include <vector>
+
+using namespace clan;
+
+// Built twice, against the SSE2 scan and against the portable one (CLANPGSQL_JSON_SCALAR),
+// so both must give the tokens these checks expect
+
+namespace
+{
+	/// \brief Canonical text of every value reachable from view.
+	std::string dump(const PgsqlJsonView &view)
+	{
+		std::string out;
+		switch (view.get_type())
+		{
+		case PgsqlJsonView::type_object:
+			{
+				out = "{";
+				const std::vector<std::string> names = view.get_member_names();
+				for (size_t i = 0; i < names.size(); i++)
+					out += "<" + names[i] + ">=" + dump(view[names[i]]) + ";";
+				return out + "}";
+			}
+		case PgsqlJsonView::type_array:
+			out = "[";
+			for (int i = 0; i < view.get_size(); i++)
+				out += dump(view[i]) + ";";
+			return out + "]";
+		case PgsqlJsonView::type_string:
+			return "<" + view.to_string() + ">";
+		case PgsqlJsonView::type_number:
+		case PgsqlJsonView::type_boolean:
+		case PgsqlJsonView::type_null:
+			return view.to_json();
+		default:
+			return "?";
+		}
+	}
+
+	void test_values()
+	{
+		PgsqlJsonView view("{\"a\": {\"b\": [10, -2.5e1, true, null, \"x\"]}, \"n\": 123456789012}");
+		CHECK(view.get_type() == PgsqlJsonView::type_object);
+		CHECK(view.get_size() == 2);
+		CHECK(view["a"]["b"].get_size() == 5);
+		CHECK(view["a"]["b"][1].to_number() == -25);
+		CHECK(view.get_path("a.b.0").to_int64() == 10);
+		CHECK(view.get_path("a.b.2").to_boolean());
+		CHECK(view.get_path("a.b.3").is_null());
+		CHECK(view.get_path("a.b.4").to_string() == "x");
+		CHECK(view["n"].to_int64() == 123456789012LL);
+		CHECK(view["missing"].is_undefined());
+		CHECK(view["a"]["b"][5].is_undefined());
+		CHECK(view["a"]["b"].to_json() == "[10, -2.5e1, true, null, \"x\"]");
+		CHECK_THROWS(view["a"]["b"][1].to_int64());
+
+		CHECK_THROWS(PgsqlJsonView("[1, 2"));
+		CHECK_THROWS(PgsqlJsonView("{\"a\": [1}]"));
+		CHECK_THROWS(PgsqlJsonView("[\"open]"));
+	}
+
+	void test_escapes()
+	{
+		const std::string document = "{\"k\\\"ey\": \"v\\\\\\\\\", \"s\": \"{[:,]}\\\"\", \"a\": [\"\\\\\", \"\\u00e9\\n\", true, 7]}";
+		const std::string expected = "{<k\"ey>=<v\\\\>;<s>=<{[:,]}\">;<a>=[<\\>;<\xc3\xa9\n>;true;7;];}";
+
+		// Shift the document over every position of the 16 byte blocks, so each
+		// backslash, escaped quote and structural character meets a block edge
+		for (int padding = 0; padding < 48; padding++)
+		{
+			const PgsqlJsonView view(std::string(padding, ' ') + document);
+			CHECK(dump(view) == expected);
+			CHECK(view["a"].get_size() == 4);
+		}
+
+		// Long runs of backslashes, an odd one escaping the quote that follows
+		for (int count = 1; count < 40; count++)
+		{
+			const std::string backslashes(2 * count, '\\');
+			const PgsqlJsonView view("[\"" + backslashes + "\", \"" + backslashes + "\\\"\", 1]");
+			CHECK(view.get_size() == 3);
+			CHECK(view[0].to_string() == std::string(count, '\\'));
+			CHECK(view[1].to_string() == std::string(count, '\\') + "\"");
+			CHECK(view[2].to_int64() == 1);
+		}
+
+		// A string spanning several blocks, full of structural characters
+		std::string text;
+		for (int i = 0; i < 20; i++)
+			text += "{[,:]}\\\"";
+		const PgsqlJsonView view("{\"t\": \"" + text + "\", \"u\": 1}");
+		CHECK(view.get_size() == 2);
+		CHECK(view["u"].to_int64() == 1);
+		CHECK(view["t"].to_string().size() == 20 * 7);
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_values();
+		test_escapes();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
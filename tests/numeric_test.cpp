@@ -0,0 +1,203 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "Pgsql/pgsql_numeric.h"
+#include "Pgsql/pgsql_value.h"
+#include "Pgsql/pgsql_binary.h"
+#include "Pgsql/pg_type.h"
+
+#include <climits>
+#include <string>
+#include <vector>
+
+using namespace clan;
+
+namespace
+{
+	/// \brief Binary NUMERIC made of the given sign, weight, display scale and base 10000 digits.
+	std::string numeric(unsigned short sign, int weight, int display_scale, const std::vector<int> &digits)
+	{
+		std::string out;
+		PgsqlBinary::write_int16(out, digits.size());
+		PgsqlBinary::write_int16(out, weight);
+		PgsqlBinary::write_uint16(out, sign);
+		PgsqlBinary::write_uint16(out, display_scale);
+		for (size_t i = 0; i < digits.size(); i++)
+			PgsqlBinary::write_int16(out, digits[i]);
+		return out;
+	}
+
+	long long binary_int64(const std::string &value, int scale)
+	{
+		return PgsqlNumeric::decode_int64(value.data(), value.size(), NUMERICOID, 1, scale);
+	}
+
+	long long text_int64(const std::string &value, int scale)
+	{
+		return PgsqlNumeric::decode_int64(value.data(), value.size(), NUMERICOID, 0, scale);
+	}
+
+	PgsqlValue value_of(const std::string &value, int format)
+	{
+		return PgsqlValue(value.data(), value.size(), NUMERICOID, format);
+	}
+
+	const unsigned short positive = 0x0000;
+	const unsigned short negative = 0x4000;
+
+	void test_special_values()
+	{
+		const std::string nan = numeric(0xC000, 0, 0, std::vector<int>());
+		const std::string infinity = numeric(0xD000, 0, 0, std::vector<int>());
+		const std::string negative_infinity = numeric(0xF000, 0, 0, std::vector<int>());
+		CHECK(PgsqlNumeric::to_text(nan.data(), nan.size()) == "NaN");
+		CHECK(PgsqlNumeric::to_text(infinity.data(), infinity.size()) == "Infinity");
+		CHECK(PgsqlNumeric::to_text(negative_infinity.data(), negative_infinity.size()) == "-Infinity");
+		CHECK_THROWS(binary_int64(nan, 0));
+		CHECK_THROWS(binary_int64(infinity, 2));
+		CHECK_THROWS(text_int64("NaN", 0));
+		CHECK_THROWS(text_int64("-Infinity", 0));
+		CHECK_THROWS(value_of(nan, 1).to_int());
+		CHECK(value_of(nan, 1).to_string() == "NaN");
+
+		// Zero has no digit; a negative sign on it is ignored
+		CHECK(binary_int64(numeric(positive, 0, 2, std::vector<int>()), 2) == 0);
+		CHECK(binary_int64(numeric(negative, 0, 2, std::vector<int>()), 2) == 0);
+		CHECK(text_int64("-0.00", 2) == 0);
+		CHECK(text_int64("+0", 0) == 0);
+		const std::string zero = PgsqlNumeric::encode(0LL, 3);
+		CHECK(PgsqlNumeric::to_text(zero.data(), zero.size()) == "0.000");
+
+		CHECK_THROWS(text_int64("", 0));
+		CHECK_THROWS(text_int64("1.2.3", 0));
+		CHECK_THROWS(binary_int64(std::string("\0\1", 2), 0));
+	}
+
+	void test_weights_and_scales()
+	{
+		// 12345678.9 has the groups 1234 5678 9000, the first one of weight 1
+		const std::string value = numeric(positive, 1, 1, std::vector<int>{ 1234, 5678, 9000 });
+		CHECK(PgsqlNumeric::to_text(value.data(), value.size()) == "12345678.9");
+		CHECK(binary_int64(value, 0) == 12345679);
+		CHECK(binary_int64(value, 1) == 123456789);
+		CHECK(binary_int64(value, 4) == 123456789000LL);
+
+		// Weights far from the unit
+		const std::string large = numeric(positive, 30, 0, std::vector<int>{ 1 });
+		CHECK_THROWS(binary_int64(large, 0));
+		CHECK(PgsqlNumeric::to_text(large.data(), large.size()) == "1" + std::string(120, '0'));
+		const std::string small = numeric(positive, -30, 124, std::vector<int>{ 5000 });
+		CHECK(binary_int64(small, 0) == 0);
+		CHECK(binary_int64(small, PgsqlNumeric::max_scale) == 0);
+		const std::string tenth_thousandth = numeric(negative, -1, 4, std::vector<int>{ 5 });
+		CHECK(binary_int64(tenth_thousandth, 4) == -5);
+		CHECK(binary_int64(tenth_thousandth, 3) == -1);
+		CHECK(text_int64("-0.0005", 3) == -1);
+		CHECK(text_int64("1.5e-3", 3) == 2);
+		CHECK(text_int64("12e2", 0) == 1200);
+
+		// Fixed point scales are positive and bounded
+		CHECK_THROWS(binary_int64(value, -1));
+		CHECK_THROWS(text_int64("1", -2));
+		CHECK_THROWS(text_int64("1", PgsqlNumeric::max_scale + 1));
+
+		// Encoding keeps the display scale and drops the zero groups
+		const std::string encoded = PgsqlNumeric::encode(-123450LL, 4);
+		CHECK(PgsqlNumeric::to_text(encoded.data(), encoded.size()) == "-12.3450");
+		CHECK(binary_int64(encoded, 4) == -123450);
+		CHECK(encoded == numeric(negative, 0, 4, std::vector<int>{ 12, 3450 }));
+	}
+
+	void test_integer_limits()
+	{
+		const std::string max = numeric(positive, 4, 0, std::vector<int>{ 922, 3372, 368, 5477, 5807 });
+		const std::string min = numeric(negative, 4, 0, std::vector<int>{ 922, 3372, 368, 5477, 5808 });
+		const std::string over = numeric(positive, 4, 0, std::vector<int>{ 922, 3372, 368, 5477, 5808 });
+		CHECK(binary_int64(max, 0) == LLONG_MAX);
+		CHECK(binary_int64(min, 0) == LLONG_MIN);
+		CHECK_THROWS(binary_int64(over, 0));
+		CHECK_THROWS(binary_int64(max, 1));
+		CHECK(text_int64("9223372036854775807", 0) == LLONG_MAX);
+		CHECK(text_int64("-9223372036854775808", 0) == LLONG_MIN);
+		CHECK_THROWS(text_int64("9223372036854775808", 0));
+		CHECK_THROWS(text_int64("-9223372036854775809", 0));
+		CHECK(PgsqlNumeric::encode(LLONG_MAX, 0) == max);
+		CHECK(PgsqlNumeric::encode(LLONG_MIN, 0) == min);
+		const std::string scaled_min = PgsqlNumeric::encode(LLONG_MIN, 18);
+		CHECK(PgsqlNumeric::to_text(scaled_min.data(), scaled_min.size()) == "-9.223372036854775808");
+
+#ifdef __SIZEOF_INT128__
+		const __int128 max128 = static_cast<__int128>((static_cast<unsigned __int128>(1) << 127) - 1);
+		const __int128 min128 = -max128 - 1;
+		const std::string encoded_max = PgsqlNumeric::encode(max128, 0);
+		const std::string encoded_min = PgsqlNumeric::encode(min128, 0);
+		CHECK(PgsqlNumeric::to_text(encoded_max.data(), encoded_max.size()) == "170141183460469231731687303715884105727");
+		CHECK(PgsqlNumeric::to_text(encoded_min.data(), encoded_min.size()) == "-170141183460469231731687303715884105728");
+		CHECK(PgsqlNumeric::decode_int128(encoded_max.data(), encoded_max.size(), NUMERICOID, 1, 0) == max128);
+		CHECK(PgsqlNumeric::decode_int128(encoded_min.data(), encoded_min.size(), NUMERICOID, 1, 0) == min128);
+		const std::string over128 = "170141183460469231731687303715884105728";
+		CHECK_THROWS(PgsqlNumeric::decode_int128(over128.data(), over128.size(), NUMERICOID, 0, 0));
+		const std::string scaled = PgsqlNumeric::encode(max128, PgsqlNumeric::max_scale);
+		CHECK(PgsqlNumeric::decode_int128(scaled.data(), scaled.size(), NUMERICOID, 1, PgsqlNumeric::max_scale) == max128);
+#endif
+	}
+
+	void test_value_conversions()
+	{
+		// Both formats truncate toward zero when read as integers
+		const std::string positive_value = numeric(positive, 0, 1, std::vector<int>{ 2, 7000 });
+		const std::string negative_value = numeric(negative, 0, 1, std::vector<int>{ 2, 7000 });
+		CHECK(value_of(positive_value, 1).to_int() == 2);
+		CHECK(value_of(negative_value, 1).to_int() == -2);
+		CHECK(value_of(negative_value, 1).to_int64() == -2);
+		CHECK(value_of("2.7", 0).to_int() == 2);
+		CHECK(value_of("-2.7", 0).to_int64() == -2);
+		CHECK(value_of(positive_value, 1).to_fixed(0) == 3);
+		CHECK(value_of(negative_value, 1).to_string() == "-2.7");
+		CHECK(value_of(negative_value, 1).to_double() == -2.7);
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_special_values();
+		test_weights_and_scales();
+		test_integer_limits();
+		test_value_conversions();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
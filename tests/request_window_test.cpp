@@ -0,0 +1,153 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "Pgsql/pgsql_request_window.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace clan;
+
+namespace
+{
+	struct Requests
+	{
+		Requests() : runs(0), sum(0) { }
+
+		std::vector<int> values;
+		int runs;
+		int sum;
+	};
+
+	typedef PgsqlRequestWindow<Requests> Window;
+
+	std::shared_ptr<Window::Batch> submit(Window &window, int value)
+	{
+		std::unique_lock<std::mutex> lock(window.mutex);
+		return window.submit(lock,
+			[&](Requests &requests) { requests.values.push_back(value); return requests.values.size(); },
+			[](Requests &requests)
+			{
+				requests.runs++;
+				requests.sum = 0;
+				for (int v : requests.values)
+					requests.sum += v;
+				if (requests.sum < 0)
+					throw std::runtime_error("negative");
+			});
+	}
+
+	void test_single_request()
+	{
+		Window window(8, 0);
+		std::shared_ptr<Window::Batch> batch = submit(window, 5);
+		CHECK(batch->done && batch->closed && !batch->error);
+		CHECK(batch->content.values.size() == 1 && batch->content.runs == 1 && batch->content.sum == 5);
+		CHECK(window.batch_count == 1);
+
+		// The leader waits for the window to close, without other callers
+		Window waiting(8, 50);
+		const auto start = std::chrono::steady_clock::now();
+		submit(waiting, 1);
+		CHECK(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50));
+	}
+
+	void test_full_batches()
+	{
+		// A full batch runs at once, well before its 10 s window
+		const int threads = 16;
+		const int max_size = 4;
+		Window window(max_size, 10000);
+		std::vector<std::shared_ptr<Window::Batch> > batches(threads);
+		std::vector<std::thread> callers;
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < threads; i++)
+			callers.push_back(std::thread([&, i] { batches[i] = submit(window, i + 1); }));
+		for (std::thread &caller : callers)
+			caller.join();
+		CHECK(std::chrono::steady_clock::now() - start < std::chrono::seconds(5));
+
+		// Every request was run exactly once, in a batch of max_size
+		CHECK(window.batch_count == threads / max_size);
+		int total = 0;
+		for (int i = 0; i < threads; i++)
+		{
+			const Requests &requests = batches[i]->content;
+			CHECK(batches[i]->done && !batches[i]->error);
+			CHECK(requests.runs == 1 && requests.values.size() == static_cast<size_t>(max_size));
+			int found = 0;
+			for (int v : requests.values)
+				found += v == i + 1;
+			CHECK(found == 1);
+			total += requests.sum;
+		}
+		CHECK(total == max_size * threads * (threads + 1) / 2);
+	}
+
+	void test_errors()
+	{
+		// Every caller of a failed batch gets its error
+		Window window(2, 10000);
+		std::shared_ptr<Window::Batch> first;
+		std::thread caller([&] { first = submit(window, -10); });
+		std::shared_ptr<Window::Batch> second = submit(window, 3);
+		caller.join();
+		CHECK(first == second);
+		CHECK(second->error);
+		CHECK(second->content.runs == 1);
+
+		// The next batch starts afresh
+		std::shared_ptr<Window::Batch> third;
+		std::thread next([&] { third = submit(window, 1); });
+		std::shared_ptr<Window::Batch> fourth = submit(window, 2);
+		next.join();
+		CHECK(third == fourth && third != second && !third->error && third->content.sum == 3);
+		CHECK(window.batch_count == 2);
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_single_request();
+		test_full_batches();
+		test_errors();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
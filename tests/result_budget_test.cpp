@@ -0,0 +1,202 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "ClanLib/Pgsql/pgsql_connection.h"
+#include "ClanLib/Pgsql/pgsql_command.h"
+#include "ClanLib/Pgsql/pgsql_reader.h"
+#include "ClanLib/Pgsql/pgsql_exception.h"
+#include "ClanLib/Database/db_command.h"
+#include "ClanLib/Database/db_reader.h"
+#include "Pgsql/pgsql_result_spill.h"
+#include "Pgsql/pg_type.h"
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <libpq-fe.h>
+
+using namespace clan;
+
+namespace
+{
+	std::string row_text(int row)
+	{
+		// Embedded zero bytes must survive the file
+		return "row " + std::to_string(row) + std::string(1, '\0') + std::string(row % 50, 'x');
+	}
+
+	/// \brief Result of two text columns built without a server, the second one NULL on every third row.
+	PGresult *make_result(int rows)
+	{
+		PGresult *result = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+		PGresAttDesc columns[2];
+		std::memset(columns, 0, sizeof(columns));
+		columns[0].name = const_cast<char*>("id");
+		columns[0].typid = INT4OID;
+		columns[0].typlen = 4;
+		columns[0].atttypmod = -1;
+		columns[1].name = const_cast<char*>("text");
+		columns[1].typid = TEXTOID;
+		columns[1].typlen = -1;
+		columns[1].atttypmod = -1;
+		CHECK(PQsetResultAttrs(result, 2, columns));
+
+		for (int row = 0; row < rows; row++)
+		{
+			const std::string id = std::to_string(row);
+			const std::string text = row_text(row);
+			CHECK(PQsetvalue(result, row, 0, const_cast<char*>(id.c_str()), id.size()));
+			if (row % 3 == 2)
+				CHECK(PQsetvalue(result, row, 1, nullptr, -1));
+			else
+				CHECK(PQsetvalue(result, row, 1, const_cast<char*>(text.data()), text.size()));
+		}
+		return result;
+	}
+
+	void test_spill_round_trip()
+	{
+		const int rows = 5000;
+		PGresult *result = make_result(rows);
+		const std::string default_directory;
+		PgsqlResultSpill spill(default_directory);
+		for (int row = 0; row < rows; row++)
+			spill.append_row(result, row);
+		spill.finish();
+		PQclear(result);
+		CHECK(spill.get_row_count() == rows);
+		CHECK(spill.get_size() > 0);
+
+		size_t position = 0;
+		std::vector<const char*> values(2);
+		std::vector<int> lengths(2);
+		for (int row = 0; row < rows; row++)
+		{
+			spill.read_row(position, values, lengths);
+			CHECK(std::string(values[0], lengths[0]) == std::to_string(row));
+			if (row % 3 == 2)
+			{
+				CHECK(values[1] == nullptr);
+			}
+			else
+			{
+				CHECK(values[1] != nullptr);
+				CHECK(std::string(values[1], lengths[1]) == row_text(row));
+				CHECK(values[1][lengths[1]] == '\0');
+			}
+		}
+		CHECK(position == spill.get_size());
+	}
+
+	/// \brief Count the rows of each result of command, checking the first column counts up from 1.
+	std::vector<int> read_rows(PgsqlConnection &connection, DBCommand &command)
+	{
+		std::vector<int> counts;
+		DBReader reader = connection.execute_reader(command);
+		PgsqlReader results(reader);
+		do
+		{
+			int rows = 0;
+			while (reader.retrieve_row())
+				CHECK(reader.get_column_int(0) == ++rows);
+			counts.push_back(rows);
+		} while (results.next_result());
+		return counts;
+	}
+
+	bool too_large(PgsqlConnection &connection, DBCommand &command)
+	{
+		try
+		{
+			connection.execute_reader(command);
+		}
+		catch (const PgsqlResultTooLargeException &)
+		{
+			return true;
+		}
+		return false;
+	}
+
+	void test_budget(const std::string &connection_string)
+	{
+		PgsqlConnection connection(connection_string);
+		const size_t budget = 64 * 1024;
+		const std::string sql = "SELECT g, repeat('x', 100) FROM generate_series(1, 5000) g";
+
+		// A read only statement is streamed, then cancelled or moved to a file at the budget
+		DBCommand select = connection.create_command(sql);
+		connection.set_result_memory_budget(budget, PgsqlConnection::throw_on_overflow);
+		CHECK(too_large(connection, select));
+		connection.set_result_memory_budget(budget, PgsqlConnection::spill_to_disk);
+		CHECK(read_rows(connection, select) == std::vector<int>{ 5000 });
+
+		// Several statements are charged once received whole, each result on its own
+		DBCommand statements = connection.create_command(sql + "; SELECT 1");
+		PgsqlCommand(statements).set_multiple_statements(true);
+		connection.set_result_memory_budget(budget, PgsqlConnection::throw_on_overflow);
+		CHECK(too_large(connection, statements));
+		connection.set_result_memory_budget(budget, PgsqlConnection::spill_to_disk);
+		CHECK(read_rows(connection, statements) == (std::vector<int>{ 5000, 1 }));
+
+		// The global budget applies too
+		connection.set_result_memory_budget(0, PgsqlConnection::throw_on_overflow);
+		PgsqlConnection::set_global_result_memory_budget(budget);
+		CHECK(too_large(connection, select));
+		CHECK(too_large(connection, statements));
+		PgsqlConnection::set_global_result_memory_budget(0);
+
+		// Within the budget, the rows stay in memory
+		connection.set_result_memory_budget(16 * 1024 * 1024, PgsqlConnection::throw_on_overflow);
+		CHECK(read_rows(connection, select) == std::vector<int>{ 5000 });
+		CHECK(read_rows(connection, statements) == (std::vector<int>{ 5000, 1 }));
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_spill_round_trip();
+
+		// The budgets need a server, for instance CLANPGSQL_TEST_CONNECTION="host=localhost dbname=test"
+		const char *connection_string = std::getenv("CLANPGSQL_TEST_CONNECTION");
+		if (connection_string && *connection_string)
+			test_budget(connection_string);
+		else
+			std::printf("CLANPGSQL_TEST_CONNECTION is not set: the tests needing a server are skipped\n");
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,143 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "Pgsql/pgsql_row_queue.h"
+
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace clan;
+
+namespace
+{
+	std::string make_row(int producer, int index)
+	{
+		char text[32];
+		std::snprintf(text, sizeof(text), "%d:%06d\n", producer, index);
+		return text;
+	}
+
+	void test_single_thread()
+	{
+		PgsqlRowQueue queue(3);
+		std::vector<std::string> buffers(2);
+		std::vector<int> row_counts(2, 0);
+		CHECK(queue.is_empty());
+		CHECK(!queue.pop(buffers, row_counts));
+
+		// A capacity of 3 is rounded up to 4 cells
+		std::string row;
+		for (int i = 0; i < 4; i++)
+		{
+			row = make_row(i % 2, i);
+			CHECK(queue.push(i % 2, row));
+			CHECK(row.empty());
+		}
+		row = "full";
+		CHECK(!queue.push(0, row));
+		CHECK(row == "full");
+		CHECK(queue.get_enqueue_position() == 4);
+		CHECK(!queue.is_empty());
+
+		// Rows come out in order, appended to the buffer of their table
+		CHECK(queue.pop(buffers, row_counts));
+		CHECK(queue.push(1, row));
+		while (queue.pop(buffers, row_counts))
+		{
+		}
+		CHECK(queue.is_empty());
+		CHECK(buffers[0] == make_row(0, 0) + make_row(0, 2));
+		CHECK(buffers[1] == make_row(1, 1) + make_row(1, 3) + "full");
+		CHECK(row_counts[0] == 2 && row_counts[1] == 3);
+		CHECK(queue.get_enqueue_position() == 5);
+	}
+
+	void test_producers()
+	{
+		const int producer_count = 4;
+		const int rows_per_producer = 20000;
+		PgsqlRowQueue queue(64);
+
+		std::vector<std::thread> producers;
+		for (int producer = 0; producer < producer_count; producer++)
+		{
+			producers.push_back(std::thread([&queue, producer, rows_per_producer]
+			{
+				for (int i = 0; i < rows_per_producer; i++)
+				{
+					std::string row = make_row(producer, i);
+					while (!queue.push(producer, row))
+						std::this_thread::yield();
+				}
+			}));
+		}
+
+		std::vector<std::string> buffers(producer_count);
+		std::vector<int> row_counts(producer_count, 0);
+		int received = 0;
+		while (received < producer_count * rows_per_producer)
+		{
+			if (queue.pop(buffers, row_counts))
+				received++;
+			else
+				std::this_thread::yield();
+		}
+		for (auto &producer : producers)
+			producer.join();
+		CHECK(queue.is_empty());
+
+		// Every row arrives once, in the order its producer pushed it
+		for (int producer = 0; producer < producer_count; producer++)
+		{
+			std::string expected;
+			for (int i = 0; i < rows_per_producer; i++)
+				expected += make_row(producer, i);
+			CHECK(row_counts[producer] == rows_per_producer);
+			CHECK(buffers[producer] == expected);
+		}
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_single_thread();
+		test_producers();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
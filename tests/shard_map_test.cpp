@@ -0,0 +1,173 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "Pgsql/pgsql_shard_map.h"
+#include "Pgsql/pgsql_shard_merge.h"
+
+#include <climits>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+using namespace clan;
+
+namespace
+{
+	int shard_of(const PgsqlShardMap &map, int key)
+	{
+		return map.shard_of_hash(PgsqlShardMap::hash(std::to_string(key)));
+	}
+
+	void test_hash_ring()
+	{
+		PgsqlShardMap map;
+		CHECK_THROWS(map.shard_of_hash(0));
+		CHECK(PgsqlShardMap::hash("a") == PgsqlShardMap::hash("a"));
+		CHECK(PgsqlShardMap::hash("shard#0") != PgsqlShardMap::hash("shard#1"));
+
+		map.add_points("a", 0, 1);
+		CHECK(shard_of(map, 1) == 0 && shard_of(map, 2) == 0);
+
+		// Every shard gets a fair share of the keys
+		map.add_points("b", 1, 100);
+		map.add_points("c", 2, 100);
+		map.add_points("a", 0, 100);
+		const int key_count = 30000;
+		std::vector<int> before(key_count);
+		std::vector<int> counts(3, 0);
+		for (int key = 0; key < key_count; key++)
+		{
+			before[key] = shard_of(map, key);
+			counts[before[key]]++;
+		}
+		for (int count : counts)
+			CHECK(count > key_count / 4 && count < key_count / 2);
+
+		// A new shard only takes keys, about its share of them, and twice as many for twice the weight
+		map.add_points("d", 3, 200);
+		int moved = 0;
+		for (int key = 0; key < key_count; key++)
+		{
+			const int after = shard_of(map, key);
+			CHECK(after == before[key] || after == 3);
+			if (after != before[key])
+				moved++;
+		}
+		CHECK(moved > key_count * 3 / 10 && moved < key_count * 7 / 10);
+	}
+
+	void test_key_ranges()
+	{
+		PgsqlShardMap map;
+		CHECK_THROWS(map.shard_of_range(0));
+		map.set_key_range(0, 0);
+		map.set_key_range(100, 1);
+		map.set_key_range(1000, 2);
+		CHECK_THROWS(map.shard_of_range(-1));
+		CHECK(map.shard_of_range(0) == 0);
+		CHECK(map.shard_of_range(99) == 0);
+		CHECK(map.shard_of_range(100) == 1);
+		CHECK(map.shard_of_range(999) == 1);
+		CHECK(map.shard_of_range(LLONG_MAX) == 2);
+
+		map.set_key_range(100, 2);
+		CHECK(map.shard_of_range(500) == 2);
+		map.set_key_range(LLONG_MIN, 1);
+		CHECK(map.shard_of_range(-1) == 1);
+	}
+
+	void test_compare_numeric_text()
+	{
+		using PgsqlShardMerge::compare_numeric_text;
+		CHECK(compare_numeric_text("1.10", "1.1") == 0);
+		CHECK(compare_numeric_text("007", "7") == 0);
+		CHECK(compare_numeric_text("-0.00", "0") == 0);
+		CHECK(compare_numeric_text("10", "9.99") == 1);
+		CHECK(compare_numeric_text("0.05", "0.5") == -1);
+		CHECK(compare_numeric_text("-10", "-9") == -1);
+		CHECK(compare_numeric_text("-0.5", "0.1") == -1);
+		CHECK(compare_numeric_text("123456789012345678901234567890.5", "123456789012345678901234567890.49") == 1);
+		CHECK(compare_numeric_text("-123456789012345678901234567890.5", "-123456789012345678901234567890.49") == -1);
+
+		// -Infinity, the numbers, Infinity, then NaN
+		CHECK(compare_numeric_text("-Infinity", "-99999999") == -1);
+		CHECK(compare_numeric_text("Infinity", "99999999") == 1);
+		CHECK(compare_numeric_text("NaN", "Infinity") == 1);
+		CHECK(compare_numeric_text("NaN", "NaN") == 0);
+	}
+
+	void test_parse_iso_datetime()
+	{
+		using PgsqlShardMerge::parse_iso_datetime;
+		const long long day = 86400LL * 1000000;
+		CHECK(parse_iso_datetime("1970-01-01") == 0);
+		CHECK(parse_iso_datetime("1970-01-02") == day);
+		CHECK(parse_iso_datetime("1969-12-31 23:59:59.5") == -500000);
+		CHECK(parse_iso_datetime("2000-01-01 00:00:00.123") - parse_iso_datetime("2000-01-01") == 123000);
+		CHECK(parse_iso_datetime("2000-03-01") - parse_iso_datetime("2000-02-28") == 2 * day);
+
+		// Offsets of timestamptz
+		CHECK(parse_iso_datetime("2000-01-01 00:00:00+02") == parse_iso_datetime("1999-12-31 22:00:00+00"));
+		CHECK(parse_iso_datetime("2000-01-01 05:30:00+05:30") == parse_iso_datetime("2000-01-01 00:00:00"));
+		CHECK(parse_iso_datetime("2000-01-01 00:00:00-00:00:10") == parse_iso_datetime("2000-01-01 00:00:10"));
+
+		// Years past 9999 and before Christ
+		CHECK(parse_iso_datetime("10000-01-01") - parse_iso_datetime("9999-12-31") == day);
+		CHECK(parse_iso_datetime("0001-01-01") - parse_iso_datetime("0001-12-31 BC") == day);
+		CHECK(parse_iso_datetime("0002-01-01 BC") < parse_iso_datetime("0001-01-01 BC"));
+		CHECK(parse_iso_datetime("0001-01-01 00:00:00+01 BC") < parse_iso_datetime("0001-01-01 00:00:00 BC"));
+
+		CHECK(parse_iso_datetime("infinity") == LLONG_MAX);
+		CHECK(parse_iso_datetime("-infinity") == LLONG_MIN);
+
+		CHECK_THROWS(parse_iso_datetime("01/02/2000"));
+		CHECK_THROWS(parse_iso_datetime("2000-13-01"));
+		CHECK_THROWS(parse_iso_datetime("2000-01-01 00:00"));
+		CHECK_THROWS(parse_iso_datetime("2000-01-01 00:00:00.1234567"));
+		CHECK_THROWS(parse_iso_datetime("2000-01-01 AD"));
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_hash_ring();
+		test_key_ranges();
+		test_compare_numeric_text();
+		test_parse_iso_datetime();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}
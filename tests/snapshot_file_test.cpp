@@ -0,0 +1,260 @@
+/*
+**  ClanLib SDK
+**  Copyright (c) 1997-2013 The ClanLib Team
+**
+**  This software is provided 'as-is', without any express or implied
+**  warranty.  In no event will the authors be held liable for any damages
+**  arising from the use of this software.
+**
+**  Permission is granted to anyone to use this software for any purpose,
+**  including commercial applications, and to alter it and redistribute it
+**  freely, subject to the following restrictions:
+**
+**  1. The origin of this software must not be misrepresented; you must not
+**     claim that you wrote the original software. If you use this software
+**     in a product, an acknowledgment in the product documentation would be
+**     appreciated but is not required.
+**  2. Altered source versions must be plainly marked as such, and must not be
+**     misrepresented as being the original software.
+**  3. This notice may not be removed or altered from any source distribution.
+**
+**  Note: Some of the libraries ClanLib may link to may have additional
+**  requirements or restrictions.
+**
+**  File Author(s):
+**
+**    Jeremy Cochoy
+*/
+
+
+#include "test.h"
+#include "ClanLib/Pgsql/pgsql_snapshot_file.h"
+#include "ClanLib/Database/db_reader.h"
+#include "Pgsql/pgsql_result_snapshot.h"
+#include "Pgsql/pg_type.h"
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <stdint.h>
+
+#include <libpq-fe.h>
+
+using namespace clan;
+
+namespace
+{
+	const char *path = "snapshot_file_test.snapshot";
+
+	// Offsets in the file, as documented in pgsql_snapshot_file.cpp and pgsql_result_snapshot.h
+	const size_t file_header_size = 40;
+	const size_t key_length_offset = 12;
+	const size_t snapshot_offset_offset = 24;
+	const size_t snapshot_size_offset = 32;
+	const size_t snapshot_header_size = 32;
+	const size_t column_size = 40;
+
+	std::shared_ptr<const PgsqlResultSnapshot> make_snapshot(int rows)
+	{
+		PGresult *result = PQmakeEmptyPGresult(nullptr, PGRES_TUPLES_OK);
+		PGresAttDesc columns[2];
+		std::memset(columns, 0, sizeof(columns));
+		columns[0].name = const_cast<char*>("id");
+		columns[0].typid = INT4OID;
+		columns[0].typlen = 4;
+		columns[0].atttypmod = -1;
+		columns[1].name = const_cast<char*>("name");
+		columns[1].typid = TEXTOID;
+		columns[1].typlen = -1;
+		columns[1].atttypmod = -1;
+		CHECK(PQsetResultAttrs(result, 2, columns));
+		for (int row = 0; row < rows; row++)
+		{
+			const std::string id = std::to_string(row);
+			const std::string name = "name " + id;
+			CHECK(PQsetvalue(result, row, 0, const_cast<char*>(id.c_str()), id.size()));
+			CHECK(PQsetvalue(result, row, 1, const_cast<char*>(name.c_str()), name.size()));
+		}
+		std::shared_ptr<const PgsqlResultSnapshot> snapshot = PgsqlResultSnapshot::create(result);
+		PQclear(result);
+		return snapshot;
+	}
+
+	/// \brief Contents of a snapshot file saved with key and version.
+	std::string make_file(const PgsqlResultSnapshot &snapshot, const std::string &key, const std::string &version)
+	{
+		const uint32_t byte_order = 0x01020304;
+		const uint32_t key_length = key.size();
+		const uint32_t version_length = version.size();
+		const uint64_t snapshot_offset = (file_header_size + key.size() + version.size() + 7) & ~uint64_t(7);
+		const uint64_t snapshot_size = snapshot.get_memory_size();
+
+		std::string file("CLPGSNF1", 8);
+		file.append(reinterpret_cast<const char*>(&byte_order), 4);
+		file.append(reinterpret_cast<const char*>(&key_length), 4);
+		file.append(reinterpret_cast<const char*>(&version_length), 4);
+		file.append(4, '\0');
+		file.append(reinterpret_cast<const char*>(&snapshot_offset), 8);
+		file.append(reinterpret_cast<const char*>(&snapshot_size), 8);
+		file += key + version;
+		file.resize(snapshot_offset, '\0');
+		file.append(snapshot.get_data(), snapshot.get_memory_size());
+		return file;
+	}
+
+	void write_file(const std::string &contents)
+	{
+		FILE *file = std::fopen(path, "wb");
+		CHECK(file != nullptr);
+		CHECK(std::fwrite(contents.data(), 1, contents.size(), file) == contents.size());
+		CHECK(std::fclose(file) == 0);
+	}
+
+	void set_uint64(std::string &contents, size_t offset, uint64_t value)
+	{
+		std::memcpy(&contents[offset], &value, sizeof(value));
+	}
+
+	/// \brief Open the file and read every value; returns false if it is refused.
+	bool open_and_read(const std::string &contents)
+	{
+		write_file(contents);
+		DBReader reader;
+		try
+		{
+			reader = PgsqlSnapshotFile::open(path);
+		}
+		catch (const Exception &)
+		{
+			return false;
+		}
+
+		// A corrupt value may still fail to convert, but never reads outside the file
+		try
+		{
+			while (reader.retrieve_row())
+			{
+				for (int column = 0; column < reader.get_column_count(); column++)
+					reader.get_column_string(column);
+			}
+		}
+		catch (const Exception &)
+		{
+		}
+		return true;
+	}
+
+	void test_valid_file()
+	{
+		std::shared_ptr<const PgsqlResultSnapshot> snapshot = make_snapshot(10);
+		write_file(make_file(*snapshot, "key", "version 1"));
+
+		DBReader reader = PgsqlSnapshotFile::open(path);
+		CHECK(reader.get_column_count() == 2);
+		int rows = 0;
+		while (reader.retrieve_row())
+		{
+			CHECK(reader.get_column_int(0) == rows);
+			CHECK(reader.get_column_string(1) == "name " + std::to_string(rows));
+			rows++;
+		}
+		CHECK(rows == 10);
+	}
+
+	void test_invalid_files()
+	{
+		std::remove(path);
+		CHECK_THROWS(PgsqlSnapshotFile::open(path));
+
+		std::shared_ptr<const PgsqlResultSnapshot> snapshot = make_snapshot(3);
+		const std::string valid = make_file(*snapshot, "key", "version");
+		const size_t snapshot_offset = (file_header_size + 10 + 7) & ~size_t(7);
+		CHECK(open_and_read(valid));
+
+		CHECK(!open_and_read(std::string()));
+		CHECK(!open_and_read(valid.substr(0, file_header_size - 1)));
+		CHECK(!open_and_read(valid.substr(0, valid.size() - 1)));
+
+		std::string corrupt = valid;
+		corrupt[7] = '2';
+		CHECK(!open_and_read(corrupt));
+
+		// Byte order of another machine
+		corrupt = valid;
+		std::swap(corrupt[8], corrupt[11]);
+		std::swap(corrupt[9], corrupt[10]);
+		CHECK(!open_and_read(corrupt));
+
+		// Key running over the snapshot
+		corrupt = valid;
+		corrupt[key_length_offset] = 100;
+		CHECK(!open_and_read(corrupt));
+		corrupt[key_length_offset + 3] = '\377';
+		CHECK(!open_and_read(corrupt));
+
+		// Snapshot misaligned, past the end of the file, or larger than it
+		corrupt = valid;
+		set_uint64(corrupt, snapshot_offset_offset, snapshot_offset + 1);
+		CHECK(!open_and_read(corrupt));
+		set_uint64(corrupt, snapshot_offset_offset, valid.size() + 8);
+		CHECK(!open_and_read(corrupt));
+		set_uint64(corrupt, snapshot_offset_offset, ~uint64_t(7));
+		CHECK(!open_and_read(corrupt));
+		corrupt = valid;
+		set_uint64(corrupt, snapshot_size_offset, snapshot->get_memory_size() + 1);
+		CHECK(!open_and_read(corrupt));
+		set_uint64(corrupt, snapshot_size_offset, ~uint64_t(0));
+		CHECK(!open_and_read(corrupt));
+
+		// Snapshot with a wrong size, too many columns, or offsets out of the buffer
+		const size_t first_column = snapshot_offset + snapshot_header_size;
+		corrupt = valid;
+		set_uint64(corrupt, snapshot_offset + 24, snapshot->get_memory_size() - 8);
+		CHECK(!open_and_read(corrupt));
+		corrupt = valid;
+		corrupt[snapshot_offset + 8] = 100;
+		CHECK(!open_and_read(corrupt));
+		corrupt = valid;
+		set_uint64(corrupt, first_column, snapshot->get_memory_size());
+		CHECK(!open_and_read(corrupt));
+		corrupt = valid;
+		set_uint64(corrupt, first_column + 24, snapshot->get_memory_size() - 8);
+		CHECK(!open_and_read(corrupt));
+		corrupt = valid;
+		set_uint64(corrupt, first_column + column_size + 32, snapshot->get_memory_size());
+		CHECK(!open_and_read(corrupt));
+	}
+
+	void test_corrupt_bytes()
+	{
+		// Whatever byte of the header and tables is damaged, nothing is read outside the file
+		std::shared_ptr<const PgsqlResultSnapshot> snapshot = make_snapshot(3);
+		const std::string valid = make_file(*snapshot, "key", "version");
+		for (size_t offset = 0; offset < valid.size(); offset++)
+		{
+			for (char value : { '\0', '\1', '\177', '\377' })
+			{
+				std::string corrupt = valid;
+				corrupt[offset] = value;
+				open_and_read(corrupt);
+			}
+		}
+		std::remove(path);
+	}
+}
+
+int main()
+{
+	try
+	{
+		test_valid_file();
+		test_invalid_files();
+		test_corrupt_bytes();
+	}
+	catch (const Exception &e)
+	{
+		std::fprintf(stderr, "Unexpected exception: %s\n", e.message.c_str());
+		return 1;
+	}
+	return 0;
+}